@@ -3,7 +3,9 @@ MCC DAQ HATs module.
 """
 from daqhats.hats import HatError, hat_list, HatIDs, TriggerModes, \
     OptionFlags, wait_for_interrupt, interrupt_state, \
-    interrupt_callback_enable, interrupt_callback_disable, HatCallback
+    interrupt_callback_enable, interrupt_callback_disable, HatCallback, \
+    ScanStream, interrupt_event_fd, interrupt_event_disable, \
+    wait_for_interrupt_async, ScanGroup
 from daqhats.mcc118 import mcc118
 from daqhats.mcc128 import mcc128, AnalogInputMode, AnalogInputRange
 from daqhats.mcc152 import mcc152, DIOConfigItem
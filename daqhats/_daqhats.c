@@ -0,0 +1,486 @@
+/*
+*   file _daqhats.c
+*   author Measurement Computing Corp.
+*   brief This file contains an optional CPython extension for the hot scan,
+*       single-point and DIO paths of the daqhats package.
+*
+*   The functions take the same arguments as the library functions they wrap
+*   and return the library result code (plus any values read) so the Python
+*   classes keep their existing error handling.  Each call releases the GIL
+*   while the library is executing, the same as ctypes.
+*
+*   The Python classes fall back to ctypes when this module is not built.
+*/
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdint.h>
+#include <string.h>
+#include <daqhats/daqhats.h>
+
+#define NUM_DIO_CHANNELS    8
+
+typedef int (*AInReadFunc)(uint8_t address, uint8_t channel, uint32_t options,
+    double* value);
+typedef int (*ScanReadFunc)(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* buffer,
+    uint32_t buffer_size_samples, uint32_t* samples_read_per_channel);
+typedef int (*ChannelCountFunc)(uint8_t address);
+
+/******************************************************************************
+  Get a writable, C-contiguous float64 buffer from obj.  Raises ValueError and
+  returns 0 if obj does not qualify.
+ *****************************************************************************/
+static int _get_scan_buffer(PyObject* obj, Py_buffer* view)
+{
+    if ((PyObject_GetBuffer(obj, view,
+        PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0))
+    {
+        PyErr_Clear();
+        PyErr_SetString(PyExc_ValueError,
+            "The buffer must be a writable, C-contiguous float64 array.");
+        return 0;
+    }
+
+    if ((view->itemsize != sizeof(double)) ||
+        (view->format == NULL) ||
+        ((strcmp(view->format, "d") != 0) &&
+         (strcmp(view->format, "<d") != 0) &&
+         (strcmp(view->format, "=d") != 0)))
+    {
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_ValueError,
+            "The buffer must be a writable, C-contiguous float64 array.");
+        return 0;
+    }
+
+    return 1;
+}
+
+/******************************************************************************
+  Return the integer value of an object that supports __index__ (int, bool,
+  numpy integers), or -1 if it doesn't.
+ *****************************************************************************/
+static long _index_value(PyObject* obj)
+{
+    PyObject* number;
+    long value;
+
+    if (!PyIndex_Check(obj) ||
+        ((number = PyNumber_Index(obj)) == NULL))
+    {
+        return -1;
+    }
+    value = PyLong_AsLong(number);
+    Py_DECREF(number);
+    return value;
+}
+
+/******************************************************************************
+  Build a port mask and value from a dictionary of channel:value pairs.
+  Raises ValueError and returns 0 if the dictionary is invalid.
+ *****************************************************************************/
+static int _parse_bit_dict(PyObject* dict, uint8_t* mask, uint8_t* values)
+{
+    PyObject* key;
+    PyObject* item;
+    Py_ssize_t pos = 0;
+    long channel;
+    long value;
+
+    if (!PyDict_Check(dict))
+    {
+        PyErr_SetString(PyExc_TypeError, "Expected a dictionary.");
+        return 0;
+    }
+
+    *mask = 0;
+    *values = 0;
+
+    while (PyDict_Next(dict, &pos, &key, &item))
+    {
+        channel = _index_value(key);
+        if ((channel < 0) || (channel >= NUM_DIO_CHANNELS))
+        {
+            PyErr_Clear();
+            PyErr_Format(PyExc_ValueError, "Invalid channel %S.", key);
+            return 0;
+        }
+
+        value = _index_value(item);
+        if ((value != 0) && (value != 1))
+        {
+            PyErr_Clear();
+            PyErr_Format(PyExc_ValueError,
+                "Invalid value %S, expecting 0 or 1.", item);
+            return 0;
+        }
+
+        *mask |= (uint8_t)(1 << channel);
+        if (value == 0)
+        {
+            *values &= (uint8_t)~(1 << channel);
+        }
+        else
+        {
+            *values |= (uint8_t)(1 << channel);
+        }
+    }
+
+    if (*mask == 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "No channels specified.");
+        return 0;
+    }
+
+    return 1;
+}
+
+/******************************************************************************
+  Common analog input and scan read implementations.
+ *****************************************************************************/
+static PyObject* _a_in_read(PyObject* args, AInReadFunc read_func)
+{
+    unsigned char address;
+    unsigned char channel;
+    unsigned int options;
+    double value = 0.0;
+    int result;
+
+    if (!PyArg_ParseTuple(args, "bbI", &address, &channel, &options))
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    result = read_func(address, channel, options, &value);
+    Py_END_ALLOW_THREADS
+
+    return Py_BuildValue("id", result, value);
+}
+
+static PyObject* _a_in_scan_read(PyObject* args, ScanReadFunc read_func)
+{
+    unsigned char address;
+    int samples_per_channel;
+    double timeout;
+    PyObject* obj;
+    Py_buffer view;
+    double* buffer = NULL;
+    uint32_t buffer_size = 0;
+    uint16_t status = 0;
+    uint32_t samples_read = 0;
+    int result;
+
+    if (!PyArg_ParseTuple(args, "bidO", &address, &samples_per_channel,
+        &timeout, &obj))
+    {
+        return NULL;
+    }
+
+    if (obj != Py_None)
+    {
+        if (!_get_scan_buffer(obj, &view))
+        {
+            return NULL;
+        }
+        buffer = (double*)view.buf;
+        buffer_size = (uint32_t)(view.len / sizeof(double));
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    result = read_func(address, &status, samples_per_channel, timeout, buffer,
+        buffer_size, &samples_read);
+    Py_END_ALLOW_THREADS
+
+    if (obj != Py_None)
+    {
+        PyBuffer_Release(&view);
+    }
+
+    return Py_BuildValue("iHk", result, status, (unsigned long)samples_read);
+}
+
+static PyObject* _a_in_scan_read_into(PyObject* args, ScanReadFunc read_func,
+    ChannelCountFunc count_func)
+{
+    unsigned char address;
+    double timeout;
+    PyObject* obj;
+    Py_buffer view;
+    uint32_t buffer_size;
+    uint16_t status = 0;
+    uint32_t samples_read = 0;
+    int num_channels;
+    int result;
+
+    if (!PyArg_ParseTuple(args, "bdO", &address, &timeout, &obj))
+    {
+        return NULL;
+    }
+
+    if (!_get_scan_buffer(obj, &view))
+    {
+        return NULL;
+    }
+    buffer_size = (uint32_t)(view.len / sizeof(double));
+
+    Py_BEGIN_ALLOW_THREADS
+    num_channels = count_func(address);
+    if (num_channels == 0)
+    {
+        result = RESULT_RESOURCE_UNAVAIL;
+    }
+    else
+    {
+        result = read_func(address, &status,
+            (int32_t)(buffer_size / num_channels), timeout, (double*)view.buf,
+            buffer_size, &samples_read);
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&view);
+
+    return Py_BuildValue("iHk", result, status, (unsigned long)samples_read);
+}
+
+/******************************************************************************
+  Board-specific analog input wrappers.
+ *****************************************************************************/
+static PyObject* mcc118_a_in_read_py(PyObject* self, PyObject* args)
+{
+    (void)self;
+    return _a_in_read(args, mcc118_a_in_read);
+}
+
+static PyObject* mcc118_a_in_scan_read_py(PyObject* self, PyObject* args)
+{
+    (void)self;
+    return _a_in_scan_read(args, mcc118_a_in_scan_read);
+}
+
+static PyObject* mcc118_a_in_scan_read_into_py(PyObject* self, PyObject* args)
+{
+    (void)self;
+    return _a_in_scan_read_into(args, mcc118_a_in_scan_read,
+        mcc118_a_in_scan_channel_count);
+}
+
+static PyObject* mcc128_a_in_read_py(PyObject* self, PyObject* args)
+{
+    (void)self;
+    return _a_in_read(args, mcc128_a_in_read);
+}
+
+static PyObject* mcc128_a_in_scan_read_py(PyObject* self, PyObject* args)
+{
+    (void)self;
+    return _a_in_scan_read(args, mcc128_a_in_scan_read);
+}
+
+static PyObject* mcc128_a_in_scan_read_into_py(PyObject* self, PyObject* args)
+{
+    (void)self;
+    return _a_in_scan_read_into(args, mcc128_a_in_scan_read,
+        mcc128_a_in_scan_channel_count);
+}
+
+static PyObject* mcc172_a_in_scan_read_py(PyObject* self, PyObject* args)
+{
+    (void)self;
+    return _a_in_scan_read(args, mcc172_a_in_scan_read);
+}
+
+static PyObject* mcc172_a_in_scan_read_into_py(PyObject* self, PyObject* args)
+{
+    (void)self;
+    return _a_in_scan_read_into(args, mcc172_a_in_scan_read,
+        mcc172_a_in_scan_channel_count);
+}
+
+/******************************************************************************
+  MCC 152 digital I/O wrappers.
+ *****************************************************************************/
+static PyObject* mcc152_dio_input_read_bit_py(PyObject* self, PyObject* args)
+{
+    unsigned char address;
+    unsigned char channel;
+    uint8_t value = 0;
+    int result;
+
+    (void)self;
+    if (!PyArg_ParseTuple(args, "bb", &address, &channel))
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    result = mcc152_dio_input_read_bit(address, channel, &value);
+    Py_END_ALLOW_THREADS
+
+    return Py_BuildValue("iB", result, value);
+}
+
+static PyObject* mcc152_dio_input_read_port_py(PyObject* self, PyObject* args)
+{
+    unsigned char address;
+    uint8_t value = 0;
+    int result;
+
+    (void)self;
+    if (!PyArg_ParseTuple(args, "b", &address))
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    result = mcc152_dio_input_read_port(address, &value);
+    Py_END_ALLOW_THREADS
+
+    return Py_BuildValue("iB", result, value);
+}
+
+static PyObject* mcc152_dio_output_write_bit_py(PyObject* self, PyObject* args)
+{
+    unsigned char address;
+    unsigned char channel;
+    unsigned char value;
+    int result;
+
+    (void)self;
+    if (!PyArg_ParseTuple(args, "bbb", &address, &channel, &value))
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    result = mcc152_dio_output_write_bit(address, channel, value);
+    Py_END_ALLOW_THREADS
+
+    return PyLong_FromLong(result);
+}
+
+static PyObject* mcc152_dio_output_write_port_py(PyObject* self,
+    PyObject* args)
+{
+    unsigned char address;
+    unsigned char value;
+    int result;
+
+    (void)self;
+    if (!PyArg_ParseTuple(args, "bb", &address, &value))
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    result = mcc152_dio_output_write_port(address, value);
+    Py_END_ALLOW_THREADS
+
+    return PyLong_FromLong(result);
+}
+
+static PyObject* mcc152_dio_output_write_dict_py(PyObject* self,
+    PyObject* args)
+{
+    unsigned char address;
+    PyObject* dict;
+    uint8_t mask;
+    uint8_t values;
+    uint8_t port = 0;
+    int result;
+
+    (void)self;
+    if (!PyArg_ParseTuple(args, "bO", &address, &dict) ||
+        !_parse_bit_dict(dict, &mask, &values))
+    {
+        return NULL;
+    }
+
+    // read-modify-write the whole port in one pass
+    Py_BEGIN_ALLOW_THREADS
+    result = mcc152_dio_output_read_port(address, &port);
+    if (result == RESULT_SUCCESS)
+    {
+        port = (port & ~mask) | values;
+        result = mcc152_dio_output_write_port(address, port);
+    }
+    Py_END_ALLOW_THREADS
+
+    return PyLong_FromLong(result);
+}
+
+static PyObject* mcc152_dio_config_write_dict_py(PyObject* self,
+    PyObject* args)
+{
+    unsigned char address;
+    unsigned char item;
+    PyObject* dict;
+    uint8_t mask;
+    uint8_t values;
+    uint8_t port = 0;
+    int result;
+
+    (void)self;
+    if (!PyArg_ParseTuple(args, "bbO", &address, &item, &dict) ||
+        !_parse_bit_dict(dict, &mask, &values))
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    result = mcc152_dio_config_read_port(address, item, &port);
+    if (result == RESULT_SUCCESS)
+    {
+        port = (port & ~mask) | values;
+        result = mcc152_dio_config_write_port(address, item, port);
+    }
+    Py_END_ALLOW_THREADS
+
+    return PyLong_FromLong(result);
+}
+
+static PyMethodDef _daqhats_methods[] =
+{
+    {"mcc118_a_in_read", mcc118_a_in_read_py, METH_VARARGS, NULL},
+    {"mcc118_a_in_scan_read", mcc118_a_in_scan_read_py, METH_VARARGS, NULL},
+    {"mcc118_a_in_scan_read_into", mcc118_a_in_scan_read_into_py,
+        METH_VARARGS, NULL},
+    {"mcc128_a_in_read", mcc128_a_in_read_py, METH_VARARGS, NULL},
+    {"mcc128_a_in_scan_read", mcc128_a_in_scan_read_py, METH_VARARGS, NULL},
+    {"mcc128_a_in_scan_read_into", mcc128_a_in_scan_read_into_py,
+        METH_VARARGS, NULL},
+    {"mcc172_a_in_scan_read", mcc172_a_in_scan_read_py, METH_VARARGS, NULL},
+    {"mcc172_a_in_scan_read_into", mcc172_a_in_scan_read_into_py,
+        METH_VARARGS, NULL},
+    {"mcc152_dio_input_read_bit", mcc152_dio_input_read_bit_py,
+        METH_VARARGS, NULL},
+    {"mcc152_dio_input_read_port", mcc152_dio_input_read_port_py,
+        METH_VARARGS, NULL},
+    {"mcc152_dio_output_write_bit", mcc152_dio_output_write_bit_py,
+        METH_VARARGS, NULL},
+    {"mcc152_dio_output_write_port", mcc152_dio_output_write_port_py,
+        METH_VARARGS, NULL},
+    {"mcc152_dio_output_write_dict", mcc152_dio_output_write_dict_py,
+        METH_VARARGS, NULL},
+    {"mcc152_dio_config_write_dict", mcc152_dio_config_write_dict_py,
+        METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef _daqhats_module =
+{
+    PyModuleDef_HEAD_INIT,
+    "_daqhats",
+    "Native implementation of the daqhats hot paths.",
+    -1,
+    _daqhats_methods,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+PyMODINIT_FUNC PyInit__daqhats(void)
+{
+    return PyModule_Create(&_daqhats_module);
+}
@@ -0,0 +1,60 @@
+"""
+Asyncio support for the MCC DAQ HAT library.
+
+This module requires Python 3.5 or later.  It is imported on demand by the
+*_async() methods so the rest of the package remains usable on older
+versions of Python.
+"""
+import asyncio
+import os
+from daqhats.hats import _scan_wait_begin, _scan_wait_end
+
+async def _wait_readable(event_fd):
+    """
+    Wait for a library event descriptor to become readable, then reset it.
+    """
+    # get_running_loop() is Python 3.7 or later; before that get_event_loop()
+    # returns the running loop when called from a coroutine
+    loop = getattr(asyncio, 'get_running_loop', asyncio.get_event_loop)()
+    future = loop.create_future()
+
+    def _ready():
+        if not future.done():
+            future.set_result(None)
+
+    loop.add_reader(event_fd, _ready)
+    try:
+        await future
+    finally:
+        loop.remove_reader(event_fd)
+
+    try:
+        os.read(event_fd, 8)
+    except (BlockingIOError, InterruptedError):
+        pass
+
+async def wait_for_interrupt(event_fd):
+    """
+    Wait for the interrupt event descriptor to be signaled.
+    """
+    await _wait_readable(event_fd)
+
+async def a_in_scan_read(board, samples_per_channel):
+    """
+    Wait until a scan has the requested data available or has stopped, then
+    read it without blocking.  Only one caller may wait on a scan at a time.
+    """
+    _scan_wait_begin(board)
+    try:
+        event_fd = board.a_in_scan_event_fd(samples_per_channel)
+        while True:
+            await _wait_readable(event_fd)
+            # the descriptor may hold a stale signal from an earlier threshold
+            status = board.a_in_scan_status()
+            if (not status.running or
+                    status.samples_available >= samples_per_channel):
+                break
+    finally:
+        _scan_wait_end(board)
+
+    return board.a_in_scan_read_numpy(samples_per_channel, 0)
@@ -2,12 +2,24 @@
 Wraps the global methods from the MCC Hat library for use in Python.
 """
 from collections import namedtuple
+import os
+import select
+import time
+from threading import Thread, Event, Lock
 from ctypes import cdll, Structure, c_ubyte, c_ushort, c_char, c_int, POINTER, \
-    CFUNCTYPE, c_void_p
+    CFUNCTYPE, c_void_p, c_double, byref
 from enum import IntEnum, unique
+try:
+    from queue import Queue
+except ImportError:
+    from Queue import Queue
 
 _HAT_CALLBACK = None
 
+# Addresses of the scans with a caller waiting on the scan event threshold
+_SCAN_WAITERS = set()
+_SCAN_WAITERS_LOCK = Lock()
+
 @unique
 class HatIDs(IntEnum):
     """Known MCC HAT IDs."""
@@ -339,6 +351,93 @@ def interrupt_callback_disable():
     if _libc.hat_interrupt_callback_disable() != 0:
         raise Exception("Could not disable callback function.")
 
+def interrupt_event_fd():
+    """
+    Get a file descriptor that becomes readable when an interrupt occurs.
+
+    The descriptor may be used with select, poll or an event loop.  Read 8
+    bytes from it to reset it before waiting again.  It is owned by the
+    library; call :py:func:`interrupt_event_disable` to close it.
+
+    This function only applies when using devices that can generate an
+    interrupt:
+
+    * MCC 152
+
+    Returns:
+        int: The file descriptor.
+
+    Raises:
+        Exception: Internal error creating the descriptor.
+    """
+    _libc = _load_daqhats_library()
+    if _libc == 0:
+        raise Exception("Could not load the library.")
+
+    _libc.hat_interrupt_event_enable.argtypes = [POINTER(c_int)]
+    _libc.hat_interrupt_event_enable.restype = c_int
+
+    event_fd = c_int(-1)
+    if _libc.hat_interrupt_event_enable(byref(event_fd)) != 0:
+        raise Exception("Could not enable the interrupt event.")
+
+    return event_fd.value
+
+def interrupt_event_disable():
+    """
+    Close the descriptor returned by :py:func:`interrupt_event_fd`.
+
+    Raises:
+        Exception: Internal error disabling the event.
+    """
+    _libc = _load_daqhats_library()
+    if _libc == 0:
+        return
+
+    _libc.hat_interrupt_event_disable.argtypes = []
+    _libc.hat_interrupt_event_disable.restype = c_int
+
+    if _libc.hat_interrupt_event_disable() != 0:
+        raise Exception("Could not disable the interrupt event.")
+
+def wait_for_interrupt_async():
+    """
+    Wait for an interrupt from a DAQ HAT to occur without blocking the
+    asyncio event loop.
+
+    Returns an awaitable for use in a coroutine (requires Python 3.5 or
+    later): ::
+
+        await wait_for_interrupt_async()
+
+    The interrupt is edge-signaled, so check the device interrupt status after
+    the awaitable completes.
+
+    Returns:
+        awaitable: Completes when an interrupt occurs.
+    """
+    from daqhats import aio
+    return aio.wait_for_interrupt(interrupt_event_fd())
+
+def _scan_wait_begin(board):
+    """
+    Claim the scan event threshold of a board for one waiter.  The library
+    keeps a single threshold per scan, so a second waiter would change it
+    under the first.
+    """
+    address = board.address()
+    with _SCAN_WAITERS_LOCK:
+        if address in _SCAN_WAITERS:
+            raise HatError(address, "Another read is waiting on this scan.")
+        _SCAN_WAITERS.add(address)
+
+def _scan_wait_end(board):
+    """
+    Release the scan event threshold claimed by :py:func:`_scan_wait_begin`.
+    """
+    with _SCAN_WAITERS_LOCK:
+        _SCAN_WAITERS.discard(board.address())
+
 class Hat(object): # pylint: disable=too-few-public-methods
     """
     DAQ HAT base class.
@@ -380,3 +479,410 @@ class Hat(object): # pylint: disable=too-few-public-methods
     def address(self):
         """Return the device address."""
         return self._address
+
+    @staticmethod
+    def _scan_buffer(out):
+        """
+        Return a ctypes array sharing memory with a caller-owned buffer and the
+        buffer size in samples.  The buffer may be a NumPy array or any object
+        supporting the buffer protocol, and must be writable, C-contiguous and
+        contain float64 values.  No data is copied.
+        """
+        view = memoryview(out)
+        if (view.readonly or not view.c_contiguous or
+                view.format not in ('d', '<d', '=d')):
+            view.release()
+            raise ValueError("The buffer must be a writable, C-contiguous "
+                             "float64 array.")
+        size = view.nbytes // view.itemsize
+        view.release()
+        return (c_double * size).from_buffer(out), size
+
+    @staticmethod
+    def _scan_frame(out, channel_count):
+        """
+        Return the size and the sample and channel strides, in samples, of a
+        2-D float64 NumPy array with one row per sample and one column per scan
+        channel.  The array does not need to be contiguous.
+        """
+        try:
+            valid = (out.ndim == 2 and out.dtype.char == 'd' and
+                     out.dtype.isnative and out.flags.writeable)
+        except AttributeError:
+            valid = False
+        if not valid:
+            raise ValueError("The frame must be a writable, 2-D float64 NumPy "
+                             "array.")
+        if out.shape[1] != channel_count:
+            raise ValueError("The frame must have one column per scan "
+                             "channel.")
+
+        rows = out.shape[0]
+        if rows == 0:
+            return 0, channel_count, 1
+
+        strides = []
+        for length, stride in zip(out.shape, out.strides):
+            if length <= 1:
+                # the stride of a single row or column is never used
+                stride = out.itemsize
+            if stride <= 0 or stride % out.itemsize != 0:
+                raise ValueError("The frame strides must be positive.")
+            strides.append(stride // out.itemsize)
+
+        size = (rows - 1) * strides[0] + (channel_count - 1) * strides[1] + 1
+        return size, strides[0], strides[1]
+
+class ScanStream(object):
+    """
+    Background reader for a running analog input scan.
+
+    Returned by the **a_in_scan_stream()** method of the scanning DAQ HATs and
+    used as an iterator.  A reader thread fills a ring of preallocated NumPy
+    blocks from the scan buffer while the caller processes previously filled
+    blocks.  The library reads release the Python GIL while waiting for data,
+    so several boards may be streamed concurrently from one process without
+    blocking Python code.
+
+    Each iteration returns a 1-D NumPy array of interleaved samples with
+    **block_size** samples per channel.  The array is owned by the stream and
+    is reused once the next block is requested, so copy it if it must be kept.
+    The last block of a finite scan may be shorter.  Iteration ends when the
+    scan completes or :py:func:`close` is called; a :py:class:`HatError` is
+    raised if the scan reports a hardware or buffer overrun.
+
+    Args:
+        board: The board object with an active scan.
+        block_size (int): The number of samples per channel in each block.
+        dtype: The NumPy data type of the blocks, float64 if unspecified.
+        depth (int): The number of blocks in the ring.
+    """
+    _POLL_TIMEOUT = 0.1
+
+    def __init__(self, board, block_size, dtype=None, depth=4):
+        import numpy
+
+        self._done = True
+        if block_size < 1:
+            raise ValueError("Invalid block_size {}.".format(block_size))
+        if depth < 2:
+            raise ValueError("Invalid depth {}.".format(depth))
+
+        self._board = board
+        self._num_channels = board.a_in_scan_channel_count()
+        if self._num_channels == 0:
+            raise HatError(board.address(), "Scan not active.")
+
+        samples = block_size * self._num_channels
+        if dtype is None:
+            dtype = numpy.float64
+        self._blocks = [numpy.empty(samples, dtype=dtype)
+                        for _ in range(depth)]
+        if self._blocks[0].dtype == numpy.float64:
+            self._scratch = None
+        else:
+            self._scratch = numpy.empty(samples, dtype=numpy.float64)
+
+        self._free = Queue()
+        self._filled = Queue()
+        for index in range(depth):
+            self._free.put(index)
+        self._current = None
+        self._stop = Event()
+        self._done = False
+
+        self._thread = Thread(target=self._reader)
+        self._thread.daemon = True
+        self._thread.start()
+
+    def _reader(self):
+        """
+        Reader thread: fill free blocks and pass them to the consumer.
+        """
+        try:
+            while not self._stop.is_set():
+                index = self._free.get()
+                if index is None:
+                    break
+                block = self._blocks[index]
+                target = block if self._scratch is None else self._scratch
+                count = 0
+                finished = False
+                while count < len(target) and not self._stop.is_set():
+                    result = self._board.a_in_scan_read_into(
+                        target[count:], self._POLL_TIMEOUT)
+                    count += (result.samples_read_per_channel *
+                              self._num_channels)
+                    if result.hardware_overrun or result.buffer_overrun:
+                        raise HatError(
+                            self._board.address(),
+                            "Hardware overrun." if result.hardware_overrun
+                            else "Buffer overrun.")
+                    if (not result.running and
+                            result.samples_read_per_channel == 0):
+                        finished = True
+                        break
+                if count > 0:
+                    if self._scratch is not None:
+                        block[:count] = self._scratch[:count]
+                    self._filled.put((index, count))
+                if finished:
+                    break
+        except Exception as error: # pylint: disable=broad-except
+            self._filled.put(error)
+            return
+        self._filled.put(None)
+
+    def __iter__(self):
+        return self
+
+    def __next__(self):
+        if self._current is not None:
+            # the consumer is finished with the previous block
+            self._free.put(self._current)
+            self._current = None
+        if self._done:
+            raise StopIteration
+        item = self._filled.get()
+        if item is None or isinstance(item, Exception):
+            self._done = True
+            self._thread.join()
+            if item is None:
+                raise StopIteration
+            raise item
+        self._current, count = item
+        block = self._blocks[self._current]
+        return block if count == len(block) else block[:count]
+
+    next = __next__     # Python 2
+
+    def close(self):
+        """
+        Stop the reader thread.  The scan itself is not stopped.
+        """
+        if not self._done:
+            self._stop.set()
+            self._free.put(None)
+            self._thread.join()
+            self._done = True
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+class ScanGroup(object):
+    """
+    Read synchronized scans from multiple boards as 2-D frames.
+
+    The boards must already have scans running from a common sample clock,
+    such as MCC 172s sharing a clock and trigger or MCC 118s using an external
+    clock.  Each :py:func:`read` returns a single NumPy array with one row per
+    sample and one column per channel, with the channels of each board in the
+    order the boards were passed.  Every board writes its samples directly into
+    its block of columns.  Rows that a board supplied beyond those available
+    from every other board are kept and returned first by the next read, so
+    the rows stay aligned: ::
+
+        group = ScanGroup([board0, board1, board2, board3])
+        result = group.read(1000, 5.0)
+        frame = result.data         # shape (1000, group.channel_count)
+
+    Args:
+        boards (list): The board objects (:py:class:`mcc118`,
+            :py:class:`mcc128` or :py:class:`mcc172`) with active scans.
+
+    Raises:
+        HatError: A scan is not active on one of the boards.
+        ValueError: No boards were specified.
+    """
+    _scan_read_type = namedtuple(
+        'ScanGroupRead', ['running', 'hardware_overrun', 'buffer_overrun',
+                          'triggered', 'timeout', 'data'])
+
+    def __init__(self, boards):
+        self._boards = list(boards)
+        if not self._boards:
+            raise ValueError("No boards specified.")
+
+        self._columns = []
+        self.channel_count = 0
+        for board in self._boards:
+            count = board.a_in_scan_channel_count()
+            if count == 0:
+                raise HatError(board.address(), "Scan not active.")
+            self._columns.append((self.channel_count,
+                                  self.channel_count + count))
+            self.channel_count += count
+
+        self._event_fds = None
+        self._scratch = None
+        # rows read from each board but not yet returned
+        self._pending = [None] * len(self._boards)
+
+    def _pending_rows(self, index):
+        """
+        Return the number of rows kept from an earlier read for a board.
+        """
+        pending = self._pending[index]
+        return 0 if pending is None else len(pending)
+
+    def _wait(self, samples_per_channel, timeout):
+        """
+        Wait for the boards to have data and return the number of rows that
+        every board can supply and the timeout status.
+        """
+        claimed = []
+        try:
+            for board in self._boards:
+                _scan_wait_begin(board)
+                claimed.append(board)
+            return self._wait_claimed(samples_per_channel, timeout)
+        finally:
+            for board in claimed:
+                _scan_wait_end(board)
+
+    def _wait_claimed(self, samples_per_channel, timeout):
+        """
+        :py:func:`_wait` with the event thresholds of the boards claimed.
+        """
+        clock = getattr(time, 'monotonic', time.time)
+        deadline = None if timeout < 0 else clock() + timeout
+
+        while True:
+            statuses = [board.a_in_scan_status() for board in self._boards]
+            counts = [status.samples_available + self._pending_rows(index)
+                      for index, status in enumerate(statuses)]
+            if samples_per_channel < 0:
+                break
+            ready = [(count >= samples_per_channel or not status.running)
+                     for count, status in zip(counts, statuses)]
+            if all(ready):
+                break
+            remaining = None if deadline is None else deadline - clock()
+            if remaining is not None and remaining <= 0:
+                break
+
+            if self._event_fds is None:
+                self._event_fds = [None] * len(self._boards)
+            waiting = []
+            for index, board in enumerate(self._boards):
+                if not ready[index]:
+                    self._event_fds[index] = board.a_in_scan_event_fd(
+                        samples_per_channel - self._pending_rows(index))
+                    waiting.append(self._event_fds[index])
+            for event_fd in select.select(waiting, [], [], remaining)[0]:
+                try:
+                    os.read(event_fd, 8)
+                except OSError:
+                    pass
+
+        available = min(counts)
+        if samples_per_channel < 0:
+            return available, False
+
+        rows = min(samples_per_channel, available)
+        return rows, (timeout > 0 and rows < samples_per_channel)
+
+    def read(self, samples_per_channel, timeout, dtype=None):
+        """
+        Read scan status and an aligned frame of data from all boards.
+
+        Args:
+            samples_per_channel (int): The number of samples per channel to
+                read from each board.  Specify -1 to read all of the samples
+                that are available on every board (the smallest count), or 0 to
+                only read the scan status.
+            timeout (float): The amount of time in seconds to wait for every
+                board to have the samples available.  Specify a negative number
+                to wait indefinitely, or 0 to return immediately with the
+                samples that are available on all boards.  Waiting does not hold
+                the GIL or poll the boards.
+            dtype: The NumPy data type of the frame (float64 or float32),
+                float64 if unspecified.
+
+        Returns:
+            namedtuple: A namedtuple containing the following field names:
+
+            * **running** (bool): True if any scan is running.
+            * **hardware_overrun** (bool): True if any board had a hardware
+              overrun.
+            * **buffer_overrun** (bool): True if any board had a scan buffer
+              overrun.
+            * **triggered** (bool): True if every scan has been triggered.
+            * **timeout** (bool): True if the timeout expired before every
+              board had the requested samples.
+            * **data** (NumPy array): The samples, one row per sample and
+              :py:attr:`channel_count` columns.
+
+        Raises:
+            HatError: A scan is not active, a board is not initialized, or
+                another read is waiting on one of the scans.
+            ValueError: Incorrect argument.
+        """
+        import numpy
+
+        dtype = numpy.dtype(numpy.float64 if dtype is None else dtype)
+        if dtype not in (numpy.float64, numpy.float32):
+            raise ValueError("Invalid dtype {}.".format(dtype))
+
+        rows, timed_out = self._wait(samples_per_channel, timeout)
+
+        if dtype == numpy.float64:
+            frame = numpy.empty((rows, self.channel_count), numpy.float64)
+        else:
+            # the library writes float64, so fill a reused frame and convert
+            if self._scratch is None or self._scratch.shape[0] < rows:
+                self._scratch = numpy.empty((rows, self.channel_count),
+                                            numpy.float64)
+            frame = self._scratch[:rows]
+
+        running = False
+        hardware_overrun = False
+        buffer_overrun = False
+        triggered = True
+        counts = []
+        for index, board in enumerate(self._boards):
+            first, last = self._columns[index]
+            columns = frame[:, first:last]
+
+            # rows kept from the previous read come first
+            kept = min(self._pending_rows(index), rows)
+            if kept > 0:
+                columns[:kept] = self._pending[index][:kept]
+                self._pending[index] = self._pending[index][kept:]
+                if len(self._pending[index]) == 0:
+                    self._pending[index] = None
+
+            result = board.a_in_scan_read_frame(columns[kept:], 0)
+            counts.append(kept + result.samples_read_per_channel)
+            running = running or result.running
+            hardware_overrun = hardware_overrun or result.hardware_overrun
+            buffer_overrun = buffer_overrun or result.buffer_overrun
+            triggered = triggered and result.triggered
+
+        # keep the rows that not every board supplied for the next read
+        rows = min(counts) if counts else 0
+        for index, count in enumerate(counts):
+            if count > rows:
+                first, last = self._columns[index]
+                extra = frame[rows:count, first:last].copy()
+                if self._pending[index] is not None:
+                    extra = numpy.concatenate((extra, self._pending[index]))
+                self._pending[index] = extra
+
+        data = frame[:rows]
+        if dtype != numpy.float64:
+            data = data.astype(dtype)
+
+        return self._scan_read_type(
+            running=running,
+            hardware_overrun=hardware_overrun,
+            buffer_overrun=buffer_overrun,
+            triggered=triggered,
+            timeout=timed_out,
+            data=data)
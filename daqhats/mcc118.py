@@ -2,11 +2,14 @@
 """
 Wraps all of the methods from the MCC 118 library for use in Python.
 """
-import sys
 from collections import namedtuple
 from ctypes import c_ubyte, c_int, c_ushort, c_ulong, c_long, c_double, \
-    POINTER, c_char_p, byref, create_string_buffer
-from daqhats.hats import Hat, HatError, OptionFlags
+    c_void_p, POINTER, c_char_p, byref, create_string_buffer
+try:
+    from daqhats import _daqhats as _native
+except ImportError:
+    _native = None
+from daqhats.hats import Hat, HatError, ScanStream, OptionFlags
 
 class mcc118(Hat): # pylint: disable=invalid-name
     """
@@ -28,6 +31,16 @@ class mcc118(Hat): # pylint: disable=invalid-name
 
     _MAX_SAMPLE_RATE = 100000.0
 
+    _scan_read_type = namedtuple(
+        'MCC118ScanRead',
+        ['running', 'hardware_overrun', 'buffer_overrun', 'triggered',
+         'timeout', 'data'])
+
+    _scan_read_into_type = namedtuple(
+        'MCC118ScanReadInto',
+        ['running', 'hardware_overrun', 'buffer_overrun', 'triggered',
+         'timeout', 'samples_read_per_channel'])
+
     _dev_info_type = namedtuple(
         'MCC118DeviceInfo', [
             'NUM_AI_CHANNELS', 'AI_MIN_CODE', 'AI_MAX_CODE',
@@ -101,8 +114,16 @@ class mcc118(Hat): # pylint: disable=invalid-name
             c_ubyte, POINTER(c_ulong)]
         self._lib.mcc118_a_in_scan_buffer_size.restype = c_int
 
+        self._lib.mcc118_a_in_scan_read.argtypes = [
+            c_ubyte, POINTER(c_ushort), c_long, c_double, c_void_p, c_ulong,
+            POINTER(c_ulong)]
         self._lib.mcc118_a_in_scan_read.restype = c_int
 
+        self._lib.mcc118_a_in_scan_read_strided.argtypes = [
+            c_ubyte, POINTER(c_ushort), c_long, c_double, c_void_p, c_ulong,
+            c_ulong, c_ulong, POINTER(c_ulong)]
+        self._lib.mcc118_a_in_scan_read_strided.restype = c_int
+
         self._lib.mcc118_a_in_scan_stop.argtypes = [c_ubyte]
         self._lib.mcc118_a_in_scan_stop.restype = c_int
 
@@ -112,6 +133,10 @@ class mcc118(Hat): # pylint: disable=invalid-name
         self._lib.mcc118_a_in_scan_channel_count.argtypes = [c_ubyte]
         self._lib.mcc118_a_in_scan_channel_count.restype = c_ubyte
 
+        self._lib.mcc118_a_in_scan_event_enable.argtypes = [
+            c_ubyte, c_ulong, POINTER(c_int)]
+        self._lib.mcc118_a_in_scan_event_enable.restype = c_int
+
         self._lib.mcc118_test_clock.argtypes = [
             c_ubyte, c_ubyte, POINTER(c_ubyte)]
         self._lib.mcc118_test_clock.restype = c_int
@@ -383,13 +408,18 @@ class mcc118(Hat): # pylint: disable=invalid-name
             raise ValueError("Invalid channel {0}. Must be 0-{1}.".format(
                 channel, self._AIN_NUM_CHANNELS-1))
 
-        data_value = c_double()
-
-        if (self._lib.mcc118_a_in_read(
+        if _native is not None:
+            result, value = _native.mcc118_a_in_read(
+                self._address, channel, options)
+        else:
+            data_value = c_double()
+            result = self._lib.mcc118_a_in_read(
                 self._address, channel, options, byref(data_value))
-                != self._RESULT_SUCCESS):
+            value = data_value.value
+
+        if result != self._RESULT_SUCCESS:
             raise HatError(self._address, "Incorrect response.")
-        return data_value.value
+        return value
 
     def a_in_scan_actual_rate(self, channel_count, sample_rate_per_channel):
         """
@@ -679,10 +709,6 @@ class mcc118(Hat): # pylint: disable=invalid-name
 
         num_channels = self._lib.mcc118_a_in_scan_channel_count(self._address)
 
-        self._lib.mcc118_a_in_scan_read.argtypes = [
-            c_ubyte, POINTER(c_ushort), c_long, c_double, POINTER(c_double),
-            c_ulong, POINTER(c_ulong)]
-
         samples_read_per_channel = c_ulong(0)
         samples_to_read = 0
         status = c_ushort(0)
@@ -736,17 +762,13 @@ class mcc118(Hat): # pylint: disable=invalid-name
 
         total_read = samples_read_per_channel.value * num_channels
 
-        # python 2 / 3 workaround for xrange
-        if sys.version_info.major > 2:
-            data_list = [data_buffer[i] for i in range(total_read)]
+        # slicing the ctypes array converts it to a list in a single call
+        if total_read > 0:
+            data_list = data_buffer[:total_read]
         else:
-            data_list = [data_buffer[i] for i in xrange(total_read)]
+            data_list = []
 
-        scan_status = namedtuple(
-            'MCC118ScanRead',
-            ['running', 'hardware_overrun', 'buffer_overrun', 'triggered',
-             'timeout', 'data'])
-        return scan_status(
+        return self._scan_read_type(
             running=(status.value & self._STATUS_RUNNING) != 0,
             hardware_overrun=(status.value & self._STATUS_HW_OVERRUN) != 0,
             buffer_overrun=(status.value & self._STATUS_BUFFER_OVERRUN) != 0,
@@ -799,18 +821,12 @@ class mcc118(Hat): # pylint: disable=invalid-name
         """
         try:
             import numpy
-            from numpy.ctypeslib import ndpointer
         except ImportError:
             raise
 
         if not self._initialized:
             raise HatError(self._address, "Not initialized.")
 
-        self._lib.mcc118_a_in_scan_read.argtypes = [
-            c_ubyte, POINTER(c_ushort), c_long, c_double,
-            ndpointer(c_double, flags="C_CONTIGUOUS"), c_ulong,
-            POINTER(c_ulong)]
-
         num_channels = self._lib.mcc118_a_in_scan_channel_count(self._address)
         samples_read_per_channel = c_ulong()
         status = c_ushort()
@@ -849,9 +865,15 @@ class mcc118(Hat): # pylint: disable=invalid-name
             raise ValueError("Invalid samples_per_channel {}.".format(
                 samples_per_channel))
 
-        result = self._lib.mcc118_a_in_scan_read(
-            self._address, byref(status), samples_to_read, timeout, data_buffer,
-            buffer_size, byref(samples_read_per_channel))
+        if _native is not None:
+            result, status.value, samples_read_per_channel.value = \
+                _native.mcc118_a_in_scan_read(
+                    self._address, samples_to_read, timeout, data_buffer)
+        else:
+            result = self._lib.mcc118_a_in_scan_read(
+                self._address, byref(status), samples_to_read, timeout,
+                data_buffer.ctypes.data if data_buffer is not None else None,
+                buffer_size, byref(samples_read_per_channel))
 
         if result == self._RESULT_BAD_PARAMETER:
             raise ValueError("Invalid parameter.")
@@ -865,14 +887,11 @@ class mcc118(Hat): # pylint: disable=invalid-name
 
         total_read = samples_read_per_channel.value * num_channels
 
-        if total_read < buffer_size:
-            data_buffer = numpy.resize(data_buffer, (total_read,))
+        if data_buffer is not None and total_read < buffer_size:
+            # return a view of the valid data rather than a resized copy
+            data_buffer = data_buffer[:total_read]
 
-        scan_status = namedtuple(
-            'MCC118ScanRead',
-            ['running', 'hardware_overrun', 'buffer_overrun', 'triggered',
-             'timeout', 'data'])
-        return scan_status(
+        return self._scan_read_type(
             running=(status.value & self._STATUS_RUNNING) != 0,
             hardware_overrun=(status.value & self._STATUS_HW_OVERRUN) != 0,
             buffer_overrun=(status.value & self._STATUS_BUFFER_OVERRUN) != 0,
@@ -880,6 +899,326 @@ class mcc118(Hat): # pylint: disable=invalid-name
             timeout=timed_out,
             data=data_buffer)
 
+    def a_in_scan_read_into(self, out, timeout):
+        """
+        Read scan status and data into a caller-owned buffer.
+
+        This function is similar to :py:func:`a_in_scan_read_numpy` except that
+        the data is written in place into **out** rather than into a newly
+        allocated array.  **out** may be a NumPy array or any other object
+        supporting the buffer protocol that is writable, C-contiguous, and
+        contains float64 values.  The same buffer can be reused for every read
+        so a continuous scan can be read without allocating memory or
+        converting data per call.
+
+        The number of samples per channel requested is the size of **out**
+        divided by the number of channels in the scan.  The samples are
+        interleaved by channel in the same order as :py:func:`a_in_scan_read`.
+
+        Args:
+            out (buffer): The buffer that receives the data.
+            timeout (float): The amount of time in seconds to wait for the
+                buffer to be filled.  Specify a negative number to wait
+                indefinitely, or 0 to return immediately with the samples that
+                are already in the scan buffer.  If the timeout is met and the
+                buffer has not been filled, then the function will return with
+                the amount that has been read and the timeout status set.
+
+        Returns:
+            namedtuple: A namedtuple containing the following field names:
+
+            * **running** (bool): True if the scan is running, False if it has
+              stopped or completed.
+            * **hardware_overrun** (bool): True if the hardware could not
+              acquire and unload samples fast enough and data was lost.
+            * **buffer_overrun** (bool): True if the background scan buffer was
+              not read fast enough and data was lost.
+            * **triggered** (bool): True if the trigger conditions have been met
+              and data acquisition started.
+            * **timeout** (bool): True if the timeout time expired before the
+              buffer was filled.
+            * **samples_read_per_channel** (int): The number of samples per
+              channel written to the start of **out**.
+
+        Raises:
+            HatError: A scan is not active, the board is not initialized, does
+                not respond, or responds incorrectly.
+            ValueError: **out** is not a writable, C-contiguous float64 buffer.
+        """
+        if not self._initialized:
+            raise HatError(self._address, "Not initialized.")
+
+        samples_read_per_channel = c_ulong()
+        status = c_ushort()
+        timed_out = False
+
+        if _native is not None:
+            result, status.value, samples_read_per_channel.value = \
+                _native.mcc118_a_in_scan_read_into(self._address, timeout, out)
+        else:
+            data_buffer, buffer_size = self._scan_buffer(out)
+
+            num_channels = self._lib.mcc118_a_in_scan_channel_count(
+                self._address)
+            if num_channels == 0:
+                raise HatError(self._address, "Scan not active.")
+
+            result = self._lib.mcc118_a_in_scan_read(
+                self._address, byref(status), buffer_size // num_channels,
+                timeout, data_buffer, buffer_size,
+                byref(samples_read_per_channel))
+
+        if result == self._RESULT_BAD_PARAMETER:
+            raise ValueError("Invalid parameter.")
+        elif result == self._RESULT_RESOURCE_UNAVAIL:
+            raise HatError(self._address, "Scan not active.")
+        elif result == self._RESULT_TIMEOUT:
+            timed_out = True
+        elif result != self._RESULT_SUCCESS:
+            raise HatError(self._address, "Incorrect response {}.".format(
+                result))
+
+        return self._scan_read_into_type(
+            running=(status.value & self._STATUS_RUNNING) != 0,
+            hardware_overrun=(status.value & self._STATUS_HW_OVERRUN) != 0,
+            buffer_overrun=(status.value & self._STATUS_BUFFER_OVERRUN) != 0,
+            triggered=(status.value & self._STATUS_TRIGGERED) != 0,
+            timeout=timed_out,
+            samples_read_per_channel=samples_read_per_channel.value)
+
+    def a_in_scan_read_planar(self, samples_per_channel, timeout):
+        """
+        Read scan status and data as one NumPy row per channel.
+
+        This is the same as :py:func:`a_in_scan_read_numpy` except that the
+        data is de-interleaved: **data** is a 2-D array with one row per scan
+        channel, so ``data[0]`` holds every sample of the first channel in the
+        scan.  The library writes the rows directly with a cache-blocked
+        transpose, so there is no separate de-interleave pass in Python.
+
+        Args:
+            samples_per_channel (int): The number of samples per channel to
+                read, as in :py:func:`a_in_scan_read_numpy`.
+            timeout (float): The amount of time in seconds to wait for the
+                samples to be read, as in :py:func:`a_in_scan_read_numpy`.
+
+        Returns:
+            namedtuple: The same fields as :py:func:`a_in_scan_read_numpy`,
+            with **data** a NumPy array of shape (channels, samples read).
+
+        Raises:
+            HatError: A scan is not active, the board is not initialized, does
+                not respond, or responds incorrectly.
+            ValueError: Incorrect argument.
+        """
+        try:
+            import numpy
+        except ImportError:
+            raise
+
+        if not self._initialized:
+            raise HatError(self._address, "Not initialized.")
+
+        num_channels = self._lib.mcc118_a_in_scan_channel_count(self._address)
+        if num_channels == 0:
+            raise HatError(self._address, "Scan not active.")
+
+        if samples_per_channel < 0:
+            # read all available data, ignoring the timeout
+            samples_to_read = self.a_in_scan_status().samples_available
+            timeout = 0
+        else:
+            samples_to_read = samples_per_channel
+
+        data = numpy.empty((num_channels, samples_to_read), numpy.float64)
+        result = self.a_in_scan_read_frame(data.T, timeout)
+
+        return self._scan_read_type(
+            running=result.running,
+            hardware_overrun=result.hardware_overrun,
+            buffer_overrun=result.buffer_overrun,
+            triggered=result.triggered,
+            timeout=result.timeout,
+            data=data[:, :result.samples_read_per_channel])
+
+    def a_in_scan_read_frame(self, out, timeout):
+        """
+        Read scan status and data into the rows of a 2-D NumPy array.
+
+        This is the same as :py:func:`a_in_scan_read_into` except that **out**
+        is a float64 NumPy array with one row per sample and one column per
+        scan channel, and it does not need to be contiguous.  A block of
+        columns in a larger array may be passed so several boards fill one
+        frame in place: ::
+
+            frame = numpy.empty((1000, 8))
+            board_a.a_in_scan_read_frame(frame[:, 0:4], 5.0)
+            board_b.a_in_scan_read_frame(frame[:, 4:8], 5.0)
+
+        The library writes each sample directly to its row and column.
+        :py:class:`ScanGroup` uses this method to read synchronized boards.
+
+        Args:
+            out (numpy.ndarray): The 2-D float64 array that receives the data.
+                The number of rows is the number of samples per channel to read.
+            timeout (float): The amount of time in seconds to wait for the
+                array to be filled.  Specify a negative number to wait
+                indefinitely, or 0 to return immediately with the samples that
+                are already in the scan buffer.
+
+        Returns:
+            namedtuple: The same fields as :py:func:`a_in_scan_read_into`, with
+            **samples_read_per_channel** the number of rows written to the
+            start of **out**.
+
+        Raises:
+            HatError: A scan is not active, the board is not initialized, does
+                not respond, or responds incorrectly.
+            ValueError: **out** is not a writable, 2-D float64 NumPy array with
+                one column per scan channel.
+        """
+        if not self._initialized:
+            raise HatError(self._address, "Not initialized.")
+
+        num_channels = self._lib.mcc118_a_in_scan_channel_count(self._address)
+        if num_channels == 0:
+            raise HatError(self._address, "Scan not active.")
+
+        buffer_size, sample_stride, channel_stride = self._scan_frame(
+            out, num_channels)
+
+        samples_read_per_channel = c_ulong()
+        status = c_ushort()
+        timed_out = False
+
+        result = self._lib.mcc118_a_in_scan_read_strided(
+            self._address, byref(status), out.shape[0], timeout,
+            out.ctypes.data, buffer_size, sample_stride, channel_stride,
+            byref(samples_read_per_channel))
+
+        if result == self._RESULT_BAD_PARAMETER:
+            raise ValueError("Invalid parameter.")
+        elif result == self._RESULT_RESOURCE_UNAVAIL:
+            raise HatError(self._address, "Scan not active.")
+        elif result == self._RESULT_TIMEOUT:
+            timed_out = True
+        elif result != self._RESULT_SUCCESS:
+            raise HatError(self._address, "Incorrect response {}.".format(
+                result))
+
+        return self._scan_read_into_type(
+            running=(status.value & self._STATUS_RUNNING) != 0,
+            hardware_overrun=(status.value & self._STATUS_HW_OVERRUN) != 0,
+            buffer_overrun=(status.value & self._STATUS_BUFFER_OVERRUN) != 0,
+            triggered=(status.value & self._STATUS_TRIGGERED) != 0,
+            timeout=timed_out,
+            samples_read_per_channel=samples_read_per_channel.value)
+
+    def a_in_scan_stream(self, block_size, dtype=None, depth=4):
+        """
+        Stream scan data in fixed-size blocks.
+
+        Returns a :py:class:`ScanStream` iterator for the active scan.  A
+        background thread reads the scan buffer into a ring of **depth**
+        preallocated NumPy arrays, each holding **block_size** samples per
+        channel interleaved by channel, and the iterator returns each block as
+        it is filled: ::
+
+            with board.a_in_scan_stream(1000) as stream:
+                for block in stream:
+                    process(block)
+
+        A block is reused after the next block is requested, so copy it if it
+        must be kept.  Iteration ends when the scan completes.  Multiple boards
+        may be streamed concurrently because the reads do not hold the Python
+        GIL while waiting for data.
+
+        Args:
+            block_size (int): The number of samples per channel in each block.
+            dtype: The NumPy data type of each block (float64 or float32),
+                float64 if unspecified.
+            depth (int): The number of blocks in the ring, default 4.
+
+        Returns:
+            :py:class:`ScanStream`: The block iterator.
+
+        Raises:
+            HatError: A scan is not active or the board is not initialized.
+            ValueError: Incorrect argument.
+        """
+        if not self._initialized:
+            raise HatError(self._address, "Not initialized.")
+
+        return ScanStream(self, block_size, dtype, depth)
+
+    def a_in_scan_event_fd(self, samples_per_channel):
+        """
+        Get a file descriptor that signals when scan data is available.
+
+        The descriptor becomes readable when at least **samples_per_channel**
+        samples per channel are in the scan buffer, or when the scan stops.  It
+        may be used with select, poll or an event loop instead of blocking in
+        :py:func:`a_in_scan_read`.  Read 8 bytes from it to reset it before
+        waiting again.  Calling this method again changes the threshold and
+        returns the same descriptor, so only one caller should wait on it at a
+        time.
+
+        The descriptor is owned by the library and is closed by
+        :py:func:`a_in_scan_cleanup`.
+
+        Args:
+            samples_per_channel (int): The number of samples per channel that
+                must be available before the descriptor is signaled.
+
+        Returns:
+            int: The file descriptor.
+
+        Raises:
+            HatError: A scan is not active or the board is not initialized.
+        """
+        if not self._initialized:
+            raise HatError(self._address, "Not initialized.")
+
+        event_fd = c_int(-1)
+        result = self._lib.mcc118_a_in_scan_event_enable(
+            self._address, samples_per_channel, byref(event_fd))
+
+        if result == self._RESULT_RESOURCE_UNAVAIL:
+            raise HatError(self._address, "Scan not active.")
+        elif result != self._RESULT_SUCCESS:
+            raise HatError(self._address, "Incorrect response {}.".format(
+                result))
+
+        return event_fd.value
+
+    def a_in_scan_read_async(self, samples_per_channel):
+        """
+        Read scan data without blocking the asyncio event loop.
+
+        Returns an awaitable for use in a coroutine (requires Python 3.5 or
+        later).  It waits on :py:func:`a_in_scan_event_fd` until
+        **samples_per_channel** samples per channel are available or the scan
+        stops, then returns the result of
+        :py:func:`a_in_scan_read_numpy` with a timeout of 0: ::
+
+            result = await board.a_in_scan_read_async(1000)
+
+        Args:
+            samples_per_channel (int): The number of samples per channel to
+                wait for and read.
+
+        Returns:
+            awaitable: Completes with the same namedtuple as
+            :py:func:`a_in_scan_read_numpy`.
+
+        Raises:
+            HatError: A scan is not active, the board is not initialized, or
+                another read (such as a :py:class:`ScanGroup` read) is waiting
+                on this scan.
+        """
+        from daqhats import aio
+        return aio.a_in_scan_read(self, samples_per_channel)
+
     def a_in_scan_channel_count(self):
         """
         Read the number of channels in the current analog input scan.
@@ -6,6 +6,10 @@ from collections import namedtuple
 from ctypes import c_ubyte, c_int, c_char_p, c_ulong, c_double, POINTER, \
     create_string_buffer, byref
 from enum import IntEnum, unique
+try:
+    from daqhats import _daqhats as _native
+except ImportError:
+    _native = None
 from daqhats.hats import Hat, HatError, OptionFlags
 
 @unique
@@ -353,14 +357,19 @@ class mcc152(Hat): # pylint: disable=invalid-name,too-many-public-methods
         if channel not in range(self._DIO_NUM_CHANNELS):
             raise ValueError("Invalid channel {}.".format(channel))
 
-        value = c_ubyte()
-        result = self._lib.mcc152_dio_input_read_bit(
-            self._address, channel, byref(value))
+        if _native is not None:
+            result, value = _native.mcc152_dio_input_read_bit(
+                self._address, channel)
+        else:
+            c_value = c_ubyte()
+            result = self._lib.mcc152_dio_input_read_bit(
+                self._address, channel, byref(c_value))
+            value = c_value.value
 
         if result != self._RESULT_SUCCESS:
             raise HatError(self._address, "Incorrect response.")
 
-        return value.value
+        return value
 
     def dio_input_read_port(self):
         """
@@ -396,14 +405,18 @@ class mcc152(Hat): # pylint: disable=invalid-name,too-many-public-methods
         if not self._initialized:
             raise HatError(self._address, "Not initialized.")
 
-        value = c_ubyte()
-        result = self._lib.mcc152_dio_input_read_port(
-            self._address, byref(value))
+        if _native is not None:
+            result, value = _native.mcc152_dio_input_read_port(self._address)
+        else:
+            c_value = c_ubyte()
+            result = self._lib.mcc152_dio_input_read_port(
+                self._address, byref(c_value))
+            value = c_value.value
 
         if result != self._RESULT_SUCCESS:
             raise HatError(self._address, "Incorrect response.")
 
-        return value.value
+        return value
 
     def dio_input_read_tuple(self):
         """
@@ -434,15 +447,9 @@ class mcc152(Hat): # pylint: disable=invalid-name,too-many-public-methods
         if not self._initialized:
             raise HatError(self._address, "Not initialized.")
 
-        value = c_ubyte()
-        result = self._lib.mcc152_dio_input_read_port(
-            self._address, byref(value))
-
-        if result != self._RESULT_SUCCESS:
-            raise HatError(self._address, "Incorrect response.")
+        reg = self.dio_input_read_port()
 
         # convert byte to tuple of bits
-        reg = value.value
         mytuple = tuple(((reg >> i) & 0x01) for i in range(
             self._DIO_NUM_CHANNELS))
 
@@ -475,8 +482,12 @@ class mcc152(Hat): # pylint: disable=invalid-name,too-many-public-methods
             raise ValueError(
                 "Invalid value {}, expecting 0 or 1.".format(value))
 
-        result = self._lib.mcc152_dio_output_write_bit(
-            self._address, channel, value)
+        if _native is not None:
+            result = _native.mcc152_dio_output_write_bit(
+                self._address, channel, value)
+        else:
+            result = self._lib.mcc152_dio_output_write_bit(
+                self._address, channel, value)
 
         if result != self._RESULT_SUCCESS:
             raise HatError(self._address, "Incorrect response.")
@@ -517,8 +528,12 @@ class mcc152(Hat): # pylint: disable=invalid-name,too-many-public-methods
         if values not in range(256):
             raise ValueError("Invalid values {}.".format(values))
 
-        result = self._lib.mcc152_dio_output_write_port(
-            self._address, values)
+        if _native is not None:
+            result = _native.mcc152_dio_output_write_port(
+                self._address, values)
+        else:
+            result = self._lib.mcc152_dio_output_write_port(
+                self._address, values)
 
         if result != self._RESULT_SUCCESS:
             raise HatError(self._address, "Incorrect response.")
@@ -553,7 +568,16 @@ class mcc152(Hat): # pylint: disable=invalid-name,too-many-public-methods
         if not self._initialized:
             raise HatError(self._address, "Not initialized.")
 
-        orig_val = c_ubyte
+        if _native is not None:
+            # validate the dictionary and read-modify-write the port in one
+            # call
+            result = _native.mcc152_dio_output_write_dict(
+                self._address, value_dict)
+            if result != self._RESULT_SUCCESS:
+                raise HatError(self._address, "Incorrect response.")
+            return
+
+        orig_val = c_ubyte()
         result = self._lib.mcc152_dio_output_read_port(
             self._address, byref(orig_val))
         if result != self._RESULT_SUCCESS:
@@ -1094,7 +1118,18 @@ class mcc152(Hat): # pylint: disable=invalid-name,too-many-public-methods
         if not self._initialized:
             raise HatError(self._address, "Not initialized.")
 
-        orig_val = c_ubyte
+        if _native is not None:
+            # validate the dictionary and read-modify-write the port in one
+            # call
+            result = _native.mcc152_dio_config_write_dict(
+                self._address, item, value_dict)
+            if result == self._RESULT_BAD_PARAMETER:
+                raise ValueError("Invalid item {}.".format(item))
+            elif result != self._RESULT_SUCCESS:
+                raise HatError(self._address, "Incorrect response.")
+            return
+
+        orig_val = c_ubyte()
         result = self._lib.mcc152_dio_config_read_port(
             self._address, item, byref(orig_val))
         if result != self._RESULT_SUCCESS:
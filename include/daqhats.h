@@ -14,6 +14,9 @@
 #include "mcc134.h"
 #include "mcc152.h"
 #include "mcc172.h"
+#include "daqhatsd.h"
+#include "hat_stream.h"
+#include "hat_poll.h"
 
 /// Known DAQ HAT IDs.
 enum HatIDs
@@ -75,6 +78,9 @@ enum ResultCode
 #define OPTS_EXTTRIGGER         (0x0008)
 /// Run until explicitly stopped.
 #define OPTS_CONTINUOUS         (0x0010)
+/// Overwrite the oldest scan data instead of stopping with a buffer overrun
+/// (flight recorder.)
+#define OPTS_OVERWRITE          (0x0020)
 
 /// Contains information about a specific board.
 struct HatInfo
@@ -89,6 +95,17 @@ struct HatInfo
     char product_name[256];
 };
 
+/// The result of opening one board with [hat_open_all()](@ref hat_open_all).
+struct HatOpenResult
+{
+    /// The board address.
+    uint8_t address;
+    /// The product ID, one of [HatIDs](@ref HatIDs)
+    uint16_t id;
+    /// The [result code](@ref ResultCode) of opening the board.
+    int result;
+};
+
 /// Scan trigger input modes.
 enum TriggerMode
 {
@@ -156,6 +173,30 @@ extern "C" {
 */
 int hat_list(uint16_t filter_id, struct HatInfo* list);
 
+/**
+*   Open all detected DAQ HAT boards.
+*
+*   Finds the boards with [hat_list()](@ref hat_list) and opens each one with
+*   the open function for its type, such as mcc118_open(), from a separate
+*   thread per board.  The EEPROM data parsing and other per-board setup run
+*   concurrently; the SPI transfers that identify and initialize the boards
+*   still take turns on the shared bus.  This is much faster than opening the
+*   boards one at a time when several boards are attached.
+*
+*   Boards that open successfully must be closed with the close function for
+*   their type.  A board that was already open has its open count incremented,
+*   as with the individual open functions.
+*
+*   @param filter_id  An optional [ID](@ref HatIDs) filter to only open boards
+*       with a specific ID. Use [HAT_ID_ANY](@ref HAT_ID_ANY) to open all
+*       boards.
+*   @param list    A pointer to a user-allocated array of struct HatOpenResult
+*       that receives the address, ID and open result of each board, or NULL.
+*       Size the array as for [hat_list()](@ref hat_list).
+*   @return The number of boards found.
+*/
+int hat_open_all(uint16_t filter_id, struct HatOpenResult* list);
+
 /**
 *   Return a text description for a DAQ HAT result code.
 *
@@ -247,6 +288,82 @@ int hat_interrupt_callback_enable(void (*function)(void*), void* user_data);
 */
 int hat_interrupt_callback_disable(void);
 
+/**
+*   Return a file descriptor that becomes readable when an interrupt occurs.
+*
+*   The descriptor is an eventfd that is signaled each time the DAQ HAT
+*   interrupt signal becomes active, so it may be used with select(), poll(),
+*   epoll or an event loop instead of blocking in hat_wait_for_interrupt().
+*   Read 8 bytes from the descriptor to clear it after it becomes readable. The
+*   descriptor is non-blocking and is owned by the library; do not close it.
+*
+*   The descriptor may be used at the same time as a callback function set with
+*   hat_interrupt_callback_enable(). Calling this function when the descriptor
+*   already exists returns the same descriptor.
+*
+*   This function only applies when using devices that can generate an
+*   interrupt:
+*       - MCC 152
+*
+*   @param fd   Receives the file descriptor.
+*   @return [RESULT_SUCCESS](@ref RESULT_SUCCESS),
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER), or
+*       [RESULT_UNDEFINED](@ref RESULT_UNDEFINED).
+*/
+int hat_interrupt_event_enable(int* fd);
+
+/**
+*   Close the interrupt file descriptor.
+*
+*   Closes the descriptor returned by hat_interrupt_event_enable(). Any
+*   callback function set with hat_interrupt_callback_enable() remains active.
+*
+*   @return [RESULT_SUCCESS](@ref RESULT_SUCCESS) or
+*       [RESULT_UNDEFINED](@ref RESULT_UNDEFINED).
+*/
+int hat_interrupt_event_disable(void);
+
+/**
+*   Start a command batch.
+*
+*   Every board function normally obtains and releases the inter-process SPI
+*   lock on its own, so a loop that accesses several boards lets other threads
+*   and processes use the bus between each call. After calling this function
+*   the calling thread keeps the lock until hat_batch_end(), so the functions it
+*   calls in between run back to back and each returns its result as usual. The
+*   board address is only changed when a call accesses a different board than
+*   the previous one.
+*
+*   Batches may be nested; the lock is released by the outermost
+*   hat_batch_end(). Other threads and processes, including the library scan
+*   threads, wait while a batch is open, so keep batches short and do not call
+*   functions that wait for a scan thread, such as the scan cleanup and close
+*   functions, inside a batch.
+*
+*   This applies to the devices that use the SPI bus:
+*       - MCC 118
+*       - MCC 128
+*       - MCC 134
+*       - MCC 152 (analog output)
+*       - MCC 172
+*
+*   @return [RESULT_SUCCESS](@ref RESULT_SUCCESS) or
+*       [RESULT_LOCK_TIMEOUT](@ref RESULT_LOCK_TIMEOUT).
+*/
+int hat_batch_begin(void);
+
+/**
+*   End a command batch.
+*
+*   Ends the batch started by the matching hat_batch_begin() in the calling
+*   thread, releasing the SPI lock if it is the outermost batch.
+*
+*   @return [RESULT_SUCCESS](@ref RESULT_SUCCESS) or
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if the calling thread
+*       has no batch open.
+*/
+int hat_batch_end(void);
+
 #ifdef __cplusplus
 }
 #endif
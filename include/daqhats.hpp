@@ -0,0 +1,679 @@
+/**
+*   @file daqhats.hpp
+*   @author Measurement Computing Corp.
+*   @brief This file contains a header-only C++17 interface to the DAQ HAT
+*   library.
+*
+*   The C++ interface is a thin layer over the C functions.  It provides:
+*   - RAII objects that open / close boards and stop / clean up scans,
+*   - exceptions instead of result codes (daqhats::error),
+*   - non-copying views of scan data (daqhats::span), including direct access
+*       to the library scan buffer with daqhats::scan::peek(),
+*   - per-board traits (daqhats::board_traits) with the channel count, code
+*       range and input ranges as compile-time constants, and constexpr
+*       conversion functions built on them.
+*
+*   All functions are inline and call the C library directly, so there is
+*   nothing additional to link.  Example:
+*
+*       daqhats::board<daqhats::mcc172_tag> hat(0);
+*       auto acquisition = hat.a_in_scan_start(0x03, 10000, OPTS_CONTINUOUS);
+*       for (;;)
+*       {
+*           auto block = acquisition.peek();
+*           process(block.data);
+*           acquisition.consume(block.samples_per_channel);
+*       }
+*/
+#ifndef _DAQHATS_HPP
+#define _DAQHATS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "daqhats.h"
+
+namespace daqhats
+{
+
+/// Exception thrown when a library function returns an error.
+class error : public std::runtime_error
+{
+public:
+    /// Create the exception for a [ResultCode](@ref ResultCode).
+    explicit error(int code)
+        : std::runtime_error(hat_error_message(code)), code_(code)
+    {
+    }
+
+    /// The [ResultCode](@ref ResultCode) returned by the library.
+    int code() const noexcept
+    {
+        return code_;
+    }
+
+private:
+    int code_;
+};
+
+/// Throw daqhats::error if a library function did not succeed.
+inline void check(int result)
+{
+    if (result != RESULT_SUCCESS)
+    {
+        throw error(result);
+    }
+}
+
+/**
+*   @brief A non-owning view of contiguous elements.
+*
+*   This is the subset of C++20 std::span used by this interface, so the
+*   interface can be used with C++17.
+*/
+template <typename T>
+class span
+{
+public:
+    using element_type = T;
+    using value_type = typename std::remove_cv<T>::type;
+    using size_type = std::size_t;
+    using pointer = T*;
+    using iterator = T*;
+
+    constexpr span() noexcept : data_(nullptr), size_(0) {}
+
+    constexpr span(T* data, size_type size) noexcept
+        : data_(data), size_(size)
+    {
+    }
+
+    template <std::size_t N>
+    constexpr span(T (&array)[N]) noexcept : data_(array), size_(N) {}
+
+    /// View a contiguous container such as std::vector or std::array.
+    template <typename Container, typename = typename std::enable_if<
+        std::is_convertible<decltype(std::declval<Container&>().data()),
+            T*>::value>::type>
+    constexpr span(Container& container) noexcept
+        : data_(container.data()), size_(container.size())
+    {
+    }
+
+    constexpr T* data() const noexcept { return data_; }
+    constexpr size_type size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T* begin() const noexcept { return data_; }
+    constexpr T* end() const noexcept { return data_ + size_; }
+    constexpr T& operator[](size_type index) const noexcept
+    {
+        return data_[index];
+    }
+
+    /// Return a view of count elements starting at offset.
+    constexpr span subspan(size_type offset, size_type count) const noexcept
+    {
+        return span(data_ + offset, count);
+    }
+
+private:
+    T* data_;
+    size_type size_;
+};
+
+/// Scan status flags.
+struct scan_status
+{
+    bool hardware_overrun;  ///< The device scan buffer was not read in time.
+    bool buffer_overrun;    ///< The library scan buffer was not read in time.
+    bool triggered;         ///< The trigger conditions have been met.
+    bool running;           ///< The scan is running.
+
+    /// Decode the status bits returned by the library.
+    constexpr explicit scan_status(uint16_t status = 0) noexcept
+        : hardware_overrun((status & STATUS_HW_OVERRUN) != 0),
+          buffer_overrun((status & STATUS_BUFFER_OVERRUN) != 0),
+          triggered((status & STATUS_TRIGGERED) != 0),
+          running((status & STATUS_RUNNING) != 0)
+    {
+    }
+
+    /// True if data was lost.
+    constexpr bool overrun() const noexcept
+    {
+        return hardware_overrun || buffer_overrun;
+    }
+};
+
+/// The result of reading scan data.
+struct scan_read_result
+{
+    scan_status status;             ///< The scan status.
+    uint32_t samples_per_channel;   ///< The number of samples read per channel.
+    bool timed_out;                 ///< The timeout expired before all data
+                                    ///< was read.
+};
+
+/// A block of scan data in the library scan buffer, interleaved by channel.
+struct scan_block
+{
+    span<const double> data;        ///< The samples.
+    uint32_t samples_per_channel;   ///< The number of samples per channel.
+};
+
+/// Calibration coefficients for a channel or range.
+struct coefficients
+{
+    double slope;
+    double offset;
+};
+
+/// Board type tags used to select board_traits.
+struct mcc118_tag {};
+struct mcc128_tag {};   ///< @copydoc mcc118_tag
+struct mcc134_tag {};   ///< @copydoc mcc118_tag
+struct mcc152_tag {};   ///< @copydoc mcc118_tag
+struct mcc172_tag {};   ///< @copydoc mcc118_tag
+
+/**
+*   @brief Compile-time information and library functions for a board type.
+*
+*   Specialized for each board tag.  Constants describe the hardware and
+*   convert() turns a code read with OPTS_NOSCALEDATA | OPTS_NOCALIBRATEDATA
+*   into the value the library returns with OPTS_DEFAULT.
+*/
+template <typename Board>
+struct board_traits;
+
+/// MCC 118 traits.
+template <>
+struct board_traits<mcc118_tag>
+{
+    static constexpr uint16_t id = HAT_ID_MCC_118;
+    static constexpr uint8_t channel_count = 8;
+    static constexpr int code_bits = 12;
+    static constexpr int32_t min_code = 0;
+    static constexpr int32_t max_code = 4095;
+    static constexpr double range_min = -10.0;
+    static constexpr double range_max = 10.0;
+    static constexpr double lsb_size =
+        (range_max - range_min) / (max_code - min_code + 1);
+
+    /// Convert a raw code to volts.
+    static constexpr double convert(double code, const coefficients& cal,
+        uint8_t /*range*/ = 0) noexcept
+    {
+        return (((code * cal.slope) + cal.offset) * lsb_size) + range_min;
+    }
+
+    static constexpr auto open = &mcc118_open;
+    static constexpr auto close = &mcc118_close;
+    static constexpr auto is_open = &mcc118_is_open;
+    static constexpr auto serial = &mcc118_serial;
+    static constexpr auto a_in_read = &mcc118_a_in_read;
+    static constexpr auto a_in_scan_start = &mcc118_a_in_scan_start;
+    static constexpr auto a_in_scan_status = &mcc118_a_in_scan_status;
+    static constexpr auto a_in_scan_read = &mcc118_a_in_scan_read;
+    static constexpr auto a_in_scan_read_planar =
+        &mcc118_a_in_scan_read_planar;
+    static constexpr auto a_in_scan_peek = &mcc118_a_in_scan_peek;
+    static constexpr auto a_in_scan_consume = &mcc118_a_in_scan_consume;
+    static constexpr auto a_in_scan_event_enable =
+        &mcc118_a_in_scan_event_enable;
+    static constexpr auto a_in_scan_channel_count =
+        &mcc118_a_in_scan_channel_count;
+    static constexpr auto a_in_scan_stop = &mcc118_a_in_scan_stop;
+    static constexpr auto a_in_scan_cleanup = &mcc118_a_in_scan_cleanup;
+};
+
+/// MCC 128 traits.
+template <>
+struct board_traits<mcc128_tag>
+{
+    static constexpr uint16_t id = HAT_ID_MCC_128;
+    static constexpr uint8_t channel_count = 8;
+    static constexpr int code_bits = 16;
+    static constexpr int32_t min_code = 0;
+    static constexpr int32_t max_code = 65535;
+    /// Full scale of each AnalogInputRange.
+    static constexpr std::array<double, 4> range_full_scale =
+        {10.0, 5.0, 2.0, 1.0};
+    static constexpr double range_min = -10.0;
+    static constexpr double range_max = 10.0;
+
+    /// Convert a raw code to volts for an AnalogInputRange.  The library
+    /// already inverts the ADC code, so this matches mcc128_a_in_read().
+    static constexpr double convert(double code, const coefficients& cal,
+        uint8_t range = A_IN_RANGE_BIP_10V) noexcept
+    {
+        return (((code * cal.slope) + cal.offset) *
+            ((2.0 * range_full_scale[range]) / (max_code - min_code + 1))) -
+            range_full_scale[range];
+    }
+
+    static constexpr auto open = &mcc128_open;
+    static constexpr auto close = &mcc128_close;
+    static constexpr auto is_open = &mcc128_is_open;
+    static constexpr auto serial = &mcc128_serial;
+    static constexpr auto a_in_read = &mcc128_a_in_read;
+    static constexpr auto a_in_scan_start = &mcc128_a_in_scan_start;
+    static constexpr auto a_in_scan_status = &mcc128_a_in_scan_status;
+    static constexpr auto a_in_scan_read = &mcc128_a_in_scan_read;
+    static constexpr auto a_in_scan_read_planar =
+        &mcc128_a_in_scan_read_planar;
+    static constexpr auto a_in_scan_peek = &mcc128_a_in_scan_peek;
+    static constexpr auto a_in_scan_consume = &mcc128_a_in_scan_consume;
+    static constexpr auto a_in_scan_event_enable =
+        &mcc128_a_in_scan_event_enable;
+    static constexpr auto a_in_scan_channel_count =
+        &mcc128_a_in_scan_channel_count;
+    static constexpr auto a_in_scan_stop = &mcc128_a_in_scan_stop;
+    static constexpr auto a_in_scan_cleanup = &mcc128_a_in_scan_cleanup;
+};
+
+/// MCC 134 traits.
+template <>
+struct board_traits<mcc134_tag>
+{
+    static constexpr uint16_t id = HAT_ID_MCC_134;
+    static constexpr uint8_t channel_count = 4;
+    static constexpr int code_bits = 24;
+    static constexpr int32_t min_code = -8388608;
+    static constexpr int32_t max_code = 8388607;
+    static constexpr double range_min = -0.078125;
+    static constexpr double range_max = 0.078125;
+
+    /// Convert a raw code to volts.
+    static constexpr double convert(double code, const coefficients& cal,
+        uint8_t /*range*/ = 0) noexcept
+    {
+        return ((code * cal.slope) + cal.offset) *
+            ((range_max - range_min) / (1.0 * max_code - min_code + 1));
+    }
+
+    static constexpr auto open = &mcc134_open;
+    static constexpr auto close = &mcc134_close;
+    static constexpr auto is_open = &mcc134_is_open;
+    static constexpr auto serial = &mcc134_serial;
+    static constexpr auto a_in_read = &mcc134_a_in_read;
+    static constexpr auto t_in_read = &mcc134_t_in_read;
+};
+
+/// MCC 152 traits.
+template <>
+struct board_traits<mcc152_tag>
+{
+    static constexpr uint16_t id = HAT_ID_MCC_152;
+    static constexpr uint8_t channel_count = 2;
+    static constexpr uint8_t dio_channel_count = 8;
+    static constexpr int code_bits = 12;
+    static constexpr int32_t min_code = 0;
+    static constexpr int32_t max_code = 4095;
+    static constexpr double range_min = 0.0;
+    static constexpr double range_max = 5.0;
+
+    static constexpr auto open = &mcc152_open;
+    static constexpr auto close = &mcc152_close;
+    static constexpr auto is_open = &mcc152_is_open;
+    static constexpr auto serial = &mcc152_serial;
+    static constexpr auto a_out_write = &mcc152_a_out_write;
+};
+
+/// MCC 172 traits.
+template <>
+struct board_traits<mcc172_tag>
+{
+    static constexpr uint16_t id = HAT_ID_MCC_172;
+    static constexpr uint8_t channel_count = 2;
+    static constexpr int code_bits = 24;
+    static constexpr int32_t min_code = -8388608;
+    static constexpr int32_t max_code = 8388607;
+    static constexpr double range_min = -5.0;
+    static constexpr double range_max = 5.0;
+    static constexpr double lsb_size =
+        (range_max - range_min) / (1.0 * max_code - min_code + 1);
+
+    /// Convert a raw code to volts (or mechanical units when the
+    /// sensitivity, in mV / unit, is not the default 1000.)
+    static constexpr double convert(double code, const coefficients& cal,
+        uint8_t /*range*/ = 0, double sensitivity = 1000.0) noexcept
+    {
+        return ((code - cal.offset) * cal.slope) *
+            (lsb_size / (sensitivity / 1000.0));
+    }
+
+    static constexpr auto open = &mcc172_open;
+    static constexpr auto close = &mcc172_close;
+    static constexpr auto is_open = &mcc172_is_open;
+    static constexpr auto serial = &mcc172_serial;
+    static constexpr auto a_in_scan_start = &mcc172_a_in_scan_start;
+    static constexpr auto a_in_scan_status = &mcc172_a_in_scan_status;
+    static constexpr auto a_in_scan_read = &mcc172_a_in_scan_read;
+    static constexpr auto a_in_scan_read_planar =
+        &mcc172_a_in_scan_read_planar;
+    static constexpr auto a_in_scan_peek = &mcc172_a_in_scan_peek;
+    static constexpr auto a_in_scan_consume = &mcc172_a_in_scan_consume;
+    static constexpr auto a_in_scan_event_enable =
+        &mcc172_a_in_scan_event_enable;
+    static constexpr auto a_in_scan_channel_count =
+        &mcc172_a_in_scan_channel_count;
+    static constexpr auto a_in_scan_stop = &mcc172_a_in_scan_stop;
+    static constexpr auto a_in_scan_cleanup = &mcc172_a_in_scan_cleanup;
+};
+
+/**
+*   @brief Convert raw codes interleaved by channel to values in place.
+*
+*   The data must have been read with OPTS_NOSCALEDATA | OPTS_NOCALIBRATEDATA.
+*   The channel count is a template parameter so the per-channel coefficients
+*   are applied by an unrolled inner loop.
+*/
+template <typename Board, std::size_t Channels>
+inline void convert_codes(span<double> data,
+    const std::array<coefficients, Channels>& cal,
+    const std::array<uint8_t, Channels>& ranges = {})
+{
+    static_assert((Channels > 0) &&
+        (Channels <= board_traits<Board>::channel_count),
+        "Invalid channel count for this board.");
+
+    std::size_t index = 0;
+    for (; index + Channels <= data.size(); index += Channels)
+    {
+        for (std::size_t channel = 0; channel < Channels; channel++)
+        {
+            data[index + channel] = board_traits<Board>::convert(
+                data[index + channel], cal[channel], ranges[channel]);
+        }
+    }
+}
+
+/**
+*   @brief An active analog input scan.
+*
+*   Created by board::a_in_scan_start().  The scan is stopped and its
+*   resources released when the object is destroyed.
+*/
+template <typename Board>
+class scan
+{
+public:
+    using traits = board_traits<Board>;
+
+    /// Take ownership of the scan running on a board.
+    explicit scan(uint8_t address) noexcept : address_(address), active_(true)
+    {
+    }
+
+    scan(const scan&) = delete;
+    scan& operator=(const scan&) = delete;
+
+    scan(scan&& other) noexcept
+        : address_(other.address_),
+          active_(std::exchange(other.active_, false))
+    {
+    }
+
+    scan& operator=(scan&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            address_ = other.address_;
+            active_ = std::exchange(other.active_, false);
+        }
+        return *this;
+    }
+
+    ~scan()
+    {
+        release();
+    }
+
+    /// The number of channels in the scan.
+    uint8_t channel_count() const noexcept
+    {
+        return static_cast<uint8_t>(traits::a_in_scan_channel_count(address_));
+    }
+
+    /// Read the scan status and the samples per channel available.
+    scan_status status(uint32_t* samples_available = nullptr) const
+    {
+        uint16_t status_bits = 0;
+        uint32_t available = 0;
+
+        check(traits::a_in_scan_status(address_, &status_bits, &available));
+        if (samples_available)
+        {
+            *samples_available = available;
+        }
+        return scan_status(status_bits);
+    }
+
+    /**
+    *   @brief Read data interleaved by channel into a caller-owned buffer.
+    *
+    *   Reads as many samples per channel as fit in \b buffer, waiting up to
+    *   \b timeout seconds (negative waits indefinitely, 0 returns what is
+    *   available.)
+    */
+    scan_read_result read(span<double> buffer, double timeout) const
+    {
+        uint16_t status_bits = 0;
+        uint32_t samples_read = 0;
+        uint8_t channels = channel_count();
+        int result;
+
+        result = traits::a_in_scan_read(address_, &status_bits,
+            channels ? static_cast<int32_t>(buffer.size() / channels) : 0,
+            timeout, buffer.data(), static_cast<uint32_t>(buffer.size()),
+            &samples_read);
+        if (result != RESULT_TIMEOUT)
+        {
+            check(result);
+        }
+        return scan_read_result{scan_status(status_bits), samples_read,
+            result == RESULT_TIMEOUT};
+    }
+
+    /**
+    *   @brief Read data into one buffer per channel.
+    *
+    *   Each buffer receives up to \b samples_per_channel samples.
+    */
+    scan_read_result read_planar(double* const* buffers,
+        uint32_t samples_per_channel, double timeout) const
+    {
+        uint16_t status_bits = 0;
+        uint32_t samples_read = 0;
+        int result;
+
+        result = traits::a_in_scan_read_planar(address_, &status_bits,
+            static_cast<int32_t>(samples_per_channel), timeout, buffers,
+            samples_per_channel, &samples_read);
+        if (result != RESULT_TIMEOUT)
+        {
+            check(result);
+        }
+        return scan_read_result{scan_status(status_bits), samples_read,
+            result == RESULT_TIMEOUT};
+    }
+
+    /**
+    *   @brief Access the oldest unread data in the library scan buffer.
+    *
+    *   No data is copied.  The block stays valid until it is released with
+    *   consume(); it may be shorter than the available data when the scan
+    *   buffer wraps.
+    */
+    scan_block peek() const
+    {
+        const double* data = nullptr;
+        uint32_t samples = 0;
+
+        check(traits::a_in_scan_peek(address_, &data, &samples));
+        return scan_block{span<const double>(data,
+            static_cast<std::size_t>(samples) * channel_count()), samples};
+    }
+
+    /// Release data returned by peek().
+    void consume(uint32_t samples_per_channel) const
+    {
+        check(traits::a_in_scan_consume(address_, samples_per_channel));
+    }
+
+    /// Return a descriptor signaled when data is available or the scan ends.
+    int event_fd(uint32_t samples_per_channel) const
+    {
+        int fd = -1;
+
+        check(traits::a_in_scan_event_enable(address_, samples_per_channel,
+            &fd));
+        return fd;
+    }
+
+    /// Stop the scan; the data remains available until destruction.
+    void stop() const
+    {
+        check(traits::a_in_scan_stop(address_));
+    }
+
+private:
+    void release() noexcept
+    {
+        if (active_)
+        {
+            traits::a_in_scan_stop(address_);
+            traits::a_in_scan_cleanup(address_);
+            active_ = false;
+        }
+    }
+
+    uint8_t address_;
+    bool active_;
+};
+
+/**
+*   @brief An open DAQ HAT board.
+*
+*   The board is opened by the constructor and closed by the destructor.
+*   Functions that are not wrapped may be called through call().
+*/
+template <typename Board>
+class board
+{
+public:
+    using traits = board_traits<Board>;
+
+    /// Open the board at an address.
+    explicit board(uint8_t address) : address_(address), open_(false)
+    {
+        check(traits::open(address));
+        open_ = true;
+    }
+
+    board(const board&) = delete;
+    board& operator=(const board&) = delete;
+
+    board(board&& other) noexcept
+        : address_(other.address_), open_(std::exchange(other.open_, false))
+    {
+    }
+
+    board& operator=(board&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            address_ = other.address_;
+            open_ = std::exchange(other.open_, false);
+        }
+        return *this;
+    }
+
+    ~board()
+    {
+        release();
+    }
+
+    /// The board address.
+    uint8_t address() const noexcept
+    {
+        return address_;
+    }
+
+    /// Read the serial number.
+    std::string serial() const
+    {
+        char buffer[16] = {0};
+
+        check(traits::serial(address_, buffer));
+        return std::string(buffer);
+    }
+
+    /// Read a single analog input value (MCC 118, 128 and 134.)
+    double a_in_read(uint8_t channel, uint32_t options = OPTS_DEFAULT) const
+    {
+        double value = 0.0;
+
+        check(traits::a_in_read(address_, channel, options, &value));
+        return value;
+    }
+
+    /// Read a thermocouple temperature (MCC 134.)
+    double t_in_read(uint8_t channel) const
+    {
+        double value = 0.0;
+
+        check(traits::t_in_read(address_, channel, &value));
+        return value;
+    }
+
+    /// Write an analog output value (MCC 152.)
+    void a_out_write(uint8_t channel, double value,
+        uint32_t options = OPTS_DEFAULT) const
+    {
+        check(traits::a_out_write(address_, channel, options, value));
+    }
+
+    /**
+    *   @brief Start a scan (MCC 118, 128 and 172.)
+    *
+    *   Takes the same arguments as the C function after the address.  The
+    *   returned object stops and cleans up the scan when destroyed.
+    */
+    template <typename... Args>
+    scan<Board> a_in_scan_start(Args... args)
+    {
+        check(traits::a_in_scan_start(address_, args...));
+        return scan<Board>(address_);
+    }
+
+    /// Call any board function that takes the address as its first argument.
+    template <typename Function, typename... Args>
+    void call(Function function, Args&&... args) const
+    {
+        check(function(address_, std::forward<Args>(args)...));
+    }
+
+private:
+    void release() noexcept
+    {
+        if (open_)
+        {
+            traits::close(address_);
+            open_ = false;
+        }
+    }
+
+    uint8_t address_;
+    bool open_;
+};
+
+}   // namespace daqhats
+
+#endif
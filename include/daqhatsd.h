@@ -0,0 +1,165 @@
+/**
+*   @file daqhatsd.h
+*   @author Measurement Computing Corp.
+*   @brief This file contains the client functions for the daqhatsd daemon.
+*
+*   The optional daqhatsd daemon opens all MCC 118, MCC 128 and MCC 172 boards
+*   and owns the SPI bus.  Applications use these functions instead of the
+*   board functions to share the daemon's acquisitions: a scan is run once by
+*   the daemon and published in shared memory, and any number of processes
+*   can read it, each at its own pace, without additional bus traffic.
+*
+*   The functions mirror the board functions of the same name and return the
+*   same [result codes](@ref ResultCode).  A board is used either through the
+*   daemon or directly, not both.
+*
+*   10/17/2026
+*/
+#ifndef _DAQHATSD_H
+#define _DAQHATSD_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*   @brief Connect to the daqhatsd daemon.
+*
+*   The other daqhatsd functions connect automatically, so calling this is
+*   only needed to check that the daemon is running.
+*
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_COMMS_FAILURE](@ref RESULT_COMMS_FAILURE) if the daemon is not
+*       running.
+*/
+int daqhatsd_connect(void);
+
+/**
+*   @brief Disconnect from the daqhatsd daemon.
+*
+*   Any scans this process joined are released and their shared memory
+*   unmapped.
+*/
+void daqhatsd_disconnect(void);
+
+/**
+*   @brief Perform a single reading of an analog input channel through the
+*   daemon (MCC 118 and MCC 128.)
+*
+*   @param address  The board address (0 - 7).
+*   @param channel  The analog input channel number.
+*   @param options  Options bitmask, as for mcc118_a_in_read().
+*   @param value    Receives the analog input value.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful.
+*/
+int daqhatsd_a_in_read(uint8_t address, uint8_t channel, uint32_t options,
+    double* value);
+
+/**
+*   @brief Start or join a hardware-paced analog input scan run by the daemon.
+*
+*   If the daemon is already running a scan on the board with the same
+*   parameters, this process joins it and reads data from that point on;
+*   otherwise a new scan is started.  If a scan with different parameters is
+*   running, [RESULT_BUSY](@ref RESULT_BUSY) is returned.
+*
+*   For the MCC 172 a non-zero sample_rate_per_channel configures the local
+*   clock before starting; use 0 to keep the current clock configuration.
+*
+*   @param address  The board address (0 - 7).
+*   @param channel_mask A bit mask of the channels to be scanned.
+*   @param samples_per_channel  The number of samples to acquire per channel
+*       (finite mode,) or can be used to set a larger scan buffer size than
+*       the default (continuous mode.)
+*   @param sample_rate_per_channel  The A/D sample rate in samples per
+*       channel per second.
+*   @param options  The options bitmask, as for mcc118_a_in_scan_start().
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful.
+*/
+int daqhatsd_a_in_scan_start(uint8_t address, uint8_t channel_mask,
+    uint32_t samples_per_channel, double sample_rate_per_channel,
+    uint32_t options);
+
+/**
+*   @brief Read the status of a scan joined by this process.
+*
+*   @param address  The board address (0 - 7).
+*   @param status   Receives the scan status bitmask.  STATUS_BUFFER_OVERRUN
+*       means this process did not read the data in time; the scan continues
+*       and reading resumes with the newest data.
+*   @param samples_per_channel  Receives the number of samples per channel
+*       available to this process.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if this process
+*       has not joined a scan on the board.
+*/
+int daqhatsd_a_in_scan_status(uint8_t address, uint16_t* status,
+    uint32_t* samples_per_channel);
+
+/**
+*   @brief Read scan data from a scan joined by this process.
+*
+*   The arguments are the same as mcc118_a_in_scan_read().
+*
+*   @param address  The board address (0 - 7).
+*   @param status   Receives the scan status bitmask.
+*   @param samples_per_channel  The number of samples per channel to read, or
+*       -1 to read all available samples.
+*   @param timeout  The amount of time in seconds to wait for the samples to
+*       be read; negative waits indefinitely, 0 returns immediately.
+*   @param buffer   The user data buffer that receives the samples.
+*   @param buffer_size_samples  The size of the buffer in samples.
+*   @param samples_read_per_channel Returns the actual number of samples read
+*       from each channel.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_TIMEOUT](@ref RESULT_TIMEOUT) if the requested samples were not
+*       available in time,
+*       [RESULT_COMMS_FAILURE](@ref RESULT_COMMS_FAILURE) if the daemon exited
+*       while waiting.
+*/
+int daqhatsd_a_in_scan_read(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* buffer,
+    uint32_t buffer_size_samples, uint32_t* samples_read_per_channel);
+
+/**
+*   @brief Return the number of channels in a scan joined by this process.
+*
+*   @param address  The board address (0 - 7).
+*   @return The number of channels, 0 - 8.
+*/
+int daqhatsd_a_in_scan_channel_count(uint8_t address);
+
+/**
+*   @brief Leave a scan joined by this process.
+*
+*   The daemon stops the scan when no process remains joined to it.  Data
+*   already published can still be read until daqhatsd_a_in_scan_cleanup()
+*   is called.
+*
+*   @param address  The board address (0 - 7).
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful.
+*/
+int daqhatsd_a_in_scan_stop(uint8_t address);
+
+/**
+*   @brief Leave a scan if needed and release its shared memory.
+*
+*   @param address  The board address (0 - 7).
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful.
+*/
+int daqhatsd_a_in_scan_cleanup(uint8_t address);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,190 @@
+/**
+*   @file hat_poll.h
+*   @author Measurement Computing Corp.
+*   @brief This file contains the software-timed polling functions.
+*
+*   A poll runs a set of single-point reads (@ref HatPollItem) on a fixed
+*   period from a library thread.  Each period, or tick, is started on an
+*   absolute CLOCK_MONOTONIC deadline with clock_nanosleep(), so the timing does
+*   not drift with the time taken by the reads.  The results of each tick are
+*   stored with their timestamps in a buffer that the application reads with
+*   hat_poll_read().
+*
+*   The items are grouped when the poll is started so a tick is as short as
+*   possible:
+*       - MCC 118 and MCC 128 items on the same board with the same options
+*         are read with one mcc118_a_in_read_multi() or
+*         mcc128_a_in_read_multi() call, and all of these boards are read
+*         under one SPI lock (hat_batch_begin()).
+*       - MCC 152 items on the same board are read with one
+*         mcc152_dio_input_read_port() call.
+*       - MCC 134 items return the values measured by the MCC 134 background
+*         thread and do not use the bus.
+*
+*   10/17/2026
+*/
+#ifndef _HAT_POLL_H
+#define _HAT_POLL_H
+
+#include <stdint.h>
+
+/// The maximum number of items in a poll.
+#define HAT_POLL_MAX_ITEMS          64
+
+/// Poll item operations.
+enum HatPollOperation
+{
+    /// mcc118_a_in_read(), using the item channel and options.
+    HAT_POLL_MCC118_A_IN        = 0,
+    /// mcc128_a_in_read(), using the item channel and options.
+    HAT_POLL_MCC128_A_IN        = 1,
+    /// mcc134_t_in_read(), using the item channel.
+    HAT_POLL_MCC134_T_IN        = 2,
+    /// mcc134_a_in_read(), using the item channel and options.
+    HAT_POLL_MCC134_A_IN        = 3,
+    /// mcc152_dio_input_read_bit(), using the item channel.
+    HAT_POLL_MCC152_DIO_IN      = 4,
+    /// mcc152_dio_input_read_port(); the item channel is ignored.
+    HAT_POLL_MCC152_DIO_PORT    = 5
+};
+
+/// A read performed on each tick.
+struct HatPollItem
+{
+    uint8_t address;        ///< The board address.
+    uint8_t operation;      ///< A @ref HatPollOperation.
+    uint8_t channel;        ///< The channel or DIO bit.
+    uint8_t reserved;
+    uint32_t options;       ///< The read options, as for the read function.
+};
+
+/// The record of one tick.
+struct HatPollTick
+{
+    /// The tick number, counted from 0 at the start of the poll.  Ticks that
+    /// were skipped because of missed deadlines leave gaps in the numbers.
+    uint64_t index;
+    /// The CLOCK_MONOTONIC time in nanoseconds the tick was scheduled for.
+    uint64_t deadline;
+    /// The CLOCK_MONOTONIC time in nanoseconds the tick started.
+    uint64_t timestamp;
+    /// The time in nanoseconds taken by the reads.
+    uint32_t duration;
+    /// [RESULT_SUCCESS](@ref RESULT_SUCCESS), or the result of the first read
+    /// that failed.  The values of failed reads are NAN.
+    int32_t result;
+};
+
+/// Poll statistics.
+struct HatPollStatus
+{
+    uint64_t ticks;         ///< The number of ticks performed.
+    /// The number of ticks that started more than half a period after their
+    /// deadline.
+    uint64_t late_ticks;
+    /// The number of deadlines skipped because a tick ended more than a
+    /// period after the following deadline.
+    uint64_t missed_deadlines;
+    /// The number of ticks discarded because the buffer was full.
+    uint64_t overruns;
+    uint64_t errors;        ///< The number of ticks with a failed read.
+    uint32_t queued;        ///< The number of ticks waiting to be read.
+    uint32_t buffer_size;   ///< The buffer size in ticks.
+    double latency_max;     ///< The maximum start latency in microseconds.
+    double duration_max;    ///< The maximum tick duration in microseconds.
+};
+
+/// A poll instance.
+struct HatPoll;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*   @brief Start a software-timed poll.
+*
+*   The boards used by the items must already be opened.  The first tick runs
+*   immediately and the following ticks at multiples of \b period after it.
+*   The poll thread runs with the SCHED_FIFO real-time policy when the process
+*   is allowed to set it (it requires root or CAP_SYS_NICE); otherwise it uses
+*   the normal policy.
+*
+*   Each tick uses the bus for the time of its reads, so the functions for the
+*   polled boards may still be called by the application, but they wait while a
+*   tick reads the MCC 118 and MCC 128 boards.
+*
+*   @param items    The items to read on each tick.  The values of each tick
+*       are returned in this order.
+*   @param item_count   The number of items, 1 -
+*       [HAT_POLL_MAX_ITEMS](@ref HAT_POLL_MAX_ITEMS).
+*   @param period   The tick period in seconds, greater than 0 and at most
+*       86400.
+*   @param buffer_size  The number of ticks the buffer holds, rounded up to a
+*       power of 2.  0 selects one second of ticks, at least 64.
+*   @param poll     Receives the poll instance.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if an argument is
+*           invalid, a board is not open, or a channel is not valid for the
+*           current MCC 128 input mode,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if the memory
+*           or thread could not be allocated.
+*/
+int hat_poll_start(const struct HatPollItem* items, uint16_t item_count,
+    double period, uint32_t buffer_size, struct HatPoll** poll);
+
+/**
+*   @brief Read tick records and values from a poll.
+*
+*   Waits until at least one tick is available or the timeout expires, then
+*   returns up to \b max_ticks ticks.  The values are stored tick by tick, with
+*   one value per item in the order the items were passed to hat_poll_start().
+*   DIO values are returned as 0 / 1 or the port value.
+*
+*   @param poll     The poll instance.
+*   @param max_ticks    The maximum number of ticks to return.
+*   @param timeout  The time in seconds to wait for a tick; negative to wait
+*       forever, 0 to return immediately.
+*   @param ticks    Receives the tick records; may be NULL.
+*   @param values   Receives the values, item count * max_ticks doubles; may
+*       be NULL.
+*   @param ticks_read   Receives the number of ticks returned.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_TIMEOUT](@ref RESULT_TIMEOUT) if no tick was available before
+*           the timeout,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if an argument is
+*           invalid.
+*/
+int hat_poll_read(struct HatPoll* poll, uint32_t max_ticks, double timeout,
+    struct HatPollTick* ticks, double* values, uint32_t* ticks_read);
+
+/**
+*   @brief Read the poll statistics.
+*
+*   @param poll     The poll instance.
+*   @param status   Receives the statistics.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if an argument is
+*           invalid.
+*/
+int hat_poll_status(struct HatPoll* poll, struct HatPollStatus* status);
+
+/**
+*   @brief Stop a poll and free its resources.
+*
+*   @param poll     The poll instance.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if an argument is
+*           invalid.
+*/
+int hat_poll_stop(struct HatPoll* poll);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
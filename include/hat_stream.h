@@ -0,0 +1,255 @@
+/**
+*   @file hat_stream.h
+*   @author Measurement Computing Corp.
+*   @brief This file contains the scan streaming server and client functions.
+*
+*   The streaming server publishes the data of scans running in this process
+*   (MCC 118, MCC 128 and MCC 172) to other local processes over a Unix domain
+*   stream socket.  Each scan block is sent as a @ref HatStreamFrame header
+*   followed by the interleaved samples as doubles.
+*
+*   Flow control is credit based: a subscriber grants credits, and the server
+*   sends one block per credit.  The server always removes the data from the
+*   scan buffer at the acquisition rate, so a subscriber that runs out of
+*   credits, or whose socket is full, loses blocks rather than slowing the
+*   acquisition; depending on its policy it is disconnected or receives
+*   fewer blocks.
+*
+*   10/17/2026
+*/
+#ifndef _HAT_STREAM_H
+#define _HAT_STREAM_H
+
+#include <stdint.h>
+
+/// The value of HatStreamFrame.magic and HatStreamRequest.magic.
+#define HAT_STREAM_MAGIC            0x48535452  // "HSTR"
+
+/// The socket path used by the daqhats_stream server.
+#define HAT_STREAM_DEFAULT_PATH     "/run/daqhats_stream.sock"
+
+/// The maximum number of subscribers of one server.
+#define HAT_STREAM_MAX_SUBSCRIBERS  32
+
+// Server options
+
+/// Default behavior.
+#define HAT_STREAM_OPTS_DEFAULT     (0x0000)
+/// Copy each block out of the scan buffer before sending it.  By default the
+/// blocks are sent directly from the scan buffer, with no copy in user space.
+#define HAT_STREAM_OPTS_COPY        (0x0001)
+
+/// Subscriber policies when a block can't be delivered.
+enum HatStreamPolicy
+{
+    /// Drop the block; a subscriber that misses
+    /// [HAT_STREAM_MAX_MISSED](@ref HAT_STREAM_MAX_MISSED) consecutive blocks
+    /// is disconnected.
+    HAT_STREAM_POLICY_DROP      = 0,
+    /// Double the decimation factor, so the subscriber receives only every
+    /// Nth block, up to
+    /// [HAT_STREAM_MAX_DECIMATION](@ref HAT_STREAM_MAX_DECIMATION).  The
+    /// factor is halved again after the subscriber keeps up for a while.
+    HAT_STREAM_POLICY_DECIMATE  = 1
+};
+
+/// Consecutive missed blocks before a HAT_STREAM_POLICY_DROP subscriber is
+/// disconnected.
+#define HAT_STREAM_MAX_MISSED       256
+/// The maximum decimation factor for HAT_STREAM_POLICY_DECIMATE.
+#define HAT_STREAM_MAX_DECIMATION   256
+
+/// Subscriber request commands.
+enum HatStreamCommand
+{
+    /// Select the boards and policy and grant the initial credits.
+    HAT_STREAM_CMD_SUBSCRIBE    = 1,
+    /// Grant additional credits.
+    HAT_STREAM_CMD_CREDIT       = 2
+};
+
+/// A request from a subscriber to the server.
+struct HatStreamRequest
+{
+    uint32_t magic;         ///< HAT_STREAM_MAGIC
+    uint8_t command;        ///< A @ref HatStreamCommand.
+    uint8_t address_mask;   ///< Board addresses to receive (SUBSCRIBE.)
+    uint8_t policy;         ///< A @ref HatStreamPolicy (SUBSCRIBE.)
+    uint8_t reserved;
+    uint32_t credits;       ///< Blocks the subscriber can accept.
+};
+
+/// The header preceding each block of samples.
+struct HatStreamFrame
+{
+    uint32_t magic;         ///< HAT_STREAM_MAGIC
+    uint8_t address;        ///< The board address.
+    uint8_t channel_count;  ///< The number of channels in the scan.
+    uint16_t status;        ///< The scan status bitmask.
+    uint32_t samples_per_channel;   ///< The number of samples per channel.
+    /// The number of blocks from this board not delivered to this subscriber
+    /// since its previous frame.
+    uint32_t dropped;
+    /// The current decimation factor of the subscriber.
+    uint32_t decimation;
+    uint32_t reserved;
+    /// The index of the first sample per channel in the block, counted from
+    /// the first data the server read from the scan.
+    uint64_t sequence;
+};
+
+/// A streaming server instance.
+struct HatStreamServer;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*   @brief Start a streaming server.
+*
+*   The server runs in its own thread.  It publishes the scans on the boards
+*   in \b address_mask that are open in this process and have been attached
+*   with hat_stream_server_attach().  The server becomes the reader of those
+*   scans: the application must not read them, and the server uses the scan
+*   event descriptor (mcc118_a_in_scan_event_enable()).  Data is read even
+*   when there are no subscribers.
+*
+*   Blocks hold \b samples_per_block samples per channel; a shorter block is
+*   sent where the data wraps in the scan buffer and when the scan ends.
+*   The blocks available to a subscriber in one pass are sent with a single
+*   sendmsg() call.
+*
+*   @param path     The path of the socket to create.  An existing socket at
+*       this path is replaced.
+*   @param address_mask A bit mask of the board addresses to publish.
+*   @param samples_per_block    The number of samples per channel in a block.
+*   @param options  Options bitmask:
+*       - [HAT_STREAM_OPTS_DEFAULT](@ref HAT_STREAM_OPTS_DEFAULT)
+*       - [HAT_STREAM_OPTS_COPY](@ref HAT_STREAM_OPTS_COPY)
+*   @param server   Receives the server instance.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if an argument is
+*           invalid,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if the socket
+*           or thread could not be created.
+*/
+int hat_stream_server_start(const char* path, uint8_t address_mask,
+    uint32_t samples_per_block, uint32_t options,
+    struct HatStreamServer** server);
+
+/**
+*   @brief Stop a streaming server.
+*
+*   Disconnects the subscribers, removes the socket and frees the server.
+*   The scans themselves are not stopped.
+*
+*   @param server   The server instance.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful.
+*/
+int hat_stream_server_stop(struct HatStreamServer* server);
+
+/**
+*   @brief Attach a streaming server to a scan.
+*
+*   Call this after the scan has been started on the board (for example with
+*   mcc118_a_in_scan_start()) to publish it.  The server detaches by itself
+*   once it has sent the end of the scan, so a scan that is started again
+*   must be attached again.  Attaching a board that is already attached
+*   replaces its scan.
+*
+*   @param server   The server instance.
+*   @param address  The board address, one of the addresses in the
+*       \b address_mask passed to hat_stream_server_start().
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if an argument is
+*           invalid, the board is not open or the scan was started with
+*           OPTS_OVERWRITE,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if a scan has
+*           not been started on the board.
+*/
+int hat_stream_server_attach(struct HatStreamServer* server, uint8_t address);
+
+/**
+*   @brief Detach a streaming server from a scan.
+*
+*   Returns once the server has stopped using the scan buffer, so the scan
+*   may then be cleaned up (mcc118_a_in_scan_cleanup() or the equivalent for
+*   the other boards.)  Call this, or hat_stream_server_stop(), before
+*   cleaning up an attached scan or closing its board.  Detaching a board
+*   that is not attached has no effect.
+*
+*   @param server   The server instance.
+*   @param address  The board address.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if an argument is
+*           invalid.
+*/
+int hat_stream_server_detach(struct HatStreamServer* server, uint8_t address);
+
+/**
+*   @brief Connect to a streaming server.
+*
+*   @param path     The path of the server socket.
+*   @param address_mask A bit mask of the board addresses to receive.
+*   @param policy   A @ref HatStreamPolicy.
+*   @param credits  The number of blocks the subscriber can accept before
+*       granting more with hat_stream_credit().
+*   @param fd   Receives the socket descriptor, which may be used with poll().
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_COMMS_FAILURE](@ref RESULT_COMMS_FAILURE) if the server is not
+*           running.
+*/
+int hat_stream_connect(const char* path, uint8_t address_mask, uint8_t policy,
+    uint32_t credits, int* fd);
+
+/**
+*   @brief Grant additional credits to the server.
+*
+*   @param fd       The socket descriptor from hat_stream_connect().
+*   @param credits  The number of additional blocks the subscriber can accept.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_COMMS_FAILURE](@ref RESULT_COMMS_FAILURE) if the server has
+*           disconnected.
+*/
+int hat_stream_credit(int fd, uint32_t credits);
+
+/**
+*   @brief Receive one block from the server.
+*
+*   @param fd       The socket descriptor from hat_stream_connect().
+*   @param frame    Receives the block header.
+*   @param buffer   Receives the samples, interleaved by channel.
+*   @param buffer_size_samples  The size of the buffer in samples.  A block
+*       that does not fit is discarded.
+*   @param timeout  The time in seconds to wait for a block; negative waits
+*       indefinitely, 0 returns immediately.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_TIMEOUT](@ref RESULT_TIMEOUT) if no block arrived in time,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if the block did not
+*           fit in the buffer,
+*       [RESULT_COMMS_FAILURE](@ref RESULT_COMMS_FAILURE) if the server has
+*           disconnected.
+*/
+int hat_stream_read(int fd, struct HatStreamFrame* frame, double* buffer,
+    uint32_t buffer_size_samples, double timeout);
+
+/**
+*   @brief Disconnect from a streaming server.
+*
+*   @param fd   The socket descriptor from hat_stream_connect().
+*/
+void hat_stream_disconnect(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
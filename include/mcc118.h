@@ -190,6 +190,36 @@ int mcc118_calibration_coefficient_write(uint8_t address, uint8_t channel,
 int mcc118_a_in_read(uint8_t address, uint8_t channel, uint32_t options, 
     double* value);
 
+/**
+*   @brief Perform a single reading of several analog input channels and return
+*       the values.
+*
+*   This is equivalent to calling mcc118_a_in_read() for each channel in
+*   channel_mask, but the board is locked and selected only once, so the set of
+*   channels is read faster and without other threads or processes accessing
+*   the board in between.  When 5 or more channels are requested and no scan
+*   is using the board, they are read with a one sample internal scan at the
+*   maximum rate (4 commands, samples 10 us apart); otherwise the readings are
+*   sent back to back.
+*
+*   The values are stored in ascending channel order, one per bit set in
+*   channel_mask, so values must have room for as many values as there are bits
+*   set. For example, a channel_mask of 0x15 stores channels 0, 2, and 4 in
+*   values[0], values[1], and values[2].
+*
+*   The options are the same as mcc118_a_in_read().
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param channel_mask  A bit mask of the channels to read, bit 0 is
+*       channel 0. At least one bit must be set.
+*   @param options  Options bitmask.
+*   @param values   Receives the analog input values.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful.
+*/
+int mcc118_a_in_read_multi(uint8_t address, uint8_t channel_mask,
+    uint32_t options, double* values);
+
 /**
 *   @brief Set the trigger input mode.
 *
@@ -263,6 +293,14 @@ int mcc118_a_in_scan_actual_rate(uint8_t channel_count,
 *           data to a circular buffer. The data must be read before being 
 *           overwritten to avoid a buffer overrun error. \b samples_per_channel 
 *           is only used for buffer sizing.
+*       - [OPTS_OVERWRITE](@ref OPTS_OVERWRITE): Use the scan buffer as a
+*           flight recorder. When the buffer is full the oldest data is
+*           overwritten instead of stopping the scan with a buffer overrun, so
+*           the buffer always holds the most recent data. The data is read with
+*           mcc118_a_in_scan_snapshot() or mcc118_a_in_scan_snapshot_file();
+*           the other scan read functions and mcc118_a_in_scan_event_enable()
+*           return
+*           [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER).
 *
 *   The options parameter is set to 0 or [OPTS_DEFAULT](@ref OPTS_DEFAULT) for 
 *   default operation, which is scaled and calibrated data, internal scan clock, 
@@ -406,6 +444,180 @@ int mcc118_a_in_scan_read(uint8_t address, uint16_t* status,
     int32_t samples_per_channel, double timeout, double* buffer,
     uint32_t buffer_size_samples, uint32_t* samples_read_per_channel);
 
+/**
+*   @brief Reads status and multiple samples from an analog input scan into a
+*   strided buffer.
+*
+*   This function is the same as mcc118_a_in_scan_read() except for the layout
+*   of the data in \b buffer.  Sample \b i of the \b c'th channel in the scan
+*   is stored at <tt>buffer[i * sample_stride + c * channel_stride]</tt>.  This
+*   allows the data to be written directly to its final location, such as a
+*   block of columns in a row-major frame shared by several boards
+*   (\b sample_stride is the frame width, \b channel_stride is 1) or
+*   one row per channel (\b sample_stride is 1, \b channel_stride is the row
+*   length.)  Passing \b sample_stride equal to the scan channel count and
+*   \b channel_stride of 1 produces the same layout as mcc118_a_in_scan_read().
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param status   Receives the scan status, as in mcc118_a_in_scan_read().
+*   @param samples_per_channel  The number of samples per channel to read,
+*       as in mcc118_a_in_scan_read().  If \b buffer cannot hold that many
+*       samples with the given strides then the function will read as many
+*       samples per channel as will fit.
+*   @param timeout  The amount of time in seconds to wait for the samples to be
+*       read, as in mcc118_a_in_scan_read().
+*   @param buffer   The user data buffer that receives the samples.
+*   @param buffer_size_samples  The size of the buffer in samples. Each sample
+*       is a \b double.
+*   @param sample_stride    The distance in samples between consecutive
+*       samples of one channel.  Must not be 0.
+*   @param channel_stride   The distance in samples between the channels of
+*       one sample.  Must not be 0.
+*   @param samples_read_per_channel Returns the actual number of samples read
+*       from each channel.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if a stride is 0,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if a scan is not
+*           active.
+*/
+int mcc118_a_in_scan_read_strided(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* buffer,
+    uint32_t buffer_size_samples, uint32_t sample_stride,
+    uint32_t channel_stride, uint32_t* samples_read_per_channel);
+
+/**
+*   @brief Reads status and multiple samples from an analog input scan into a
+*   separate buffer for each channel.
+*
+*   This function is the same as mcc118_a_in_scan_read() except that the data
+*   is de-interleaved: the samples for the \b c'th channel in the scan are
+*   stored contiguously in <tt>buffers[c]</tt>.  The library performs the
+*   de-interleave with a cache-blocked transpose as it copies from the scan
+*   buffer, so no separate pass over the data is needed.  To place the channels
+*   in rows of a single array use mcc118_a_in_scan_read_strided() with a
+*   \b sample_stride of 1 and a \b channel_stride of the row length.
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param status   Receives the scan status, as in mcc118_a_in_scan_read().
+*   @param samples_per_channel  The number of samples per channel to read,
+*       as in mcc118_a_in_scan_read().  If the buffers do not contain enough
+*       space then the function will read as many samples per channel as will
+*       fit.
+*   @param timeout  The amount of time in seconds to wait for the samples to be
+*       read, as in mcc118_a_in_scan_read().
+*   @param buffers  An array of pointers, one for each channel in the scan
+*       (see mcc118_a_in_scan_channel_count()), to the buffers that receive the
+*       samples.
+*   @param buffer_size_samples  The size of each buffer in samples. Each sample
+*       is a \b double.
+*   @param samples_read_per_channel Returns the actual number of samples read
+*       from each channel.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if a channel buffer
+*           is missing,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if a scan is not
+*           active.
+*/
+int mcc118_a_in_scan_read_planar(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* const* buffers,
+    uint32_t buffer_size_samples, uint32_t* samples_read_per_channel);
+
+/**
+*   @brief Access scan data in the scan buffer without copying it.
+*
+*   Returns a pointer to the oldest unread samples in the internal scan buffer,
+*   interleaved by channel and converted according to the scan options, and the
+*   number of samples per channel available there.  The count stops at the end
+*   of the circular scan buffer, so when data wraps call this function again
+*   after consuming the first part.  The data remains valid and is not removed
+*   from the scan buffer until it is released with mcc118_a_in_scan_consume().
+*   The data must be consumed before the scan buffer fills or a buffer overrun
+*   will occur, as with mcc118_a_in_scan_read().  Do not mix these functions
+*   with mcc118_a_in_scan_read() from different threads.
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param data     Receives a pointer to the unread data.
+*   @param samples_per_channel  Receives the number of samples per channel that
+*       may be accessed at \b data.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if a scan is not
+*           active.
+*/
+int mcc118_a_in_scan_peek(uint8_t address, const double** data,
+    uint32_t* samples_per_channel);
+
+/**
+*   @brief Release scan data accessed with mcc118_a_in_scan_peek().
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param samples_per_channel  The number of samples per channel to remove
+*       from the scan buffer.  Must not be more than the count returned by
+*       mcc118_a_in_scan_peek().
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if more data is
+*           released than is available,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if a scan is not
+*           active.
+*/
+int mcc118_a_in_scan_consume(uint8_t address, uint32_t samples_per_channel);
+
+/**
+*   @brief Copy the most recent data of a flight recorder scan.
+*
+*   Copies the data retained by a scan started with
+*   [OPTS_OVERWRITE](@ref OPTS_OVERWRITE) without removing it from the scan
+*   buffer. The copy is taken while the scan thread is held off, so it is a
+*   consistent window of whole scans, oldest first and interleaved by channel as
+*   in mcc118_a_in_scan_read(). If \b buffer is smaller than the retained data
+*   the most recent scans that fit are returned. The retained data is at most
+*   the scan buffer size (mcc118_a_in_scan_buffer_size()).
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param buffer   The user data buffer that receives the samples.
+*   @param buffer_size_samples  The size of the buffer in samples.
+*   @param samples_per_channel  Receives the number of samples per channel
+*       copied.
+*   @param first_sample  Receives the index of the first sample per channel
+*       copied, counted from the start of the scan; may be NULL.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if an argument is
+*           invalid or the scan was not started with OPTS_OVERWRITE,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if a scan is not
+*           active.
+*/
+int mcc118_a_in_scan_snapshot(uint8_t address, double* buffer,
+    uint32_t buffer_size_samples, uint32_t* samples_per_channel,
+    uint64_t* first_sample);
+
+/**
+*   @brief Write the data of a flight recorder scan to a file.
+*
+*   Takes a snapshot of all the retained data with mcc118_a_in_scan_snapshot()
+*   and writes it to a file as native double values interleaved by channel,
+*   with no header. The file is written after the copy is taken, so the scan is
+*   not held up by the file system. An existing file is replaced.
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param path     The path of the file to write.
+*   @param samples_per_channel  Receives the number of samples per channel
+*       written; may be NULL.
+*   @param first_sample  Receives the index of the first sample per channel
+*       written, counted from the start of the scan; may be NULL.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if an argument is
+*           invalid or the scan was not started with OPTS_OVERWRITE,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if a scan is not
+*           active or the file could not be written.
+*/
+int mcc118_a_in_scan_snapshot_file(uint8_t address, const char* path,
+    uint32_t* samples_per_channel, uint64_t* first_sample);
+
 /**
 *   @brief Stops an analog input scan.
 *
@@ -437,6 +649,35 @@ int mcc118_a_in_scan_cleanup(uint8_t address);
 */
 int mcc118_a_in_scan_channel_count(uint8_t address);
 
+/**
+*   @brief Get an event descriptor that signals when scan data is available.
+*
+*   The returned descriptor becomes readable when at least
+*   \b samples_per_channel samples per channel are in the scan buffer, or
+*   when the scan stops for any reason.  It is intended for use with poll(),
+*   select(), epoll or an event loop, so the application does not have to
+*   block in mcc118_a_in_scan_read() waiting for data.  Read the descriptor
+*   to reset it before waiting again.  Calling this function again on the same
+*   scan changes the threshold and returns the same descriptor.
+*
+*   The descriptor is owned by the library and is closed by
+*   mcc118_a_in_scan_cleanup(); do not close it in the application.
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param samples_per_channel  The number of samples per channel that must be
+*       available before the descriptor is signaled.  The threshold is limited
+*       to the scan buffer size.
+*   @param fd   Receives the event descriptor.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if an argument is
+*           invalid or the scan was started with OPTS_OVERWRITE,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if a scan has not
+*       been started under this instance of the device.
+*/
+int mcc118_a_in_scan_event_enable(uint8_t address,
+    uint32_t samples_per_channel, int* fd);
+
 /**
 *   @brief Test the CLK pin.
 *
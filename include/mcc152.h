@@ -31,6 +31,55 @@ struct MCC152DeviceInfo
     const double AO_MAX_RANGE;
 };
 
+/// The maximum analog output scan update rate in updates per second.
+#define MCC152_AO_SCAN_MAX_RATE     10000.0
+
+/// The analog output channels in an analog output scan channel mask.
+#define MCC152_AO_SCAN_MASK         0x03
+/// Add the DIO output port to an analog output scan channel mask, so the scan
+/// plays a digital pattern.
+#define MCC152_AO_SCAN_DIO          0x04
+
+/// Timing statistics of an analog output scan.
+struct MCC152AOutScanStats
+{
+    /// The number of output updates performed.
+    uint64_t updates;
+    /// The number of updates that started more than one update period after
+    /// their scheduled time (underruns: the scan thread fell behind.)
+    uint64_t late_updates;
+    /// The measured update rate in updates per second, from the first to the
+    /// most recent update.
+    double actual_rate;
+    /// The mean delay in microseconds from the scheduled time of an update to
+    /// the start of its transfers.
+    double latency_mean;
+    /// The maximum delay in microseconds from the scheduled time of an update
+    /// to the start of its transfers.
+    double latency_max;
+    /// The standard deviation of the delay in microseconds (the timing
+    /// jitter.)
+    double jitter;
+};
+
+/// The number of events held by the DIO event capture queue.
+#define MCC152_DIO_EVENT_QUEUE_SIZE 4096
+
+/// A DIO change event recorded by the DIO event capture.
+struct MCC152DIOEvent
+{
+    /// The CLOCK_MONOTONIC time of the interrupt in nanoseconds.
+    uint64_t timestamp;
+    /// The board address.
+    uint8_t address;
+    /// The input port value, or the latched value for channels with input
+    /// latching enabled.
+    uint8_t value;
+    /// The channels that changed (the interrupt status.)
+    uint8_t changed;
+    uint8_t reserved[5];
+};
+
 /// DIO Configuration Items
 enum DIOConfigItem
 {
@@ -132,6 +181,157 @@ int mcc152_a_out_write(uint8_t address, uint8_t channel, uint32_t options,
 */
 int mcc152_a_out_write_all(uint8_t address, uint32_t options, double* values);
 
+/**
+*   @brief Start a timed analog output scan.
+*
+*   A thread in the library writes the analog outputs at \b rate updates per
+*   second, scheduling each update at an absolute time so the timing does not
+*   drift.  The DAC commands for each update are built when the data is
+*   written to the scan buffer, so an update is a single SPI transfer.  When
+*   both channels are in \b channel_mask they update at the same time.  The
+*   update timing depends on the system load; use mcc152_a_out_scan_stats() to
+*   read the achieved rate and the timing jitter.  The thread runs at a
+*   real-time priority (SCHED_FIFO) when the process is allowed to.
+*
+*   Add [MCC152_AO_SCAN_DIO](@ref MCC152_AO_SCAN_DIO) to \b channel_mask to
+*   write the DIO output port on each update, after the analog outputs; use
+*   it alone for a digital pattern generator.  The port writes share one open
+*   I2C handle and are prepared with the DAC commands, so an update adds a
+*   single I2C transfer.  That transfer takes about 0.3 ms on a 100 kHz bus,
+*   which limits the rate of a scan that includes the port.  Set the channel
+*   directions with mcc152_dio_config_write_port() before the scan.
+*
+*   \b buffer holds \b samples_per_channel values for each channel in
+*   \b channel_mask, interleaved by channel with the DIO port value (0 - 255)
+*   last, and is copied into the scan
+*   buffer, which holds \b samples_per_channel samples per channel.
+*   - With [OPTS_CONTINUOUS](@ref OPTS_CONTINUOUS) the buffer is played
+*       repeatedly until mcc152_a_out_scan_stop() is called.
+*   - Otherwise the buffer is played once and more data may be added with
+*       mcc152_a_out_scan_write() as the buffer empties, streaming a waveform
+*       of any length.  The scan stops when the buffer runs out of data.
+*
+*   The outputs keep the last value written when the scan stops.
+*   mcc152_a_out_write() and mcc152_a_out_write_all() return
+*   [RESULT_BUSY](@ref RESULT_BUSY) while a scan of the analog outputs is
+*   running, and mcc152_dio_output_write_bit(), mcc152_dio_output_write_port()
+*   and mcc152_dio_reset() while a scan of the DIO port is running.  Call
+*   mcc152_a_out_scan_cleanup() to free the scan resources.
+*
+*   The valid options are:
+*       - [OPTS_NOSCALEDATA](@ref OPTS_NOSCALEDATA): The values are DAC codes
+*           (0 - 4095) rather than voltages.
+*       - [OPTS_CONTINUOUS](@ref OPTS_CONTINUOUS): Repeat the buffer until
+*           stopped.
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param channel_mask A bit mask of the channels to write: bits 0 and 1 for
+*       the analog outputs and [MCC152_AO_SCAN_DIO](@ref MCC152_AO_SCAN_DIO)
+*       for the DIO port.
+*   @param buffer   The values to write.
+*   @param samples_per_channel  The number of samples per channel in
+*       \b buffer.
+*   @param rate     The update rate in updates per second, max
+*       [MCC152_AO_SCAN_MAX_RATE](@ref MCC152_AO_SCAN_MAX_RATE).
+*   @param options  Options bitmask.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BUSY](@ref RESULT_BUSY) if a scan is already active,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if the buffer
+*           or thread could not be created.
+*/
+int mcc152_a_out_scan_start(uint8_t address, uint8_t channel_mask,
+    double* buffer, uint32_t samples_per_channel, double rate,
+    uint32_t options);
+
+/**
+*   @brief Add data to a streaming analog output scan.
+*
+*   Copies values into the free space of the scan buffer of a scan started
+*   without [OPTS_CONTINUOUS](@ref OPTS_CONTINUOUS).
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param options  Options bitmask, [OPTS_NOSCALEDATA](@ref OPTS_NOSCALEDATA)
+*       if the values are DAC codes.
+*   @param buffer   The values to write, interleaved by channel.
+*   @param samples_per_channel  The number of samples per channel in
+*       \b buffer.
+*   @param timeout  The time in seconds to wait for space for all the samples;
+*       negative waits indefinitely, 0 writes what fits and returns
+*       immediately.
+*   @param samples_written  Receives the number of samples per channel
+*       written, may be NULL.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_TIMEOUT](@ref RESULT_TIMEOUT) if not all the samples were
+*           written in time,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if the scan is
+*           continuous,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if no scan is
+*           running.
+*/
+int mcc152_a_out_scan_write(uint8_t address, uint32_t options, double* buffer,
+    uint32_t samples_per_channel, double timeout, uint32_t* samples_written);
+
+/**
+*   @brief Read the status of an analog output scan.
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param status   Receives the scan status,
+*       [STATUS_RUNNING](@ref STATUS_RUNNING) while the outputs are being
+*       updated.
+*   @param samples_free Receives the free space in the scan buffer in samples
+*       per channel (0 for a continuous scan), may be NULL.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if no scan is
+*           active,
+*       [RESULT_COMMS_FAILURE](@ref RESULT_COMMS_FAILURE) if an update
+*           failed and stopped the scan.
+*/
+int mcc152_a_out_scan_status(uint8_t address, uint16_t* status,
+    uint32_t* samples_free);
+
+/**
+*   @brief Read the timing statistics of an analog output scan.
+*
+*   The statistics remain available after the scan stops, until
+*   mcc152_a_out_scan_cleanup() is called.
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @param stats    Receives the statistics.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if no scan is
+*           active.
+*/
+int mcc152_a_out_scan_stats(uint8_t address,
+    struct MCC152AOutScanStats* stats);
+
+/**
+*   @brief Stop an analog output scan.
+*
+*   The outputs keep the last value written.  The scan stops at the next
+*   scheduled update.
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful.
+*/
+int mcc152_a_out_scan_stop(uint8_t address);
+
+/**
+*   @brief Free the resources used by an analog output scan.
+*
+*   Stops the scan first if it is running.  This must be called before
+*   another scan can be started.
+*
+*   @param address  The board address (0 - 7). Board must already be opened.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful.
+*/
+int mcc152_a_out_scan_cleanup(uint8_t address);
+
 /**
 *   @brief Reset the digital I/O to the default configuration.
 *
@@ -517,6 +717,82 @@ int mcc152_dio_config_read_bit(uint8_t address, uint8_t channel, uint8_t item,
 */
 int mcc152_dio_config_read_port(uint8_t address, uint8_t item, uint8_t* value);
 
+/**
+*   @brief Start capturing DIO change events.
+*
+*   On each interrupt the capture engine reads the interrupt status and input
+*   port of every capturing board in one I2C transfer and appends a
+*   @ref MCC152DIOEvent for each board with a pending interrupt to a queue
+*   that is read with mcc152_dio_event_read().  Reading the input port clears
+*   the interrupts, so the boards must not be read in a
+*   hat_interrupt_callback_enable() callback while capturing.
+*
+*   The boards must already be opened.  Configure the channels to capture
+*   with [DIO_INT_MASK](@ref DIO_INT_MASK), and enable
+*   [DIO_INPUT_LATCH](@ref DIO_INPUT_LATCH) to keep short pulses.  Calling
+*   this function while capturing adds the boards to the capture, and
+*   mcc152_close() removes a board.
+*
+*   @param address_mask A bit mask of the board addresses to capture.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_BAD_PARAMETER](@ref RESULT_BAD_PARAMETER) if a board is not
+*           open,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if the
+*           interrupt can't be enabled.
+*/
+int mcc152_dio_event_capture_start(uint8_t address_mask);
+
+/**
+*   @brief Read DIO change events.
+*
+*   Returns the events in the order they were recorded, up to
+*   \b max_events.  Only one thread may read the events.
+*
+*   @param events   Receives the events.
+*   @param max_events   The maximum number of events to read.
+*   @param timeout  The time in seconds to wait for at least one event;
+*       negative waits indefinitely, 0 returns immediately.
+*   @param events_read  Receives the number of events read.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_TIMEOUT](@ref RESULT_TIMEOUT) if no event arrived in time,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if the capture
+*           is not running or was stopped while waiting.
+*/
+int mcc152_dio_event_read(struct MCC152DIOEvent* events, uint32_t max_events,
+    double timeout, uint32_t* events_read);
+
+/**
+*   @brief Read the DIO event capture status.
+*
+*   @param queued   Receives the number of events waiting in the queue, may
+*       be NULL.
+*   @param overflows    Receives the number of events lost because the queue
+*       was full, may be NULL.
+*   @param errors   Receives the number of interrupts on which the boards
+*       could not be read, may be NULL.
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful,
+*       [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL) if the capture
+*           is not running.
+*/
+int mcc152_dio_event_status(uint32_t* queued, uint64_t* overflows,
+    uint64_t* errors);
+
+/**
+*   @brief Stop capturing DIO change events and free the queue.
+*
+*   Events that have not been read are discarded.  A thread waiting in
+*   mcc152_dio_event_read() is woken and returns
+*   [RESULT_RESOURCE_UNAVAIL](@ref RESULT_RESOURCE_UNAVAIL); this function
+*   returns once it has left.
+*
+*   @return [Result code](@ref ResultCode),
+*       [RESULT_SUCCESS](@ref RESULT_SUCCESS) if successful.
+*/
+int mcc152_dio_event_capture_stop(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,675 @@
+/*
+*   file daqhatsd_client.c
+*   author Measurement Computing Corp.
+*   brief This file contains the client functions for the daqhatsd daemon.
+*
+*   date 17 Oct 2026
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "daqhats.h"
+#include "daqhatsd.h"
+#include "daqhatsd_protocol.h"
+#include "util.h"
+
+#define MIN(a, b)   ((a < b) ? a : b)
+
+// A scan joined by this process
+struct DaqhatsdClientScan
+{
+    struct DaqhatsdScanRing* ring;
+    size_t map_size;
+    uint64_t read_count;
+    int notify_fd;          // valid while joined
+    bool joined;
+};
+
+// _daqhatsd_mutex protects the connection and _scans[]
+static int _daqhatsd_fd = -1;
+static pthread_mutex_t _daqhatsd_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct DaqhatsdClientScan _scans[MAX_NUMBER_HATS];
+
+/******************************************************************************
+  Connect to the daemon if not already connected.  Must be called with
+  _daqhatsd_mutex held.
+ *****************************************************************************/
+static int _daqhatsd_open(void)
+{
+    struct sockaddr_un addr;
+
+    if (_daqhatsd_fd != -1)
+    {
+        return RESULT_SUCCESS;
+    }
+
+    _daqhatsd_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (_daqhatsd_fd == -1)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, DAQHATSD_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    if (connect(_daqhatsd_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        close(_daqhatsd_fd);
+        _daqhatsd_fd = -1;
+        return RESULT_COMMS_FAILURE;
+    }
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Receive a reply from the daemon.  notify_fd, if not NULL, receives the
+  socket passed with the reply or -1.
+ *****************************************************************************/
+static bool _daqhatsd_receive(struct DaqhatsdReply* reply, int* notify_fd)
+{
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr* cmsg;
+    int fd;
+
+    iov.iov_base = reply;
+    iov.iov_len = sizeof(*reply);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    if (recvmsg(_daqhatsd_fd, &msg, MSG_CMSG_CLOEXEC) !=
+        (ssize_t)sizeof(*reply))
+    {
+        return false;
+    }
+
+    fd = -1;
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if ((cmsg != NULL) &&
+        (cmsg->cmsg_level == SOL_SOCKET) &&
+        (cmsg->cmsg_type == SCM_RIGHTS) &&
+        (cmsg->cmsg_len == CMSG_LEN(sizeof(int))))
+    {
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+
+    if (notify_fd != NULL)
+    {
+        *notify_fd = fd;
+    }
+    else if (fd != -1)
+    {
+        close(fd);
+    }
+    return true;
+}
+
+/******************************************************************************
+  Send a request to the daemon and wait for the reply.  Must be called with
+  _daqhatsd_mutex held.
+ *****************************************************************************/
+static int _daqhatsd_exchange(const struct DaqhatsdRequest* request,
+    struct DaqhatsdReply* reply, int* notify_fd)
+{
+    int result;
+
+    if (notify_fd != NULL)
+    {
+        *notify_fd = -1;
+    }
+    if ((result = _daqhatsd_open()) == RESULT_SUCCESS)
+    {
+        if ((send(_daqhatsd_fd, request, sizeof(*request), MSG_NOSIGNAL) !=
+                (ssize_t)sizeof(*request)) ||
+            !_daqhatsd_receive(reply, notify_fd))
+        {
+            // the daemon went away; the next request reconnects
+            close(_daqhatsd_fd);
+            _daqhatsd_fd = -1;
+            result = RESULT_COMMS_FAILURE;
+        }
+        else
+        {
+            result = reply->result;
+        }
+    }
+    return result;
+}
+
+/******************************************************************************
+  Send a request to the daemon and wait for the reply.
+ *****************************************************************************/
+static int _daqhatsd_request(const struct DaqhatsdRequest* request,
+    struct DaqhatsdReply* reply)
+{
+    int result;
+
+    pthread_mutex_lock(&_daqhatsd_mutex);
+    result = _daqhatsd_exchange(request, reply, NULL);
+    pthread_mutex_unlock(&_daqhatsd_mutex);
+    return result;
+}
+
+/******************************************************************************
+  Unmap the scan ring for an address.  Must be called with _daqhatsd_mutex
+  held, as must the other functions that use _scans[].
+ *****************************************************************************/
+static void _daqhatsd_unmap(uint8_t address)
+{
+    if (_scans[address].ring != NULL)
+    {
+        munmap(_scans[address].ring, _scans[address].map_size);
+        _scans[address].ring = NULL;
+        _scans[address].map_size = 0;
+    }
+}
+
+/******************************************************************************
+  Map the scan ring published by the daemon for an address.
+ *****************************************************************************/
+static int _daqhatsd_map(uint8_t address)
+{
+    char name[32];
+    struct stat st;
+    void* ptr;
+    int fd;
+
+    _daqhatsd_unmap(address);
+
+    snprintf(name, sizeof(name), DAQHATSD_SHM_NAME, address);
+    if ((fd = shm_open(name, O_RDONLY, 0)) == -1)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    if ((fstat(fd, &st) != 0) ||
+        ((size_t)st.st_size < sizeof(struct DaqhatsdScanRing)))
+    {
+        close(fd);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    _scans[address].ring = (struct DaqhatsdScanRing*)ptr;
+    _scans[address].map_size = st.st_size;
+    if ((_scans[address].ring->magic != DAQHATSD_MAGIC) ||
+        (_scans[address].ring->version != DAQHATSD_VERSION))
+    {
+        _daqhatsd_unmap(address);
+        return RESULT_INVALID_DEVICE;
+    }
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Return the samples available to this process and its status, moving the
+  read count forward if the daemon has overwritten unread data.
+ *****************************************************************************/
+static uint64_t _daqhatsd_available(struct DaqhatsdClientScan* scan,
+    uint16_t* status)
+{
+    uint64_t write_count;
+
+    write_count = __atomic_load_n(&scan->ring->write_count, __ATOMIC_ACQUIRE);
+    *status |= __atomic_load_n(&scan->ring->status, __ATOMIC_ACQUIRE);
+
+    if ((write_count - scan->read_count) > scan->ring->buffer_size)
+    {
+        // this process fell behind; continue with the newest data
+        *status |= STATUS_BUFFER_OVERRUN;
+        scan->read_count = write_count;
+    }
+    return write_count - scan->read_count;
+}
+
+/******************************************************************************
+  Leave a joined scan.
+ *****************************************************************************/
+static int _daqhatsd_leave(uint8_t address)
+{
+    struct DaqhatsdRequest request;
+    struct DaqhatsdReply reply;
+
+    if (!_scans[address].joined)
+    {
+        return RESULT_SUCCESS;
+    }
+    _scans[address].joined = false;
+    if (_scans[address].notify_fd != -1)
+    {
+        close(_scans[address].notify_fd);
+        _scans[address].notify_fd = -1;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.command = DAQHATSD_CMD_SCAN_STOP;
+    request.address = address;
+    return _daqhatsd_exchange(&request, &reply, NULL);
+}
+
+/******************************************************************************
+  Connect to the daemon.
+ *****************************************************************************/
+int daqhatsd_connect(void)
+{
+    int result;
+
+    pthread_mutex_lock(&_daqhatsd_mutex);
+    result = _daqhatsd_open();
+    pthread_mutex_unlock(&_daqhatsd_mutex);
+    return result;
+}
+
+/******************************************************************************
+  Disconnect from the daemon and release all scans.
+ *****************************************************************************/
+void daqhatsd_disconnect(void)
+{
+    uint8_t address;
+
+    pthread_mutex_lock(&_daqhatsd_mutex);
+    if (_daqhatsd_fd != -1)
+    {
+        // the daemon releases the scans this connection joined
+        close(_daqhatsd_fd);
+        _daqhatsd_fd = -1;
+    }
+
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        if (_scans[address].joined)
+        {
+            _scans[address].joined = false;
+            close(_scans[address].notify_fd);
+            _scans[address].notify_fd = -1;
+        }
+        _daqhatsd_unmap(address);
+    }
+    pthread_mutex_unlock(&_daqhatsd_mutex);
+}
+
+/******************************************************************************
+  Read a single analog input value through the daemon.
+ *****************************************************************************/
+int daqhatsd_a_in_read(uint8_t address, uint8_t channel, uint32_t options,
+    double* value)
+{
+    struct DaqhatsdRequest request;
+    struct DaqhatsdReply reply;
+    int result;
+
+    if ((address >= MAX_NUMBER_HATS) ||
+        (value == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.command = DAQHATSD_CMD_A_IN_READ;
+    request.address = address;
+    request.channel = channel;
+    request.options = options;
+
+    if ((result = _daqhatsd_request(&request, &reply)) == RESULT_SUCCESS)
+    {
+        *value = reply.value;
+    }
+    return result;
+}
+
+/******************************************************************************
+  Start or join a scan run by the daemon.
+ *****************************************************************************/
+int daqhatsd_a_in_scan_start(uint8_t address, uint8_t channel_mask,
+    uint32_t samples_per_channel, double sample_rate_per_channel,
+    uint32_t options)
+{
+    struct DaqhatsdRequest request;
+    struct DaqhatsdReply reply;
+    int notify_fd;
+    int result;
+
+    if ((address >= MAX_NUMBER_HATS) ||
+        (channel_mask == 0))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    pthread_mutex_lock(&_daqhatsd_mutex);
+    if (_scans[address].joined)
+    {
+        pthread_mutex_unlock(&_daqhatsd_mutex);
+        return RESULT_BUSY;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.command = DAQHATSD_CMD_SCAN_START;
+    request.address = address;
+    request.channel_mask = channel_mask;
+    request.samples_per_channel = samples_per_channel;
+    request.sample_rate_per_channel = sample_rate_per_channel;
+    request.options = options;
+
+    if ((result = _daqhatsd_exchange(&request, &reply, &notify_fd)) !=
+        RESULT_SUCCESS)
+    {
+        pthread_mutex_unlock(&_daqhatsd_mutex);
+        return result;
+    }
+
+    _scans[address].joined = true;
+    _scans[address].notify_fd = notify_fd;
+    if (notify_fd == -1)
+    {
+        result = RESULT_COMMS_FAILURE;
+    }
+    else
+    {
+        result = _daqhatsd_map(address);
+    }
+    if (result != RESULT_SUCCESS)
+    {
+        _daqhatsd_leave(address);
+        pthread_mutex_unlock(&_daqhatsd_mutex);
+        return result;
+    }
+    _scans[address].read_count = reply.start_count;
+    pthread_mutex_unlock(&_daqhatsd_mutex);
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Read the scan status for this process.
+ *****************************************************************************/
+int daqhatsd_a_in_scan_status(uint8_t address, uint16_t* status,
+    uint32_t* samples_per_channel)
+{
+    struct DaqhatsdClientScan* scan;
+    uint16_t stat;
+    uint64_t available;
+
+    if ((address >= MAX_NUMBER_HATS) ||
+        (status == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    pthread_mutex_lock(&_daqhatsd_mutex);
+    scan = &_scans[address];
+    if (scan->ring == NULL)
+    {
+        pthread_mutex_unlock(&_daqhatsd_mutex);
+        *status = 0;
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    stat = 0;
+    available = _daqhatsd_available(scan, &stat);
+    *status = stat;
+    if (samples_per_channel)
+    {
+        *samples_per_channel = available / scan->ring->channel_count;
+    }
+    pthread_mutex_unlock(&_daqhatsd_mutex);
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Read scan data published by the daemon.
+ *****************************************************************************/
+int daqhatsd_a_in_scan_read(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* buffer,
+    uint32_t buffer_size_samples, uint32_t* samples_read_per_channel)
+{
+    struct DaqhatsdClientScan* scan;
+    struct timespec start_time;
+    struct timespec current_time;
+    struct pollfd pfd;
+    uint64_t available;
+    uint64_t reserve_count;
+    uint32_t channel_count;
+    uint32_t samples_to_read;
+    uint32_t samples_read;
+    uint32_t current_read;
+    uint32_t index;
+    uint32_t first;
+    uint16_t stat;
+    uint8_t event;
+    double remaining;
+    int wait_ms;
+    int result;
+
+    if ((address >= MAX_NUMBER_HATS) ||
+        (status == NULL) ||
+        ((samples_per_channel > 0) &&
+            ((buffer == NULL) || (buffer_size_samples == 0))))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    pthread_mutex_lock(&_daqhatsd_mutex);
+    scan = &_scans[address];
+    if (scan->ring == NULL)
+    {
+        pthread_mutex_unlock(&_daqhatsd_mutex);
+        *status = 0;
+        if (samples_read_per_channel)
+        {
+            *samples_read_per_channel = 0;
+        }
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    channel_count = scan->ring->channel_count;
+
+    stat = 0;
+    available = _daqhatsd_available(scan, &stat);
+    if (samples_per_channel == -1)
+    {
+        // return all available, ignore timeout
+        samples_to_read = (uint32_t)available;
+    }
+    else
+    {
+        samples_to_read = samples_per_channel * channel_count;
+    }
+    if (samples_to_read > buffer_size_samples)
+    {
+        samples_to_read = buffer_size_samples;
+    }
+    samples_to_read = (samples_to_read / channel_count) * channel_count;
+
+    samples_read = 0;
+    result = RESULT_SUCCESS;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    while (samples_to_read > 0)
+    {
+        if (scan->joined)
+        {
+            // consume the notifications for the data about to be checked
+            while (recv(scan->notify_fd, &event, sizeof(event),
+                MSG_DONTWAIT) > 0)
+            {
+            }
+        }
+
+        stat &= ~STATUS_RUNNING;
+        available = _daqhatsd_available(scan, &stat);
+        if (!scan->joined)
+        {
+            // this process left the scan; only published data remains
+            stat &= ~STATUS_RUNNING;
+        }
+        if (available > 0)
+        {
+            current_read = (uint32_t)MIN(available, (uint64_t)samples_to_read);
+
+            // copy, wrapping at the end of the ring
+            index = scan->read_count % scan->ring->buffer_size;
+            first = MIN(current_read, scan->ring->buffer_size - index);
+            memcpy(&buffer[samples_read], &scan->ring->data[index],
+                first * sizeof(double));
+            memcpy(&buffer[samples_read + first], &scan->ring->data[0],
+                (current_read - first) * sizeof(double));
+
+            // discard the copy if the daemon was overwriting it meanwhile
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            reserve_count = __atomic_load_n(&scan->ring->reserve_count,
+                __ATOMIC_RELAXED);
+            if ((reserve_count - scan->read_count) > scan->ring->buffer_size)
+            {
+                stat |= STATUS_BUFFER_OVERRUN;
+                scan->read_count = __atomic_load_n(&scan->ring->write_count,
+                    __ATOMIC_ACQUIRE);
+                continue;
+            }
+
+            scan->read_count += current_read;
+            samples_read += current_read;
+            samples_to_read -= current_read;
+            continue;
+        }
+
+        if (!(stat & STATUS_RUNNING) ||
+            (stat & (STATUS_HW_OVERRUN | STATUS_BUFFER_OVERRUN)))
+        {
+            break;
+        }
+
+        // wait for the daemon to publish more data
+        wait_ms = -1;
+        if (timeout >= 0.0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &current_time);
+            remaining = timeout -
+                ((current_time.tv_sec - start_time.tv_sec) +
+                (current_time.tv_nsec - start_time.tv_nsec) / 1e9);
+            if (remaining <= 0.0)
+            {
+                if (timeout > 0.0)
+                {
+                    result = RESULT_TIMEOUT;
+                }
+                break;
+            }
+            if (remaining * 1e3 >= INT_MAX)
+            {
+                wait_ms = INT_MAX;
+            }
+            else
+            {
+                // round up so a short remainder is not a busy loop
+                wait_ms = (int)(remaining * 1e3) + 1;
+            }
+        }
+
+        pfd.fd = scan->notify_fd;
+        pfd.events = POLLIN;
+        pthread_mutex_unlock(&_daqhatsd_mutex);
+        poll(&pfd, 1, wait_ms);
+        pthread_mutex_lock(&_daqhatsd_mutex);
+
+        if (scan->ring == NULL)
+        {
+            // cleaned up by another thread meanwhile
+            stat &= ~STATUS_RUNNING;
+            break;
+        }
+        if (scan->joined && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+        {
+            // the daemon went away
+            result = RESULT_COMMS_FAILURE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_daqhatsd_mutex);
+
+    *status = stat;
+    if (samples_read_per_channel)
+    {
+        *samples_read_per_channel = samples_read / channel_count;
+    }
+    return result;
+}
+
+/******************************************************************************
+  Return the number of channels in a joined scan.
+ *****************************************************************************/
+int daqhatsd_a_in_scan_channel_count(uint8_t address)
+{
+    int count;
+
+    if (address >= MAX_NUMBER_HATS)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&_daqhatsd_mutex);
+    count = 0;
+    if (_scans[address].ring != NULL)
+    {
+        count = _scans[address].ring->channel_count;
+    }
+    pthread_mutex_unlock(&_daqhatsd_mutex);
+    return count;
+}
+
+/******************************************************************************
+  Leave a joined scan.
+ *****************************************************************************/
+int daqhatsd_a_in_scan_stop(uint8_t address)
+{
+    int result;
+
+    if (address >= MAX_NUMBER_HATS)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    pthread_mutex_lock(&_daqhatsd_mutex);
+    result = _daqhatsd_leave(address);
+    pthread_mutex_unlock(&_daqhatsd_mutex);
+    return result;
+}
+
+/******************************************************************************
+  Leave a joined scan and release its shared memory.
+ *****************************************************************************/
+int daqhatsd_a_in_scan_cleanup(uint8_t address)
+{
+    int result;
+
+    if (address >= MAX_NUMBER_HATS)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    pthread_mutex_lock(&_daqhatsd_mutex);
+    result = _daqhatsd_leave(address);
+    _daqhatsd_unmap(address);
+    pthread_mutex_unlock(&_daqhatsd_mutex);
+    return result;
+}
@@ -0,0 +1,78 @@
+/*
+*   file daqhatsd_protocol.h
+*   author Measurement Computing Corp.
+*   brief This file contains the definitions shared by the daqhatsd daemon and
+*       its client functions in the library.
+*
+*   date 17 Oct 2026
+*/
+#ifndef _DAQHATSD_PROTOCOL_H
+#define _DAQHATSD_PROTOCOL_H
+
+#include <stdint.h>
+#include "util.h"
+
+// The control socket (SOCK_SEQPACKET) created by the daemon
+#define DAQHATSD_SOCKET_PATH    "/run/daqhatsd.sock"
+
+// The shared memory scan ring for each board address
+#define DAQHATSD_SHM_NAME       "/daqhatsd_scan_%u"
+
+#define DAQHATSD_MAGIC          0x44514853  // "DQHS"
+#define DAQHATSD_VERSION        3
+
+// Control commands
+enum DaqhatsdCommand
+{
+    DAQHATSD_CMD_A_IN_READ = 1,
+    DAQHATSD_CMD_SCAN_START,
+    DAQHATSD_CMD_SCAN_STOP
+};
+
+// Control request, one per message
+struct DaqhatsdRequest
+{
+    uint32_t command;
+    uint8_t address;
+    uint8_t channel;
+    uint8_t channel_mask;
+    uint8_t reserved;
+    uint32_t samples_per_channel;
+    uint32_t options;
+    double sample_rate_per_channel;
+};
+
+// Control reply, one per request.  A successful DAQHATSD_CMD_SCAN_START reply
+// carries a notification socket (SCM_RIGHTS); the daemon sends a message on it
+// each time it publishes data or the scan status changes so the client can
+// wait for data with poll().
+struct DaqhatsdReply
+{
+    int32_t result;
+    uint32_t reserved;
+    double value;
+    // The write_count of the scan ring when the client joined the scan
+    uint64_t start_count;
+};
+
+// Shared memory scan ring.  The daemon is the only writer.  Before storing
+// whole scans at data[write_count % buffer_size] it advances reserve_count to
+// the end of the space it will write, and afterwards it publishes them by
+// advancing write_count (release).  Each client keeps its own read count and
+// detects that it has fallen behind when write_count - read_count exceeds
+// buffer_size; a copy is only kept if reserve_count - read_count, read after
+// the copy, does not exceed buffer_size (the data was not being overwritten.)
+// The acquisition is never slowed by a client.
+struct DaqhatsdScanRing
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t channel_count;
+    uint32_t buffer_size;           // samples, a multiple of channel_count
+    uint64_t write_count;           // samples written since the scan started
+    uint64_t reserve_count;         // write_count plus the samples being written
+    uint16_t status;                // STATUS_* flags of the acquisition
+    CACHE_ALIGNED double data[];
+};
+
+#endif
@@ -0,0 +1,641 @@
+/*
+*   file hat_poll.c
+*   author Measurement Computing Corp.
+*   brief This file contains the software-timed polling functions.
+*
+*   date 17 Oct 2026
+*/
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "daqhats.h"
+#include "hat_poll.h"
+#include "util.h"
+
+#define MIN(a, b)   ((a < b) ? a : b)
+
+#define NSEC_PER_SEC            1000000000ULL
+// Longest sleep before checking for a stop request
+#define POLL_STOP_CHECK_NS      100000000ULL
+// Priority above the SCHED_FIFO minimum, the same as the MCC 152 output scan
+#define POLL_PRIORITY           10
+#define POLL_MIN_BUFFER_SIZE    64
+#define POLL_MAX_PERIOD         86400.0
+
+// Items read with one call
+struct PollGroup
+{
+    uint8_t address;
+    uint8_t operation;
+    uint8_t channel_mask;       // MCC 118 / MCC 128 channels in the group
+    uint32_t options;
+    uint16_t item_count;
+    uint16_t items[HAT_POLL_MAX_ITEMS];
+};
+
+struct HatPoll
+{
+    struct HatPollItem items[HAT_POLL_MAX_ITEMS];
+    uint16_t item_count;
+
+    // the SPI groups are first so they run under one lock
+    struct PollGroup groups[HAT_POLL_MAX_ITEMS];
+    uint16_t group_count;
+    uint16_t spi_group_count;
+
+    uint64_t period_ns;
+    pthread_t thread;
+    bool stop_thread;
+
+    // single producer / single consumer tick buffer; the indexes count ticks
+    // and are masked with buffer_size - 1
+    uint32_t buffer_size;
+    struct HatPollTick* ticks;
+    double* values;
+    double* scratch;            // values of a tick that is discarded
+    uint32_t write_index;
+    uint32_t read_index;
+    int event_fd;
+
+    // statistics
+    uint64_t tick_count;
+    uint64_t late_ticks;
+    uint64_t missed_deadlines;
+    uint64_t overruns;
+    uint64_t errors;
+    uint64_t latency_max_ns;
+    uint64_t duration_max_ns;
+};
+
+static inline uint64_t _timespec_ns(const struct timespec* ts)
+{
+    return ((uint64_t)ts->tv_sec * NSEC_PER_SEC) + ts->tv_nsec;
+}
+
+static inline uint64_t _now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return _timespec_ns(&now);
+}
+
+/******************************************************************************
+  Check an item against the open boards.
+ *****************************************************************************/
+static bool _item_valid(const struct HatPollItem* item)
+{
+    uint8_t mode;
+
+    if (item->address >= MAX_NUMBER_HATS)
+    {
+        return false;
+    }
+
+    switch (item->operation)
+    {
+    case HAT_POLL_MCC118_A_IN:
+        return (mcc118_is_open(item->address) && (item->channel < 8));
+    case HAT_POLL_MCC128_A_IN:
+        // channels 4 - 7 only exist in single-ended mode
+        return (mcc128_is_open(item->address) &&
+            (mcc128_a_in_mode_read(item->address, &mode) == RESULT_SUCCESS) &&
+            (item->channel < ((mode == A_IN_MODE_SE) ? 8 : 4)));
+    case HAT_POLL_MCC134_T_IN:
+    case HAT_POLL_MCC134_A_IN:
+        return (mcc134_is_open(item->address) && (item->channel < 4));
+    case HAT_POLL_MCC152_DIO_IN:
+        return (mcc152_is_open(item->address) && (item->channel < 8));
+    case HAT_POLL_MCC152_DIO_PORT:
+        return mcc152_is_open(item->address);
+    default:
+        return false;
+    }
+}
+
+/******************************************************************************
+  Return true if an item is read over the SPI bus.
+ *****************************************************************************/
+static bool _item_spi(const struct HatPollItem* item)
+{
+    return ((item->operation == HAT_POLL_MCC118_A_IN) ||
+        (item->operation == HAT_POLL_MCC128_A_IN));
+}
+
+/******************************************************************************
+  Add an item to the group it can be read with, creating the group if needed.
+ *****************************************************************************/
+static void _group_item(struct HatPoll* poll, uint16_t index)
+{
+    const struct HatPollItem* item = &poll->items[index];
+    struct PollGroup* group;
+    uint16_t count;
+
+    for (count = 0; count < poll->group_count; count++)
+    {
+        group = &poll->groups[count];
+        if (group->address != item->address)
+        {
+            continue;
+        }
+
+        if ((_item_spi(item) &&
+                (group->operation == item->operation) &&
+                (group->options == item->options)) ||
+            ((item->operation >= HAT_POLL_MCC152_DIO_IN) &&
+                (group->operation >= HAT_POLL_MCC152_DIO_IN)))
+        {
+            if (_item_spi(item))
+            {
+                group->channel_mask |= (1 << item->channel);
+            }
+            group->items[group->item_count++] = index;
+            return;
+        }
+    }
+
+    // MCC 134 items are read one at a time
+    group = &poll->groups[poll->group_count++];
+    group->address = item->address;
+    group->operation = item->operation;
+    group->options = item->options;
+    group->channel_mask = _item_spi(item) ? (1 << item->channel) : 0;
+    group->item_count = 1;
+    group->items[0] = index;
+}
+
+/******************************************************************************
+  Read one group and store its values.
+ *****************************************************************************/
+static int _poll_group(const struct HatPoll* poll,
+    const struct PollGroup* group, double* values)
+{
+    const struct HatPollItem* item;
+    double data[8];
+    uint8_t port;
+    uint16_t count;
+    int result;
+
+    port = 0;
+    switch (group->operation)
+    {
+    case HAT_POLL_MCC118_A_IN:
+        result = mcc118_a_in_read_multi(group->address, group->channel_mask,
+            group->options, data);
+        break;
+    case HAT_POLL_MCC128_A_IN:
+        result = mcc128_a_in_read_multi(group->address, group->channel_mask,
+            group->options, data);
+        break;
+    case HAT_POLL_MCC134_T_IN:
+        result = mcc134_t_in_read(group->address,
+            poll->items[group->items[0]].channel, &data[0]);
+        break;
+    case HAT_POLL_MCC134_A_IN:
+        result = mcc134_a_in_read(group->address,
+            poll->items[group->items[0]].channel, group->options, &data[0]);
+        break;
+    default:
+        result = mcc152_dio_input_read_port(group->address, &port);
+        break;
+    }
+
+    for (count = 0; count < group->item_count; count++)
+    {
+        item = &poll->items[group->items[count]];
+        if (result != RESULT_SUCCESS)
+        {
+            values[group->items[count]] = NAN;
+            continue;
+        }
+
+        switch (item->operation)
+        {
+        case HAT_POLL_MCC118_A_IN:
+        case HAT_POLL_MCC128_A_IN:
+            // the multi reads return the channels in ascending order
+            values[group->items[count]] = data[__builtin_popcount(
+                group->channel_mask & ((1 << item->channel) - 1))];
+            break;
+        case HAT_POLL_MCC152_DIO_IN:
+            values[group->items[count]] = (double)((port >> item->channel) &
+                0x01);
+            break;
+        case HAT_POLL_MCC152_DIO_PORT:
+            values[group->items[count]] = (double)port;
+            break;
+        default:
+            values[group->items[count]] = data[0];
+            break;
+        }
+    }
+
+    return result;
+}
+
+/******************************************************************************
+  Perform the reads of one tick.  Returns the first failure.
+ *****************************************************************************/
+static int _poll_tick(const struct HatPoll* poll, double* values)
+{
+    uint16_t count;
+    int result;
+    int ret;
+    bool batch;
+
+    result = RESULT_SUCCESS;
+
+    // the SPI boards are read under one lock; if it can't be obtained the
+    // reads will report the lock timeout themselves
+    batch = ((poll->spi_group_count > 0) &&
+        (hat_batch_begin() == RESULT_SUCCESS));
+
+    for (count = 0; count < poll->group_count; count++)
+    {
+        if (batch && (count == poll->spi_group_count))
+        {
+            hat_batch_end();
+            batch = false;
+        }
+
+        ret = _poll_group(poll, &poll->groups[count], values);
+        if ((ret != RESULT_SUCCESS) && (result == RESULT_SUCCESS))
+        {
+            result = ret;
+        }
+    }
+
+    if (batch)
+    {
+        hat_batch_end();
+    }
+
+    return result;
+}
+
+/******************************************************************************
+  Update a statistic maximum.  Only the poll thread writes the statistics.
+ *****************************************************************************/
+static inline void _update_max(uint64_t* max, uint64_t value)
+{
+    if (value > __atomic_load_n(max, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(max, value, __ATOMIC_RELAXED);
+    }
+}
+
+/******************************************************************************
+  Poll thread.  Each tick is started on an absolute deadline so the period
+  does not drift with the time taken by the reads.
+ *****************************************************************************/
+static void* _poll_thread(void* arg)
+{
+    struct HatPoll* poll = (struct HatPoll*)arg;
+    struct HatPollTick* tick;
+    struct sched_param param;
+    struct timespec wake;
+    double* values;
+    uint64_t first_ns;
+    uint64_t deadline_ns;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t wake_ns;
+    uint64_t skipped;
+    uint32_t read_index;
+    uint32_t slot;
+    bool full;
+    int result;
+
+    // run at a real-time priority when the process is allowed to; otherwise
+    // keep the normal priority
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + POLL_PRIORITY;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    first_ns = _now_ns();
+    deadline_ns = first_ns;
+
+    while (1)
+    {
+        // sleep until the deadline, waking periodically to check for a stop
+        // request when the period is long
+        while (1)
+        {
+            start_ns = _now_ns();
+            if ((start_ns >= deadline_ns) ||
+                __atomic_load_n(&poll->stop_thread, __ATOMIC_ACQUIRE))
+            {
+                break;
+            }
+
+            wake_ns = MIN(deadline_ns, start_ns + POLL_STOP_CHECK_NS);
+            wake.tv_sec = wake_ns / NSEC_PER_SEC;
+            wake.tv_nsec = wake_ns % NSEC_PER_SEC;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+        }
+
+        if (__atomic_load_n(&poll->stop_thread, __ATOMIC_ACQUIRE))
+        {
+            break;
+        }
+
+        // read into the next buffer slot, or discard the tick if the reader
+        // has fallen behind
+        read_index = __atomic_load_n(&poll->read_index, __ATOMIC_ACQUIRE);
+        full = ((poll->write_index - read_index) >= poll->buffer_size);
+        slot = poll->write_index & (poll->buffer_size - 1);
+        values = full ? poll->scratch :
+            &poll->values[(size_t)slot * poll->item_count];
+
+        result = _poll_tick(poll, values);
+        end_ns = _now_ns();
+
+        if (full)
+        {
+            __atomic_add_fetch(&poll->overruns, 1, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            tick = &poll->ticks[slot];
+            tick->index = (deadline_ns - first_ns) / poll->period_ns;
+            tick->deadline = deadline_ns;
+            tick->timestamp = start_ns;
+            tick->duration = (uint32_t)MIN(end_ns - start_ns, UINT32_MAX);
+            tick->result = result;
+            __atomic_store_n(&poll->write_index, poll->write_index + 1,
+                __ATOMIC_RELEASE);
+            eventfd_write(poll->event_fd, 1);
+        }
+
+        __atomic_add_fetch(&poll->tick_count, 1, __ATOMIC_RELAXED);
+        if (result != RESULT_SUCCESS)
+        {
+            __atomic_add_fetch(&poll->errors, 1, __ATOMIC_RELAXED);
+        }
+        if ((start_ns - deadline_ns) > (poll->period_ns / 2))
+        {
+            __atomic_add_fetch(&poll->late_ticks, 1, __ATOMIC_RELAXED);
+        }
+        _update_max(&poll->latency_max_ns, start_ns - deadline_ns);
+        _update_max(&poll->duration_max_ns, end_ns - start_ns);
+
+        // Schedule the next tick.  A tick that ends less than a period after
+        // the next deadline is followed immediately by a late tick; beyond
+        // that the deadlines that have passed are skipped.
+        deadline_ns += poll->period_ns;
+        if (end_ns > (deadline_ns + poll->period_ns))
+        {
+            skipped = (end_ns - deadline_ns) / poll->period_ns;
+            deadline_ns += skipped * poll->period_ns;
+            __atomic_add_fetch(&poll->missed_deadlines, skipped,
+                __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+  Free a poll instance.
+ *****************************************************************************/
+static void _poll_free(struct HatPoll* poll)
+{
+    if (poll->event_fd != -1)
+    {
+        close(poll->event_fd);
+    }
+    free(poll->ticks);
+    free(poll->values);
+    free(poll->scratch);
+    free(poll);
+}
+
+/******************************************************************************
+  Start a software-timed poll.
+ *****************************************************************************/
+int hat_poll_start(const struct HatPollItem* items, uint16_t item_count,
+    double period, uint32_t buffer_size, struct HatPoll** poll)
+{
+    struct HatPoll* p;
+    uint32_t size;
+    uint16_t index;
+
+    if ((items == NULL) ||
+        (item_count == 0) ||
+        (item_count > HAT_POLL_MAX_ITEMS) ||
+        !(period > 0.0) ||
+        (period > POLL_MAX_PERIOD) ||
+        (buffer_size > (1U << 31)) ||
+        (poll == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    for (index = 0; index < item_count; index++)
+    {
+        if (!_item_valid(&items[index]))
+        {
+            return RESULT_BAD_PARAMETER;
+        }
+    }
+
+    if ((p = (struct HatPoll*)calloc(1, sizeof(*p))) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    p->event_fd = -1;
+    memcpy(p->items, items, item_count * sizeof(struct HatPollItem));
+    p->item_count = item_count;
+    p->period_ns = (uint64_t)llround(period * NSEC_PER_SEC);
+    if (p->period_ns == 0)
+    {
+        p->period_ns = 1;
+    }
+
+    // group the SPI items first, then the others
+    for (index = 0; index < item_count; index++)
+    {
+        if (_item_spi(&items[index]))
+        {
+            _group_item(p, index);
+        }
+    }
+    p->spi_group_count = p->group_count;
+    for (index = 0; index < item_count; index++)
+    {
+        if (!_item_spi(&items[index]))
+        {
+            _group_item(p, index);
+        }
+    }
+
+    // the buffer size is a power of 2 so the indexes can be masked
+    if (buffer_size == 0)
+    {
+        buffer_size = (uint32_t)MIN(ceil(1.0 / period), (double)(1U << 20));
+    }
+    size = POLL_MIN_BUFFER_SIZE;
+    while (size < buffer_size)
+    {
+        size <<= 1;
+    }
+    p->buffer_size = size;
+
+    p->ticks = (struct HatPollTick*)calloc(size, sizeof(struct HatPollTick));
+    p->values = (double*)calloc((size_t)size * item_count, sizeof(double));
+    p->scratch = (double*)calloc(item_count, sizeof(double));
+    p->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((p->ticks == NULL) ||
+        (p->values == NULL) ||
+        (p->scratch == NULL) ||
+        (p->event_fd == -1))
+    {
+        _poll_free(p);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if (pthread_create(&p->thread, NULL, _poll_thread, p) != 0)
+    {
+        _poll_free(p);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    *poll = p;
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Read tick records and values from a poll.
+ *****************************************************************************/
+int hat_poll_read(struct HatPoll* instance, uint32_t max_ticks, double timeout,
+    struct HatPollTick* ticks, double* values, uint32_t* ticks_read)
+{
+    struct pollfd poll_data;
+    struct timespec start;
+    struct timespec now;
+    eventfd_t value;
+    uint32_t write_index;
+    uint32_t read_index;
+    uint32_t slot;
+    uint32_t count;
+    uint32_t index;
+    int timeout_ms;
+    int wait_ms;
+
+    if ((instance == NULL) ||
+        (max_ticks == 0) ||
+        (ticks_read == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+    *ticks_read = 0;
+
+    timeout_ms = (timeout < 0.0) ? -1 : (int)(timeout * 1000.0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    read_index = instance->read_index;
+    while (1)
+    {
+        write_index = __atomic_load_n(&instance->write_index, __ATOMIC_ACQUIRE);
+        if (write_index != read_index)
+        {
+            break;
+        }
+
+        // wait for the poll thread to signal a new tick
+        if (timeout_ms < 0)
+        {
+            wait_ms = -1;
+        }
+        else
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            wait_ms = timeout_ms - (int)_difftime_ms(&start, &now);
+            if (wait_ms <= 0)
+            {
+                return RESULT_TIMEOUT;
+            }
+        }
+        poll_data.fd = instance->event_fd;
+        poll_data.events = POLLIN;
+        poll_data.revents = 0;
+        if ((poll(&poll_data, 1, wait_ms) == -1) && (errno != EINTR))
+        {
+            return RESULT_UNDEFINED;
+        }
+        eventfd_read(instance->event_fd, &value);
+    }
+
+    count = MIN(write_index - read_index, max_ticks);
+    for (index = 0; index < count; index++)
+    {
+        slot = (read_index + index) & (instance->buffer_size - 1);
+        if (ticks)
+        {
+            ticks[index] = instance->ticks[slot];
+        }
+        if (values)
+        {
+            memcpy(&values[(size_t)index * instance->item_count],
+                &instance->values[(size_t)slot * instance->item_count],
+                instance->item_count * sizeof(double));
+        }
+    }
+    __atomic_store_n(&instance->read_index, read_index + count, __ATOMIC_RELEASE);
+
+    *ticks_read = count;
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Read the poll statistics.
+ *****************************************************************************/
+int hat_poll_status(struct HatPoll* poll, struct HatPollStatus* status)
+{
+    if ((poll == NULL) ||
+        (status == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    status->ticks = __atomic_load_n(&poll->tick_count, __ATOMIC_RELAXED);
+    status->late_ticks = __atomic_load_n(&poll->late_ticks, __ATOMIC_RELAXED);
+    status->missed_deadlines = __atomic_load_n(&poll->missed_deadlines,
+        __ATOMIC_RELAXED);
+    status->overruns = __atomic_load_n(&poll->overruns, __ATOMIC_RELAXED);
+    status->errors = __atomic_load_n(&poll->errors, __ATOMIC_RELAXED);
+    status->queued = __atomic_load_n(&poll->write_index, __ATOMIC_ACQUIRE) -
+        __atomic_load_n(&poll->read_index, __ATOMIC_ACQUIRE);
+    status->buffer_size = poll->buffer_size;
+    status->latency_max = __atomic_load_n(&poll->latency_max_ns,
+        __ATOMIC_RELAXED) / 1000.0;
+    status->duration_max = __atomic_load_n(&poll->duration_max_ns,
+        __ATOMIC_RELAXED) / 1000.0;
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Stop a poll and free its resources.
+ *****************************************************************************/
+int hat_poll_stop(struct HatPoll* poll)
+{
+    if (poll == NULL)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    __atomic_store_n(&poll->stop_thread, true, __ATOMIC_RELEASE);
+    pthread_join(poll->thread, NULL);
+
+    _poll_free(poll);
+    return RESULT_SUCCESS;
+}
@@ -0,0 +1,1103 @@
+/*
+*   file hat_stream.c
+*   author Measurement Computing Corp.
+*   brief This file contains the scan streaming server and client functions.
+*
+*   date 17 Oct 2026
+*/
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "daqhats.h"
+#include "hat_stream.h"
+#include "util.h"
+
+#define MIN(a, b)   ((a < b) ? a : b)
+
+// Server loop period when no scan data or requests arrive
+#define STREAM_POLL_MS          10
+// Maximum blocks taken from one board per pass
+#define STREAM_MAX_BATCH        32
+#define STREAM_MAX_BLOCKS       (MAX_NUMBER_HATS * STREAM_MAX_BATCH)
+// Consecutive blocks delivered before a decimated subscriber's factor is
+// halved
+#define STREAM_KEEP_BLOCKS      64
+
+// Library functions with the same signature on all scanning boards
+struct StreamScanFunctions
+{
+    int (*a_in_scan_status)(uint8_t, uint16_t*, uint32_t*);
+    int (*a_in_scan_peek)(uint8_t, const double**, uint32_t*);
+    int (*a_in_scan_consume)(uint8_t, uint32_t);
+    int (*a_in_scan_channel_count)(uint8_t);
+    int (*a_in_scan_event_enable)(uint8_t, uint32_t, int*);
+};
+
+static const struct StreamScanFunctions _scan_functions[] =
+{
+    {
+        mcc118_a_in_scan_status, mcc118_a_in_scan_peek,
+        mcc118_a_in_scan_consume, mcc118_a_in_scan_channel_count,
+        mcc118_a_in_scan_event_enable
+    },
+    {
+        mcc128_a_in_scan_status, mcc128_a_in_scan_peek,
+        mcc128_a_in_scan_consume, mcc128_a_in_scan_channel_count,
+        mcc128_a_in_scan_event_enable
+    },
+    {
+        mcc172_a_in_scan_status, mcc172_a_in_scan_peek,
+        mcc172_a_in_scan_consume, mcc172_a_in_scan_channel_count,
+        mcc172_a_in_scan_event_enable
+    }
+};
+
+#define NUM_SCAN_FUNCTIONS  \
+    (sizeof(_scan_functions) / sizeof(_scan_functions[0]))
+
+// A scan the server is attached to
+struct StreamBoard
+{
+    const struct StreamScanFunctions* functions;    // NULL if not attached
+    int event_fd;
+    uint8_t channel_count;
+    bool finished;              // the end of the scan has been published
+    uint64_t sequence;          // samples per channel published
+    uint32_t collected;         // samples per channel taken in this pass
+};
+
+// A block of scan data taken in this pass.  samples_per_channel is 0 for the
+// block that reports the end of a scan.
+struct StreamBlock
+{
+    uint8_t address;
+    uint8_t channel_count;
+    uint16_t status;
+    uint32_t samples_per_channel;
+    uint64_t sequence;
+    const double* data;
+};
+
+struct StreamSubscriber
+{
+    int fd;                     // -1 once disconnected
+    bool subscribed;
+    uint8_t address_mask;
+    uint8_t policy;
+    uint32_t credits;
+    uint32_t decimation;
+    uint32_t kept;              // consecutive blocks delivered
+    uint32_t missed;            // consecutive blocks missed
+    uint32_t phase[MAX_NUMBER_HATS];
+    uint32_t dropped[MAX_NUMBER_HATS];
+
+    // a partially received request
+    struct HatStreamRequest request;
+    size_t request_size;
+
+    // the unsent remainder of a partial sendmsg()
+    uint8_t* pending;
+    size_t pending_size;
+    size_t pending_offset;
+};
+
+struct HatStreamServer
+{
+    struct sockaddr_un addr;
+    int listen_fd;
+    uint8_t address_mask;
+    uint32_t samples_per_block;
+    uint32_t options;
+    pthread_t thread;
+    volatile bool stop_thread;
+
+    // held by the server thread while it uses the boards, and by
+    // hat_stream_server_attach() and hat_stream_server_detach()
+    pthread_mutex_t mutex;
+    uint32_t generation;        // incremented when a board is detached
+
+    struct StreamBoard boards[MAX_NUMBER_HATS];
+    struct StreamSubscriber subscribers[HAT_STREAM_MAX_SUBSCRIBERS];
+    int subscriber_count;
+
+    struct StreamBlock blocks[STREAM_MAX_BLOCKS];
+    int block_count;
+    double* copy_buffer;        // HAT_STREAM_OPTS_COPY
+    size_t copy_size;
+
+    // per-subscriber scratch for one sendmsg()
+    struct HatStreamFrame frames[STREAM_MAX_BLOCKS];
+    struct iovec iov[2 * STREAM_MAX_BLOCKS];
+};
+
+/******************************************************************************
+  Detach from a board.  Called with the server mutex held.
+ *****************************************************************************/
+static void _detach_board(struct HatStreamServer* server, uint8_t address)
+{
+    struct StreamBoard* board = &server->boards[address];
+
+    board->functions = NULL;
+    board->event_fd = -1;
+    board->channel_count = 0;
+    board->finished = false;
+    server->generation++;
+}
+
+/******************************************************************************
+  Add a block to the list for this pass.
+ *****************************************************************************/
+static void _add_block(struct HatStreamServer* server, uint8_t address,
+    uint16_t status, const double* data, uint32_t samples_per_channel)
+{
+    struct StreamBoard* board = &server->boards[address];
+    struct StreamBlock* block = &server->blocks[server->block_count++];
+
+    block->address = address;
+    block->channel_count = board->channel_count;
+    block->status = status;
+    block->samples_per_channel = samples_per_channel;
+    block->sequence = board->sequence;
+    block->data = data;
+
+    board->sequence += samples_per_channel;
+    board->collected += samples_per_channel;
+}
+
+/******************************************************************************
+  Take the whole blocks available in each scan buffer.  A short block is
+  taken where the data wraps in the scan buffer (peek stops there) and when
+  the scan has ended.  The data stays in the scan buffer until
+  _consume_blocks().
+ *****************************************************************************/
+static void _collect_blocks(struct HatStreamServer* server)
+{
+    const struct StreamScanFunctions* fn;
+    struct StreamBoard* board;
+    const double* data;
+    uint32_t available;
+    uint32_t contiguous;
+    uint32_t batch;
+    uint16_t status;
+    uint8_t address;
+
+    server->block_count = 0;
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        board = &server->boards[address];
+        board->collected = 0;
+        if (((fn = board->functions) == NULL) ||
+            board->finished ||
+            (board->channel_count == 0))
+        {
+            continue;
+        }
+
+        // read the status first so the data is complete if it has stopped
+        if ((fn->a_in_scan_status(address, &status, &available) !=
+                RESULT_SUCCESS) ||
+            (fn->a_in_scan_peek(address, &data, &contiguous) !=
+                RESULT_SUCCESS))
+        {
+            continue;
+        }
+
+        batch = 0;
+        while ((contiguous >= server->samples_per_block) &&
+            (batch < STREAM_MAX_BATCH))
+        {
+            _add_block(server, address, status, data,
+                server->samples_per_block);
+            data += server->samples_per_block * board->channel_count;
+            contiguous -= server->samples_per_block;
+            available -= MIN(available, server->samples_per_block);
+            batch++;
+        }
+
+        if (batch < STREAM_MAX_BATCH)
+        {
+            if ((contiguous > 0) &&
+                ((contiguous < available) || !(status & STATUS_RUNNING)))
+            {
+                _add_block(server, address, status, data, contiguous);
+                available -= MIN(available, contiguous);
+                contiguous = 0;
+                batch++;
+            }
+            if ((batch < STREAM_MAX_BATCH) &&
+                !(status & STATUS_RUNNING) &&
+                (available == 0))
+            {
+                // tell the subscribers that the scan has ended
+                _add_block(server, address, status, NULL, 0);
+                board->finished = true;
+            }
+        }
+    }
+}
+
+/******************************************************************************
+  Release the data taken in this pass from the scan buffers.
+ *****************************************************************************/
+static void _consume_blocks(struct HatStreamServer* server)
+{
+    struct StreamBoard* board;
+    uint8_t address;
+
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        board = &server->boards[address];
+        if (board->collected > 0)
+        {
+            board->functions->a_in_scan_consume(address, board->collected);
+            board->collected = 0;
+        }
+        if (board->finished)
+        {
+            // the end has been published; a new scan is attached again
+            _detach_board(server, address);
+        }
+    }
+}
+
+/******************************************************************************
+  Copy the blocks taken in this pass to the server's buffer and release them
+  from the scan buffers before they are sent (HAT_STREAM_OPTS_COPY.)
+ *****************************************************************************/
+static void _copy_blocks(struct HatStreamServer* server)
+{
+    struct StreamBlock* block;
+    size_t total;
+    size_t count;
+    double* ptr;
+    int index;
+
+    total = 0;
+    for (index = 0; index < server->block_count; index++)
+    {
+        block = &server->blocks[index];
+        total += (size_t)block->samples_per_channel * block->channel_count;
+    }
+    if (total > server->copy_size)
+    {
+        ptr = (double*)realloc(server->copy_buffer, total * sizeof(double));
+        if (ptr == NULL)
+        {
+            // send from the scan buffer instead
+            return;
+        }
+        server->copy_buffer = ptr;
+        server->copy_size = total;
+    }
+
+    ptr = server->copy_buffer;
+    for (index = 0; index < server->block_count; index++)
+    {
+        block = &server->blocks[index];
+        count = (size_t)block->samples_per_channel * block->channel_count;
+        if (count > 0)
+        {
+            memcpy(ptr, block->data, count * sizeof(double));
+            block->data = ptr;
+            ptr += count;
+        }
+    }
+
+    _consume_blocks(server);
+}
+
+/******************************************************************************
+  Close a subscriber.  It is removed from the list at the end of the pass.
+ *****************************************************************************/
+static void _close_subscriber(struct StreamSubscriber* sub)
+{
+    if (sub->fd != -1)
+    {
+        close(sub->fd);
+        sub->fd = -1;
+    }
+    free(sub->pending);
+    sub->pending = NULL;
+}
+
+/******************************************************************************
+  Handle a complete request from a subscriber.
+ *****************************************************************************/
+static void _handle_request(struct StreamSubscriber* sub)
+{
+    const struct HatStreamRequest* request = &sub->request;
+
+    if (request->magic != HAT_STREAM_MAGIC)
+    {
+        _close_subscriber(sub);
+        return;
+    }
+
+    switch (request->command)
+    {
+    case HAT_STREAM_CMD_SUBSCRIBE:
+        sub->subscribed = true;
+        sub->address_mask = request->address_mask;
+        sub->policy = request->policy;
+        sub->credits = request->credits;
+        break;
+    case HAT_STREAM_CMD_CREDIT:
+        if (request->credits > (UINT32_MAX - sub->credits))
+        {
+            sub->credits = UINT32_MAX;
+        }
+        else
+        {
+            sub->credits += request->credits;
+        }
+        break;
+    default:
+        _close_subscriber(sub);
+        break;
+    }
+}
+
+/******************************************************************************
+  Receive the requests waiting on a subscriber's socket.
+ *****************************************************************************/
+static void _receive_requests(struct StreamSubscriber* sub)
+{
+    ssize_t size;
+
+    while (sub->fd != -1)
+    {
+        size = recv(sub->fd, (uint8_t*)&sub->request + sub->request_size,
+            sizeof(sub->request) - sub->request_size, MSG_DONTWAIT);
+        if (size > 0)
+        {
+            sub->request_size += size;
+            if (sub->request_size == sizeof(sub->request))
+            {
+                _handle_request(sub);
+                sub->request_size = 0;
+            }
+        }
+        else if ((size < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+        {
+            break;
+        }
+        else
+        {
+            // disconnected
+            _close_subscriber(sub);
+        }
+    }
+}
+
+/******************************************************************************
+  Send the remainder of a partial sendmsg().
+ *****************************************************************************/
+static void _flush_pending(struct StreamSubscriber* sub)
+{
+    ssize_t size;
+
+    if ((sub->fd == -1) || (sub->pending == NULL))
+    {
+        return;
+    }
+
+    size = send(sub->fd, sub->pending + sub->pending_offset,
+        sub->pending_size - sub->pending_offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (size > 0)
+    {
+        sub->pending_offset += size;
+        if (sub->pending_offset == sub->pending_size)
+        {
+            free(sub->pending);
+            sub->pending = NULL;
+        }
+    }
+    else if ((size < 0) && (errno != EAGAIN) && (errno != EINTR))
+    {
+        _close_subscriber(sub);
+    }
+}
+
+/******************************************************************************
+  Keep the part of the iovec array past offset bytes for a later send.
+ *****************************************************************************/
+static bool _save_pending(struct StreamSubscriber* sub,
+    const struct iovec* iov, int iov_count, size_t offset, size_t total)
+{
+    size_t length;
+    int index;
+
+    if ((sub->pending = (uint8_t*)malloc(total - offset)) == NULL)
+    {
+        return false;
+    }
+    sub->pending_size = total - offset;
+    sub->pending_offset = 0;
+
+    length = 0;
+    for (index = 0; index < iov_count; index++)
+    {
+        if (offset >= iov[index].iov_len)
+        {
+            offset -= iov[index].iov_len;
+            continue;
+        }
+        memcpy(sub->pending + length, (uint8_t*)iov[index].iov_base + offset,
+            iov[index].iov_len - offset);
+        length += iov[index].iov_len - offset;
+        offset = 0;
+    }
+    return true;
+}
+
+/******************************************************************************
+  Record a block a subscriber could not take and apply its policy.
+ *****************************************************************************/
+static void _miss_block(struct StreamSubscriber* sub, uint8_t address,
+    bool* decimated)
+{
+    sub->dropped[address]++;
+    sub->kept = 0;
+
+    if (sub->policy == HAT_STREAM_POLICY_DECIMATE)
+    {
+        // back off once per pass
+        if (!*decimated && (sub->decimation < HAT_STREAM_MAX_DECIMATION))
+        {
+            sub->decimation *= 2;
+        }
+        *decimated = true;
+    }
+    else if (++sub->missed >= HAT_STREAM_MAX_MISSED)
+    {
+        _close_subscriber(sub);
+    }
+}
+
+/******************************************************************************
+  Send this pass's blocks to a subscriber with a single sendmsg().  The
+  block data is referenced in place, not copied.
+ *****************************************************************************/
+static void _deliver_blocks(struct HatStreamServer* server,
+    struct StreamSubscriber* sub)
+{
+    const struct StreamBlock* block;
+    struct HatStreamFrame* frame;
+    struct msghdr msg;
+    uint8_t address;
+    size_t total;
+    ssize_t size;
+    size_t ends;
+    bool decimated;
+    int iov_count;
+    int frame_count;
+    int index;
+
+    if (!sub->subscribed)
+    {
+        return;
+    }
+
+    decimated = false;
+    iov_count = 0;
+    frame_count = 0;
+    total = 0;
+    for (index = 0; (index < server->block_count) && (sub->fd != -1);
+        index++)
+    {
+        block = &server->blocks[index];
+        address = block->address;
+        if (!(sub->address_mask & (1 << address)))
+        {
+            continue;
+        }
+
+        // the end of a scan is always reported and needs no credit
+        if (block->samples_per_channel > 0)
+        {
+            if ((++sub->phase[address] % sub->decimation) != 0)
+            {
+                sub->dropped[address]++;
+                continue;
+            }
+            if ((sub->credits == 0) || (sub->pending != NULL))
+            {
+                _miss_block(sub, address, &decimated);
+                continue;
+            }
+            sub->credits--;
+            sub->missed = 0;
+            if ((++sub->kept >= STREAM_KEEP_BLOCKS) && (sub->decimation > 1))
+            {
+                sub->decimation /= 2;
+                sub->kept = 0;
+            }
+        }
+        else if (sub->pending != NULL)
+        {
+            continue;
+        }
+
+        frame = &server->frames[frame_count++];
+        frame->magic = HAT_STREAM_MAGIC;
+        frame->address = address;
+        frame->channel_count = block->channel_count;
+        frame->status = block->status;
+        frame->samples_per_channel = block->samples_per_channel;
+        frame->dropped = sub->dropped[address];
+        frame->decimation = sub->decimation;
+        frame->reserved = 0;
+        frame->sequence = block->sequence;
+        sub->dropped[address] = 0;
+
+        server->iov[iov_count].iov_base = frame;
+        server->iov[iov_count].iov_len = sizeof(*frame);
+        total += server->iov[iov_count++].iov_len;
+        if (block->samples_per_channel > 0)
+        {
+            server->iov[iov_count].iov_base = (void*)block->data;
+            server->iov[iov_count].iov_len = (size_t)block->samples_per_channel *
+                block->channel_count * sizeof(double);
+            total += server->iov[iov_count++].iov_len;
+        }
+    }
+
+    if ((iov_count == 0) || (sub->fd == -1))
+    {
+        return;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = server->iov;
+    msg.msg_iovlen = iov_count;
+    size = sendmsg(sub->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (size < 0)
+    {
+        if ((errno != EAGAIN) && (errno != EINTR))
+        {
+            _close_subscriber(sub);
+            return;
+        }
+        // the socket is full; none of the blocks were sent
+        ends = 0;
+        for (index = 0; index < frame_count; index++)
+        {
+            frame = &server->frames[index];
+            sub->dropped[frame->address] += frame->dropped;
+            if (frame->samples_per_channel > 0)
+            {
+                sub->credits++;
+                _miss_block(sub, frame->address, &decimated);
+            }
+            else
+            {
+                // keep the end of scan reports
+                server->frames[ends++] = *frame;
+            }
+        }
+        if ((ends > 0) && (sub->fd != -1))
+        {
+            server->iov[0].iov_base = server->frames;
+            server->iov[0].iov_len = ends * sizeof(*frame);
+            _save_pending(sub, server->iov, 1, 0, server->iov[0].iov_len);
+        }
+    }
+    else if ((size_t)size < total)
+    {
+        // the data must be copied since it is released from the scan buffer
+        if (!_save_pending(sub, server->iov, iov_count, size, total))
+        {
+            _close_subscriber(sub);
+        }
+    }
+}
+
+/******************************************************************************
+  Remove closed subscribers from the list.
+ *****************************************************************************/
+static void _remove_subscribers(struct HatStreamServer* server)
+{
+    int index;
+
+    for (index = server->subscriber_count - 1; index >= 0; index--)
+    {
+        if (server->subscribers[index].fd == -1)
+        {
+            server->subscribers[index] =
+                server->subscribers[--server->subscriber_count];
+        }
+    }
+}
+
+/******************************************************************************
+  Accept a new subscriber.
+ *****************************************************************************/
+static void _accept_subscriber(struct HatStreamServer* server)
+{
+    struct StreamSubscriber* sub;
+    int fd;
+
+    fd = accept4(server->listen_fd, NULL, NULL,
+        SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1)
+    {
+        return;
+    }
+    if (server->subscriber_count >= HAT_STREAM_MAX_SUBSCRIBERS)
+    {
+        close(fd);
+        return;
+    }
+
+    sub = &server->subscribers[server->subscriber_count++];
+    memset(sub, 0, sizeof(*sub));
+    sub->fd = fd;
+    sub->decimation = 1;
+}
+
+/******************************************************************************
+  The server thread.
+ *****************************************************************************/
+static void* _stream_thread(void* arg)
+{
+    struct HatStreamServer* server = (struct HatStreamServer*)arg;
+    struct pollfd fds[1 + HAT_STREAM_MAX_SUBSCRIBERS + MAX_NUMBER_HATS];
+    struct StreamSubscriber* sub;
+    uint64_t counter;
+    uint32_t generation;
+    uint8_t address;
+    int count;
+    int index;
+
+    while (!server->stop_thread)
+    {
+        fds[0].fd = server->listen_fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        for (index = 0; index < server->subscriber_count; index++)
+        {
+            sub = &server->subscribers[index];
+            fds[index + 1].fd = sub->fd;
+            fds[index + 1].events = POLLIN |
+                ((sub->pending != NULL) ? POLLOUT : 0);
+            fds[index + 1].revents = 0;
+        }
+        count = server->subscriber_count + 1;
+        pthread_mutex_lock(&server->mutex);
+        for (address = 0; address < MAX_NUMBER_HATS; address++)
+        {
+            // the event of a finished scan stays set, so it is not waited on
+            if ((server->boards[address].functions != NULL) &&
+                !server->boards[address].finished &&
+                (server->boards[address].event_fd != -1))
+            {
+                fds[count].fd = server->boards[address].event_fd;
+                fds[count].events = POLLIN;
+                fds[count].revents = 0;
+                count++;
+            }
+        }
+        generation = server->generation;
+        pthread_mutex_unlock(&server->mutex);
+
+        if (poll(fds, count, STREAM_POLL_MS) < 0)
+        {
+            continue;
+        }
+
+        for (index = 0; index < server->subscriber_count; index++)
+        {
+            sub = &server->subscribers[index];
+            if (fds[index + 1].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                _receive_requests(sub);
+            }
+            if (fds[index + 1].revents & POLLOUT)
+            {
+                _flush_pending(sub);
+            }
+        }
+
+        pthread_mutex_lock(&server->mutex);
+
+        // reset the scan events, unless a board was detached while waiting
+        // and its descriptor may have been closed
+        if (generation == server->generation)
+        {
+            for (index = server->subscriber_count + 1; index < count; index++)
+            {
+                if (fds[index].revents & POLLIN)
+                {
+                    if (read(fds[index].fd, &counter, sizeof(counter)) < 0)
+                    {
+                        // nothing to reset
+                    }
+                }
+            }
+        }
+
+        _collect_blocks(server);
+        if (server->options & HAT_STREAM_OPTS_COPY)
+        {
+            _copy_blocks(server);
+        }
+        for (index = 0; index < server->subscriber_count; index++)
+        {
+            _deliver_blocks(server, &server->subscribers[index]);
+        }
+        _consume_blocks(server);
+        pthread_mutex_unlock(&server->mutex);
+
+        _remove_subscribers(server);
+        if (fds[0].revents & POLLIN)
+        {
+            _accept_subscriber(server);
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+  Start a streaming server.
+ *****************************************************************************/
+int hat_stream_server_start(const char* path, uint8_t address_mask,
+    uint32_t samples_per_block, uint32_t options,
+    struct HatStreamServer** server)
+{
+    struct HatStreamServer* srv;
+    uint8_t address;
+
+    if ((path == NULL) ||
+        (strlen(path) >= sizeof(srv->addr.sun_path)) ||
+        (address_mask == 0) ||
+        (samples_per_block == 0) ||
+        (server == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if ((srv = (struct HatStreamServer*)calloc(1, sizeof(*srv))) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    srv->address_mask = address_mask;
+    srv->samples_per_block = samples_per_block;
+    srv->options = options;
+    pthread_mutex_init(&srv->mutex, NULL);
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        srv->boards[address].event_fd = -1;
+    }
+
+    srv->addr.sun_family = AF_UNIX;
+    strcpy(srv->addr.sun_path, path);
+
+    srv->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK |
+        SOCK_CLOEXEC, 0);
+    if (srv->listen_fd == -1)
+    {
+        pthread_mutex_destroy(&srv->mutex);
+        free(srv);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    unlink(path);
+    if ((bind(srv->listen_fd, (struct sockaddr*)&srv->addr,
+            sizeof(srv->addr)) != 0) ||
+        (listen(srv->listen_fd, 8) != 0))
+    {
+        close(srv->listen_fd);
+        pthread_mutex_destroy(&srv->mutex);
+        free(srv);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if (pthread_create(&srv->thread, NULL, _stream_thread, srv) != 0)
+    {
+        close(srv->listen_fd);
+        unlink(path);
+        pthread_mutex_destroy(&srv->mutex);
+        free(srv);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    *server = srv;
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Stop a streaming server.
+ *****************************************************************************/
+int hat_stream_server_stop(struct HatStreamServer* server)
+{
+    int index;
+
+    if (server == NULL)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    server->stop_thread = true;
+    pthread_join(server->thread, NULL);
+
+    for (index = 0; index < server->subscriber_count; index++)
+    {
+        _close_subscriber(&server->subscribers[index]);
+    }
+    close(server->listen_fd);
+    unlink(server->addr.sun_path);
+    free(server->copy_buffer);
+    pthread_mutex_destroy(&server->mutex);
+    free(server);
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Attach a server to a scan that has been started.
+ *****************************************************************************/
+int hat_stream_server_attach(struct HatStreamServer* server, uint8_t address)
+{
+    struct StreamBoard* board;
+    const double* data;
+    uint32_t contiguous;
+    size_t index;
+    int result;
+    int fd;
+
+    if ((server == NULL) ||
+        (address >= MAX_NUMBER_HATS) ||
+        !(server->address_mask & (1 << address)))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    pthread_mutex_lock(&server->mutex);
+    board = &server->boards[address];
+    if (board->functions != NULL)
+    {
+        _detach_board(server, address);
+    }
+
+    // the scan must be one that can be peeked, not a flight recorder scan
+    result = RESULT_RESOURCE_UNAVAIL;
+    for (index = 0; index < NUM_SCAN_FUNCTIONS; index++)
+    {
+        result = _scan_functions[index].a_in_scan_peek(address, &data,
+            &contiguous);
+        if (result == RESULT_SUCCESS)
+        {
+            result = _scan_functions[index].a_in_scan_event_enable(address,
+                server->samples_per_block, &fd);
+        }
+        if (result == RESULT_SUCCESS)
+        {
+            board->functions = &_scan_functions[index];
+            board->event_fd = fd;
+            board->channel_count =
+                board->functions->a_in_scan_channel_count(address);
+            board->finished = false;
+            board->sequence = 0;
+            break;
+        }
+        if (result != RESULT_BAD_PARAMETER)
+        {
+            // the board type matched but there is no scan to attach to
+            break;
+        }
+    }
+    pthread_mutex_unlock(&server->mutex);
+
+    return result;
+}
+
+/******************************************************************************
+  Detach a server from a scan.
+ *****************************************************************************/
+int hat_stream_server_detach(struct HatStreamServer* server, uint8_t address)
+{
+    if ((server == NULL) ||
+        (address >= MAX_NUMBER_HATS))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    // waits for the server to finish with the scan buffer
+    pthread_mutex_lock(&server->mutex);
+    if (server->boards[address].functions != NULL)
+    {
+        _detach_board(server, address);
+    }
+    pthread_mutex_unlock(&server->mutex);
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Send a request to a streaming server.
+ *****************************************************************************/
+static int _stream_request(int fd, uint8_t command, uint8_t address_mask,
+    uint8_t policy, uint32_t credits)
+{
+    struct HatStreamRequest request;
+
+    memset(&request, 0, sizeof(request));
+    request.magic = HAT_STREAM_MAGIC;
+    request.command = command;
+    request.address_mask = address_mask;
+    request.policy = policy;
+    request.credits = credits;
+
+    if (send(fd, &request, sizeof(request), MSG_NOSIGNAL) !=
+        (ssize_t)sizeof(request))
+    {
+        return RESULT_COMMS_FAILURE;
+    }
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Receive exactly count bytes.
+ *****************************************************************************/
+static bool _stream_recv(int fd, void* buffer, size_t count)
+{
+    ssize_t size;
+
+    while (count > 0)
+    {
+        size = recv(fd, buffer, count, MSG_WAITALL);
+        if (size > 0)
+        {
+            buffer = (uint8_t*)buffer + size;
+            count -= size;
+        }
+        else if ((size == 0) || (errno != EINTR))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/******************************************************************************
+  Connect to a streaming server.
+ *****************************************************************************/
+int hat_stream_connect(const char* path, uint8_t address_mask, uint8_t policy,
+    uint32_t credits, int* fd)
+{
+    struct sockaddr_un addr;
+    int sock;
+
+    if ((path == NULL) ||
+        (strlen(path) >= sizeof(addr.sun_path)) ||
+        (policy > HAT_STREAM_POLICY_DECIMATE) ||
+        (fd == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if ((connect(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+        (_stream_request(sock, HAT_STREAM_CMD_SUBSCRIBE, address_mask, policy,
+            credits) != RESULT_SUCCESS))
+    {
+        close(sock);
+        return RESULT_COMMS_FAILURE;
+    }
+
+    *fd = sock;
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Grant credits to a streaming server.
+ *****************************************************************************/
+int hat_stream_credit(int fd, uint32_t credits)
+{
+    return _stream_request(fd, HAT_STREAM_CMD_CREDIT, 0, 0, credits);
+}
+
+/******************************************************************************
+  Receive one block from a streaming server.
+ *****************************************************************************/
+int hat_stream_read(int fd, struct HatStreamFrame* frame, double* buffer,
+    uint32_t buffer_size_samples, double timeout)
+{
+    struct pollfd pfd;
+    double discard[256];
+    size_t count;
+    size_t length;
+    int ret;
+
+    if (frame == NULL)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    do
+    {
+        ret = poll(&pfd, 1, (timeout < 0.0) ? -1 : (int)(timeout * 1000));
+    } while ((ret < 0) && (errno == EINTR));
+    if (ret == 0)
+    {
+        return RESULT_TIMEOUT;
+    }
+
+    if ((ret < 0) ||
+        !_stream_recv(fd, frame, sizeof(*frame)) ||
+        (frame->magic != HAT_STREAM_MAGIC))
+    {
+        return RESULT_COMMS_FAILURE;
+    }
+
+    count = (size_t)frame->samples_per_channel * frame->channel_count;
+    if ((buffer != NULL) && (count <= buffer_size_samples))
+    {
+        if (!_stream_recv(fd, buffer, count * sizeof(double)))
+        {
+            return RESULT_COMMS_FAILURE;
+        }
+        return RESULT_SUCCESS;
+    }
+
+    // skip the data to stay in step with the stream
+    while (count > 0)
+    {
+        length = MIN(count, sizeof(discard) / sizeof(discard[0]));
+        if (!_stream_recv(fd, discard, length * sizeof(double)))
+        {
+            return RESULT_COMMS_FAILURE;
+        }
+        count -= length;
+    }
+    return RESULT_BAD_PARAMETER;
+}
+
+/******************************************************************************
+  Disconnect from a streaming server.
+ *****************************************************************************/
+void hat_stream_disconnect(int fd)
+{
+    if (fd != -1)
+    {
+        close(fd);
+    }
+}
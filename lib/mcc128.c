@@ -16,6 +16,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <sys/eventfd.h>
 #include <linux/spi/spidev.h>
 #include "daqhats.h"
 #include "util.h"
@@ -155,6 +156,10 @@ struct MCC128DeviceInfo mcc128_device_info =
 #define MAX_SAMPLES_READ        ((MAX_SPI_TRANSFER - MSG_RX_HEADER_SIZE)/ \
                                 SAMPLE_SIZE_BYTES)
 
+// mcc128_a_in_read_multi() reads this many channels or more with a one sample
+// internal scan (4 commands) instead of one AIn command per channel.
+#define BURST_MIN_CHANNELS      5
+
 // MCC 128 command response codes
 #define FW_RES_SUCCESS          0x00
 #define FW_RES_BAD_PROTOCOL     0x01
@@ -191,32 +196,54 @@ struct mcc128FactoryData
     double offsets[NUM_RANGES];
 };
 
+// Converts a block of raw scan data to double precision.
+typedef void (*mcc128IngestKernel)(const uint16_t* raw, double* buffer,
+    uint32_t count, const double* gains, const double* biases);
+
 // Local data for analog input scans
 struct mcc128ScanThreadInfo
 {
+    // Set at scan start, read-only while the scan runs
     pthread_t handle;
     double* scan_buffer;
     uint32_t buffer_size;
-    volatile uint32_t write_index;
-    volatile uint32_t read_index;
-    volatile uint32_t samples_transferred;
-    volatile uint32_t buffer_depth;
-
     uint16_t read_threshold;
     uint16_t options;
+    uint8_t channel_count;
+    uint8_t modes[NUM_CHANNELS];
+    uint8_t ranges[NUM_CHANNELS];
+    double slopes[NUM_RANGES];
+    double offsets[NUM_RANGES];
+    mcc128IngestKernel ingest;
+    double gains[NUM_CHANNELS];
+    double biases[NUM_CHANNELS];
+    uint16_t* raw_buffer;
+
+    // Written by the scan thread (raw_depth is also reduced by the conversion
+    // thread)
+    CACHE_ALIGNED volatile uint32_t write_index;
+    volatile uint32_t samples_transferred;
+    volatile uint32_t raw_depth;
+    uint64_t samples_discarded;     // overwritten by OPTS_OVERWRITE
     volatile bool hw_overrun;
     volatile bool buffer_overrun;
     volatile bool thread_started;
     volatile bool thread_running;
-    bool stop_thread;
     bool triggered;
     volatile bool scan_running;
-    uint8_t channel_count;
+    bool convert_stop;
+    pthread_cond_t convert_cond;
+
+    // Written by the conversion thread (buffer_depth is also reduced by reads)
+    CACHE_ALIGNED uint32_t convert_index;
+    volatile uint32_t buffer_depth;
     uint8_t channel_index;
-    uint8_t modes[NUM_CHANNELS];
-    uint8_t ranges[NUM_CHANNELS];
-    double slopes[NUM_RANGES];
-    double offsets[NUM_RANGES];
+
+    // Written by the reading thread
+    CACHE_ALIGNED volatile uint32_t read_index;
+    bool stop_thread;
+    int event_fd;
+    uint32_t event_threshold;
 };
 
 // Local data for each open MCC 128 board.
@@ -245,6 +272,7 @@ struct mcc128Device
 
 static struct mcc128Device* _devices[MAX_NUMBER_HATS];
 static bool _mcc128_lib_initialized = false;
+static pthread_once_t _mcc128_lib_once = PTHREAD_ONCE_INIT;
 
 static const char* const spi_device = SPI_DEVICE_0; // the spidev device
 static const uint8_t spi_mode = SPI_MODE_1;         // use mode 1 (CPOL=0,
@@ -277,88 +305,37 @@ static bool _check_addr(uint8_t address)
 }
 
 /******************************************************************************
-  Parse a buffer and look for a valid message
+  Locate a reply frame for command in a buffer.  The frame normally starts at
+  the first byte, so the header is checked in place; memchr() is only used to
+  resynchronize when it does not.
  *****************************************************************************/
-static bool _parse_buffer(uint8_t* buffer, uint16_t length,
-    uint16_t* frame_start, uint16_t* frame_length, uint16_t* remaining)
+static bool _parse_buffer(const uint8_t* buffer, uint16_t length,
+    uint8_t command, uint16_t* frame_start, uint16_t* frame_length)
 {
-    uint8_t* ptr = buffer;
-    uint16_t index;
-    bool found_frame;
-    int parse_state = 0;
+    const uint8_t* ptr = buffer;
+    const uint8_t* end = buffer + length;
     uint16_t data_count;
-    uint16_t data_index;
-    uint16_t _remaining;
-    uint16_t _frame_length;
-    uint16_t _frame_start;
 
-    found_frame = false;
-    _remaining = 0;
-    _frame_length = 0;
-    _frame_start = 0;
-    data_index = 0;
-    data_count = 0;
-
-    for (index = 0; (index < length) && !found_frame; index++)
+    while ((ptr != NULL) && ((end - ptr) >= MSG_RX_HEADER_SIZE))
     {
-        switch (parse_state)
+        if ((ptr[MSG_RX_INDEX_START] == MSG_START) &&
+            (ptr[MSG_RX_INDEX_COMMAND] == command))
         {
-        case 0: // looking for start
-            if (MSG_START == ptr[index])
+            data_count = ptr[MSG_RX_INDEX_COUNT_LOW] |
+                ((uint16_t)ptr[MSG_RX_INDEX_COUNT_HIGH] << 8);
+            if ((end - ptr) < (MSG_RX_HEADER_SIZE + data_count))
             {
-                _frame_start = index;
-                data_count = 0;
-                data_index = 0;
-                parse_state++;
+                // incomplete
+                return false;
             }
-            break;
-        case 1: // command
-            parse_state++;
-            break;
-        case 2: // status
-            parse_state++;
-            break;
-        case 3: // count low
-            data_count = ptr[index];
-            parse_state++;
-            break;
-        case 4: // count high
-            data_count |= (uint16_t)ptr[index] << 8;
-            if (data_count == 0)
-            {
-                _remaining = 0;
-                found_frame = true;
-                _frame_length = MSG_RX_HEADER_SIZE;
-                parse_state = 6;
-            }
-            else
-            {
-                _remaining = data_count;// + 1;
-                parse_state++;
-            }
-            break;
-        case 5: // data
-            _remaining--;
-            if (++data_index >= data_count)
-            {
-                parse_state++;
-                found_frame = true;
-                _frame_length = data_count + MSG_RX_HEADER_SIZE;
-            }
-            break;
-        case 6: // message is complete
-            break;
-        default:
-            parse_state = 0;
-            break;
+            *frame_start = (uint16_t)(ptr - buffer);
+            *frame_length = MSG_RX_HEADER_SIZE + data_count;
+            return true;
         }
+        ptr = memchr(ptr + 1, MSG_START, end - ptr - 1);
     }
 
-    *remaining = _remaining;
-    *frame_length = _frame_length;
-    *frame_start = _frame_start;
-
-    return found_frame;
+    return false;
 }
 
 /******************************************************************************
@@ -386,7 +363,53 @@ static int _create_frame(uint8_t* buffer, uint8_t command, uint16_t count,
 }
 
 /******************************************************************************
-  Perform command / response SPI transfers to an MCC 128.
+  Obtain the SPI lock and select an MCC 128 for one or more _spi_command()
+  calls.  The caller releases the lock with _release_lock().
+ *****************************************************************************/
+static int _spi_begin(uint8_t address, int* lock_fd)
+{
+    struct mcc128Device* dev;
+    uint8_t temp;
+    int ret;
+
+    if (!_check_addr(address))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+    dev = _devices[address];
+
+    // Obtain a spi lock
+    if ((*lock_fd = _obtain_lock()) < 0)
+    {
+        // could not get a lock within 5 seconds, report as a timeout
+        return RESULT_LOCK_TIMEOUT;
+    }
+
+    _set_address(address);
+
+    // check spi mode and change if necessary
+    ret = ioctl(dev->spi_fd, SPI_IOC_RD_MODE, &temp);
+    if (ret == -1)
+    {
+        _release_lock(*lock_fd);
+        return RESULT_UNDEFINED;
+    }
+    if (temp != spi_mode)
+    {
+        ret = ioctl(dev->spi_fd, SPI_IOC_WR_MODE, &spi_mode);
+        if (ret == -1)
+        {
+            _release_lock(*lock_fd);
+            return RESULT_UNDEFINED;
+        }
+    }
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Perform one command / response exchange with an MCC 128.  The caller holds
+  the SPI lock and has selected the board with _spi_begin().
 
   address: board address
   command: firmware API command code
@@ -399,7 +422,7 @@ static int _create_frame(uint8_t* buffer, uint8_t command, uint16_t count,
 
   Return: RESULT_SUCCESS if successful
  *****************************************************************************/
-static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
+static int _spi_command(uint8_t address, uint8_t command, void* tx_data,
     uint16_t tx_data_count, void* rx_data, uint16_t rx_data_count,
     uint32_t reply_timeout_us, uint32_t retry_us)
 {
@@ -407,9 +430,7 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
     struct timespec current_time;
     uint32_t diff;
     bool got_reply = false;
-    int lock_fd;
     int ret;
-    uint8_t temp;
     bool timeout = false;
 
     uint16_t tx_count;
@@ -425,32 +446,6 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
         return RESULT_BAD_PARAMETER;
     }
 
-    // Obtain a spi lock
-    if ((lock_fd = _obtain_lock()) < 0)
-    {
-        // could not get a lock within 5 seconds, report as a timeout
-        return RESULT_LOCK_TIMEOUT;
-    }
-
-    _set_address(address);
-
-    // check spi mode and change if necessary
-    ret = ioctl(dev->spi_fd, SPI_IOC_RD_MODE, &temp);
-    if (ret == -1)
-    {
-        _release_lock(lock_fd);
-        return RESULT_UNDEFINED;
-    }
-    if (temp != spi_mode)
-    {
-        ret = ioctl(dev->spi_fd, SPI_IOC_WR_MODE, &spi_mode);
-        if (ret == -1)
-        {
-            _release_lock(lock_fd);
-            return RESULT_UNDEFINED;
-        }
-    }
-
     tx_count = _create_frame(dev->tx_buffer, command, tx_data_count, tx_data);
 
     // Init the spi ioctl structure, using temp_buffer for the intermediate
@@ -466,7 +461,6 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
     // send the command
     if ((ret = ioctl(dev->spi_fd, SPI_IOC_MESSAGE(1), &tr)) < 1)
     {
-        _release_lock(lock_fd);
         return RESULT_UNDEFINED;
     }
 
@@ -478,8 +472,9 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
     // read the reply
     uint16_t frame_start = 0;
     uint16_t frame_length;
-    uint16_t remaining = 0;
     uint16_t read_amount = rx_data_count + MSG_RX_HEADER_SIZE;
+    struct spi_ioc_transfer segments[3];
+    bool in_place = false;
 
     // only read the first byte of the reply in order to test for the device
     // readiness
@@ -514,14 +509,68 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
 
     if (got_reply)
     {
-        // read the rest of the reply
-        tr.tx_buf = (uintptr_t)NULL;//dev->temp_buffer;
+        // Read the rest of the reply in one transaction.  The frame starts
+        // at the byte that signaled the reply was ready, so the rest of the
+        // header goes to rx_buffer and the payload straight to rx_data; the
+        // trailing byte lands where it would in a contiguous read.
+        memset(segments, 0, sizeof(segments));
+        segments[0] = tr;
+        segments[0].rx_buf = (uintptr_t)&dev->rx_buffer[1];
+        segments[0].len = MSG_RX_HEADER_SIZE - 1;
+        segments[1] = tr;
+        segments[1].rx_buf =
+            (uintptr_t)&dev->rx_buffer[MSG_RX_HEADER_SIZE + rx_data_count];
+        segments[1].len = 1;
+        if (rx_data_count > 0)
+        {
+            segments[2] = segments[1];
+            segments[1].rx_buf = (uintptr_t)rx_data;
+            segments[1].len = rx_data_count;
+            ret = ioctl(dev->spi_fd, SPI_IOC_MESSAGE(3), segments);
+        }
+        else
+        {
+            ret = ioctl(dev->spi_fd, SPI_IOC_MESSAGE(2), segments);
+        }
 
-        int read_start = 1;
-        int total_read = 1;
+        int read_start = read_amount + 1;
+        int total_read = read_amount + 1;
 
         got_reply = false;
-        do
+        if (ret >= 1)
+        {
+            if ((dev->rx_buffer[MSG_RX_INDEX_START] == MSG_START) &&
+                (dev->rx_buffer[MSG_RX_INDEX_COMMAND] == command) &&
+                (dev->rx_buffer[MSG_RX_INDEX_COUNT_LOW] ==
+                    (uint8_t)rx_data_count) &&
+                (dev->rx_buffer[MSG_RX_INDEX_COUNT_HIGH] ==
+                    (uint8_t)(rx_data_count >> 8)))
+            {
+                // the payload is already in place
+                got_reply = true;
+                in_place = true;
+            }
+            else
+            {
+                // resynchronize on the contiguous reply
+                if (rx_data_count > 0)
+                {
+                    memcpy(&dev->rx_buffer[MSG_RX_INDEX_DATA], rx_data,
+                        rx_data_count);
+                }
+                got_reply = _parse_buffer(dev->rx_buffer, total_read, command,
+                    &frame_start, &frame_length);
+            }
+        }
+        else
+        {
+            read_start = 1;
+            total_read = 1;
+        }
+
+        tr.tx_buf = (uintptr_t)NULL;
+        while (!got_reply && !timeout &&
+               ((read_start + read_amount) < MAX_SPI_TRANSFER))
         {
             tr.rx_buf = (uintptr_t)&dev->rx_buffer[read_start];
             tr.len = read_amount;
@@ -532,8 +581,8 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
                 read_start += read_amount;
 
                 // parse the reply
-                got_reply = _parse_buffer(dev->rx_buffer, total_read,
-                    &frame_start, &frame_length, &remaining);
+                got_reply = _parse_buffer(dev->rx_buffer, total_read, command,
+                    &frame_start, &frame_length);
             }
             else
             {
@@ -543,14 +592,11 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
             clock_gettime(CLOCK_MONOTONIC, &current_time);
             diff = _difftime_us(&start_time, &current_time);
             timeout = (diff > reply_timeout_us);
-        } while (!got_reply && !timeout &&
-                 ((read_start + read_amount) < MAX_SPI_TRANSFER));
+        }
     }
 
     if (!got_reply)
     {
-        // clear the SPI lock
-        _release_lock(lock_fd);
         return RESULT_TIMEOUT;
     }
 
@@ -560,7 +606,7 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
         switch (dev->rx_buffer[frame_start+MSG_RX_INDEX_STATUS])
         {
         case FW_RES_SUCCESS:
-            if (rx_data_count > 0)
+            if ((rx_data_count > 0) && !in_place)
             {
                 memcpy(rx_data, &dev->rx_buffer[frame_start+MSG_RX_INDEX_DATA],
                     rx_data_count);
@@ -590,7 +636,38 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
         ret = RESULT_BAD_PARAMETER;
     }
 
-    // clear the SPI lock
+    return ret;
+}
+
+/******************************************************************************
+  Perform command / response SPI transfers to an MCC 128.
+
+  address: board address
+  command: firmware API command code
+  tx_data: optional transmit data buffer
+  tx_data_count: count of transmit data bytes
+  rx_data: optional receive data buffer
+  rx_data_count: count of receive data bytes
+  reply_timeout_us: Time to wait for a reply in microseconds
+  retry_us: delay between read retries in microseconds
+
+  Return: RESULT_SUCCESS if successful
+ *****************************************************************************/
+static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
+    uint16_t tx_data_count, void* rx_data, uint16_t rx_data_count,
+    uint32_t reply_timeout_us, uint32_t retry_us)
+{
+    int lock_fd;
+    int ret;
+
+    if ((ret = _spi_begin(address, &lock_fd)) != RESULT_SUCCESS)
+    {
+        return ret;
+    }
+
+    ret = _spi_command(address, command, tx_data, tx_data_count, rx_data,
+        rx_data_count, reply_timeout_us, retry_us);
+
     _release_lock(lock_fd);
     return ret;
 }
@@ -769,94 +846,299 @@ static int _parse_factory_data(cJSON* root, struct mcc128FactoryData* data)
 /******************************************************************************
   Perform any library initialization.
  *****************************************************************************/
-static void _mcc128_lib_init(void)
+static void _mcc128_lib_init_once(void)
 {
     int i;
 
-    if (!_mcc128_lib_initialized)
+    for (i = 0; i < MAX_NUMBER_HATS; i++)
+    {
+        _devices[i] = NULL;
+    }
+
+    _mcc128_lib_initialized = true;
+}
+
+/******************************************************************************
+  Perform the library initialization once, even when boards are opened from
+  several threads at the same time.
+ *****************************************************************************/
+static void _mcc128_lib_init(void)
+{
+    pthread_once(&_mcc128_lib_once, &_mcc128_lib_init_once);
+}
+
+/******************************************************************************
+  Scan data ingest kernels.  The calibration and scaling selected by the scan
+  options and the range of each queue element are folded into one gain and
+  bias per channel when the scan starts, and a kernel is chosen for the
+  channel count so the per-sample work is a single multiply-add with no option
+  tests or channel index bookkeeping.  The kernels convert whole scans (count
+  is a multiple of the channel count.)  The ADC codes are inverted, so the
+  kernels convert (MAX_CODE - raw).
+ *****************************************************************************/
+static inline void _ingest_scans(const uint16_t* raw, double* buffer,
+    uint32_t count, uint8_t channel_count, const double* gains,
+    const double* biases)
+{
+    uint32_t index;
+    uint8_t channel;
+
+    // channel_count is a constant in each caller so this loop is unrolled
+    for (index = 0; index < count; index += channel_count)
     {
-        for (i = 0; i < MAX_NUMBER_HATS; i++)
+        for (channel = 0; channel < channel_count; channel++)
         {
-            _devices[i] = NULL;
+            buffer[index + channel] =
+                ((double)(MAX_CODE - raw[index + channel]) * gains[channel]) +
+                biases[channel];
         }
+    }
+}
+
+#define INGEST_KERNEL(n) \
+static void _ingest_##n(const uint16_t* raw, double* buffer, uint32_t count, \
+    const double* gains, const double* biases) \
+{ \
+    _ingest_scans(raw, buffer, count, n, gains, biases); \
+}
 
-        _mcc128_lib_initialized = true;
+INGEST_KERNEL(1)
+INGEST_KERNEL(2)
+INGEST_KERNEL(3)
+INGEST_KERNEL(4)
+INGEST_KERNEL(5)
+INGEST_KERNEL(6)
+INGEST_KERNEL(7)
+INGEST_KERNEL(8)
+
+// Kernel for OPTS_NOSCALEDATA | OPTS_NOCALIBRATEDATA, independent of the
+// channel count.
+static void _ingest_raw(const uint16_t* raw, double* buffer, uint32_t count,
+    const double* gains, const double* biases)
+{
+    uint32_t index;
+
+    (void)gains;
+    (void)biases;
+    for (index = 0; index < count; index++)
+    {
+        buffer[index] = (double)(MAX_CODE - raw[index]);
     }
 }
 
+static const mcc128IngestKernel _ingest_kernels[NUM_CHANNELS] =
+{
+    _ingest_1, _ingest_2, _ingest_3, _ingest_4,
+    _ingest_5, _ingest_6, _ingest_7, _ingest_8
+};
+
 /******************************************************************************
-  Read the specified number of samples of scan data as double precision.
+  Compute the per-channel gains and biases for the scan options and select the
+  ingest kernel.  Called at scan start after the queue and coefficients are
+  saved.
  *****************************************************************************/
-static int _a_in_read_scan_data(uint8_t address, uint16_t sample_count,
-    bool scaled, bool calibrated, double* buffer)
+static void _select_ingest_kernel(struct mcc128ScanThreadInfo* info)
 {
-    uint16_t count;
-    int ret;
-    struct mcc128Device* dev;
-    struct mcc128ScanThreadInfo* info;
-    uint16_t* rx_data;
+    uint8_t index;
     uint8_t range;
+    bool calibrated = (info->options & OPTS_NOCALIBRATEDATA) == 0;
+    bool scaled = (info->options & OPTS_NOSCALEDATA) == 0;
+
+    for (index = 0; index < info->channel_count; index++)
+    {
+        range = info->ranges[index];
+        info->gains[index] = 1.0;
+        info->biases[index] = 0.0;
+
+        if (calibrated)
+        {
+            info->gains[index] = info->slopes[range];
+            info->biases[index] = info->offsets[range];
+        }
+
+        if (scaled)
+        {
+            info->gains[index] *= LSB_SIZES[range];
+            info->biases[index] = (info->biases[index] * LSB_SIZES[range]) -
+                RANGE_OFFSETS[range];
+        }
+    }
+
+    if (!calibrated && !scaled)
+    {
+        info->ingest = _ingest_raw;
+    }
+    else
+    {
+        info->ingest = _ingest_kernels[info->channel_count - 1];
+    }
+}
 
+/******************************************************************************
+  Read the specified number of samples of raw scan data.
+ *****************************************************************************/
+static int _a_in_read_scan_data(uint8_t address, uint16_t sample_count,
+    uint16_t* raw)
+{
     if (!_check_addr(address) ||
-        (buffer == NULL))
+        (raw == NULL))
     {
         return RESULT_BAD_PARAMETER;
     }
 
-    dev = _devices[address];
-    info = dev->scan_info;
-    if (info == NULL)
+    // send the read scan data command
+    return _spi_transfer(address, CMD_AINSCANDATA, &sample_count, 2, raw,
+        sample_count*SAMPLE_SIZE_BYTES, 40*MSEC, 1);
+}
+
+/******************************************************************************
+  Convert raw scan data to double precision.
+ *****************************************************************************/
+static void _convert_scan_data(struct mcc128ScanThreadInfo* info,
+    const uint16_t* raw, uint32_t sample_count, double* buffer)
+{
+    uint32_t count;
+    uint32_t scan_count;
+
+    // finish a scan that was split by the previous read
+    count = 0;
+    while ((info->channel_index != 0) && (count < sample_count))
     {
-        return RESULT_UNDEFINED;
+        buffer[count] = ((double)(MAX_CODE - raw[count]) *
+            info->gains[info->channel_index]) +
+            info->biases[info->channel_index];
+        count++;
+        info->channel_index++;
+        if (info->channel_index >= info->channel_count)
+        {
+            info->channel_index = 0;
+        }
     }
 
+    // convert the complete scans
+    scan_count = ((sample_count - count) / info->channel_count) *
+        info->channel_count;
+    info->ingest(&raw[count], &buffer[count], scan_count, info->gains,
+        info->biases);
+    count += scan_count;
 
-    rx_data = (uint16_t*)calloc(1, sample_count * SAMPLE_SIZE_BYTES);
-    if (rx_data == NULL)
+    // start of a scan that will be completed by the next read
+    for (; count < sample_count; count++)
     {
-        return RESULT_RESOURCE_UNAVAIL;
+        buffer[count] = ((double)(MAX_CODE - raw[count]) *
+            info->gains[info->channel_index]) +
+            info->biases[info->channel_index];
+        info->channel_index++;
     }
+}
 
-    // send the read scan data command
-    ret = _spi_transfer(address, CMD_AINSCANDATA, &sample_count, 2, rx_data,
-        sample_count*SAMPLE_SIZE_BYTES, 40*MSEC, 1);
+/******************************************************************************
+  Make room for new data in a flight recorder scan (OPTS_OVERWRITE) by
+  discarding the oldest whole scans.  Returns false if the data can't fit,
+  which is a buffer overrun.  Must be called with scan_mutex held.
+ *****************************************************************************/
+static bool _discard_oldest(struct mcc128ScanThreadInfo* info)
+{
+    uint32_t count;
 
-    if (ret != RESULT_SUCCESS)
+    if ((info->options & OPTS_OVERWRITE) == 0)
     {
-        free(rx_data);
-        return ret;
+        return false;
     }
 
-    range = info->ranges[info->channel_index];
+    // keep the oldest data at the start of a scan
+    count = info->raw_depth + info->buffer_depth - info->buffer_size;
+    count = ((count + info->channel_count - 1) / info->channel_count) *
+        info->channel_count;
+    if (count > info->buffer_depth)
+    {
+        return false;
+    }
+
+    info->read_index += count;
+    if (info->read_index >= info->buffer_size)
+    {
+        info->read_index -= info->buffer_size;
+    }
+    info->buffer_depth -= count;
+    info->samples_discarded += count;
+    return true;
+}
 
-    for (count = 0; count < sample_count; count++)
+/******************************************************************************
+  Signal the scan event descriptor if enough data is available or the scan
+  thread has finished.  Must be called with scan_mutex held.
+ *****************************************************************************/
+static void _signal_scan_event(struct mcc128ScanThreadInfo* info)
+{
+    if ((info->event_fd != -1) &&
+        (!info->thread_running ||
+         (info->buffer_depth >= info->event_threshold)))
     {
-        // convert raw values to double
-        buffer[count] = (double)(MAX_CODE - rx_data[count]);
+        eventfd_write(info->event_fd, 1);
+    }
+}
 
-        if (calibrated)
+/******************************************************************************
+  Convert the raw samples waiting in the raw ring and make them available to
+  readers.  Must be called with scan_mutex held; the mutex is released while
+  converting.
+ *****************************************************************************/
+static void _convert_pending(uint8_t address,
+    struct mcc128ScanThreadInfo* info)
+{
+    uint32_t index;
+    uint32_t count;
+
+    while (info->raw_depth > 0)
+    {
+        // convert up to the end of the ring
+        index = info->convert_index;
+        count = info->raw_depth;
+        if ((info->buffer_size - index) < count)
         {
-            // apply the correct cal factor to each sample in the list
-            buffer[count] *= info->slopes[range];
-            buffer[count] += info->offsets[range];
+            count = info->buffer_size - index;
         }
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
 
-        // convert to volts if desired
-        if (scaled)
+        _convert_scan_data(info, &info->raw_buffer[index], count,
+            &info->scan_buffer[index]);
+
+        pthread_mutex_lock(&_devices[address]->scan_mutex);
+        info->convert_index += count;
+        if (info->convert_index >= info->buffer_size)
         {
-            buffer[count] *= LSB_SIZES[range];
-            buffer[count] -= RANGE_OFFSETS[range];
+            info->convert_index = 0;
         }
+        info->raw_depth -= count;
+        info->buffer_depth += count;
+        _signal_scan_event(info);
+    }
+}
 
-        info->channel_index++;
-        if (info->channel_index >= info->channel_count)
+/******************************************************************************
+  Converts the raw samples read by the scan thread so the time spent on
+  conversion does not delay servicing the device.
+ *****************************************************************************/
+static void* _convert_thread(void* arg)
+{
+    uint8_t address = *(uint8_t*)arg;
+    struct mcc128ScanThreadInfo* info = _devices[address]->scan_info;
+
+    free(arg);
+
+    pthread_mutex_lock(&_devices[address]->scan_mutex);
+    while (true)
+    {
+        _convert_pending(address, info);
+        if (info->convert_stop)
         {
-            info->channel_index = 0;
+            break;
         }
+        pthread_cond_wait(&info->convert_cond, &_devices[address]->scan_mutex);
     }
-
-    free(rx_data);
-    return RESULT_SUCCESS;
+    pthread_mutex_unlock(&_devices[address]->scan_mutex);
+    return NULL;
 }
 
 /******************************************************************************
@@ -873,11 +1155,12 @@ static void* _scan_thread(void* arg)
     uint32_t status_count;
     uint8_t address = *(uint8_t*)arg;
     struct mcc128ScanThreadInfo* info = _devices[address]->scan_info;
-    bool calibrated;
-    bool scaled;
     bool stop_thread;
     uint8_t rx_buffer[7];
     bool scan_running;
+    pthread_t converter;
+    bool converter_started;
+    uint8_t* converter_arg;
 
     free(arg);
 
@@ -895,22 +1178,22 @@ static void* _scan_thread(void* arg)
 
     status_count = 0;
 
-    if (info->options & OPTS_NOSCALEDATA)
-    {
-        scaled = false;
-    }
-    else
-    {
-        scaled = true;
-    }
-
-    if (info->options & OPTS_NOCALIBRATEDATA)
-    {
-        calibrated = false;
-    }
-    else
+    // start the conversion thread
+    pthread_cond_init(&info->convert_cond, NULL);
+    converter_started = false;
+    converter_arg = (uint8_t*)malloc(sizeof(uint8_t));
+    if (converter_arg != NULL)
     {
-        calibrated = true;
+        *converter_arg = address;
+        if (pthread_create(&converter, NULL, _convert_thread,
+            converter_arg) == 0)
+        {
+            converter_started = true;
+        }
+        else
+        {
+            free(converter_arg);
+        }
     }
 
 #define MIN_SLEEP_US	100
@@ -981,8 +1264,7 @@ static void* _scan_thread(void* arg)
                     }
 
                     if ((error = _a_in_read_scan_data(address, read_count,
-                        scaled, calibrated,
-                        &info->scan_buffer[info->write_index])) ==
+                        &info->raw_buffer[info->write_index])) ==
                         RESULT_SUCCESS)
                     {
                         info->write_index += read_count;
@@ -991,19 +1273,27 @@ static void* _scan_thread(void* arg)
                             info->write_index = 0;
                         }
 
+                        // pass the data to the conversion thread, or convert
+                        // it here if that thread could not be started
                         pthread_mutex_lock(&_devices[address]->scan_mutex);
-                        info->buffer_depth += read_count;
-                        pthread_mutex_unlock(&_devices[address]->scan_mutex);
-
-                        if (info->buffer_depth > info->buffer_size)
+                        info->raw_depth += read_count;
+                        if (((info->raw_depth + info->buffer_depth) >
+                            info->buffer_size) && !_discard_oldest(info))
                         {
-                            pthread_mutex_lock(&_devices[address]->scan_mutex);
                             info->buffer_overrun = true;
                             info->scan_running = false;
-                            pthread_mutex_unlock(
-                                &_devices[address]->scan_mutex);
                             done = true;
                         }
+                        if (converter_started)
+                        {
+                            pthread_cond_signal(&info->convert_cond);
+                        }
+                        else
+                        {
+                            _convert_pending(address, info);
+                        }
+                        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+
                         info->samples_transferred += read_count;
                     }
 
@@ -1049,8 +1339,20 @@ static void* _scan_thread(void* arg)
         mcc128_a_in_scan_stop(address);
     }
 
+    // let the conversion thread finish the remaining data
+    if (converter_started)
+    {
+        pthread_mutex_lock(&_devices[address]->scan_mutex);
+        info->convert_stop = true;
+        pthread_cond_signal(&info->convert_cond);
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+        pthread_join(converter, NULL);
+    }
+    pthread_cond_destroy(&info->convert_cond);
+
     pthread_mutex_lock(&_devices[address]->scan_mutex);
     info->thread_running = false;
+    _signal_scan_event(info);
     pthread_mutex_unlock(&_devices[address]->scan_mutex);
     return NULL;
 }
@@ -1088,6 +1390,109 @@ static int _calc_scan_period(double sample_rate, uint16_t* period,
     return RESULT_SUCCESS;
 }
 
+/******************************************************************************
+  Read one sample of each channel in a queue with a single scan at the maximum
+  ADC rate, so the samples are taken 10 us apart.  The caller holds the SPI
+  lock and has selected the board with _spi_begin().  Returns RESULT_BUSY
+  without starting anything if the board has a scan running or unread scan
+  data, from this or another process.
+ *****************************************************************************/
+static int _a_in_read_burst(uint8_t address, uint8_t queue_count,
+    const uint8_t* queue, uint16_t* raw)
+{
+    struct timespec start_time;
+    struct timespec current_time;
+    uint8_t status[7];
+    uint8_t buffer[NUM_CHANNELS + 8];
+    uint16_t period;
+    uint8_t divider;
+    uint8_t index;
+    uint32_t available;
+    uint16_t sample_count;
+    int ret;
+
+    if (_devices[address]->scan_info != NULL)
+    {
+        return RESULT_BUSY;
+    }
+
+    ret = _spi_command(address, CMD_AINSCANSTATUS, NULL, 0, status, 7,
+        1*MSEC, 20);
+    if (ret != RESULT_SUCCESS)
+    {
+        return ret;
+    }
+    if ((status[0] & 0x01) ||
+        (status[1] != 0) ||
+        (status[2] != 0) ||
+        (status[3] != 0))
+    {
+        return RESULT_BUSY;
+    }
+
+    _calc_scan_period(MAX_ADC_RATE / queue_count, &period, &divider);
+    buffer[0] = 1;      // one sample per channel
+    buffer[1] = 0;
+    buffer[2] = 0;
+    buffer[3] = 0;
+    buffer[4] = (uint8_t)period;
+    buffer[5] = (uint8_t)(period >> 8);
+    buffer[6] = divider;
+    buffer[7] = queue_count - 1;
+    for (index = 0; index < queue_count; index++)
+    {
+        buffer[index + 8] = queue[index];
+    }
+
+    ret = _spi_command(address, CMD_AINSCANSTART, buffer, queue_count + 8,
+        NULL, 0, 20*MSEC, 10);
+    if (ret != RESULT_SUCCESS)
+    {
+        return ret;
+    }
+
+    // wait for the conversions
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    do
+    {
+        ret = _spi_command(address, CMD_AINSCANSTATUS, NULL, 0, status, 7,
+            1*MSEC, 20);
+        if (ret != RESULT_SUCCESS)
+        {
+            break;
+        }
+        available = ((uint32_t)status[3] << 16) +
+            ((uint32_t)status[2] << 8) + status[1];
+        if (available >= queue_count)
+        {
+            break;
+        }
+        if (!(status[0] & 0x01))
+        {
+            // the scan ended without the samples
+            ret = RESULT_UNDEFINED;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &current_time);
+        if (_difftime_us(&start_time, &current_time) > 20*MSEC)
+        {
+            ret = RESULT_TIMEOUT;
+            break;
+        }
+    } while (true);
+
+    if (ret != RESULT_SUCCESS)
+    {
+        // leave the board idle
+        _spi_command(address, CMD_AINSCANSTOP, NULL, 0, NULL, 0, 20*MSEC, 10);
+        return ret;
+    }
+
+    sample_count = queue_count;
+    return _spi_command(address, CMD_AINSCANDATA, &sample_count, 2, raw,
+        sample_count*SAMPLE_SIZE_BYTES, 40*MSEC, 1);
+}
+
 //*****************************************************************************
 // Global Functions
 
@@ -1149,25 +1554,37 @@ int mcc128_open(uint8_t address)
 
         if (custom_size > 0)
         {
-            // convert the JSON custom data to parameters
-            cJSON* root = cJSON_Parse(custom_data);
-            if (root == NULL)
-            {
-                // error parsing the JSON data
-                _set_defaults(&dev->factory_data);
-                printf("Warning - address %d using factory EEPROM default "
-                    "values\n", address);
-            }
-            else
+            // use the cached factory data if it matches the EEPROM,
+            // otherwise convert the JSON custom data to parameters
+            if (!_factory_cache_load(address, HAT_ID_MCC_128, custom_data,
+                custom_size, &dev->factory_data,
+                sizeof(dev->factory_data)))
             {
-                if (!_parse_factory_data(root, &dev->factory_data))
+                cJSON* root = cJSON_Parse(custom_data);
+                if (root == NULL)
                 {
-                    // invalid custom data, use default values
+                    // error parsing the JSON data
                     _set_defaults(&dev->factory_data);
                     printf("Warning - address %d using factory EEPROM default "
                         "values\n", address);
                 }
-                cJSON_Delete(root);
+                else
+                {
+                    if (!_parse_factory_data(root, &dev->factory_data))
+                    {
+                        // invalid custom data, use default values
+                        _set_defaults(&dev->factory_data);
+                        printf("Warning - address %d using factory EEPROM "
+                            "default values\n", address);
+                    }
+                    else
+                    {
+                        _factory_cache_store(address, HAT_ID_MCC_128,
+                            custom_data, custom_size, &dev->factory_data,
+                            sizeof(dev->factory_data));
+                    }
+                    cJSON_Delete(root);
+                }
             }
 
             free(custom_data);
@@ -1550,6 +1967,133 @@ int mcc128_a_in_read(uint8_t address, uint8_t channel, uint32_t options,
     return RESULT_SUCCESS;
 }
 
+/******************************************************************************
+  Perform a single reading of several analog input channels.
+ *****************************************************************************/
+int mcc128_a_in_read_multi(uint8_t address, uint8_t channel_mask,
+    uint32_t options, double* values)
+{
+    int ret;
+    int lock_fd;
+    uint8_t channel;
+    uint8_t num_channels;
+    uint8_t count;
+    uint8_t mode;
+    uint8_t range;
+    uint8_t fw_channel;
+    uint8_t queue[NUM_CHANNELS];
+    uint16_t codes[NUM_AI_CHANNELS_SE];
+    uint16_t raw[NUM_CHANNELS];
+    double val;
+
+    if (!_check_addr(address) ||
+        (channel_mask == 0) ||
+        (values == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    mode = _devices[address]->ain_mode;
+    range = _devices[address]->ain_range;
+    num_channels = (mode == A_IN_MODE_SE) ?
+        NUM_AI_CHANNELS_SE : NUM_AI_CHANNELS_DIFF;
+
+    if ((channel_mask >> num_channels) != 0)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    count = 0;
+    for (channel = 0; channel < num_channels; channel++)
+    {
+        if (channel_mask & (1 << channel))
+        {
+            queue[count++] = ((range & 0x03) << 4) |
+                             ((mode & 0x01) << 3) |
+                             (channel & 0x07);
+        }
+    }
+
+    // select the board once for all of the commands
+    ret = _spi_begin(address, &lock_fd);
+    if (ret != RESULT_SUCCESS)
+    {
+        return ret;
+    }
+
+    ret = RESULT_BUSY;
+    if (count >= BURST_MIN_CHANNELS)
+    {
+        ret = _a_in_read_burst(address, count, queue, raw);
+        if (ret == RESULT_SUCCESS)
+        {
+            // the scan data is in queue (ascending channel) order
+            count = 0;
+            for (channel = 0; channel < num_channels; channel++)
+            {
+                if (channel_mask & (1 << channel))
+                {
+                    codes[channel] = raw[count++];
+                }
+            }
+        }
+    }
+
+    if (ret == RESULT_BUSY)
+    {
+        // few channels, or a scan is using the board; send the AIn commands
+        // back to back
+        count = 0;
+        for (channel = 0; channel < num_channels; channel++)
+        {
+            if (channel_mask & (1 << channel))
+            {
+                fw_channel = queue[count++];
+                ret = _spi_command(address, CMD_AIN, &fw_channel, 1,
+                    &codes[channel], 2, 20*MSEC, 10);
+                if (ret != RESULT_SUCCESS)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    _release_lock(lock_fd);
+
+    if (ret != RESULT_SUCCESS)
+    {
+        return ret;
+    }
+
+    count = 0;
+    for (channel = 0; channel < num_channels; channel++)
+    {
+        if ((channel_mask & (1 << channel)) == 0)
+        {
+            continue;
+        }
+
+        val = (double)(MAX_CODE - codes[channel]);
+
+        // calibrate?
+        if ((options & OPTS_NOCALIBRATEDATA) == 0)
+        {
+            val *= _devices[address]->factory_data.slopes[range];
+            val += _devices[address]->factory_data.offsets[range];
+        }
+
+        // calculate voltage?
+        if ((options & OPTS_NOSCALEDATA) == 0)
+        {
+            val = (val * LSB_SIZE(RANGE_GAINS[range])) +
+                VOLTAGE_MIN(RANGE_GAINS[range]);
+        }
+        values[count++] = val;
+    }
+    return RESULT_SUCCESS;
+}
+
 /******************************************************************************
   Set the scan trigger mode.
  *****************************************************************************/
@@ -1637,15 +2181,16 @@ int mcc128_a_in_scan_queue_start(uint8_t address, uint8_t queue_count,
         return RESULT_BUSY;
     }
 
-    dev->scan_info = (struct mcc128ScanThreadInfo*)calloc(
-        sizeof(struct mcc128ScanThreadInfo), 1);
-    if (dev->scan_info == NULL)
+    // the scan is published in dev->scan_info once it is complete
+    info = (struct mcc128ScanThreadInfo*)_aligned_calloc(
+        sizeof(struct mcc128ScanThreadInfo));
+    if (info == NULL)
     {
         return RESULT_RESOURCE_UNAVAIL;
     }
 
-    info = dev->scan_info;
     info->options = (uint16_t)options;
+    info->event_fd = -1;
 
     num_channels = queue_count;
     info->channel_count = num_channels;
@@ -1664,6 +2209,7 @@ int mcc128_a_in_scan_queue_start(uint8_t address, uint8_t queue_count,
         NUM_RANGES*sizeof(double));
     memcpy(info->offsets, dev->factory_data.offsets,
         NUM_RANGES*sizeof(double));
+    _select_ingest_kernel(info);
 
     // Make sure the rate is within the board specs
     adc_rate = 0.0;
@@ -1674,7 +2220,6 @@ int mcc128_a_in_scan_queue_start(uint8_t address, uint8_t queue_count,
         if (adc_rate > MAX_ADC_RATE)
         {
             free(info);
-            dev->scan_info = NULL;
             return RESULT_BAD_PARAMETER;
         }
     }
@@ -1727,15 +2272,16 @@ int mcc128_a_in_scan_queue_start(uint8_t address, uint8_t queue_count,
 
     info->buffer_size *= num_channels;
 
-    // allocate the buffer
-    info->scan_buffer = (double*)calloc(1, info->buffer_size * sizeof(double));
+    // allocate the buffer, followed by the raw data ring of the same length
+    info->scan_buffer = (double*)_aligned_calloc(
+        info->buffer_size * (sizeof(double) + SAMPLE_SIZE_BYTES));
     if (info->scan_buffer == NULL)
     {
         // can't allocate memory
         free(info);
-        dev->scan_info = NULL;
         return RESULT_RESOURCE_UNAVAIL;
     }
+    info->raw_buffer = (uint16_t*)&info->scan_buffer[info->buffer_size];
 
     // Set the device read threshold based on the scan rate - read data
     // every 100ms or faster.
@@ -1764,7 +2310,6 @@ int mcc128_a_in_scan_queue_start(uint8_t address, uint8_t queue_count,
     {
         free(info->scan_buffer);
         free(info);
-        dev->scan_info = NULL;
         return RESULT_RESOURCE_UNAVAIL;
     }
 
@@ -1820,12 +2365,16 @@ int mcc128_a_in_scan_queue_start(uint8_t address, uint8_t queue_count,
         pthread_attr_destroy(&attr);
         free(info->scan_buffer);
         free(info);
-        dev->scan_info = NULL;
         return result;
     }
 
     info->thread_started = false;
 
+    // publish the scan for the scan thread and the other scan functions
+    pthread_mutex_lock(&dev->scan_mutex);
+    dev->scan_info = info;
+    pthread_mutex_unlock(&dev->scan_mutex);
+
     // create the scan data thread
     uint8_t* temp_address = (uint8_t*)malloc(sizeof(uint8_t));
     *temp_address = address;
@@ -1834,10 +2383,12 @@ int mcc128_a_in_scan_queue_start(uint8_t address, uint8_t queue_count,
     {
         free(temp_address);
         mcc128_a_in_scan_stop(address);
+        pthread_mutex_lock(&dev->scan_mutex);
+        dev->scan_info = NULL;
+        pthread_mutex_unlock(&dev->scan_mutex);
         pthread_attr_destroy(&attr);
         free(info->scan_buffer);
         free(info);
-        dev->scan_info = NULL;
         return RESULT_RESOURCE_UNAVAIL;
     }
 
@@ -1923,15 +2474,16 @@ int mcc128_a_in_scan_start(uint8_t address, uint8_t channel_mask,
         return RESULT_BUSY;
     }
 
-    dev->scan_info = (struct mcc128ScanThreadInfo*)calloc(
-        sizeof(struct mcc128ScanThreadInfo), 1);
-    if (dev->scan_info == NULL)
+    // the scan is published in dev->scan_info once it is complete
+    info = (struct mcc128ScanThreadInfo*)_aligned_calloc(
+        sizeof(struct mcc128ScanThreadInfo));
+    if (info == NULL)
     {
         return RESULT_RESOURCE_UNAVAIL;
     }
 
-    info = dev->scan_info;
     info->options = (uint16_t)options;
+    info->event_fd = -1;
 
     num_channels = 0;
     for (channel = 0; channel < NUM_CHANNELS; channel++)
@@ -1960,7 +2512,6 @@ int mcc128_a_in_scan_start(uint8_t address, uint8_t channel_mask,
         if (adc_rate > MAX_ADC_RATE)
         {
             free(info);
-            dev->scan_info = NULL;
             return RESULT_BAD_PARAMETER;
         }
     }
@@ -2013,15 +2564,16 @@ int mcc128_a_in_scan_start(uint8_t address, uint8_t channel_mask,
 
     info->buffer_size *= num_channels;
 
-    // allocate the buffer
-    info->scan_buffer = (double*)calloc(1, info->buffer_size * sizeof(double));
+    // allocate the buffer, followed by the raw data ring of the same length
+    info->scan_buffer = (double*)_aligned_calloc(
+        info->buffer_size * (sizeof(double) + SAMPLE_SIZE_BYTES));
     if (info->scan_buffer == NULL)
     {
         // can't allocate memory
         free(info);
-        dev->scan_info = NULL;
         return RESULT_RESOURCE_UNAVAIL;
     }
+    info->raw_buffer = (uint16_t*)&info->scan_buffer[info->buffer_size];
 
     // Set the device read threshold based on the scan rate - read data
     // every 100ms or faster.
@@ -2050,7 +2602,6 @@ int mcc128_a_in_scan_start(uint8_t address, uint8_t channel_mask,
     {
         free(info->scan_buffer);
         free(info);
-        dev->scan_info = NULL;
         return RESULT_RESOURCE_UNAVAIL;
     }
 
@@ -2111,12 +2662,16 @@ int mcc128_a_in_scan_start(uint8_t address, uint8_t channel_mask,
         pthread_attr_destroy(&attr);
         free(info->scan_buffer);
         free(info);
-        dev->scan_info = NULL;
         return result;
     }
 
     info->thread_started = false;
 
+    // publish the scan for the scan thread and the other scan functions
+    pthread_mutex_lock(&dev->scan_mutex);
+    dev->scan_info = info;
+    pthread_mutex_unlock(&dev->scan_mutex);
+
     // create the scan data thread
     uint8_t* temp_address = (uint8_t*)malloc(sizeof(uint8_t));
     *temp_address = address;
@@ -2125,10 +2680,12 @@ int mcc128_a_in_scan_start(uint8_t address, uint8_t channel_mask,
     {
         free(temp_address);
         mcc128_a_in_scan_stop(address);
+        pthread_mutex_lock(&dev->scan_mutex);
+        dev->scan_info = NULL;
+        pthread_mutex_unlock(&dev->scan_mutex);
         pthread_attr_destroy(&attr);
         free(info->scan_buffer);
         free(info);
-        dev->scan_info = NULL;
         return RESULT_RESOURCE_UNAVAIL;
     }
 
@@ -2185,6 +2742,63 @@ int mcc128_a_in_scan_channel_count(uint8_t address)
     return _devices[address]->scan_info->channel_count;
 }
 
+/******************************************************************************
+  Return an event descriptor that becomes readable when the requested amount
+  of scan data is available or the scan thread ends.
+ *****************************************************************************/
+int mcc128_a_in_scan_event_enable(uint8_t address,
+    uint32_t samples_per_channel, int* fd)
+{
+    struct mcc128ScanThreadInfo* info;
+
+    if (!_check_addr(address) ||
+        (fd == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if (samples_per_channel == 0)
+    {
+        samples_per_channel = 1;
+    }
+
+    pthread_mutex_lock(&_devices[address]->scan_mutex);
+    if ((info = _devices[address]->scan_info) == NULL)
+    {
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if (info->options & OPTS_OVERWRITE)
+    {
+        // a flight recorder buffer is always full, so the event would never
+        // reset
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if (info->event_fd == -1)
+    {
+        info->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (info->event_fd == -1)
+        {
+            pthread_mutex_unlock(&_devices[address]->scan_mutex);
+            return RESULT_RESOURCE_UNAVAIL;
+        }
+    }
+
+    // a threshold larger than the buffer could never be reached
+    info->event_threshold = MIN(samples_per_channel * info->channel_count,
+        info->buffer_size);
+
+    // signal right away if the condition is already met
+    _signal_scan_event(info);
+    *fd = info->event_fd;
+    pthread_mutex_unlock(&_devices[address]->scan_mutex);
+
+    return RESULT_SUCCESS;
+}
+
 /******************************************************************************
   Read the scan status and amount of data in the scan buffer.
  *****************************************************************************/
@@ -2257,16 +2871,19 @@ int mcc128_a_in_scan_status(uint8_t address, uint16_t* status,
   Read the specified amount of data from the scan buffer.  If
   samples_per_channel == -1, return all available samples.  If timeout is
   negative, wait indefinitely.  If it is 0,  return immediately with the
-  available data.
+  available data.  The data is stored as described by layout; a layout with
+  no planes and a sample_stride of 0 stores the data interleaved by channel.
  *****************************************************************************/
-int mcc128_a_in_scan_read(uint8_t address, uint16_t* status,
-    int32_t samples_per_channel, double timeout, double* buffer,
-    uint32_t buffer_size_samples, uint32_t* samples_read_per_channel)
+static int _a_in_scan_read(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout,
+    const struct ScanLayout* layout, uint32_t* samples_read_per_channel)
 {
+    struct ScanLayout dest;
     uint32_t samples_to_read;
     uint32_t samples_read;
     uint32_t current_read;
     uint32_t max_read;
+    uint32_t buffer_frames;
     bool no_timeout;
     bool timed_out;
     bool error;
@@ -2285,7 +2902,8 @@ int mcc128_a_in_scan_read(uint8_t address, uint16_t* status,
     if (!_check_addr(address) ||
         (status == NULL) ||
         ((samples_per_channel > 0) &&
-         ((buffer == NULL) || (buffer_size_samples == 0))))
+         (((layout->buffer == NULL) && (layout->planes == NULL)) ||
+          (layout->buffer_size == 0))))
     {
         if (samples_read_per_channel)
         {
@@ -2321,6 +2939,17 @@ int mcc128_a_in_scan_read(uint8_t address, uint16_t* status,
         return RESULT_RESOURCE_UNAVAIL;
     }
 
+    if (info->options & OPTS_OVERWRITE)
+    {
+        // flight recorder data is only read with a snapshot
+        *status = 0;
+        if (samples_read_per_channel)
+        {
+            samples_read_per_channel[0] = 0;
+        }
+        return RESULT_BAD_PARAMETER;
+    }
+
     // get thread values
     pthread_mutex_lock(&_devices[address]->scan_mutex);
     buffer_depth = info->buffer_depth;
@@ -2344,12 +2973,20 @@ int mcc128_a_in_scan_read(uint8_t address, uint16_t* status,
         samples_to_read = samples_per_channel * info->channel_count;
     }
 
-    if (buffer_size_samples < samples_to_read)
+    dest = *layout;
+    if ((dest.planes == NULL) && (dest.sample_stride == 0))
+    {
+        // interleaved
+        dest.sample_stride = info->channel_count;
+        dest.channel_stride = 1;
+    }
+
+    buffer_frames = _scan_layout_frames(&dest, info->channel_count);
+    if ((buffer_frames * info->channel_count) < samples_to_read)
     {
         // buffer is not large enough, so read the amount of samples that will
         // fit
-        samples_to_read = COUNT_NORMALIZE(buffer_size_samples,
-            info->channel_count);
+        samples_to_read = buffer_frames * info->channel_count;
     }
 
     if (samples_to_read)
@@ -2381,20 +3018,23 @@ int mcc128_a_in_scan_read(uint8_t address, uint16_t* status,
                 if (max_read < current_read)
                 {
                     // when wrapping, perform two copies
-                    memcpy(&buffer[samples_read],
+                    _scan_copy(&dest, samples_read / info->channel_count,
                         &info->scan_buffer[info->read_index],
-                        max_read*sizeof(double));
+                        max_read / info->channel_count, info->channel_count);
                     samples_read += max_read;
-                    memcpy(&buffer[samples_read], &info->scan_buffer[0],
-                        (current_read - max_read)*sizeof(double));
+                    _scan_copy(&dest, samples_read / info->channel_count,
+                        &info->scan_buffer[0],
+                        (current_read - max_read) / info->channel_count,
+                        info->channel_count);
                     samples_read += (current_read - max_read);
                     info->read_index = (current_read - max_read);
                 }
                 else
                 {
-                    memcpy(&buffer[samples_read],
+                    _scan_copy(&dest, samples_read / info->channel_count,
                         &info->scan_buffer[info->read_index],
-                        current_read*sizeof(double));
+                        current_read / info->channel_count,
+                        info->channel_count);
                     samples_read += current_read;
                     info->read_index += current_read;
                     if (info->read_index >= info->buffer_size)
@@ -2475,6 +3115,293 @@ int mcc128_a_in_scan_read(uint8_t address, uint16_t* status,
     }
 }
 
+/******************************************************************************
+  Read scan data interleaved by channel.
+ *****************************************************************************/
+int mcc128_a_in_scan_read(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* buffer,
+    uint32_t buffer_size_samples, uint32_t* samples_read_per_channel)
+{
+    struct ScanLayout layout = {buffer, NULL, buffer_size_samples, 0, 0};
+
+    return _a_in_scan_read(address, status, samples_per_channel, timeout,
+        &layout, samples_read_per_channel);
+}
+
+/******************************************************************************
+  Read scan data into a strided destination.
+ *****************************************************************************/
+int mcc128_a_in_scan_read_strided(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* buffer,
+    uint32_t buffer_size_samples, uint32_t sample_stride,
+    uint32_t channel_stride, uint32_t* samples_read_per_channel)
+{
+    struct ScanLayout layout = {buffer, NULL, buffer_size_samples,
+        sample_stride, channel_stride};
+
+    if ((sample_stride == 0) ||
+        (channel_stride == 0))
+    {
+        if (samples_read_per_channel)
+        {
+            *samples_read_per_channel = 0;
+        }
+        return RESULT_BAD_PARAMETER;
+    }
+
+    return _a_in_scan_read(address, status, samples_per_channel, timeout,
+        &layout, samples_read_per_channel);
+}
+
+/******************************************************************************
+  Read scan data into a separate buffer for each channel.
+ *****************************************************************************/
+int mcc128_a_in_scan_read_planar(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* const* buffers,
+    uint32_t buffer_size_samples, uint32_t* samples_read_per_channel)
+{
+    struct ScanLayout layout = {NULL, buffers, buffer_size_samples, 0, 0};
+    int channel_count;
+    int channel;
+
+    if (buffers != NULL)
+    {
+        // every channel in the scan needs a buffer
+        channel_count = mcc128_a_in_scan_channel_count(address);
+        for (channel = 0; channel < channel_count; channel++)
+        {
+            if (buffers[channel] == NULL)
+            {
+                if (samples_read_per_channel)
+                {
+                    *samples_read_per_channel = 0;
+                }
+                return RESULT_BAD_PARAMETER;
+            }
+        }
+    }
+
+    return _a_in_scan_read(address, status, samples_per_channel, timeout,
+        &layout, samples_read_per_channel);
+}
+
+/******************************************************************************
+  Return a pointer to the oldest unread data in the scan buffer and the number
+  of samples per channel that can be read there without wrapping.  The data is
+  not removed from the scan buffer until mcc128_a_in_scan_consume() is called.
+ *****************************************************************************/
+int mcc128_a_in_scan_peek(uint8_t address, const double** data,
+    uint32_t* samples_per_channel)
+{
+    struct mcc128ScanThreadInfo* info;
+    uint32_t available;
+
+    if (!_check_addr(address) ||
+        (data == NULL) ||
+        (samples_per_channel == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    // the scan may be started from another thread
+    pthread_mutex_lock(&_devices[address]->scan_mutex);
+    if ((info = _devices[address]->scan_info) == NULL)
+    {
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+        *data = NULL;
+        *samples_per_channel = 0;
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if (info->options & OPTS_OVERWRITE)
+    {
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+        *data = NULL;
+        *samples_per_channel = 0;
+        return RESULT_BAD_PARAMETER;
+    }
+
+    // stop at the end of the scan buffer
+    available = MIN(info->buffer_depth, info->buffer_size - info->read_index);
+
+    *data = &info->scan_buffer[info->read_index];
+    *samples_per_channel = available / info->channel_count;
+    pthread_mutex_unlock(&_devices[address]->scan_mutex);
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Remove data returned by mcc128_a_in_scan_peek() from the scan buffer.
+ *****************************************************************************/
+int mcc128_a_in_scan_consume(uint8_t address, uint32_t samples_per_channel)
+{
+    struct mcc128ScanThreadInfo* info;
+    uint32_t count;
+    int result;
+
+    if (!_check_addr(address))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if ((info = _devices[address]->scan_info) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if (info->options & OPTS_OVERWRITE)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    count = samples_per_channel * info->channel_count;
+
+    pthread_mutex_lock(&_devices[address]->scan_mutex);
+    if ((count > info->buffer_depth) ||
+        (count > (info->buffer_size - info->read_index)))
+    {
+        result = RESULT_BAD_PARAMETER;
+    }
+    else
+    {
+        info->read_index += count;
+        if (info->read_index >= info->buffer_size)
+        {
+            info->read_index = 0;
+        }
+        info->buffer_depth -= count;
+        result = RESULT_SUCCESS;
+    }
+    pthread_mutex_unlock(&_devices[address]->scan_mutex);
+
+    return result;
+}
+
+/******************************************************************************
+  Copy the most recent data of a flight recorder scan (OPTS_OVERWRITE)
+  without removing it from the scan buffer.
+ *****************************************************************************/
+int mcc128_a_in_scan_snapshot(uint8_t address, double* buffer,
+    uint32_t buffer_size_samples, uint32_t* samples_per_channel,
+    uint64_t* first_sample)
+{
+    struct mcc128ScanThreadInfo* info;
+    uint32_t scans;
+    uint32_t count;
+    uint32_t skip;
+    uint32_t index;
+    uint32_t first;
+
+    if (!_check_addr(address) ||
+        (buffer == NULL) ||
+        (samples_per_channel == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+    *samples_per_channel = 0;
+
+    if ((info = _devices[address]->scan_info) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if ((info->options & OPTS_OVERWRITE) == 0)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    // The scan thread can't discard data while the mutex is held, and the
+    // conversion thread only writes outside the retained data, so the copy is
+    // consistent.
+    pthread_mutex_lock(&_devices[address]->scan_mutex);
+    scans = info->buffer_depth / info->channel_count;
+    count = MIN(scans, buffer_size_samples / info->channel_count);
+    skip = (scans - count) * info->channel_count;
+    count *= info->channel_count;
+
+    index = info->read_index + skip;
+    if (index >= info->buffer_size)
+    {
+        index -= info->buffer_size;
+    }
+    first = MIN(count, info->buffer_size - index);
+    memcpy(buffer, &info->scan_buffer[index], first * sizeof(double));
+    memcpy(&buffer[first], info->scan_buffer, (count - first) * sizeof(double));
+
+    if (first_sample)
+    {
+        *first_sample = (info->samples_discarded + skip) /
+            info->channel_count;
+    }
+    pthread_mutex_unlock(&_devices[address]->scan_mutex);
+
+    *samples_per_channel = count / info->channel_count;
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Write the retained data of a flight recorder scan to a file.
+ *****************************************************************************/
+int mcc128_a_in_scan_snapshot_file(uint8_t address, const char* path,
+    uint32_t* samples_per_channel, uint64_t* first_sample)
+{
+    struct mcc128ScanThreadInfo* info;
+    double* buffer;
+    FILE* file;
+    uint32_t count;
+    size_t samples;
+    int result;
+
+    if (!_check_addr(address) ||
+        (path == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if ((info = _devices[address]->scan_info) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if ((buffer = (double*)malloc(info->buffer_size * sizeof(double))) ==
+        NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    count = 0;
+    result = mcc128_a_in_scan_snapshot(address, buffer, info->buffer_size,
+        &count, first_sample);
+    if (result == RESULT_SUCCESS)
+    {
+        // write after the copy so the file system can't hold up the scan
+        samples = (size_t)count * info->channel_count;
+        if ((file = fopen(path, "wb")) == NULL)
+        {
+            result = RESULT_RESOURCE_UNAVAIL;
+        }
+        else
+        {
+            if (fwrite(buffer, sizeof(double), samples, file) != samples)
+            {
+                result = RESULT_RESOURCE_UNAVAIL;
+            }
+            if (fclose(file) != 0)
+            {
+                result = RESULT_RESOURCE_UNAVAIL;
+            }
+        }
+    }
+    free(buffer);
+
+    if (samples_per_channel)
+    {
+        *samples_per_channel = (result == RESULT_SUCCESS) ? count : 0;
+    }
+    return result;
+}
+
 /******************************************************************************
   Stop a running scan by sending the scan stop command to the device.  The
   thread will  detect that the scan has stopped and terminate gracefully.
@@ -2517,6 +3444,10 @@ int mcc128_a_in_scan_cleanup(uint8_t address)
             _devices[address]->scan_info->handle = 0;
         }
 
+        if (_devices[address]->scan_info->event_fd != -1)
+        {
+            close(_devices[address]->scan_info->event_fd);
+        }
         free(_devices[address]->scan_info->scan_buffer);
         free(_devices[address]->scan_info);
         _devices[address]->scan_info = NULL;
@@ -2628,14 +3559,26 @@ int mcc128_open_for_update(uint8_t address)
 
         if (custom_size > 0)
         {
-            // convert the JSON custom data to parameters
-            cJSON* root = cJSON_Parse(custom_data);
-            if (!_parse_factory_data(root, &dev->factory_data))
+            // use the cached factory data if it matches the EEPROM,
+            // otherwise convert the JSON custom data to parameters
+            if (!_factory_cache_load(address, HAT_ID_MCC_128, custom_data,
+                custom_size, &dev->factory_data,
+                sizeof(dev->factory_data)))
             {
-                // invalid custom data, use default values
-                _set_defaults(&dev->factory_data);
+                cJSON* root = cJSON_Parse(custom_data);
+                if (!_parse_factory_data(root, &dev->factory_data))
+                {
+                    // invalid custom data, use default values
+                    _set_defaults(&dev->factory_data);
+                }
+                else
+                {
+                    _factory_cache_store(address, HAT_ID_MCC_128, custom_data,
+                        custom_size, &dev->factory_data,
+                        sizeof(dev->factory_data));
+                }
+                cJSON_Delete(root);
             }
-            cJSON_Delete(root);
 
             free(custom_data);
         }
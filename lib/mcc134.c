@@ -161,6 +161,7 @@ struct mcc134Device
 
 static struct mcc134Device* _devices[MAX_NUMBER_HATS];
 static bool _mcc134_lib_initialized = false;
+static pthread_once_t _mcc134_lib_once = PTHREAD_ONCE_INIT;
 
 //*****************************************************************************
 // Local Functions
@@ -364,19 +365,25 @@ static int _parse_factory_data(cJSON* root, struct mcc134FactoryData* data)
 /******************************************************************************
   Perform any library initialization.
  *****************************************************************************/
-static void _mcc134_lib_init(void)
+static void _mcc134_lib_init_once(void)
 {
     int i;
 
-    if (!_mcc134_lib_initialized)
+    for (i = 0; i < MAX_NUMBER_HATS; i++)
     {
-        for (i = 0; i < MAX_NUMBER_HATS; i++)
-        {
-            _devices[i] = NULL;
-        }
-
-        _mcc134_lib_initialized = true;
+        _devices[i] = NULL;
     }
+
+    _mcc134_lib_initialized = true;
+}
+
+/******************************************************************************
+  Perform the library initialization once, even when boards are opened from
+  several threads at the same time.
+ *****************************************************************************/
+static void _mcc134_lib_init(void)
+{
+    pthread_once(&_mcc134_lib_once, &_mcc134_lib_init_once);
 }
 
 /******************************************************************************
@@ -749,25 +756,37 @@ int mcc134_open(uint8_t address)
 
         if (custom_size > 0)
         {
-            // convert the JSON custom data to parameters
-            cJSON* root = cJSON_Parse(custom_data);
-            if (root == NULL)
+            // use the cached factory data if it matches the EEPROM,
+            // otherwise convert the JSON custom data to parameters
+            if (!_factory_cache_load(address, HAT_ID_MCC_134, custom_data,
+                custom_size, &dev->factory_data,
+                sizeof(dev->factory_data)))
             {
-                // error parsing the JSON data
-                _set_defaults(&dev->factory_data);
-                printf("Warning - address %d using factory EEPROM default "
-                    "values\n", address);
-            }
-            else
-            {
-                if (!_parse_factory_data(root, &dev->factory_data))
+                cJSON* root = cJSON_Parse(custom_data);
+                if (root == NULL)
                 {
-                    // invalid custom data, use default values
+                    // error parsing the JSON data
                     _set_defaults(&dev->factory_data);
                     printf("Warning - address %d using factory EEPROM default "
                         "values\n", address);
                 }
-                cJSON_Delete(root);
+                else
+                {
+                    if (!_parse_factory_data(root, &dev->factory_data))
+                    {
+                        // invalid custom data, use default values
+                        _set_defaults(&dev->factory_data);
+                        printf("Warning - address %d using factory EEPROM "
+                            "default values\n", address);
+                    }
+                    else
+                    {
+                        _factory_cache_store(address, HAT_ID_MCC_134,
+                            custom_data, custom_size, &dev->factory_data,
+                            sizeof(dev->factory_data));
+                    }
+                    cJSON_Delete(root);
+                }
             }
 
             free(custom_data);
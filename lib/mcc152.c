@@ -14,6 +14,11 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include "daqhats.h"
 #include "util.h"
 #include "cJSON.h"
@@ -59,6 +64,20 @@ struct MCC152DeviceInfo mcc152_device_info =
 #define MIN(a, b)           ((a < b) ? a : b)
 #define MAX(a, b)           ((a > b) ? a : b)
 
+#define NSEC_PER_SEC        1000000000ull
+
+// The real-time priority of the output scan thread above the minimum
+#define MCC152_SCAN_PRIORITY    10
+
+// Each output scan update holds a prepared DAC frame followed by a prepared DIO
+// port write.
+#define SCAN_DIO_OFFSET     MCC152_DAC_FRAME_SIZE
+#define SCAN_FRAME_SIZE     (MCC152_DAC_FRAME_SIZE + MCC152_DIO_FRAME_SIZE)
+
+// The maximum number of times the DIO event capture reads the boards on one
+// interrupt edge while the shared interrupt line stays active.
+#define DIO_CAPTURE_MAX_PASSES  16
+
 /// \cond
 // Contains the device-specific data stored at the factory.
 struct mcc152FactoryData
@@ -67,6 +86,41 @@ struct mcc152FactoryData
     char serial[SERIAL_SIZE];
 };
 
+// Analog output scan data.  The scan buffer holds a prepared DAC frame and
+// DIO port write for each update.
+struct mcc152AOutScan
+{
+    pthread_t handle;
+    pthread_mutex_t mutex;
+    pthread_cond_t space_cond;  // signaled when the thread frees buffer space
+    uint8_t address;
+    uint8_t spi_device;
+    uint8_t channel_mask;
+    uint8_t channel_count;
+    uint8_t frame_size;         // DAC frame size, 0 if no analog outputs
+    bool dio;                   // the scan includes the DIO port
+    int dio_handle;             // bus handle for the DIO port writes
+    bool continuous;
+    uint8_t* frames;
+    uint32_t buffer_size;       // size of the scan buffer in updates
+    uint32_t read_index;
+    uint32_t write_index;
+    uint32_t buffer_depth;      // updates waiting in the scan buffer
+    uint64_t period_ns;
+    bool stop_thread;
+    bool scan_running;
+    int result;
+
+    // timing statistics
+    uint64_t updates;
+    uint64_t late_updates;
+    uint64_t first_ns;
+    uint64_t last_ns;
+    double latency_sum;
+    double latency_sum_sq;
+    double latency_max;
+};
+
 // Local data for each open MCC 152 board.
 struct mcc152Device
 {
@@ -74,6 +128,26 @@ struct mcc152Device
     struct mcc152FactoryData factory_data;   // Factory data
     uint8_t spi_device;         // which SPI device for the DAC (rev 1 boards
                                 // used SPI 1, newer boards use SPI 0)
+    struct mcc152AOutScan* ao_scan; // analog output scan, if active
+};
+
+// DIO event capture data.  The interrupt thread is the only writer and the
+// reading thread the only reader of the event queue, so the queue indexes are
+// published with atomic loads and stores rather than a lock.  The indexes run
+// freely and are masked with the queue size.  readers and stopping are
+// protected by _dio_capture_mutex; the capture is freed only after the last
+// reader has left.
+struct mcc152DIOCapture
+{
+    struct MCC152DIOEvent* events;
+    int event_fd;               // signaled when events are added or on stop
+    uint8_t address_mask;       // the boards being captured
+    uint32_t readers;           // threads in mcc152_dio_event_read()
+    bool stopping;              // mcc152_dio_event_capture_stop() was called
+    uint64_t overflows;
+    uint64_t errors;
+    CACHE_ALIGNED uint32_t write_index;
+    CACHE_ALIGNED uint32_t read_index;
 };
 /// \endcond
 
@@ -82,6 +156,10 @@ struct mcc152Device
 
 static struct mcc152Device* _devices[MAX_NUMBER_HATS];
 static bool _mcc152_lib_initialized = false;
+static pthread_once_t _mcc152_lib_once = PTHREAD_ONCE_INIT;
+static struct mcc152DIOCapture* _dio_capture = NULL;
+static pthread_mutex_t _dio_capture_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _dio_capture_cond = PTHREAD_COND_INITIALIZER;
 
 //*****************************************************************************
 // Local Functions
@@ -174,18 +252,324 @@ static int _parse_factory_data(cJSON* root, struct mcc152FactoryData* data)
 /******************************************************************************
   Perform any library initialization.
  *****************************************************************************/
-static void _mcc152_lib_init(void)
+static void _mcc152_lib_init_once(void)
 {
     int i;
-    
-    if (!_mcc152_lib_initialized)
+
+    for (i = 0; i < MAX_NUMBER_HATS; i++)
     {
-        for (i = 0; i < MAX_NUMBER_HATS; i++)
+        _devices[i] = NULL;
+    }
+
+    _mcc152_lib_initialized = true;
+}
+
+/******************************************************************************
+  Perform the library initialization once, even when boards are opened from
+  several threads at the same time.
+ *****************************************************************************/
+static void _mcc152_lib_init(void)
+{
+    pthread_once(&_mcc152_lib_once, &_mcc152_lib_init_once);
+}
+
+/******************************************************************************
+  Convert an analog output value to a DAC code.
+ *****************************************************************************/
+static uint16_t _value_to_code(double value, uint32_t options)
+{
+    if ((options & OPTS_NOSCALEDATA) == 0)
+    {
+        // voltage
+        if (value < 0.0)
         {
-            _devices[i] = NULL;
+            value = 0.0;
+        }
+        else if (value > MAX_VOLTAGE)
+        {
+            value = MAX_VOLTAGE;
+        }
+        return (uint16_t)((value / LSB_SIZE) + 0.5);
+    }
+    else
+    {
+        // code
+        if (value < 0.0)
+        {
+            value = 0.0;
+        }
+        else if (value > MAX_CODE)
+        {
+            value = MAX_CODE;
+        }
+        return (uint16_t)(value + 0.5);
+    }
+}
+
+/******************************************************************************
+  Convert interleaved values to DAC frames in the analog output scan buffer
+  and advance the write index.
+ *****************************************************************************/
+static void _ao_scan_prepare(struct mcc152AOutScan* scan, const double* buffer,
+    uint32_t count, uint32_t options)
+{
+    uint16_t codes[NUM_AO_CHANNELS];
+    uint8_t* frame;
+    double port;
+    uint32_t index;
+    uint32_t write_index;
+    int channel;
+
+    write_index = scan->write_index;
+    for (index = 0; index < count; index++)
+    {
+        frame = &scan->frames[write_index * SCAN_FRAME_SIZE];
+        codes[0] = 0;
+        codes[1] = 0;
+        for (channel = 0; channel < NUM_AO_CHANNELS; channel++)
+        {
+            if (scan->channel_mask & (1 << channel))
+            {
+                codes[channel] = _value_to_code(*buffer++, options);
+            }
+        }
+        if (scan->channel_mask & MCC152_AO_SCAN_MASK)
+        {
+            scan->frame_size = _mcc152_dac_prepare(
+                scan->channel_mask & MCC152_AO_SCAN_MASK, codes[0], codes[1],
+                frame);
+        }
+        if (scan->dio)
+        {
+            // the port value is never scaled
+            port = *buffer++;
+            if (port < 0.0)
+            {
+                port = 0.0;
+            }
+            else if (port > 255.0)
+            {
+                port = 255.0;
+            }
+            _mcc152_dio_prepare((uint8_t)port, &frame[SCAN_DIO_OFFSET]);
+        }
+
+        write_index++;
+        if (write_index == scan->buffer_size)
+        {
+            write_index = 0;
+        }
+    }
+    scan->write_index = write_index;
+}
+
+/******************************************************************************
+  Return true if a running output scan is updating any of the outputs in
+  channel_mask.
+ *****************************************************************************/
+static bool _scan_busy(uint8_t address, uint8_t channel_mask)
+{
+    struct mcc152AOutScan* scan;
+
+    if (!_check_addr(address))
+    {
+        return false;
+    }
+    scan = _devices[address]->ao_scan;
+    return ((scan != NULL) &&
+            scan->scan_running &&
+            ((scan->channel_mask & channel_mask) != 0));
+}
+
+static inline uint64_t _timespec_ns(const struct timespec* ts)
+{
+    return ((uint64_t)ts->tv_sec * NSEC_PER_SEC) + ts->tv_nsec;
+}
+
+/******************************************************************************
+  Analog output scan thread.  Each update is scheduled at an absolute time
+  from the start of the scan with clock_nanosleep(), so the delay of one
+  update does not shift the ones after it.
+ *****************************************************************************/
+static void* _ao_scan_thread(void* arg)
+{
+    struct mcc152AOutScan* scan = (struct mcc152AOutScan*)arg;
+    struct timespec deadline;
+    struct timespec now;
+    uint64_t deadline_ns;
+    uint64_t now_ns;
+    const uint8_t* frame;
+    struct sched_param param;
+    double latency;
+    int result;
+
+    // run at a real-time priority when the process is allowed to; otherwise
+    // keep the normal priority
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) +
+        MCC152_SCAN_PRIORITY;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    deadline_ns = _timespec_ns(&now);
+
+    while (1)
+    {
+        // a streaming scan ends when it runs out of data; the writer checks
+        // scan_running under the same lock so it can't add data too late
+        pthread_mutex_lock(&scan->mutex);
+        if (scan->stop_thread || (scan->buffer_depth == 0))
+        {
+            scan->scan_running = false;
+            pthread_cond_broadcast(&scan->space_cond);
+            pthread_mutex_unlock(&scan->mutex);
+            break;
+        }
+        // the writer does not touch this frame until the read index moves on
+        frame = &scan->frames[scan->read_index * SCAN_FRAME_SIZE];
+        pthread_mutex_unlock(&scan->mutex);
+
+        deadline.tv_sec = deadline_ns / NSEC_PER_SEC;
+        deadline.tv_nsec = deadline_ns % NSEC_PER_SEC;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+            NULL) == EINTR)
+        {
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        now_ns = _timespec_ns(&now);
+        result = RESULT_SUCCESS;
+        if (scan->frame_size > 0)
+        {
+            result = _mcc152_dac_write_frame(scan->spi_device, scan->address,
+                frame, scan->frame_size);
+        }
+        if (scan->dio && (result == RESULT_SUCCESS))
+        {
+            result = _mcc152_dio_write_frame(scan->dio_handle, scan->address,
+                &frame[SCAN_DIO_OFFSET]);
+        }
+
+        pthread_mutex_lock(&scan->mutex);
+        if (result != RESULT_SUCCESS)
+        {
+            scan->result = result;
+            scan->scan_running = false;
+            pthread_cond_broadcast(&scan->space_cond);
+            pthread_mutex_unlock(&scan->mutex);
+            break;
+        }
+
+        latency = (double)(now_ns - deadline_ns) / 1000.0;
+        if (scan->updates == 0)
+        {
+            scan->first_ns = now_ns;
+        }
+        scan->last_ns = now_ns;
+        scan->updates++;
+        scan->latency_sum += latency;
+        scan->latency_sum_sq += latency * latency;
+        if (latency > scan->latency_max)
+        {
+            scan->latency_max = latency;
+        }
+        if ((now_ns - deadline_ns) > scan->period_ns)
+        {
+            scan->late_updates++;
+        }
+
+        scan->read_index++;
+        if (scan->read_index == scan->buffer_size)
+        {
+            scan->read_index = 0;
+        }
+        if (!scan->continuous)
+        {
+            scan->buffer_depth--;
+            pthread_cond_broadcast(&scan->space_cond);
+        }
+        pthread_mutex_unlock(&scan->mutex);
+
+        deadline_ns += scan->period_ns;
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+  DIO event capture interrupt handler, called by the interrupt thread.  The
+  interrupt line is shared and level sensitive, so a board that interrupts
+  while the others are being read keeps it active without a new edge; the
+  boards are read again until the line goes inactive.
+ *****************************************************************************/
+static void _dio_capture_handler(void* arg)
+{
+    struct mcc152DIOCapture* capture = (struct mcc152DIOCapture*)arg;
+    struct MCC152DIOEvent* event;
+    struct timespec now;
+    uint8_t status[MAX_NUMBER_HATS];
+    uint8_t values[MAX_NUMBER_HATS];
+    uint8_t address_mask;
+    uint8_t address;
+    uint32_t write_index;
+    uint32_t read_index;
+    bool added;
+    int pass;
+
+    for (pass = 0; pass < DIO_CAPTURE_MAX_PASSES; pass++)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        address_mask = __atomic_load_n(&capture->address_mask,
+            __ATOMIC_ACQUIRE);
+        if (address_mask == 0)
+        {
+            break;
+        }
+
+        if (_mcc152_dio_event_read(address_mask, status, values) !=
+            RESULT_SUCCESS)
+        {
+            __atomic_add_fetch(&capture->errors, 1, __ATOMIC_RELAXED);
+            break;
+        }
+
+        write_index = capture->write_index;
+        read_index = __atomic_load_n(&capture->read_index, __ATOMIC_ACQUIRE);
+        added = false;
+        for (address = 0; address < MAX_NUMBER_HATS; address++)
+        {
+            if (((address_mask & (1 << address)) == 0) ||
+                (status[address] == 0))
+            {
+                continue;
+            }
+
+            if ((write_index - read_index) >= MCC152_DIO_EVENT_QUEUE_SIZE)
+            {
+                __atomic_add_fetch(&capture->overflows, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+
+            event = &capture->events[write_index &
+                (MCC152_DIO_EVENT_QUEUE_SIZE - 1)];
+            event->timestamp = _timespec_ns(&now);
+            event->address = address;
+            event->value = values[address];
+            event->changed = status[address];
+            write_index++;
+            added = true;
+        }
+
+        if (added)
+        {
+            __atomic_store_n(&capture->write_index, write_index,
+                __ATOMIC_RELEASE);
+            eventfd_write(capture->event_fd, 1);
+        }
+
+        if (hat_interrupt_state() == 0)
+        {
+            break;
         }
-        
-        _mcc152_lib_initialized = true;
     }
 }
 
@@ -257,25 +641,37 @@ int mcc152_open(uint8_t address)
                 dev->spi_device = 1;
             }
 
-            // convert the JSON custom data to parameters
-            cJSON* root = cJSON_Parse(custom_data);
-            if (root == NULL)
+            // use the cached factory data if it matches the EEPROM,
+            // otherwise convert the JSON custom data to parameters
+            if (!_factory_cache_load(address, HAT_ID_MCC_152, custom_data,
+                custom_size, &dev->factory_data,
+                sizeof(dev->factory_data)))
             {
-                // error parsing the JSON data
-                _set_defaults(&dev->factory_data);
-                printf("Warning - address %d using factory EEPROM default "
-                    "values\n", address);
-            }
-            else
-            {
-                if (!_parse_factory_data(root, &dev->factory_data))
+                cJSON* root = cJSON_Parse(custom_data);
+                if (root == NULL)
                 {
-                    // invalid custom data, use default values
+                    // error parsing the JSON data
                     _set_defaults(&dev->factory_data);
                     printf("Warning - address %d using factory EEPROM default "
                         "values\n", address);
                 }
-                cJSON_Delete(root);
+                else
+                {
+                    if (!_parse_factory_data(root, &dev->factory_data))
+                    {
+                        // invalid custom data, use default values
+                        _set_defaults(&dev->factory_data);
+                        printf("Warning - address %d using factory EEPROM "
+                            "default values\n", address);
+                    }
+                    else
+                    {
+                        _factory_cache_store(address, HAT_ID_MCC_152,
+                            custom_data, custom_size, &dev->factory_data,
+                            sizeof(dev->factory_data));
+                    }
+                    cJSON_Delete(root);
+                }
             }
 
             free(custom_data);
@@ -344,6 +740,16 @@ int mcc152_close(uint8_t address)
     _devices[address]->handle_count--;
     if (_devices[address]->handle_count == 0)
     {
+        mcc152_a_out_scan_cleanup(address);
+
+        // stop capturing DIO events from this board
+        pthread_mutex_lock(&_dio_capture_mutex);
+        if (_dio_capture != NULL)
+        {
+            __atomic_and_fetch(&_dio_capture->address_mask,
+                (uint8_t)~(1 << address), __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&_dio_capture_mutex);
         free(_devices[address]);
         _devices[address] = NULL;
     }
@@ -389,6 +795,11 @@ int mcc152_a_out_write(uint8_t address, uint8_t channel, uint32_t options,
         return RESULT_BAD_PARAMETER;
     }
 
+    if (_scan_busy(address, MCC152_AO_SCAN_MASK))
+    {
+        return RESULT_BUSY;
+    }
+
     if ((options & OPTS_NOSCALEDATA) == 0)
     {
         // user passed voltage
@@ -434,6 +845,11 @@ int mcc152_a_out_write_all(uint8_t address, uint32_t options, double* values)
         return RESULT_BAD_PARAMETER;
     }
 
+    if (_scan_busy(address, MCC152_AO_SCAN_MASK))
+    {
+        return RESULT_BUSY;
+    }
+
     for (i = 0; i < NUM_AO_CHANNELS; i++)
     {
         if ((options & OPTS_NOSCALEDATA) == 0)
@@ -468,6 +884,317 @@ int mcc152_a_out_write_all(uint8_t address, uint32_t options, double* values)
         codes[0], codes[1]);
 }
 
+/******************************************************************************
+  Start a timed analog output scan.
+ *****************************************************************************/
+int mcc152_a_out_scan_start(uint8_t address, uint8_t channel_mask,
+    double* buffer, uint32_t samples_per_channel, double rate,
+    uint32_t options)
+{
+    struct mcc152AOutScan* scan;
+    struct mcc152Device* dev;
+    pthread_condattr_t attr;
+
+    if (!_check_addr(address) ||
+        (channel_mask == 0) ||
+        ((channel_mask & ~(MCC152_AO_SCAN_MASK | MCC152_AO_SCAN_DIO)) != 0) ||
+        (buffer == NULL) ||
+        (samples_per_channel == 0) ||
+        (rate <= 0.0) ||
+        (rate > MCC152_AO_SCAN_MAX_RATE))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    dev = _devices[address];
+    if (dev->ao_scan != NULL)
+    {
+        return RESULT_BUSY;
+    }
+
+    if ((scan = (struct mcc152AOutScan*)calloc(1,
+        sizeof(struct mcc152AOutScan))) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    if ((scan->frames = (uint8_t*)malloc((size_t)samples_per_channel *
+        SCAN_FRAME_SIZE)) == NULL)
+    {
+        free(scan);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    // the DIO port writes use one bus handle for the whole scan
+    scan->dio = ((channel_mask & MCC152_AO_SCAN_DIO) != 0);
+    scan->dio_handle = -1;
+    if (scan->dio && ((scan->dio_handle = _mcc152_dio_open()) < 0))
+    {
+        free(scan->frames);
+        free(scan);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    scan->address = address;
+    scan->spi_device = dev->spi_device;
+    scan->channel_mask = channel_mask;
+    scan->channel_count = ((channel_mask & 0x01) ? 1 : 0) +
+        ((channel_mask & 0x02) ? 1 : 0) + (scan->dio ? 1 : 0);
+    scan->continuous = ((options & OPTS_CONTINUOUS) != 0);
+    scan->buffer_size = samples_per_channel;
+    scan->period_ns = (uint64_t)((NSEC_PER_SEC / rate) + 0.5);
+    scan->result = RESULT_SUCCESS;
+
+    // build all the frames before the first update
+    _ao_scan_prepare(scan, buffer, samples_per_channel, options);
+    scan->buffer_depth = samples_per_channel;
+    scan->scan_running = true;
+
+    pthread_mutex_init(&scan->mutex, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&scan->space_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    dev->ao_scan = scan;
+    if (pthread_create(&scan->handle, NULL, &_ao_scan_thread, scan) != 0)
+    {
+        dev->ao_scan = NULL;
+        pthread_cond_destroy(&scan->space_cond);
+        pthread_mutex_destroy(&scan->mutex);
+        _mcc152_dio_close(scan->dio_handle);
+        free(scan->frames);
+        free(scan);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Add data to a streaming analog output scan.
+ *****************************************************************************/
+int mcc152_a_out_scan_write(uint8_t address, uint32_t options, double* buffer,
+    uint32_t samples_per_channel, double timeout, uint32_t* samples_written)
+{
+    struct mcc152AOutScan* scan;
+    struct timespec deadline;
+    uint64_t deadline_ns;
+    uint32_t written;
+    uint32_t count;
+    int result;
+
+    if (samples_written)
+    {
+        *samples_written = 0;
+    }
+
+    if (!_check_addr(address) ||
+        ((buffer == NULL) && (samples_per_channel > 0)))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if ((scan = _devices[address]->ao_scan) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    if (scan->continuous)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if (timeout > 0.0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline_ns = _timespec_ns(&deadline) +
+            (uint64_t)(timeout * NSEC_PER_SEC);
+        deadline.tv_sec = deadline_ns / NSEC_PER_SEC;
+        deadline.tv_nsec = deadline_ns % NSEC_PER_SEC;
+    }
+
+    result = RESULT_SUCCESS;
+    written = 0;
+    pthread_mutex_lock(&scan->mutex);
+    while (written < samples_per_channel)
+    {
+        if (!scan->scan_running)
+        {
+            result = RESULT_RESOURCE_UNAVAIL;
+            break;
+        }
+
+        count = MIN(scan->buffer_size - scan->buffer_depth,
+            samples_per_channel - written);
+        if (count > 0)
+        {
+            // the thread does not read the free space, so the frames are
+            // built without holding the lock
+            pthread_mutex_unlock(&scan->mutex);
+            _ao_scan_prepare(scan, &buffer[written * scan->channel_count],
+                count, options);
+            pthread_mutex_lock(&scan->mutex);
+            scan->buffer_depth += count;
+            written += count;
+        }
+        else if (timeout == 0.0)
+        {
+            result = RESULT_TIMEOUT;
+            break;
+        }
+        else if (timeout < 0.0)
+        {
+            pthread_cond_wait(&scan->space_cond, &scan->mutex);
+        }
+        else if (pthread_cond_timedwait(&scan->space_cond, &scan->mutex,
+            &deadline) == ETIMEDOUT)
+        {
+            result = RESULT_TIMEOUT;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&scan->mutex);
+
+    if (samples_written)
+    {
+        *samples_written = written;
+    }
+    return result;
+}
+
+/******************************************************************************
+  Read the status of an analog output scan.
+ *****************************************************************************/
+int mcc152_a_out_scan_status(uint8_t address, uint16_t* status,
+    uint32_t* samples_free)
+{
+    struct mcc152AOutScan* scan;
+    int result;
+
+    if (!_check_addr(address) ||
+        (status == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if ((scan = _devices[address]->ao_scan) == NULL)
+    {
+        *status = 0;
+        if (samples_free)
+        {
+            *samples_free = 0;
+        }
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    pthread_mutex_lock(&scan->mutex);
+    *status = scan->scan_running ? STATUS_RUNNING : 0;
+    if (samples_free)
+    {
+        *samples_free = scan->continuous ? 0 :
+            (scan->buffer_size - scan->buffer_depth);
+    }
+    result = scan->result;
+    pthread_mutex_unlock(&scan->mutex);
+
+    return result;
+}
+
+/******************************************************************************
+  Read the timing statistics of an analog output scan.
+ *****************************************************************************/
+int mcc152_a_out_scan_stats(uint8_t address,
+    struct MCC152AOutScanStats* stats)
+{
+    struct mcc152AOutScan* scan;
+    double variance;
+
+    if (!_check_addr(address) ||
+        (stats == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if ((scan = _devices[address]->ao_scan) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    memset(stats, 0, sizeof(struct MCC152AOutScanStats));
+
+    pthread_mutex_lock(&scan->mutex);
+    stats->updates = scan->updates;
+    stats->late_updates = scan->late_updates;
+    if (scan->updates > 1)
+    {
+        stats->actual_rate = (double)(scan->updates - 1) * NSEC_PER_SEC /
+            (double)(scan->last_ns - scan->first_ns);
+    }
+    if (scan->updates > 0)
+    {
+        stats->latency_mean = scan->latency_sum / scan->updates;
+        stats->latency_max = scan->latency_max;
+        variance = (scan->latency_sum_sq / scan->updates) -
+            (stats->latency_mean * stats->latency_mean);
+        stats->jitter = (variance > 0.0) ? sqrt(variance) : 0.0;
+    }
+    pthread_mutex_unlock(&scan->mutex);
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Stop an analog output scan.
+ *****************************************************************************/
+int mcc152_a_out_scan_stop(uint8_t address)
+{
+    struct mcc152AOutScan* scan;
+
+    if (!_check_addr(address))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if (((scan = _devices[address]->ao_scan) != NULL) &&
+        (scan->handle != 0))
+    {
+        pthread_mutex_lock(&scan->mutex);
+        scan->stop_thread = true;
+        pthread_mutex_unlock(&scan->mutex);
+
+        pthread_join(scan->handle, NULL);
+        scan->handle = 0;
+    }
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Free the resources used by an analog output scan.
+ *****************************************************************************/
+int mcc152_a_out_scan_cleanup(uint8_t address)
+{
+    struct mcc152AOutScan* scan;
+
+    if (!_check_addr(address))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if ((scan = _devices[address]->ao_scan) != NULL)
+    {
+        mcc152_a_out_scan_stop(address);
+
+        _devices[address]->ao_scan = NULL;
+        pthread_cond_destroy(&scan->space_cond);
+        pthread_mutex_destroy(&scan->mutex);
+        _mcc152_dio_close(scan->dio_handle);
+        free(scan->frames);
+        free(scan);
+    }
+
+    return RESULT_SUCCESS;
+}
+
 /******************************************************************************
   Reset DIO to default configuration.
  *****************************************************************************/
@@ -480,6 +1207,11 @@ int mcc152_dio_reset(uint8_t address)
         return RESULT_BAD_PARAMETER;
     }    
 
+    if (_scan_busy(address, MCC152_AO_SCAN_DIO))
+    {
+        return RESULT_BUSY;
+    }
+
     // write the register values
     
     // interrupt mask
@@ -586,6 +1318,11 @@ int mcc152_dio_output_write_bit(uint8_t address, uint8_t channel, uint8_t value)
     {
         return RESULT_BAD_PARAMETER;
     }
+
+    if (_scan_busy(address, MCC152_AO_SCAN_DIO))
+    {
+        return RESULT_BUSY;
+    }
     
     return _mcc152_dio_reg_write(address, DIO_REG_OUTPUT_PORT, channel, value,
         true);
@@ -596,6 +1333,11 @@ int mcc152_dio_output_write_bit(uint8_t address, uint8_t channel, uint8_t value)
  *****************************************************************************/
 int mcc152_dio_output_write_port(uint8_t address, uint8_t values)
 {
+    if (_scan_busy(address, MCC152_AO_SCAN_DIO))
+    {
+        return RESULT_BUSY;
+    }
+
     return _mcc152_dio_reg_write(address, DIO_REG_OUTPUT_PORT, DIO_CHANNEL_ALL,
         values, true);
 }
@@ -862,3 +1604,254 @@ int mcc152_dio_config_read_port(uint8_t address, uint8_t item, uint8_t* value)
     }
     return RESULT_SUCCESS;
 }
+
+/******************************************************************************
+  Start capturing DIO change events.
+ *****************************************************************************/
+int mcc152_dio_event_capture_start(uint8_t address_mask)
+{
+    struct mcc152DIOCapture* capture;
+    uint8_t address;
+    int result;
+
+    if (address_mask == 0)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        if ((address_mask & (1 << address)) && !_check_addr(address))
+        {
+            return RESULT_BAD_PARAMETER;
+        }
+    }
+
+    pthread_mutex_lock(&_dio_capture_mutex);
+    if (_dio_capture != NULL)
+    {
+        // already running, add the boards
+        __atomic_or_fetch(&_dio_capture->address_mask, address_mask,
+            __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&_dio_capture_mutex);
+        return RESULT_SUCCESS;
+    }
+
+    capture = (struct mcc152DIOCapture*)_aligned_calloc(
+        sizeof(struct mcc152DIOCapture));
+    if (capture == NULL)
+    {
+        pthread_mutex_unlock(&_dio_capture_mutex);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    capture->events = (struct MCC152DIOEvent*)calloc(
+        MCC152_DIO_EVENT_QUEUE_SIZE, sizeof(struct MCC152DIOEvent));
+    capture->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((capture->events == NULL) || (capture->event_fd == -1))
+    {
+        if (capture->event_fd != -1)
+        {
+            close(capture->event_fd);
+        }
+        free(capture->events);
+        free(capture);
+        pthread_mutex_unlock(&_dio_capture_mutex);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    capture->address_mask = address_mask;
+
+    result = _interrupt_capture_set(_dio_capture_handler, capture);
+    if (result != RESULT_SUCCESS)
+    {
+        close(capture->event_fd);
+        free(capture->events);
+        free(capture);
+        pthread_mutex_unlock(&_dio_capture_mutex);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    _dio_capture = capture;
+    pthread_mutex_unlock(&_dio_capture_mutex);
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Leave the capture after reading, letting a waiting stop free it.
+ *****************************************************************************/
+static void _dio_capture_release(struct mcc152DIOCapture* capture)
+{
+    pthread_mutex_lock(&_dio_capture_mutex);
+    if ((--capture->readers == 0) && capture->stopping)
+    {
+        pthread_cond_broadcast(&_dio_capture_cond);
+    }
+    pthread_mutex_unlock(&_dio_capture_mutex);
+}
+
+/******************************************************************************
+  Read DIO change events.
+ *****************************************************************************/
+int mcc152_dio_event_read(struct MCC152DIOEvent* events, uint32_t max_events,
+    double timeout, uint32_t* events_read)
+{
+    struct mcc152DIOCapture* capture;
+    struct pollfd poll_data;
+    struct timespec start;
+    struct timespec now;
+    eventfd_t value;
+    uint32_t write_index;
+    uint32_t read_index;
+    uint32_t count;
+    uint32_t index;
+    int timeout_ms;
+    int wait_ms;
+    int result;
+
+    if ((events == NULL) ||
+        (max_events == 0) ||
+        (events_read == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+    *events_read = 0;
+
+    pthread_mutex_lock(&_dio_capture_mutex);
+    capture = _dio_capture;
+    if (capture != NULL)
+    {
+        capture->readers++;
+    }
+    pthread_mutex_unlock(&_dio_capture_mutex);
+    if (capture == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    timeout_ms = (timeout < 0.0) ? -1 : (int)(timeout * 1000.0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    read_index = capture->read_index;
+    result = RESULT_SUCCESS;
+    while (1)
+    {
+        write_index = __atomic_load_n(&capture->write_index,
+            __ATOMIC_ACQUIRE);
+        if (write_index != read_index)
+        {
+            break;
+        }
+
+        // wait for the interrupt thread to signal new events
+        if (timeout_ms < 0)
+        {
+            wait_ms = -1;
+        }
+        else
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            wait_ms = timeout_ms - (int)_difftime_ms(&start, &now);
+            if (wait_ms <= 0)
+            {
+                result = RESULT_TIMEOUT;
+                break;
+            }
+        }
+        poll_data.fd = capture->event_fd;
+        poll_data.events = POLLIN;
+        poll_data.revents = 0;
+        if ((poll(&poll_data, 1, wait_ms) == -1) && (errno != EINTR))
+        {
+            result = RESULT_UNDEFINED;
+            break;
+        }
+        if (__atomic_load_n(&capture->stopping, __ATOMIC_ACQUIRE))
+        {
+            // leave the descriptor signaled for any other reader
+            result = RESULT_RESOURCE_UNAVAIL;
+            break;
+        }
+        eventfd_read(capture->event_fd, &value);
+    }
+
+    if (result == RESULT_SUCCESS)
+    {
+        count = MIN(write_index - read_index, max_events);
+        for (index = 0; index < count; index++)
+        {
+            events[index] = capture->events[(read_index + index) &
+                (MCC152_DIO_EVENT_QUEUE_SIZE - 1)];
+        }
+        __atomic_store_n(&capture->read_index, read_index + count,
+            __ATOMIC_RELEASE);
+        *events_read = count;
+    }
+
+    _dio_capture_release(capture);
+    return result;
+}
+
+/******************************************************************************
+  Read the DIO event capture status.
+ *****************************************************************************/
+int mcc152_dio_event_status(uint32_t* queued, uint64_t* overflows,
+    uint64_t* errors)
+{
+    struct mcc152DIOCapture* capture;
+
+    pthread_mutex_lock(&_dio_capture_mutex);
+    capture = _dio_capture;
+    if (capture == NULL)
+    {
+        pthread_mutex_unlock(&_dio_capture_mutex);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if (queued)
+    {
+        *queued = __atomic_load_n(&capture->write_index, __ATOMIC_ACQUIRE) -
+            __atomic_load_n(&capture->read_index, __ATOMIC_ACQUIRE);
+    }
+    if (overflows)
+    {
+        *overflows = __atomic_load_n(&capture->overflows, __ATOMIC_RELAXED);
+    }
+    if (errors)
+    {
+        *errors = __atomic_load_n(&capture->errors, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&_dio_capture_mutex);
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Stop capturing DIO change events and free the queue.
+ *****************************************************************************/
+int mcc152_dio_event_capture_stop(void)
+{
+    struct mcc152DIOCapture* capture;
+
+    pthread_mutex_lock(&_dio_capture_mutex);
+    capture = _dio_capture;
+    _dio_capture = NULL;
+    if (capture == NULL)
+    {
+        pthread_mutex_unlock(&_dio_capture_mutex);
+        return RESULT_SUCCESS;
+    }
+
+    // wake the readers and wait for them to leave
+    __atomic_store_n(&capture->stopping, true, __ATOMIC_RELEASE);
+    eventfd_write(capture->event_fd, 1);
+    while (capture->readers > 0)
+    {
+        pthread_cond_wait(&_dio_capture_cond, &_dio_capture_mutex);
+    }
+    pthread_mutex_unlock(&_dio_capture_mutex);
+
+    // the handler is not running once it has been removed
+    _interrupt_capture_set(NULL, NULL);
+    close(capture->event_fd);
+    free(capture->events);
+    free(capture);
+
+    return RESULT_SUCCESS;
+}
@@ -7,6 +7,7 @@
 */
 #include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/spi/spidev.h>
@@ -32,6 +33,8 @@
 #define MAX_CHANNEL     1
 #define MAX_CODE        4095
 
+#define DAC_WORD_SIZE   3       // bytes in one DAC command
+
 static const uint8_t spi_mode = SPI_MODE_1;         // use mode 1
                                                     // (CPOL=0, CPHA=1)
 static const uint8_t spi_bits = 8;                  // 8 bits per transfer
@@ -44,17 +47,22 @@ static const uint16_t spi_delay = 0;                // delay in us before
 static int spi_fd[2] = {-1, -1};
 
 /******************************************************************************
-  Perform a SPI transfer to the DAC.
+  Perform a SPI transfer to the DAC.  The data is one or two 3-byte DAC
+  commands; they are sent in a single SPI message with chip select released
+  between them so the DAC latches each one.
  *****************************************************************************/
-static int _mcc152_spi_transfer(uint8_t device, uint8_t address, void* tx_data,
-    uint8_t data_count)
+static int _mcc152_spi_transfer(uint8_t device, uint8_t address,
+    const void* tx_data, uint8_t data_count)
 {
+    struct spi_ioc_transfer tr[2];
     int lock_fd;
     uint8_t temp;
     int ret;
 
     if ((device > 1) ||                     // invalid SPI device
-        (address >= MAX_NUMBER_HATS))       // check address failed
+        (address >= MAX_NUMBER_HATS) ||     // check address failed
+        ((data_count != DAC_WORD_SIZE) &&   // one or two DAC commands
+         (data_count != (2 * DAC_WORD_SIZE))))
     {
         return RESULT_BAD_PARAMETER;
     }    
@@ -90,17 +98,27 @@ static int _mcc152_spi_transfer(uint8_t device, uint8_t address, void* tx_data,
         }
     }
 
-    // Init the spi ioctl structure
-    struct spi_ioc_transfer tr = {
-        .tx_buf = (uintptr_t)tx_data,
-        .rx_buf = (uintptr_t)NULL,
-        .len = data_count,
-        .delay_usecs = spi_delay,
-        .speed_hz = spi_rate,
-        .bits_per_word = spi_bits,
-    };
+    // Init the spi ioctl structures
+    memset(tr, 0, sizeof(tr));
+    tr[0].tx_buf = (uintptr_t)tx_data;
+    tr[0].len = DAC_WORD_SIZE;
+    tr[0].delay_usecs = spi_delay;
+    tr[0].speed_hz = spi_rate;
+    tr[0].bits_per_word = spi_bits;
+    tr[0].cs_change = 1;
+    tr[1] = tr[0];
+    tr[1].tx_buf = (uintptr_t)tx_data + DAC_WORD_SIZE;
+    tr[1].cs_change = 0;
 
-    if ((ret = ioctl(spi_fd[device], SPI_IOC_MESSAGE(1), &tr)) < 1)
+    if (data_count == DAC_WORD_SIZE)
+    {
+        ret = ioctl(spi_fd[device], SPI_IOC_MESSAGE(1), tr);
+    }
+    else
+    {
+        ret = ioctl(spi_fd[device], SPI_IOC_MESSAGE(2), tr);
+    }
+    if (ret < 1)
     {
         ret = RESULT_COMMS_FAILURE;
     }
@@ -153,9 +171,7 @@ int _mcc152_dac_write(uint8_t device, uint8_t address, uint8_t channel,
 int _mcc152_dac_write_both(uint8_t device, uint8_t address, uint16_t code0,
     uint16_t code1)
 {
-    uint8_t data[3];
-    uint16_t value;
-    int result;
+    uint8_t data[MCC152_DAC_FRAME_SIZE];
     
     if ((device > 1) ||                             // invalid SPI device
         (address >= MAX_NUMBER_HATS) ||             // check address failed
@@ -164,21 +180,58 @@ int _mcc152_dac_write_both(uint8_t device, uint8_t address, uint16_t code0,
         return RESULT_BAD_PARAMETER;
     }    
     
-    data[0] = DACCMD_WRITE | DAC_A;
-    value = code0 << 4;
-    data[1] = (uint8_t)(value >> 8);
-    data[2] = (uint8_t)value;
-    result = _mcc152_spi_transfer(device, address, data, 3);
-    if (result != RESULT_SUCCESS)
+    _mcc152_dac_prepare(0x03, code0, code1, data);
+    return _mcc152_spi_transfer(device, address, data, sizeof(data));
+}
+
+/******************************************************************************
+  Build the DAC commands that update the channels in channel_mask, so they can
+  be sent later with _mcc152_dac_write_frame().  A single channel uses one
+  write and load command; both channels use a write to channel A followed by a
+  write to channel B that loads both outputs at the same time.  Returns the
+  number of bytes in the frame.
+ *****************************************************************************/
+uint8_t _mcc152_dac_prepare(uint8_t channel_mask, uint16_t code0,
+    uint16_t code1, uint8_t* frame)
+{
+    uint16_t value;
+
+    if (channel_mask == 0x03)
     {
-        return result;
+        frame[0] = DACCMD_WRITE | DAC_A;
+        value = code0 << 4;
+        frame[1] = (uint8_t)(value >> 8);
+        frame[2] = (uint8_t)value;
+
+        frame[3] = DACCMD_WRITE_LOAD_ALL | DAC_B;
+        value = code1 << 4;
+        frame[4] = (uint8_t)(value >> 8);
+        frame[5] = (uint8_t)value;
+        return MCC152_DAC_FRAME_SIZE;
     }
-    
-    data[0] = DACCMD_WRITE_LOAD_ALL | DAC_B;
-    value = code1 << 4;
-    data[1] = (uint8_t)(value >> 8);
-    data[2] = (uint8_t)value;
-    return _mcc152_spi_transfer(device, address, data, 3);    
+
+    if (channel_mask == 0x01)
+    {
+        frame[0] = DACCMD_WRITE_LOAD | DAC_A;
+        value = code0 << 4;
+    }
+    else
+    {
+        frame[0] = DACCMD_WRITE_LOAD | DAC_B;
+        value = code1 << 4;
+    }
+    frame[1] = (uint8_t)(value >> 8);
+    frame[2] = (uint8_t)value;
+    return DAC_WORD_SIZE;
+}
+
+/******************************************************************************
+  Send a frame built by _mcc152_dac_prepare().
+ *****************************************************************************/
+int _mcc152_dac_write_frame(uint8_t device, uint8_t address,
+    const uint8_t* frame, uint8_t count)
+{
+    return _mcc152_spi_transfer(device, address, frame, count);
 }
 
 /******************************************************************************
@@ -10,12 +10,21 @@
 
 #include <stdint.h>
 
+// The maximum size of a prepared DAC frame (a command for each channel.)
+#define MCC152_DAC_FRAME_SIZE   6
+
 // Write to a single analog output channel.
 int _mcc152_dac_write(uint8_t device, uint8_t address, uint8_t channel, 
     uint16_t code);
 // Write to both channels at once.
 int _mcc152_dac_write_both(uint8_t device, uint8_t address, uint16_t code0, 
     uint16_t code1);
+// Build the commands to update the channels in channel_mask.
+uint8_t _mcc152_dac_prepare(uint8_t channel_mask, uint16_t code0,
+    uint16_t code1, uint8_t* frame);
+// Send a frame built by _mcc152_dac_prepare().
+int _mcc152_dac_write_frame(uint8_t device, uint8_t address,
+    const uint8_t* frame, uint8_t count);
 // Initialize the SPI interface and DAC.
 int _mcc152_dac_init(uint8_t device, uint8_t address);
 
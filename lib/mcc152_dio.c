@@ -6,6 +6,7 @@
 *   05/14/2019
 */
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h>
@@ -36,6 +37,12 @@ struct dio_device
 } dio_devices[MAX_NUMBER_HATS];
 /// \endcond
 
+// Serializes the transfers in this process with last_register, which tracks
+// the register pointer of each I/O expander.  A DIO scan or event capture
+// transfers from its own thread, so without it a read could use the pointer
+// shortcut after another transfer had moved the pointer.
+static pthread_mutex_t _dio_i2c_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /******************************************************************************
   Write data to an I2C device.
  *****************************************************************************/
@@ -112,11 +119,13 @@ static int _mcc152_i2c_write(uint8_t address, uint8_t reg, uint8_t value)
     }    
     addr = I2C_BASE_ADDR + address;
 
-    // Open the I2C device handle - this will block until all other handles are
-    // closed so we don't need a lock mechanism.
+    pthread_mutex_lock(&_dio_i2c_mutex);
+
+    // Open the I2C device handle only for this transfer
     i2c_fd = open(I2C_DEVICE_1, O_RDWR);
     if (i2c_fd < 0)
     {
+        pthread_mutex_unlock(&_dio_i2c_mutex);
         return RESULT_RESOURCE_UNAVAIL;
     }
 
@@ -125,6 +134,7 @@ static int _mcc152_i2c_write(uint8_t address, uint8_t reg, uint8_t value)
     if (ret == -1)
     {
         close(i2c_fd);
+        pthread_mutex_unlock(&_dio_i2c_mutex);
         return RESULT_COMMS_FAILURE;
     }
     
@@ -143,6 +153,7 @@ static int _mcc152_i2c_write(uint8_t address, uint8_t reg, uint8_t value)
     // savings if reading/writing this same register again
     close(i2c_fd);
     dio_devices[address].last_register = reg;
+    pthread_mutex_unlock(&_dio_i2c_mutex);
     
     return ret;
 }
@@ -163,11 +174,13 @@ static int _mcc152_i2c_read(uint8_t address, uint8_t reg, uint8_t* value)
     }    
     addr = I2C_BASE_ADDR + address;
 
-    // Open the I2C device handle - this will block until all other handles are
-    // closed so we don't need a lock mechanism.
+    pthread_mutex_lock(&_dio_i2c_mutex);
+
+    // Open the I2C device handle only for this transfer
     i2c_fd = open(I2C_DEVICE_1, O_RDWR);
     if (i2c_fd < 0)
     {
+        pthread_mutex_unlock(&_dio_i2c_mutex);
         return RESULT_RESOURCE_UNAVAIL;
     }
 
@@ -176,6 +189,7 @@ static int _mcc152_i2c_read(uint8_t address, uint8_t reg, uint8_t* value)
     if (ret == -1)
     {
         close(i2c_fd);
+        pthread_mutex_unlock(&_dio_i2c_mutex);
         return RESULT_COMMS_FAILURE;
     }
     
@@ -204,6 +218,7 @@ static int _mcc152_i2c_read(uint8_t address, uint8_t reg, uint8_t* value)
         ret = RESULT_SUCCESS;
         dio_devices[address].last_register = reg;
     }
+    pthread_mutex_unlock(&_dio_i2c_mutex);
     
     return ret;
 }
@@ -360,3 +375,152 @@ int _mcc152_dio_init(int address)
     return RESULT_SUCCESS;
 }
 
+
+/******************************************************************************
+  Read the interrupt status and input port registers of several boards in one
+  combined I2C transfer.  Reading the input port clears the interrupt.
+ *****************************************************************************/
+int _mcc152_dio_event_read(uint8_t address_mask, uint8_t* status,
+    uint8_t* values)
+{
+    static const uint8_t status_reg = DIO_REG_INT_STATUS;
+    static const uint8_t input_reg = DIO_REG_INPUT_PORT;
+    struct i2c_msg msgs[4 * MAX_NUMBER_HATS];
+    struct i2c_rdwr_ioctl_data rdwr;
+    int i2c_fd;
+    int count;
+    int ret;
+    uint8_t address;
+
+    if ((address_mask == 0) ||
+        (status == NULL) ||
+        (values == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    // for each board write the register pointer and read it back with a
+    // repeated start, first the interrupt status then the input port
+    count = 0;
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        if ((address_mask & (1 << address)) == 0)
+        {
+            continue;
+        }
+
+        msgs[count].addr = I2C_BASE_ADDR + address;
+        msgs[count].flags = 0;
+        msgs[count].len = 1;
+        msgs[count].buf = (uint8_t*)&status_reg;
+        count++;
+        msgs[count].addr = I2C_BASE_ADDR + address;
+        msgs[count].flags = I2C_M_RD;
+        msgs[count].len = 1;
+        msgs[count].buf = &status[address];
+        count++;
+        msgs[count].addr = I2C_BASE_ADDR + address;
+        msgs[count].flags = 0;
+        msgs[count].len = 1;
+        msgs[count].buf = (uint8_t*)&input_reg;
+        count++;
+        msgs[count].addr = I2C_BASE_ADDR + address;
+        msgs[count].flags = I2C_M_RD;
+        msgs[count].len = 1;
+        msgs[count].buf = &values[address];
+        count++;
+    }
+
+    pthread_mutex_lock(&_dio_i2c_mutex);
+    i2c_fd = open(I2C_DEVICE_1, O_RDWR);
+    if (i2c_fd < 0)
+    {
+        pthread_mutex_unlock(&_dio_i2c_mutex);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    rdwr.msgs = msgs;
+    rdwr.nmsgs = count;
+    ret = ioctl(i2c_fd, I2C_RDWR, &rdwr);
+    close(i2c_fd);
+
+    // a failed transfer may have stopped part way, so the pointer is unknown
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        if (address_mask & (1 << address))
+        {
+            dio_devices[address].last_register = (ret < 0) ? 0xFF :
+                DIO_REG_INPUT_PORT;
+        }
+    }
+    pthread_mutex_unlock(&_dio_i2c_mutex);
+
+    if (ret < 0)
+    {
+        return RESULT_COMMS_FAILURE;
+    }
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Open a bus handle for _mcc152_dio_write_frame().  The handle is kept open
+  for the duration of a scan so each update is a single ioctl().
+ *****************************************************************************/
+int _mcc152_dio_open(void)
+{
+    return open(I2C_DEVICE_1, O_RDWR);
+}
+
+/******************************************************************************
+  Close a bus handle opened with _mcc152_dio_open().
+ *****************************************************************************/
+void _mcc152_dio_close(int handle)
+{
+    if (handle >= 0)
+    {
+        close(handle);
+    }
+}
+
+/******************************************************************************
+  Build the register write that sets the output port to value.
+ *****************************************************************************/
+void _mcc152_dio_prepare(uint8_t value, uint8_t* frame)
+{
+    frame[0] = DIO_REG_OUTPUT_PORT;
+    frame[1] = value;
+}
+
+/******************************************************************************
+  Send a frame built by _mcc152_dio_prepare() on an open bus handle.
+ *****************************************************************************/
+int _mcc152_dio_write_frame(int handle, uint8_t address, const uint8_t* frame)
+{
+    struct i2c_msg msg;
+    struct i2c_rdwr_ioctl_data rdwr;
+
+    if (address >= MAX_NUMBER_HATS)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    msg.addr = I2C_BASE_ADDR + address;
+    msg.flags = 0;
+    msg.len = MCC152_DIO_FRAME_SIZE;
+    msg.buf = (uint8_t*)frame;
+    rdwr.msgs = &msg;
+    rdwr.nmsgs = 1;
+    pthread_mutex_lock(&_dio_i2c_mutex);
+    if (ioctl(handle, I2C_RDWR, &rdwr) < 0)
+    {
+        dio_devices[address].last_register = 0xFF;
+        pthread_mutex_unlock(&_dio_i2c_mutex);
+        return RESULT_COMMS_FAILURE;
+    }
+
+    // keep the cache in step with the port
+    dio_devices[address].output_port = frame[1];
+    dio_devices[address].last_register = frame[0];
+    pthread_mutex_unlock(&_dio_i2c_mutex);
+    return RESULT_SUCCESS;
+}
@@ -26,6 +26,9 @@
 #define DIO_REG_INT_STATUS          0x46
 #define DIO_REG_OUTPUT_CONFIG       0x4F
 
+// The size of a prepared output port write (register and value.)
+#define MCC152_DIO_FRAME_SIZE       2
+
 // Initialize the DIO interface.
 int _mcc152_dio_init(int address);
 // Read a DIO register.
@@ -34,5 +37,16 @@ int _mcc152_dio_reg_read(uint8_t address, uint8_t reg, uint8_t channel,
 // Write a DIO register.
 int _mcc152_dio_reg_write(uint8_t address, uint8_t reg, uint8_t channel,
     uint8_t value, bool use_cache);
+// Read the interrupt status and input port of several boards in one transfer.
+int _mcc152_dio_event_read(uint8_t address_mask, uint8_t* status,
+    uint8_t* values);
+// Open a bus handle for writing prepared frames.
+int _mcc152_dio_open(void);
+// Close a bus handle.
+void _mcc152_dio_close(int handle);
+// Build the write that sets the output port.
+void _mcc152_dio_prepare(uint8_t value, uint8_t* frame);
+// Send a frame built by _mcc152_dio_prepare().
+int _mcc152_dio_write_frame(int handle, uint8_t address, const uint8_t* frame);
 
 #endif
\ No newline at end of file
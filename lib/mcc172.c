@@ -16,6 +16,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <sys/eventfd.h>
 #include <linux/spi/spidev.h>
 #include "daqhats.h"
 #include "util.h"
@@ -143,32 +144,54 @@ struct mcc172FactoryData
     double offsets[NUM_CHANNELS];
 };
 
+// Converts a block of raw scan data to double precision.
+typedef void (*mcc172IngestKernel)(const uint8_t* raw, double* buffer,
+    uint32_t count, const double* gains, const double* biases);
+
 // Local data for analog input scans
 struct mcc172ScanThreadInfo
 {
+    // Set at scan start, read-only while the scan runs
     pthread_t handle;
     double* scan_buffer;
     uint32_t buffer_size;
-    volatile uint32_t write_index;
-    volatile uint32_t read_index;
-    volatile uint32_t samples_transferred;
-    volatile uint32_t buffer_depth;
-
     uint16_t read_threshold;
     uint16_t options;
+    uint8_t channel_count;
+    uint8_t channels[NUM_CHANNELS];
+    double slopes[NUM_CHANNELS];
+    double offsets[NUM_CHANNELS];
+    double scale_factors[NUM_CHANNELS];
+    mcc172IngestKernel ingest;
+    double gains[NUM_CHANNELS];
+    double biases[NUM_CHANNELS];
+    uint8_t* raw_buffer;
+
+    // Written by the scan thread (raw_depth is also reduced by the conversion
+    // thread)
+    CACHE_ALIGNED volatile uint32_t write_index;
+    volatile uint32_t samples_transferred;
+    volatile uint32_t raw_depth;
+    uint64_t samples_discarded;     // overwritten by OPTS_OVERWRITE
     volatile bool hw_overrun;
     volatile bool buffer_overrun;
     volatile bool thread_started;
     volatile bool thread_running;
-    bool stop_thread;
     bool triggered;
     volatile bool scan_running;
-    uint8_t channel_count;
+    bool convert_stop;
+    pthread_cond_t convert_cond;
+
+    // Written by the conversion thread (buffer_depth is also reduced by reads)
+    CACHE_ALIGNED uint32_t convert_index;
+    volatile uint32_t buffer_depth;
     uint8_t channel_index;
-    uint8_t channels[NUM_CHANNELS];
-    double slopes[NUM_CHANNELS];
-    double offsets[NUM_CHANNELS];
-    double scale_factors[NUM_CHANNELS];
+
+    // Written by the reading thread
+    CACHE_ALIGNED volatile uint32_t read_index;
+    bool stop_thread;
+    int event_fd;
+    uint32_t event_threshold;
 };
 
 // Local data for each open MCC 172 board.
@@ -197,6 +220,7 @@ struct mcc172Device
 
 static struct mcc172Device* _devices[MAX_NUMBER_HATS];
 static bool _mcc172_lib_initialized = false;
+static pthread_once_t _mcc172_lib_once = PTHREAD_ONCE_INIT;
 
 static const char* const spi_device = SPI_DEVICE_0; // the spidev device
 static const uint8_t spi_mode = SPI_MODE_1;         // use mode 1 (CPOL=0,
@@ -229,88 +253,37 @@ static bool _check_addr(uint8_t address)
 }
 
 /******************************************************************************
-  Parse a buffer and look for a valid message
+  Locate a reply frame for command in a buffer.  The frame normally starts at
+  the first byte, so the header is checked in place; memchr() is only used to
+  resynchronize when it does not.
  *****************************************************************************/
-static bool _parse_buffer(uint8_t* buffer, uint16_t length,
-    uint16_t* frame_start, uint16_t* frame_length, uint16_t* remaining)
+static bool _parse_buffer(const uint8_t* buffer, uint16_t length,
+    uint8_t command, uint16_t* frame_start, uint16_t* frame_length)
 {
-    uint8_t* ptr = buffer;
-    uint16_t index;
-    bool found_frame;
-    int parse_state = 0;
+    const uint8_t* ptr = buffer;
+    const uint8_t* end = buffer + length;
     uint16_t data_count;
-    uint16_t data_index;
-    uint16_t _remaining;
-    uint16_t _frame_length;
-    uint16_t _frame_start;
-
-    found_frame = false;
-    _remaining = 0;
-    _frame_length = 0;
-    _frame_start = 0;
-    data_index = 0;
-    data_count = 0;
 
-    for (index = 0; (index < length) && !found_frame; index++)
+    while ((ptr != NULL) && ((end - ptr) >= MSG_RX_HEADER_SIZE))
     {
-        switch (parse_state)
+        if ((ptr[MSG_RX_INDEX_START] == MSG_START) &&
+            (ptr[MSG_RX_INDEX_COMMAND] == command))
         {
-        case 0: // looking for start
-            if (MSG_START == ptr[index])
-            {
-                _frame_start = index;
-                data_count = 0;
-                data_index = 0;
-                parse_state++;
-            }
-            break;
-        case 1: // command
-            parse_state++;
-            break;
-        case 2: // status
-            parse_state++;
-            break;
-        case 3: // count low
-            data_count = ptr[index];
-            parse_state++;
-            break;
-        case 4: // count high
-            data_count |= (uint16_t)ptr[index] << 8;
-            if (data_count == 0)
-            {
-                _remaining = 0;
-                found_frame = true;
-                _frame_length = MSG_RX_HEADER_SIZE;
-                parse_state = 6;
-            }
-            else
+            data_count = ptr[MSG_RX_INDEX_COUNT_LOW] |
+                ((uint16_t)ptr[MSG_RX_INDEX_COUNT_HIGH] << 8);
+            if ((end - ptr) < (MSG_RX_HEADER_SIZE + data_count))
             {
-                _remaining = data_count;// + 1;
-                parse_state++;
+                // incomplete
+                return false;
             }
-            break;
-        case 5: // data
-            _remaining--;
-            if (++data_index >= data_count)
-            {
-                parse_state++;
-                found_frame = true;
-                _frame_length = data_count + MSG_RX_HEADER_SIZE;
-            }
-            break;
-        case 6: // message is complete
-            break;
-        default:
-            parse_state = 0;
-            break;
+            *frame_start = (uint16_t)(ptr - buffer);
+            *frame_length = MSG_RX_HEADER_SIZE + data_count;
+            return true;
         }
+        ptr = memchr(ptr + 1, MSG_START, end - ptr - 1);
     }
 
-    *remaining = _remaining;
-    *frame_length = _frame_length;
-    *frame_start = _frame_start;
-
-    return found_frame;
+    return false;
 }
 
 /******************************************************************************
@@ -430,8 +403,9 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
     // read the reply
     uint16_t frame_start = 0;
     uint16_t frame_length;
-    uint16_t remaining = 0;
     uint16_t read_amount = rx_data_count + MSG_RX_HEADER_SIZE;
+    struct spi_ioc_transfer segments[3];
+    bool in_place = false;
 
     // only read the first byte of the reply in order to test for the device
     // readiness
@@ -466,14 +440,68 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
 
     if (got_reply)
     {
-        // read the rest of the reply
-        tr.tx_buf = (uintptr_t)NULL;
+        // Read the rest of the reply in one transaction.  The frame starts
+        // at the byte that signaled the reply was ready, so the rest of the
+        // header goes to rx_buffer and the payload straight to rx_data; the
+        // trailing byte lands where it would in a contiguous read.
+        memset(segments, 0, sizeof(segments));
+        segments[0] = tr;
+        segments[0].rx_buf = (uintptr_t)&dev->rx_buffer[1];
+        segments[0].len = MSG_RX_HEADER_SIZE - 1;
+        segments[1] = tr;
+        segments[1].rx_buf =
+            (uintptr_t)&dev->rx_buffer[MSG_RX_HEADER_SIZE + rx_data_count];
+        segments[1].len = 1;
+        if (rx_data_count > 0)
+        {
+            segments[2] = segments[1];
+            segments[1].rx_buf = (uintptr_t)rx_data;
+            segments[1].len = rx_data_count;
+            ret = ioctl(dev->spi_fd, SPI_IOC_MESSAGE(3), segments);
+        }
+        else
+        {
+            ret = ioctl(dev->spi_fd, SPI_IOC_MESSAGE(2), segments);
+        }
 
-        int read_start = 1;
-        int total_read = 1;
+        int read_start = read_amount + 1;
+        int total_read = read_amount + 1;
 
         got_reply = false;
-        do
+        if (ret >= 1)
+        {
+            if ((dev->rx_buffer[MSG_RX_INDEX_START] == MSG_START) &&
+                (dev->rx_buffer[MSG_RX_INDEX_COMMAND] == command) &&
+                (dev->rx_buffer[MSG_RX_INDEX_COUNT_LOW] ==
+                    (uint8_t)rx_data_count) &&
+                (dev->rx_buffer[MSG_RX_INDEX_COUNT_HIGH] ==
+                    (uint8_t)(rx_data_count >> 8)))
+            {
+                // the payload is already in place
+                got_reply = true;
+                in_place = true;
+            }
+            else
+            {
+                // resynchronize on the contiguous reply
+                if (rx_data_count > 0)
+                {
+                    memcpy(&dev->rx_buffer[MSG_RX_INDEX_DATA], rx_data,
+                        rx_data_count);
+                }
+                got_reply = _parse_buffer(dev->rx_buffer, total_read, command,
+                    &frame_start, &frame_length);
+            }
+        }
+        else
+        {
+            read_start = 1;
+            total_read = 1;
+        }
+
+        tr.tx_buf = (uintptr_t)NULL;
+        while (!got_reply && !timeout &&
+               ((read_start + read_amount) < MAX_SPI_TRANSFER))
         {
             tr.rx_buf = (uintptr_t)&dev->rx_buffer[read_start];
             tr.len = read_amount;
@@ -484,8 +512,8 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
                 read_start += read_amount;
 
                 // parse the reply
-                got_reply = _parse_buffer(dev->rx_buffer, total_read,
-                    &frame_start, &frame_length, &remaining);
+                got_reply = _parse_buffer(dev->rx_buffer, total_read, command,
+                    &frame_start, &frame_length);
             }
             else
             {
@@ -495,8 +523,7 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
             clock_gettime(CLOCK_MONOTONIC, &current_time);
             diff = _difftime_us(&start_time, &current_time);
             timeout = (diff > reply_timeout_us);
-        } while (!got_reply && !timeout &&
-                 ((read_start + read_amount) < MAX_SPI_TRANSFER));
+        }
     }
 
     if (!got_reply)
@@ -512,7 +539,7 @@ static int _spi_transfer(uint8_t address, uint8_t command, void* tx_data,
         switch (dev->rx_buffer[frame_start+MSG_RX_INDEX_STATUS])
         {
         case FW_RES_SUCCESS:
-            if (rx_data_count > 0)
+            if ((rx_data_count > 0) && !in_place)
             {
                 memcpy(rx_data, &dev->rx_buffer[frame_start+MSG_RX_INDEX_DATA],
                     rx_data_count);
@@ -716,110 +743,303 @@ static int _parse_factory_data(cJSON* root, struct mcc172FactoryData* data)
 /******************************************************************************
   Perform any library initialization.
  *****************************************************************************/
-static void _mcc172_lib_init(void)
+static void _mcc172_lib_init_once(void)
 {
     int i;
 
-    if (!_mcc172_lib_initialized)
+    for (i = 0; i < MAX_NUMBER_HATS; i++)
+    {
+        _devices[i] = NULL;
+    }
+
+    _mcc172_lib_initialized = true;
+}
+
+/******************************************************************************
+  Perform the library initialization once, even when boards are opened from
+  several threads at the same time.
+ *****************************************************************************/
+static void _mcc172_lib_init(void)
+{
+    pthread_once(&_mcc172_lib_once, &_mcc172_lib_init_once);
+}
+
+/******************************************************************************
+  Convert a 24-bit big-endian sample to signed 32-bit.
+ *****************************************************************************/
+static inline int32_t _decode_sample(const uint8_t* ptr)
+{
+    // place the sample in the upper bits and sign extend with a shift
+    return (int32_t)(((uint32_t)ptr[0] << 24) |
+        ((uint32_t)ptr[1] << 16) |
+        ((uint32_t)ptr[2] << 8)) >> 8;
+}
+
+/******************************************************************************
+  Scan data ingest kernels.  The calibration, sensitivity and scaling selected
+  by the scan options are folded into one gain and bias per channel when the
+  scan starts, and a kernel is chosen for the channel count so the per-sample
+  work is a single multiply-add with no option tests or channel index
+  bookkeeping.  The kernels convert whole scans (count is a multiple of the
+  channel count.)
+ *****************************************************************************/
+static inline void _ingest_scans(const uint8_t* raw, double* buffer,
+    uint32_t count, uint8_t channel_count, const double* gains,
+    const double* biases)
+{
+    uint32_t index;
+    uint8_t channel;
+
+    // channel_count is a constant in each caller so this loop is unrolled
+    for (index = 0; index < count; index += channel_count)
     {
-        for (i = 0; i < MAX_NUMBER_HATS; i++)
+        for (channel = 0; channel < channel_count; channel++)
         {
-            _devices[i] = NULL;
+            buffer[index + channel] = ((double)_decode_sample(
+                &raw[(index + channel) * SAMPLE_SIZE_BYTES]) *
+                gains[channel]) + biases[channel];
         }
+    }
+}
+
+#define INGEST_KERNEL(n) \
+static void _ingest_##n(const uint8_t* raw, double* buffer, uint32_t count, \
+    const double* gains, const double* biases) \
+{ \
+    _ingest_scans(raw, buffer, count, n, gains, biases); \
+}
+
+INGEST_KERNEL(1)
+INGEST_KERNEL(2)
+
+// Kernel for OPTS_NOSCALEDATA | OPTS_NOCALIBRATEDATA, independent of the
+// channel count.
+static void _ingest_raw(const uint8_t* raw, double* buffer, uint32_t count,
+    const double* gains, const double* biases)
+{
+    uint32_t index;
 
-        _mcc172_lib_initialized = true;
+    (void)gains;
+    (void)biases;
+    for (index = 0; index < count; index++)
+    {
+        buffer[index] = (double)_decode_sample(&raw[index * SAMPLE_SIZE_BYTES]);
     }
 }
 
+static const mcc172IngestKernel _ingest_kernels[NUM_CHANNELS] =
+{
+    _ingest_1, _ingest_2
+};
+
 /******************************************************************************
-  Read the specified number of samples of scan data as double precision.
+  Compute the per-channel gains and biases for the scan options and select the
+  ingest kernel.  Called at scan start after the channel list is saved.
  *****************************************************************************/
-static int _a_in_read_scan_data(uint8_t address, uint16_t sample_count,
-    bool scaled, bool calibrated, double* buffer)
+static void _select_ingest_kernel(struct mcc172ScanThreadInfo* info)
 {
-    uint16_t count;
-    int ret;
-    struct mcc172Device* dev;
-    uint8_t* rx_data;
-    uint8_t* ptr;
-    int32_t value;
+    uint8_t index;
+    bool calibrated = (info->options & OPTS_NOCALIBRATEDATA) == 0;
+    bool scaled = (info->options & OPTS_NOSCALEDATA) == 0;
 
-    if (!_check_addr(address) ||
-        (buffer == NULL))
+    for (index = 0; index < info->channel_count; index++)
     {
-        return RESULT_BAD_PARAMETER;
+        info->gains[index] = 1.0;
+        info->biases[index] = 0.0;
+
+        if (calibrated)
+        {
+            // (value - offset) * slope
+            info->gains[index] = info->slopes[index];
+            info->biases[index] = -info->offsets[index] * info->slopes[index];
+        }
+
+        if (scaled)
+        {
+            // apply sensitivity and LSB size
+            info->gains[index] *= info->scale_factors[index];
+            info->biases[index] *= info->scale_factors[index];
+        }
     }
 
-    dev = _devices[address];
+    if (!calibrated && !scaled)
+    {
+        info->ingest = _ingest_raw;
+    }
+    else
+    {
+        info->ingest = _ingest_kernels[info->channel_count - 1];
+    }
+}
 
-    rx_data = (uint8_t*)calloc(1, sample_count * SAMPLE_SIZE_BYTES);
-    if (rx_data == NULL)
+/******************************************************************************
+  Read the specified number of samples of raw scan data.
+ *****************************************************************************/
+static int _a_in_read_scan_data(uint8_t address, uint16_t sample_count,
+    uint8_t* raw)
+{
+    if (!_check_addr(address) ||
+        (raw == NULL))
     {
-        return RESULT_RESOURCE_UNAVAIL;
+        return RESULT_BAD_PARAMETER;
     }
 
     // send the read scan data command
-    ret = _spi_transfer(address, CMD_AINSCANDATA, &sample_count, 2, rx_data,
+    return _spi_transfer(address, CMD_AINSCANDATA, &sample_count, 2, raw,
         sample_count*SAMPLE_SIZE_BYTES, 40*MSEC, 1);
+}
 
-    if (ret != RESULT_SUCCESS)
-    {
-        free(rx_data);
-        return ret;
-    }
+/******************************************************************************
+  Convert raw scan data to double precision.
+ *****************************************************************************/
+static void _convert_scan_data(struct mcc172ScanThreadInfo* info,
+    const uint8_t* raw, uint32_t sample_count, double* buffer)
+{
+    uint32_t count;
+    uint32_t scan_count;
 
-    ptr = rx_data;
-    for (count = 0; count < sample_count; count++)
+    // finish a scan that was split by the previous read
+    count = 0;
+    while ((info->channel_index != 0) && (count < sample_count))
     {
-        // convert 24-bit value to signed 32-bit
-        if (ptr[0] & 0x80)
-        {
-            value = 0xFF000000 |
-                ((uint32_t)ptr[0] << 16) |
-                ((uint32_t)ptr[1] << 8)  |
-                ptr[2];
-        }
-        else
+        buffer[count] = ((double)_decode_sample(
+            &raw[count * SAMPLE_SIZE_BYTES]) *
+            info->gains[info->channel_index]) +
+            info->biases[info->channel_index];
+        count++;
+        info->channel_index++;
+        if (info->channel_index >= info->channel_count)
         {
-            value = 0x00000000 |
-                ((uint32_t)ptr[0] << 16) |
-                ((uint32_t)ptr[1] << 8)  |
-                ptr[2];
+            info->channel_index = 0;
         }
-        ptr += SAMPLE_SIZE_BYTES;
+    }
 
-        buffer[count] = (double)value;
+    // convert the complete scans
+    scan_count = ((sample_count - count) / info->channel_count) *
+        info->channel_count;
+    info->ingest(&raw[count * SAMPLE_SIZE_BYTES], &buffer[count],
+        scan_count, info->gains, info->biases);
+    count += scan_count;
 
-        if (calibrated)
-        {
-            // apply the appropriate cal factors to each sample in the list
+    // start of a scan that will be completed by the next read
+    for (; count < sample_count; count++)
+    {
+        buffer[count] = ((double)_decode_sample(
+            &raw[count * SAMPLE_SIZE_BYTES]) *
+            info->gains[info->channel_index]) +
+            info->biases[info->channel_index];
+        info->channel_index++;
+    }
+}
 
-            // remove offset error
-            buffer[count] -= dev->scan_info->offsets[
-                dev->scan_info->channel_index];
+/******************************************************************************
+  Make room for new data in a flight recorder scan (OPTS_OVERWRITE) by
+  discarding the oldest whole scans.  Returns false if the data can't fit,
+  which is a buffer overrun.  Must be called with scan_mutex held.
+ *****************************************************************************/
+static bool _discard_oldest(struct mcc172ScanThreadInfo* info)
+{
+    uint32_t count;
 
-            // remove gain error
-            buffer[count] *= dev->scan_info->slopes[
-                dev->scan_info->channel_index];
-        }
+    if ((info->options & OPTS_OVERWRITE) == 0)
+    {
+        return false;
+    }
 
-        // convert to volts if desired
-        if (scaled)
+    // keep the oldest data at the start of a scan
+    count = info->raw_depth + info->buffer_depth - info->buffer_size;
+    count = ((count + info->channel_count - 1) / info->channel_count) *
+        info->channel_count;
+    if (count > info->buffer_depth)
+    {
+        return false;
+    }
+
+    info->read_index += count;
+    if (info->read_index >= info->buffer_size)
+    {
+        info->read_index -= info->buffer_size;
+    }
+    info->buffer_depth -= count;
+    info->samples_discarded += count;
+    return true;
+}
+
+/******************************************************************************
+  Signal the scan event descriptor if enough data is available or the scan
+  thread has finished.  Must be called with scan_mutex held.
+ *****************************************************************************/
+static void _signal_scan_event(struct mcc172ScanThreadInfo* info)
+{
+    if ((info->event_fd != -1) &&
+        (!info->thread_running ||
+         (info->buffer_depth >= info->event_threshold)))
+    {
+        eventfd_write(info->event_fd, 1);
+    }
+}
+
+/******************************************************************************
+  Convert the raw samples waiting in the raw ring and make them available to
+  readers.  Must be called with scan_mutex held; the mutex is released while
+  converting.
+ *****************************************************************************/
+static void _convert_pending(uint8_t address,
+    struct mcc172ScanThreadInfo* info)
+{
+    uint32_t index;
+    uint32_t count;
+
+    while (info->raw_depth > 0)
+    {
+        // convert up to the end of the ring
+        index = info->convert_index;
+        count = info->raw_depth;
+        if ((info->buffer_size - index) < count)
         {
-            // apply sensitivity and LSB size
-            buffer[count] *= dev->scan_info->scale_factors[
-                dev->scan_info->channel_index];
+            count = info->buffer_size - index;
         }
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
 
-        dev->scan_info->channel_index++;
-        if (dev->scan_info->channel_index >= dev->scan_info->channel_count)
+        _convert_scan_data(info,
+            &info->raw_buffer[index * SAMPLE_SIZE_BYTES], count,
+            &info->scan_buffer[index]);
+
+        pthread_mutex_lock(&_devices[address]->scan_mutex);
+        info->convert_index += count;
+        if (info->convert_index >= info->buffer_size)
         {
-            dev->scan_info->channel_index = 0;
+            info->convert_index = 0;
         }
+        info->raw_depth -= count;
+        info->buffer_depth += count;
+        _signal_scan_event(info);
     }
+}
 
-    free(rx_data);
-    return RESULT_SUCCESS;
+/******************************************************************************
+  Converts the raw samples read by the scan thread so the time spent on
+  conversion does not delay servicing the device.
+ *****************************************************************************/
+static void* _convert_thread(void* arg)
+{
+    uint8_t address = *(uint8_t*)arg;
+    struct mcc172ScanThreadInfo* info = _devices[address]->scan_info;
+
+    free(arg);
+
+    pthread_mutex_lock(&_devices[address]->scan_mutex);
+    while (true)
+    {
+        _convert_pending(address, info);
+        if (info->convert_stop)
+        {
+            break;
+        }
+        pthread_cond_wait(&info->convert_cond, &_devices[address]->scan_mutex);
+    }
+    pthread_mutex_unlock(&_devices[address]->scan_mutex);
+    return NULL;
 }
 
 /******************************************************************************
@@ -836,12 +1056,13 @@ static void* _scan_thread(void* arg)
     uint32_t status_count;
     uint8_t address = *(uint8_t*)arg;
     struct mcc172ScanThreadInfo* info = _devices[address]->scan_info;
-    bool calibrated;
-    bool scaled;
     bool stop_thread;
     uint8_t rx_buffer[5];
     bool scan_running;
     int result;
+    pthread_t converter;
+    bool converter_started;
+    uint8_t* converter_arg;
 
     free(arg);
 
@@ -859,22 +1080,22 @@ static void* _scan_thread(void* arg)
 
     status_count = 0;
 
-    if (info->options & OPTS_NOSCALEDATA)
-    {
-        scaled = false;
-    }
-    else
-    {
-        scaled = true;
-    }
-
-    if (info->options & OPTS_NOCALIBRATEDATA)
+    // start the conversion thread
+    pthread_cond_init(&info->convert_cond, NULL);
+    converter_started = false;
+    converter_arg = (uint8_t*)malloc(sizeof(uint8_t));
+    if (converter_arg != NULL)
     {
-        calibrated = false;
-    }
-    else
-    {
-        calibrated = true;
+        *converter_arg = address;
+        if (pthread_create(&converter, NULL, _convert_thread,
+            converter_arg) == 0)
+        {
+            converter_started = true;
+        }
+        else
+        {
+            free(converter_arg);
+        }
     }
 
 #define MIN_SLEEP_US	100
@@ -942,9 +1163,8 @@ static void* _scan_thread(void* arg)
                     }
 
                     if ((error = _a_in_read_scan_data(address, read_count,
-                        scaled, calibrated,
-                        &info->scan_buffer[info->write_index])) ==
-                        RESULT_SUCCESS)
+                        &info->raw_buffer[info->write_index *
+                        SAMPLE_SIZE_BYTES])) == RESULT_SUCCESS)
                     {
                         info->write_index += read_count;
                         if (info->write_index >= info->buffer_size)
@@ -952,19 +1172,27 @@ static void* _scan_thread(void* arg)
                             info->write_index = 0;
                         }
 
+                        // pass the data to the conversion thread, or convert
+                        // it here if that thread could not be started
                         pthread_mutex_lock(&_devices[address]->scan_mutex);
-                        info->buffer_depth += read_count;
-                        pthread_mutex_unlock(&_devices[address]->scan_mutex);
-
-                        if (info->buffer_depth > info->buffer_size)
+                        info->raw_depth += read_count;
+                        if (((info->raw_depth + info->buffer_depth) >
+                            info->buffer_size) && !_discard_oldest(info))
                         {
-                            pthread_mutex_lock(&_devices[address]->scan_mutex);
                             info->buffer_overrun = true;
                             info->scan_running = false;
-                            pthread_mutex_unlock(
-                                &_devices[address]->scan_mutex);
                             done = true;
                         }
+                        if (converter_started)
+                        {
+                            pthread_cond_signal(&info->convert_cond);
+                        }
+                        else
+                        {
+                            _convert_pending(address, info);
+                        }
+                        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+
                         info->samples_transferred += read_count;
                     }
 
@@ -1010,8 +1238,20 @@ static void* _scan_thread(void* arg)
         mcc172_a_in_scan_stop(address);
     }
 
+    // let the conversion thread finish the remaining data
+    if (converter_started)
+    {
+        pthread_mutex_lock(&_devices[address]->scan_mutex);
+        info->convert_stop = true;
+        pthread_cond_signal(&info->convert_cond);
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+        pthread_join(converter, NULL);
+    }
+    pthread_cond_destroy(&info->convert_cond);
+
     pthread_mutex_lock(&_devices[address]->scan_mutex);
     info->thread_running = false;
+    _signal_scan_event(info);
     pthread_mutex_unlock(&_devices[address]->scan_mutex);
     return NULL;
 }
@@ -1088,25 +1328,37 @@ int mcc172_open(uint8_t address)
                 dev->reset_polarity = 0;
             }
 
-            // convert the JSON custom data to parameters
-            cJSON* root = cJSON_Parse(custom_data);
-            if (root == NULL)
+            // use the cached factory data if it matches the EEPROM,
+            // otherwise convert the JSON custom data to parameters
+            if (!_factory_cache_load(address, HAT_ID_MCC_172, custom_data,
+                custom_size, &dev->factory_data,
+                sizeof(dev->factory_data)))
             {
-                // error parsing the JSON data
-                _set_defaults(&dev->factory_data);
-                printf("Warning - address %d using factory EEPROM default "
-                    "values\n", address);
-            }
-            else
-            {
-                if (!_parse_factory_data(root, &dev->factory_data))
+                cJSON* root = cJSON_Parse(custom_data);
+                if (root == NULL)
                 {
-                    // invalid custom data, use default values
+                    // error parsing the JSON data
                     _set_defaults(&dev->factory_data);
                     printf("Warning - address %d using factory EEPROM default "
                         "values\n", address);
                 }
-                cJSON_Delete(root);
+                else
+                {
+                    if (!_parse_factory_data(root, &dev->factory_data))
+                    {
+                        // invalid custom data, use default values
+                        _set_defaults(&dev->factory_data);
+                        printf("Warning - address %d using factory EEPROM "
+                            "default values\n", address);
+                    }
+                    else
+                    {
+                        _factory_cache_store(address, HAT_ID_MCC_172,
+                            custom_data, custom_size, &dev->factory_data,
+                            sizeof(dev->factory_data));
+                    }
+                    cJSON_Delete(root);
+                }
             }
 
             free(custom_data);
@@ -1648,15 +1900,16 @@ int mcc172_a_in_scan_start(uint8_t address, uint8_t channel_mask,
         return RESULT_BUSY;
     }
 
-    dev->scan_info = (struct mcc172ScanThreadInfo*)calloc(
-        sizeof(struct mcc172ScanThreadInfo), 1);
-    if (dev->scan_info == NULL)
+    // the scan is published in dev->scan_info once it is complete
+    info = (struct mcc172ScanThreadInfo*)_aligned_calloc(
+        sizeof(struct mcc172ScanThreadInfo));
+    if (info == NULL)
     {
         return RESULT_RESOURCE_UNAVAIL;
     }
 
-    info = dev->scan_info;
     info->options = (uint16_t)options;
+    info->event_fd = -1;
 
     num_channels = 0;
     for (channel = 0; channel < NUM_CHANNELS; channel++)
@@ -1678,6 +1931,7 @@ int mcc172_a_in_scan_start(uint8_t address, uint8_t channel_mask,
     }
     info->channel_count = num_channels;
     info->channel_index = 0;
+    _select_ingest_kernel(info);
 
     // Read the clock config, wait until in sync
     int count = 0;
@@ -1688,7 +1942,6 @@ int mcc172_a_in_scan_start(uint8_t address, uint8_t channel_mask,
         if (result != RESULT_SUCCESS)
         {
             free(info);
-            dev->scan_info = NULL;
             return result;
         }
 
@@ -1738,15 +1991,16 @@ int mcc172_a_in_scan_start(uint8_t address, uint8_t channel_mask,
 
     info->buffer_size *= num_channels;
 
-    // allocate the buffer
-    info->scan_buffer = (double*)calloc(1, info->buffer_size * sizeof(double));
+    // allocate the buffer, followed by the raw data ring of the same length
+    info->scan_buffer = (double*)_aligned_calloc(
+        info->buffer_size * (sizeof(double) + SAMPLE_SIZE_BYTES));
     if (info->scan_buffer == NULL)
     {
         // can't allocate memory
         free(info);
-        dev->scan_info = NULL;
         return RESULT_RESOURCE_UNAVAIL;
     }
+    info->raw_buffer = (uint8_t*)&info->scan_buffer[info->buffer_size];
 
     // Set the device read threshold based on the scan rate - read data
     // every 100ms or faster.
@@ -1767,7 +2021,6 @@ int mcc172_a_in_scan_start(uint8_t address, uint8_t channel_mask,
     {
         free(info->scan_buffer);
         free(info);
-        dev->scan_info = NULL;
         return RESULT_RESOURCE_UNAVAIL;
     }
 
@@ -1806,12 +2059,16 @@ int mcc172_a_in_scan_start(uint8_t address, uint8_t channel_mask,
         pthread_attr_destroy(&attr);
         free(info->scan_buffer);
         free(info);
-        dev->scan_info = NULL;
         return result;
     }
 
     info->thread_started = false;
 
+    // publish the scan for the scan thread and the other scan functions
+    pthread_mutex_lock(&dev->scan_mutex);
+    dev->scan_info = info;
+    pthread_mutex_unlock(&dev->scan_mutex);
+
     // create the scan data thread
     uint8_t* temp_address = (uint8_t*)malloc(sizeof(uint8_t));
     *temp_address = address;
@@ -1820,10 +2077,12 @@ int mcc172_a_in_scan_start(uint8_t address, uint8_t channel_mask,
     {
         free(temp_address);
         mcc172_a_in_scan_stop(address);
+        pthread_mutex_lock(&dev->scan_mutex);
+        dev->scan_info = NULL;
+        pthread_mutex_unlock(&dev->scan_mutex);
         pthread_attr_destroy(&attr);
         free(info->scan_buffer);
         free(info);
-        dev->scan_info = NULL;
         return RESULT_RESOURCE_UNAVAIL;
     }
 
@@ -1879,6 +2138,63 @@ int mcc172_a_in_scan_channel_count(uint8_t address)
     return _devices[address]->scan_info->channel_count;
 }
 
+/******************************************************************************
+  Return an event descriptor that becomes readable when the requested amount
+  of scan data is available or the scan thread ends.
+ *****************************************************************************/
+int mcc172_a_in_scan_event_enable(uint8_t address,
+    uint32_t samples_per_channel, int* fd)
+{
+    struct mcc172ScanThreadInfo* info;
+
+    if (!_check_addr(address) ||
+        (fd == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if (samples_per_channel == 0)
+    {
+        samples_per_channel = 1;
+    }
+
+    pthread_mutex_lock(&_devices[address]->scan_mutex);
+    if ((info = _devices[address]->scan_info) == NULL)
+    {
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if (info->options & OPTS_OVERWRITE)
+    {
+        // a flight recorder buffer is always full, so the event would never
+        // reset
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if (info->event_fd == -1)
+    {
+        info->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (info->event_fd == -1)
+        {
+            pthread_mutex_unlock(&_devices[address]->scan_mutex);
+            return RESULT_RESOURCE_UNAVAIL;
+        }
+    }
+
+    // a threshold larger than the buffer could never be reached
+    info->event_threshold = MIN(samples_per_channel * info->channel_count,
+        info->buffer_size);
+
+    // signal right away if the condition is already met
+    _signal_scan_event(info);
+    *fd = info->event_fd;
+    pthread_mutex_unlock(&_devices[address]->scan_mutex);
+
+    return RESULT_SUCCESS;
+}
+
 /******************************************************************************
   Read the scan status and amount of data in the scan buffer.
  *****************************************************************************/
@@ -1951,16 +2267,19 @@ int mcc172_a_in_scan_status(uint8_t address, uint16_t* status,
   Read the specified amount of data from the scan buffer.  If
   samples_per_channel == -1, return all available samples.  If timeout is
   negative, wait indefinitely.  If it is 0,  return immediately with the
-  available data.
+  available data.  The data is stored as described by layout; a layout with
+  no planes and a sample_stride of 0 stores the data interleaved by channel.
  *****************************************************************************/
-int mcc172_a_in_scan_read(uint8_t address, uint16_t* status,
-    int32_t samples_per_channel, double timeout, double* buffer,
-    uint32_t buffer_size_samples, uint32_t* samples_read_per_channel)
+static int _a_in_scan_read(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout,
+    const struct ScanLayout* layout, uint32_t* samples_read_per_channel)
 {
+    struct ScanLayout dest;
     uint32_t samples_to_read;
     uint32_t samples_read;
     uint32_t current_read;
     uint32_t max_read;
+    uint32_t buffer_frames;
     bool no_timeout;
     bool timed_out;
     bool error;
@@ -1979,7 +2298,8 @@ int mcc172_a_in_scan_read(uint8_t address, uint16_t* status,
     if (!_check_addr(address) ||
         (status == NULL) ||
         ((samples_per_channel > 0) &&
-        ((buffer == NULL) || (buffer_size_samples == 0))))
+        (((layout->buffer == NULL) && (layout->planes == NULL)) ||
+         (layout->buffer_size == 0))))
     {
         return RESULT_BAD_PARAMETER;
     }
@@ -2011,6 +2331,17 @@ int mcc172_a_in_scan_read(uint8_t address, uint16_t* status,
         return RESULT_RESOURCE_UNAVAIL;
     }
 
+    if (info->options & OPTS_OVERWRITE)
+    {
+        // flight recorder data is only read with a snapshot
+        *status = 0;
+        if (samples_read_per_channel)
+        {
+            samples_read_per_channel[0] = 0;
+        }
+        return RESULT_BAD_PARAMETER;
+    }
+
     // get thread values
     pthread_mutex_lock(&_devices[address]->scan_mutex);
     buffer_depth = info->buffer_depth;
@@ -2034,12 +2365,20 @@ int mcc172_a_in_scan_read(uint8_t address, uint16_t* status,
         samples_to_read = samples_per_channel * info->channel_count;
     }
 
-    if (buffer_size_samples < samples_to_read)
+    dest = *layout;
+    if ((dest.planes == NULL) && (dest.sample_stride == 0))
+    {
+        // interleaved
+        dest.sample_stride = info->channel_count;
+        dest.channel_stride = 1;
+    }
+
+    buffer_frames = _scan_layout_frames(&dest, info->channel_count);
+    if ((buffer_frames * info->channel_count) < samples_to_read)
     {
         // buffer is not large enough, so read the amount of samples that will
         // fit
-        samples_to_read = COUNT_NORMALIZE(buffer_size_samples,
-            info->channel_count);
+        samples_to_read = buffer_frames * info->channel_count;
     }
 
     if (samples_to_read)
@@ -2071,20 +2410,23 @@ int mcc172_a_in_scan_read(uint8_t address, uint16_t* status,
                 if (max_read < current_read)
                 {
                     // when wrapping, perform two copies
-                    memcpy(&buffer[samples_read],
+                    _scan_copy(&dest, samples_read / info->channel_count,
                         &info->scan_buffer[info->read_index],
-                        max_read*sizeof(double));
+                        max_read / info->channel_count, info->channel_count);
                     samples_read += max_read;
-                    memcpy(&buffer[samples_read], &info->scan_buffer[0],
-                        (current_read - max_read)*sizeof(double));
+                    _scan_copy(&dest, samples_read / info->channel_count,
+                        &info->scan_buffer[0],
+                        (current_read - max_read) / info->channel_count,
+                        info->channel_count);
                     samples_read += (current_read - max_read);
                     info->read_index = (current_read - max_read);
                 }
                 else
                 {
-                    memcpy(&buffer[samples_read],
+                    _scan_copy(&dest, samples_read / info->channel_count,
                         &info->scan_buffer[info->read_index],
-                        current_read*sizeof(double));
+                        current_read / info->channel_count,
+                        info->channel_count);
                     samples_read += current_read;
                     info->read_index += current_read;
                     if (info->read_index >= info->buffer_size)
@@ -2165,6 +2507,293 @@ int mcc172_a_in_scan_read(uint8_t address, uint16_t* status,
     }
 }
 
+/******************************************************************************
+  Read scan data interleaved by channel.
+ *****************************************************************************/
+int mcc172_a_in_scan_read(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* buffer,
+    uint32_t buffer_size_samples, uint32_t* samples_read_per_channel)
+{
+    struct ScanLayout layout = {buffer, NULL, buffer_size_samples, 0, 0};
+
+    return _a_in_scan_read(address, status, samples_per_channel, timeout,
+        &layout, samples_read_per_channel);
+}
+
+/******************************************************************************
+  Read scan data into a strided destination.
+ *****************************************************************************/
+int mcc172_a_in_scan_read_strided(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* buffer,
+    uint32_t buffer_size_samples, uint32_t sample_stride,
+    uint32_t channel_stride, uint32_t* samples_read_per_channel)
+{
+    struct ScanLayout layout = {buffer, NULL, buffer_size_samples,
+        sample_stride, channel_stride};
+
+    if ((sample_stride == 0) ||
+        (channel_stride == 0))
+    {
+        if (samples_read_per_channel)
+        {
+            *samples_read_per_channel = 0;
+        }
+        return RESULT_BAD_PARAMETER;
+    }
+
+    return _a_in_scan_read(address, status, samples_per_channel, timeout,
+        &layout, samples_read_per_channel);
+}
+
+/******************************************************************************
+  Read scan data into a separate buffer for each channel.
+ *****************************************************************************/
+int mcc172_a_in_scan_read_planar(uint8_t address, uint16_t* status,
+    int32_t samples_per_channel, double timeout, double* const* buffers,
+    uint32_t buffer_size_samples, uint32_t* samples_read_per_channel)
+{
+    struct ScanLayout layout = {NULL, buffers, buffer_size_samples, 0, 0};
+    int channel_count;
+    int channel;
+
+    if (buffers != NULL)
+    {
+        // every channel in the scan needs a buffer
+        channel_count = mcc172_a_in_scan_channel_count(address);
+        for (channel = 0; channel < channel_count; channel++)
+        {
+            if (buffers[channel] == NULL)
+            {
+                if (samples_read_per_channel)
+                {
+                    *samples_read_per_channel = 0;
+                }
+                return RESULT_BAD_PARAMETER;
+            }
+        }
+    }
+
+    return _a_in_scan_read(address, status, samples_per_channel, timeout,
+        &layout, samples_read_per_channel);
+}
+
+/******************************************************************************
+  Return a pointer to the oldest unread data in the scan buffer and the number
+  of samples per channel that can be read there without wrapping.  The data is
+  not removed from the scan buffer until mcc172_a_in_scan_consume() is called.
+ *****************************************************************************/
+int mcc172_a_in_scan_peek(uint8_t address, const double** data,
+    uint32_t* samples_per_channel)
+{
+    struct mcc172ScanThreadInfo* info;
+    uint32_t available;
+
+    if (!_check_addr(address) ||
+        (data == NULL) ||
+        (samples_per_channel == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    // the scan may be started from another thread
+    pthread_mutex_lock(&_devices[address]->scan_mutex);
+    if ((info = _devices[address]->scan_info) == NULL)
+    {
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+        *data = NULL;
+        *samples_per_channel = 0;
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if (info->options & OPTS_OVERWRITE)
+    {
+        pthread_mutex_unlock(&_devices[address]->scan_mutex);
+        *data = NULL;
+        *samples_per_channel = 0;
+        return RESULT_BAD_PARAMETER;
+    }
+
+    // stop at the end of the scan buffer
+    available = MIN(info->buffer_depth, info->buffer_size - info->read_index);
+
+    *data = &info->scan_buffer[info->read_index];
+    *samples_per_channel = available / info->channel_count;
+    pthread_mutex_unlock(&_devices[address]->scan_mutex);
+
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Remove data returned by mcc172_a_in_scan_peek() from the scan buffer.
+ *****************************************************************************/
+int mcc172_a_in_scan_consume(uint8_t address, uint32_t samples_per_channel)
+{
+    struct mcc172ScanThreadInfo* info;
+    uint32_t count;
+    int result;
+
+    if (!_check_addr(address))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if ((info = _devices[address]->scan_info) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if (info->options & OPTS_OVERWRITE)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    count = samples_per_channel * info->channel_count;
+
+    pthread_mutex_lock(&_devices[address]->scan_mutex);
+    if ((count > info->buffer_depth) ||
+        (count > (info->buffer_size - info->read_index)))
+    {
+        result = RESULT_BAD_PARAMETER;
+    }
+    else
+    {
+        info->read_index += count;
+        if (info->read_index >= info->buffer_size)
+        {
+            info->read_index = 0;
+        }
+        info->buffer_depth -= count;
+        result = RESULT_SUCCESS;
+    }
+    pthread_mutex_unlock(&_devices[address]->scan_mutex);
+
+    return result;
+}
+
+/******************************************************************************
+  Copy the most recent data of a flight recorder scan (OPTS_OVERWRITE)
+  without removing it from the scan buffer.
+ *****************************************************************************/
+int mcc172_a_in_scan_snapshot(uint8_t address, double* buffer,
+    uint32_t buffer_size_samples, uint32_t* samples_per_channel,
+    uint64_t* first_sample)
+{
+    struct mcc172ScanThreadInfo* info;
+    uint32_t scans;
+    uint32_t count;
+    uint32_t skip;
+    uint32_t index;
+    uint32_t first;
+
+    if (!_check_addr(address) ||
+        (buffer == NULL) ||
+        (samples_per_channel == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+    *samples_per_channel = 0;
+
+    if ((info = _devices[address]->scan_info) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if ((info->options & OPTS_OVERWRITE) == 0)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    // The scan thread can't discard data while the mutex is held, and the
+    // conversion thread only writes outside the retained data, so the copy is
+    // consistent.
+    pthread_mutex_lock(&_devices[address]->scan_mutex);
+    scans = info->buffer_depth / info->channel_count;
+    count = MIN(scans, buffer_size_samples / info->channel_count);
+    skip = (scans - count) * info->channel_count;
+    count *= info->channel_count;
+
+    index = info->read_index + skip;
+    if (index >= info->buffer_size)
+    {
+        index -= info->buffer_size;
+    }
+    first = MIN(count, info->buffer_size - index);
+    memcpy(buffer, &info->scan_buffer[index], first * sizeof(double));
+    memcpy(&buffer[first], info->scan_buffer, (count - first) * sizeof(double));
+
+    if (first_sample)
+    {
+        *first_sample = (info->samples_discarded + skip) /
+            info->channel_count;
+    }
+    pthread_mutex_unlock(&_devices[address]->scan_mutex);
+
+    *samples_per_channel = count / info->channel_count;
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Write the retained data of a flight recorder scan to a file.
+ *****************************************************************************/
+int mcc172_a_in_scan_snapshot_file(uint8_t address, const char* path,
+    uint32_t* samples_per_channel, uint64_t* first_sample)
+{
+    struct mcc172ScanThreadInfo* info;
+    double* buffer;
+    FILE* file;
+    uint32_t count;
+    size_t samples;
+    int result;
+
+    if (!_check_addr(address) ||
+        (path == NULL))
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    if ((info = _devices[address]->scan_info) == NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    if ((buffer = (double*)malloc(info->buffer_size * sizeof(double))) ==
+        NULL)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    count = 0;
+    result = mcc172_a_in_scan_snapshot(address, buffer, info->buffer_size,
+        &count, first_sample);
+    if (result == RESULT_SUCCESS)
+    {
+        // write after the copy so the file system can't hold up the scan
+        samples = (size_t)count * info->channel_count;
+        if ((file = fopen(path, "wb")) == NULL)
+        {
+            result = RESULT_RESOURCE_UNAVAIL;
+        }
+        else
+        {
+            if (fwrite(buffer, sizeof(double), samples, file) != samples)
+            {
+                result = RESULT_RESOURCE_UNAVAIL;
+            }
+            if (fclose(file) != 0)
+            {
+                result = RESULT_RESOURCE_UNAVAIL;
+            }
+        }
+    }
+    free(buffer);
+
+    if (samples_per_channel)
+    {
+        *samples_per_channel = (result == RESULT_SUCCESS) ? count : 0;
+    }
+    return result;
+}
+
 /******************************************************************************
   Stop a running scan by sending the scan stop command to the device.  The
   thread will  detect that the scan has stopped and terminate gracefully.
@@ -2207,6 +2836,10 @@ int mcc172_a_in_scan_cleanup(uint8_t address)
             _devices[address]->scan_info->handle = 0;
         }
 
+        if (_devices[address]->scan_info->event_fd != -1)
+        {
+            close(_devices[address]->scan_info->event_fd);
+        }
         free(_devices[address]->scan_info->scan_buffer);
         free(_devices[address]->scan_info);
         _devices[address]->scan_info = NULL;
@@ -2352,14 +2985,26 @@ int mcc172_open_for_update(uint8_t address)
                 dev->reset_polarity = 0;
             }
 
-            // convert the JSON custom data to parameters
-            cJSON* root = cJSON_Parse(custom_data);
-            if (!_parse_factory_data(root, &dev->factory_data))
+            // use the cached factory data if it matches the EEPROM,
+            // otherwise convert the JSON custom data to parameters
+            if (!_factory_cache_load(address, HAT_ID_MCC_172, custom_data,
+                custom_size, &dev->factory_data,
+                sizeof(dev->factory_data)))
             {
-                // invalid custom data, use default values
-                _set_defaults(&dev->factory_data);
+                cJSON* root = cJSON_Parse(custom_data);
+                if (!_parse_factory_data(root, &dev->factory_data))
+                {
+                    // invalid custom data, use default values
+                    _set_defaults(&dev->factory_data);
+                }
+                else
+                {
+                    _factory_cache_store(address, HAT_ID_MCC_172, custom_data,
+                        custom_size, &dev->factory_data,
+                        sizeof(dev->factory_data));
+                }
+                cJSON_Delete(root);
             }
-            cJSON_Delete(root);
 
             free(custom_data);
         }
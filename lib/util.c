@@ -15,6 +15,8 @@
 #include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <semaphore.h>
 #include "daqhats.h"
 #include "util.h"
@@ -54,6 +56,10 @@
 #define SIGNATURE       0x69502D52  // "R-Pi" in ASCII
 #define FORMAT_VERSION  0x01
 
+// Factory data cache file constants
+#define FACTORY_CACHE_MAGIC     0x4643434D  // "MCCF" in ASCII
+#define FACTORY_CACHE_VERSION   1
+
 // Board address GPIO pin numbers
 #define ADDR0_GPIO              12
 #define ADDR1_GPIO              13
@@ -81,6 +87,18 @@ struct _Atom
     uint16_t crc16;
 };
 
+// Factory data cache file header, followed by the board's factory data
+// struct
+struct _FactoryCacheHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t id;            // product ID
+    uint32_t size;          // size of the factory data struct
+    uint32_t checksum;      // FNV-1a of the factory data
+    uint64_t key;           // FNV-1a of the EEPROM custom data
+};
+
 // Vendor info atom data
 struct _VendorInfo
 {
@@ -112,6 +130,7 @@ static const char* const BOARD_LOCKFILES[] =
 };
 
 static const char* const HAT_SETTINGS_DIR = "/etc/mcc/hats";
+static const char* const FACTORY_CACHE_FILE = "%s/factory_%d.bin";
 static const char* const SYS_HAT_DIR = "/proc/device-tree/hat";
 static const char* const VENDOR_NAME = "Measurement Computing Corp.";
 
@@ -138,6 +157,47 @@ static int board_lockfiles[MAX_NUMBER_HATS];
 static pthread_mutex_t spi_mutex;
 static pthread_mutex_t board_mutex[MAX_NUMBER_HATS];
 
+// hat_batch_begin() nesting depth for the calling thread; while non-zero the
+// thread holds the SPI lock and _obtain_lock() / _release_lock() do nothing
+static __thread int spi_batch_depth = 0;
+// the address on the address pins, only valid while the SPI lock is held
+static int spi_selected_address = -1;
+
+// interrupt consumers; the GPIO interrupt thread calls _interrupt_handler()
+// which forwards to the user callback and / or the event descriptor
+static pthread_mutex_t interrupt_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void (*interrupt_function)(void*) = NULL;
+static void* interrupt_data = NULL;
+static int interrupt_event_fd = -1;
+// internal handler (MCC 152 DIO event capture), called before the user
+// callback
+static void (*interrupt_capture_function)(void*) = NULL;
+static void* interrupt_capture_data = NULL;
+
+// Discovery cache: the parsed board info and custom data for each address,
+// shared by hat_list() and _hat_info() so repeated listing and opening does
+// not read and parse the EEPROM files again.  _hat_cache_proc holds address 0
+// from /proc/device-tree/hat, _hat_cache[] the files in /etc/mcc/hats.
+struct _HatCacheEntry
+{
+    bool loaded;                // the source has been read
+    bool valid;                 // the EEPROM header is valid
+    bool is_mcc;                // the vendor is MCC; info is filled in
+    bool exists;                // the file existed when it was read
+    struct timespec mtime;      // file identity when it was read
+    off_t size;
+    ino_t inode;
+    struct HatInfo info;
+    char* custom;               // null terminated JSON custom data
+    uint16_t custom_size;       // not including the null
+};
+
+static pthread_mutex_t _hat_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct _HatCacheEntry _hat_cache_proc;
+static struct _HatCacheEntry _hat_cache[MAX_NUMBER_HATS];
+static int _hat_cache_inotify = -1;
+static int _hat_cache_watch = -1;
+
 // *****************************************************************************
 // Local Functions
 
@@ -203,6 +263,325 @@ void _lock_fini(void)
     }
 }
 
+/******************************************************************************
+  Read a text file from the device tree into buffer, null terminated.
+ *****************************************************************************/
+static bool _read_text_file(const char* name, char* buffer, size_t size)
+{
+    char filename[256];
+    ssize_t count;
+    int fd;
+
+    sprintf(filename, "%s/%s", SYS_HAT_DIR, name);
+    if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) == -1)
+    {
+        return false;
+    }
+    count = read(fd, buffer, size - 1);
+    close(fd);
+    if (count <= 0)
+    {
+        return false;
+    }
+    buffer[count] = '\0';
+    return true;
+}
+
+/******************************************************************************
+  Free the data held by a cache entry.
+ *****************************************************************************/
+static void _hat_cache_clear(struct _HatCacheEntry* entry)
+{
+    free(entry->custom);
+    memset(entry, 0, sizeof(*entry));
+}
+
+/******************************************************************************
+  Load the board info for address 0 from /proc/device-tree/hat.  The OS reads
+  the EEPROM at boot, so this does not change while the system is running.
+ *****************************************************************************/
+static void _hat_cache_load_proc(struct _HatCacheEntry* entry)
+{
+    char filename[256];
+    char temp[257];
+    struct stat filestat;
+    ssize_t count;
+    size_t length;
+    int fd;
+
+    _hat_cache_clear(entry);
+    entry->loaded = true;
+
+    if (!_read_text_file("vendor", temp, sizeof(temp)) ||
+        (strcmp(temp, VENDOR_NAME) != 0) ||
+        !_read_text_file("product_id", temp, sizeof(temp)))
+    {
+        return;
+    }
+
+    entry->valid = true;
+    entry->is_mcc = true;
+    entry->info.address = 0;
+    entry->info.id = (uint16_t)strtoul(temp, NULL, 16);
+    if (_read_text_file("product_ver", temp, sizeof(temp)))
+    {
+        entry->info.version = (uint16_t)strtoul(temp, NULL, 16);
+    }
+    if (_read_text_file("product", temp, sizeof(temp)))
+    {
+        length = strlen(temp);
+        if (length >= sizeof(entry->info.product_name))
+        {
+            length = sizeof(entry->info.product_name) - 1;
+        }
+        memcpy(entry->info.product_name, temp, length);
+        entry->info.product_name[length] = '\0';
+    }
+
+    // the custom data
+    sprintf(filename, "%s/custom_0", SYS_HAT_DIR);
+    if ((stat(filename, &filestat) == 0) &&
+        (filestat.st_size > 0) &&
+        (filestat.st_size < UINT16_MAX) &&
+        ((entry->custom = (char*)malloc(filestat.st_size + 1)) != NULL))
+    {
+        count = 0;
+        if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) != -1)
+        {
+            count = read(fd, entry->custom, filestat.st_size);
+            close(fd);
+        }
+        entry->custom_size = (count > 0) ? count : 0;
+        entry->custom[entry->custom_size] = '\0';
+    }
+}
+
+/******************************************************************************
+  Load the board info for an address from the EEPROM file in /etc/mcc/hats.
+  The whole file is read at once and parsed in memory.
+ *****************************************************************************/
+static void _hat_cache_load_file(uint8_t address,
+    struct _HatCacheEntry* entry)
+{
+    char filename[256];
+    struct stat filestat;
+    struct _Header header;
+    struct _Atom atom;
+    struct _VendorInfo vinf;
+    uint8_t* buffer;
+    uint8_t* ptr;
+    uint8_t* end;
+    uint16_t atom_num;
+    int fd;
+
+    _hat_cache_clear(entry);
+    entry->loaded = true;
+
+    sprintf(filename, "%s/eeprom_%d.bin", HAT_SETTINGS_DIR, address);
+    if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) == -1)
+    {
+        return;
+    }
+    if (fstat(fd, &filestat) != 0)
+    {
+        close(fd);
+        return;
+    }
+    entry->exists = true;
+    entry->mtime = filestat.st_mtim;
+    entry->size = filestat.st_size;
+    entry->inode = filestat.st_ino;
+
+    if ((filestat.st_size < HEADER_SIZE) ||
+        ((buffer = (uint8_t*)malloc(filestat.st_size)) == NULL))
+    {
+        close(fd);
+        return;
+    }
+    if (read(fd, buffer, filestat.st_size) != filestat.st_size)
+    {
+        free(buffer);
+        close(fd);
+        return;
+    }
+    close(fd);
+
+    // check the header
+    memcpy(&header, buffer, HEADER_SIZE);
+    if ((header.signature != SIGNATURE) ||
+        (header.ver != FORMAT_VERSION) ||
+        (header.numatoms < 1))
+    {
+        free(buffer);
+        return;
+    }
+    entry->valid = true;
+
+    // process the atoms by type
+    ptr = buffer + HEADER_SIZE;
+    end = buffer + filestat.st_size;
+    for (atom_num = 0;
+        (atom_num < header.numatoms) &&
+        ((end - ptr) >= (ATOM_SIZE - CRC_SIZE));
+        atom_num++)
+    {
+        memcpy(&atom, ptr, ATOM_SIZE - CRC_SIZE);
+        ptr += ATOM_SIZE - CRC_SIZE;
+        if ((atom.dlen < CRC_SIZE) ||
+            (atom.dlen > (uint32_t)(end - ptr)))
+        {
+            break;
+        }
+
+        if ((atom.type == ATOM_VENDOR_TYPE) &&
+            (atom.dlen >= VENDOR_SIZE + CRC_SIZE))
+        {
+            memcpy(&vinf, ptr, VENDOR_SIZE);
+            if (((uint32_t)VENDOR_SIZE + vinf.vslen + vinf.pslen + CRC_SIZE <=
+                    atom.dlen) &&
+                (vinf.vslen == strlen(VENDOR_NAME)) &&
+                (memcmp(ptr + VENDOR_SIZE, VENDOR_NAME, vinf.vslen) == 0))
+            {
+                // valid vendor, save the info
+                entry->is_mcc = true;
+                entry->info.address = address;
+                entry->info.id = vinf.pid;
+                entry->info.version = vinf.pver;
+                memcpy(entry->info.product_name,
+                    ptr + VENDOR_SIZE + vinf.vslen, vinf.pslen);
+                entry->info.product_name[vinf.pslen] = '\0';
+            }
+        }
+        else if ((atom.type == ATOM_CUSTOM_TYPE) &&
+            (entry->custom == NULL) &&
+            ((entry->custom = (char*)malloc(atom.dlen - CRC_SIZE + 1)) !=
+                NULL))
+        {
+            // the JSON custom data
+            entry->custom_size = atom.dlen - CRC_SIZE;
+            memcpy(entry->custom, ptr, entry->custom_size);
+            entry->custom[entry->custom_size] = '\0';
+        }
+        ptr += atom.dlen;
+    }
+
+    free(buffer);
+}
+
+/******************************************************************************
+  Check whether the EEPROM file for an address differs from the cached copy.
+ *****************************************************************************/
+static bool _hat_cache_stale(uint8_t address,
+    const struct _HatCacheEntry* entry)
+{
+    char filename[256];
+    struct stat filestat;
+
+    sprintf(filename, "%s/eeprom_%d.bin", HAT_SETTINGS_DIR, address);
+    if (stat(filename, &filestat) != 0)
+    {
+        return entry->exists;
+    }
+    return (!entry->exists ||
+        (filestat.st_mtim.tv_sec != entry->mtime.tv_sec) ||
+        (filestat.st_mtim.tv_nsec != entry->mtime.tv_nsec) ||
+        (filestat.st_size != entry->size) ||
+        (filestat.st_ino != entry->inode));
+}
+
+/******************************************************************************
+  Bring the discovery cache up to date.  Must be called with
+  _hat_cache_mutex held.
+
+  Changes to /etc/mcc/hats are detected with inotify, so an unchanged cache
+  costs one non-blocking read.  If the directory can't be watched (it does not
+  exist yet, or inotify is not available) each file is checked with stat()
+  instead.
+ *****************************************************************************/
+static void _hat_cache_refresh(void)
+{
+    char events[4096] __attribute__((aligned(__alignof__(
+        struct inotify_event))));
+    const struct inotify_event* event;
+    char* ptr;
+    bool changed;
+    bool watched;
+    ssize_t count;
+    uint8_t address;
+
+    if (!_hat_cache_proc.loaded)
+    {
+        _hat_cache_load_proc(&_hat_cache_proc);
+    }
+
+    if (_hat_cache_inotify == -1)
+    {
+        _hat_cache_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+    if ((_hat_cache_inotify != -1) && (_hat_cache_watch == -1))
+    {
+        // watch before loading so no change is missed
+        _hat_cache_watch = inotify_add_watch(_hat_cache_inotify,
+            HAT_SETTINGS_DIR, IN_CREATE | IN_DELETE | IN_MODIFY |
+            IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+            IN_DELETE_SELF | IN_MOVE_SELF);
+        if (_hat_cache_watch != -1)
+        {
+            for (address = 0; address < MAX_NUMBER_HATS; address++)
+            {
+                _hat_cache[address].loaded = false;
+            }
+        }
+    }
+
+    watched = (_hat_cache_watch != -1);
+    if (watched)
+    {
+        // a change to any EEPROM file reloads all of them; other files in
+        // the directory (such as the factory data cache) are ignored
+        changed = false;
+        while ((count = read(_hat_cache_inotify, events, sizeof(events))) > 0)
+        {
+            for (ptr = events; ptr < events + count;
+                ptr += sizeof(struct inotify_event) + event->len)
+            {
+                event = (const struct inotify_event*)ptr;
+                if (event->mask &
+                    (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+                {
+                    // the directory is gone; fall back to stat() until it
+                    // returns
+                    inotify_rm_watch(_hat_cache_inotify, _hat_cache_watch);
+                    _hat_cache_watch = -1;
+                    changed = true;
+                }
+                else if ((event->len == 0) ||
+                    (event->mask & IN_Q_OVERFLOW) ||
+                    (strncmp(event->name, "eeprom_", 7) == 0))
+                {
+                    changed = true;
+                }
+            }
+        }
+        if (changed)
+        {
+            for (address = 0; address < MAX_NUMBER_HATS; address++)
+            {
+                _hat_cache[address].loaded = false;
+            }
+        }
+    }
+
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        if (!_hat_cache[address].loaded ||
+            (!watched && _hat_cache_stale(address, &_hat_cache[address])))
+        {
+            _hat_cache_load_file(address, &_hat_cache[address]);
+        }
+    }
+}
+
 // *****************************************************************************
 // Global Functions
 
@@ -227,8 +606,10 @@ void __attribute__ ((destructor)) fini(void)
  *****************************************************************************/
 void _set_address(uint8_t address)
 {
-    if (address < MAX_NUMBER_HATS)
+    if ((address < MAX_NUMBER_HATS) &&
+        (address != spi_selected_address))
     {
+        spi_selected_address = address;
         gpio_write(ADDR0_GPIO, address & 0x01);
         gpio_write(ADDR1_GPIO, address & 0x02);
         gpio_write(ADDR2_GPIO, address & 0x04);
@@ -270,6 +651,130 @@ uint32_t _difftime_ms(struct timespec* start, struct timespec* end)
         return (uint32_t)diff;
 }
 
+/******************************************************************************
+  Allocate zeroed memory aligned to a cache line.  Release with free().
+ *****************************************************************************/
+void* _aligned_calloc(size_t size)
+{
+    void* ptr;
+
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0)
+    {
+        return NULL;
+    }
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+/******************************************************************************
+  Return the number of whole scan frames (one sample from each channel) that fit
+  in a scan read destination.
+ *****************************************************************************/
+uint32_t _scan_layout_frames(const struct ScanLayout* layout,
+    uint8_t channel_count)
+{
+    uint32_t last_channel;
+
+    if (channel_count == 0)
+    {
+        return 0;
+    }
+
+    if (layout->planes != NULL)
+    {
+        // each channel has its own buffer
+        return layout->buffer_size;
+    }
+
+    if (layout->sample_stride == 0)
+    {
+        return 0;
+    }
+
+    last_channel = (channel_count - 1) * layout->channel_stride;
+    if (layout->buffer_size <= last_channel)
+    {
+        return 0;
+    }
+
+    return ((layout->buffer_size - 1 - last_channel) / layout->sample_stride) +
+        1;
+}
+
+/******************************************************************************
+  Copy frame_count interleaved scan frames from src to a scan read destination,
+  starting at frame first_frame of the destination.
+
+  De-interleaving is done as a blocked transpose: a block of frames small
+  enough to stay in the L1 cache is read once per channel and written
+  sequentially to that channel's destination, so neither side strides through
+  memory that is not already cached.
+ *****************************************************************************/
+void _scan_copy(const struct ScanLayout* layout, uint32_t first_frame,
+    const double* src, uint32_t frame_count, uint8_t channel_count)
+{
+    uint32_t frame;
+    uint32_t block;
+    uint32_t block_frames;
+    uint8_t channel;
+    const double* in;
+    double* out;
+    uint32_t out_stride;
+
+    if ((layout->planes == NULL) && (layout->channel_stride == 1))
+    {
+        out = &layout->buffer[first_frame * layout->sample_stride];
+        if (layout->sample_stride == channel_count)
+        {
+            // interleaved destination, a single block copy
+            memcpy(out, src, frame_count * channel_count * sizeof(double));
+        }
+        else
+        {
+            // rows of a wider frame, copy each row
+            for (frame = 0; frame < frame_count; frame++)
+            {
+                memcpy(&out[frame * layout->sample_stride],
+                    &src[frame * channel_count],
+                    channel_count * sizeof(double));
+            }
+        }
+        return;
+    }
+
+    for (block = 0; block < frame_count; block += SCAN_COPY_BLOCK_FRAMES)
+    {
+        block_frames = frame_count - block;
+        if (block_frames > SCAN_COPY_BLOCK_FRAMES)
+        {
+            block_frames = SCAN_COPY_BLOCK_FRAMES;
+        }
+
+        for (channel = 0; channel < channel_count; channel++)
+        {
+            in = &src[block * channel_count + channel];
+            if (layout->planes != NULL)
+            {
+                out = &layout->planes[channel][first_frame + block];
+                out_stride = 1;
+            }
+            else
+            {
+                out = &layout->buffer[(first_frame + block) *
+                    layout->sample_stride + channel * layout->channel_stride];
+                out_stride = layout->sample_stride;
+            }
+
+            for (frame = 0; frame < block_frames; frame++)
+            {
+                *out = *in;
+                out += out_stride;
+                in += channel_count;
+            }
+        }
+    }
+}
+
 /******************************************************************************
   Control access to the SPI bus by multiple processes.
 
@@ -297,6 +802,12 @@ int _obtain_lock(void)
     struct timespec current_time;
     int test;
 
+    if (spi_batch_depth > 0)
+    {
+        // a batch in this thread already holds the lock
+        return spi_lockfile;
+    }
+
     // Block until lock obtained, but allow context switching with usleep().
     // Time out after 5 seconds
     locked = false;
@@ -328,6 +839,10 @@ int _obtain_lock(void)
     // use a mutex as well
     pthread_mutex_lock(&spi_mutex);
 
+    // another process may have changed the address pins since we last held
+    // the lock
+    spi_selected_address = -1;
+
     return spi_lockfile;
 }
 
@@ -430,11 +945,57 @@ int _obtain_board_lock(uint8_t address)
  *****************************************************************************/
 void _release_lock(int lock_fd)
 {
+    if (spi_batch_depth > 0)
+    {
+        // released by hat_batch_end()
+        return;
+    }
+
     flock(lock_fd, LOCK_UN);
     pthread_mutex_unlock(&spi_mutex);
 }
 
 
+/******************************************************************************
+  Start a command batch.  The calling thread holds the SPI lock until the
+  matching hat_batch_end(), so the board functions it calls in between run
+  back to back without other threads or processes accessing the bus.
+ *****************************************************************************/
+int hat_batch_begin(void)
+{
+    if (spi_batch_depth > 0)
+    {
+        spi_batch_depth++;
+        return RESULT_SUCCESS;
+    }
+
+    if (_obtain_lock() < 0)
+    {
+        return RESULT_LOCK_TIMEOUT;
+    }
+
+    spi_batch_depth = 1;
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  End a command batch and release the SPI lock.
+ *****************************************************************************/
+int hat_batch_end(void)
+{
+    if (spi_batch_depth == 0)
+    {
+        return RESULT_BAD_PARAMETER;
+    }
+
+    spi_batch_depth--;
+    if (spi_batch_depth == 0)
+    {
+        _release_lock(spi_lockfile);
+    }
+    return RESULT_SUCCESS;
+}
+
 /******************************************************************************
   Release a previously obtained board lock.
  *****************************************************************************/
@@ -451,164 +1012,110 @@ void _release_board_lock(uint8_t address)
  *****************************************************************************/
 int hat_list(uint16_t filter_id, struct HatInfo* pList)
 {
-    //struct HatInfo* entry;
+    const struct _HatCacheEntry* entry;
     uint8_t address;
-    char filename[256];
-    char temp[256];
-    char* ptr;
-    int eeprom_fd;
-    uint8_t count;
-    struct _Header header;
-    struct _Atom atom;
-    struct _VendorInfo vinf;
-    uint16_t id;
-    uint16_t pver;
+    int count;
 
     count = 0;
 
-    // EEPROM 0 will always use the built-in OS support to prevent caching info
-    // for a single board that is swapped out (such as during manufacturing
-    // test.)
-
-    sprintf(filename, "%s/vendor", SYS_HAT_DIR);
-    // open vendor file and compare against VENDOR_NAME
-    eeprom_fd = -1;
-    if (((eeprom_fd = open(filename, O_RDONLY)) != -1) &&
-        (read(eeprom_fd, &temp, 256) > 0) &&
-        (strcmp(temp, VENDOR_NAME) == 0))
-    {
-        // match, so read the pid
-        close(eeprom_fd);
-        eeprom_fd = -1;
-        sprintf(filename, "%s/product_id", SYS_HAT_DIR);
-        if (((eeprom_fd = open(filename, O_RDONLY)) != -1) &&
-            (read(eeprom_fd, &temp, 256) > 0))
+    pthread_mutex_lock(&_hat_cache_mutex);
+    _hat_cache_refresh();
+
+    // EEPROM 0 will always use the built-in OS support rather than a copied
+    // file, so a single board that is swapped out (such as during
+    // manufacturing test) is not reported from stale data.  Boards 1-7 will be
+    // supported with the read_eeproms utility that copies the EEPROM contents
+    // to /etc/mcc/hats
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        entry = (address == 0) ? &_hat_cache_proc : &_hat_cache[address];
+        if (entry->is_mcc &&
+            ((filter_id == 0) || (entry->info.id == filter_id)))
         {
-            // convert string to int
-            id = (uint16_t)strtoul(temp, &ptr, 16);
-            if ((filter_id == 0) ||
-                (filter_id == id))
+            if (pList != NULL)
             {
-                // pid matches, save the info
-                close(eeprom_fd);
-                eeprom_fd = -1;
-                count = 1;
-                if (pList != NULL)
-                {
-                    pList[0].address = 0;
-                    pList[0].id = id;
-
-                    // read the version
-                    sprintf(filename, "%s/product_ver", SYS_HAT_DIR);
-                    if (((eeprom_fd = open(filename, O_RDONLY)) != -1) &&
-                        (read(eeprom_fd, &temp, 256) > 0))
-                    {
-                        pver = (uint16_t)strtoul(temp, &ptr, 16);
-                        pList[0].version = pver;
-
-                        // read the product string
-                        close(eeprom_fd);
-                        eeprom_fd = -1;
-                        sprintf(filename, "%s/product", SYS_HAT_DIR);
-                        if (((eeprom_fd = open(filename, O_RDONLY)) != -1) &&
-                            (read(eeprom_fd, &temp, 256) > 0))
-                        {
-                            strcpy(pList[0].product_name, temp);
-                        }
-                    }
-                }
+                pList[count] = entry->info;
             }
+            count++;
         }
     }
-    if (eeprom_fd != -1)
-        close(eeprom_fd);
-
-    // Boards 1-7 will be supported with the read_eeproms utility that copies 
-    // the EEPROM contents to /etc/mcc/hats
-    for (address = 1; address < MAX_NUMBER_HATS; address++)
-    {
-        // look for HAT eeprom.bin files in /etc/mcc/hats
-        sprintf(filename, "%s/eeprom_%d.bin", HAT_SETTINGS_DIR, address);
 
-        // open file
-        if ((eeprom_fd = open(filename, O_RDONLY)) == -1)
-            continue;
+    pthread_mutex_unlock(&_hat_cache_mutex);
+    return count;
+}
 
-        // read hat header
-        if (read(eeprom_fd, &header, HEADER_SIZE) != HEADER_SIZE)
-        {
-            close(eeprom_fd);
-            continue;
-        }
+/******************************************************************************
+  Open one board with the open function for its type.
+ *****************************************************************************/
+static void* _hat_open_thread(void* arg)
+{
+    struct HatOpenResult* entry = (struct HatOpenResult*)arg;
 
-        // check the header
-        if ((header.signature != SIGNATURE) ||
-            (header.ver != FORMAT_VERSION) ||
-            (header.numatoms < 1))
-        {
-            close(eeprom_fd);
-            continue;
-        }
+    switch (entry->id)
+    {
+    case HAT_ID_MCC_118:
+        entry->result = mcc118_open(entry->address);
+        break;
+    case HAT_ID_MCC_128:
+        entry->result = mcc128_open(entry->address);
+        break;
+    case HAT_ID_MCC_134:
+        entry->result = mcc134_open(entry->address);
+        break;
+    case HAT_ID_MCC_152:
+        entry->result = mcc152_open(entry->address);
+        break;
+    case HAT_ID_MCC_172:
+        entry->result = mcc172_open(entry->address);
+        break;
+    default:
+        entry->result = RESULT_INVALID_DEVICE;
+        break;
+    }
+    return NULL;
+}
 
-        // header is valid, read the vendor atom
-        if (read(eeprom_fd, &atom, ATOM_SIZE-CRC_SIZE) != ATOM_SIZE-CRC_SIZE)
-        {
-            close(eeprom_fd);
-            continue;
-        }
+/******************************************************************************
+  Open all HAT boards attached to the Pi, one thread per board.  The SPI lock
+  serializes the bus transfers while the EEPROM parsing and other setup of the
+  boards overlap.
+ *****************************************************************************/
+int hat_open_all(uint16_t filter_id, struct HatOpenResult* pList)
+{
+    struct HatInfo info[MAX_NUMBER_HATS];
+    struct HatOpenResult results[MAX_NUMBER_HATS];
+    pthread_t threads[MAX_NUMBER_HATS];
+    bool started[MAX_NUMBER_HATS];
+    int count;
+    int index;
 
-        // vendor atom must be the first atom
-        if (atom.type != ATOM_VENDOR_TYPE)
-        {
-            close(eeprom_fd);
-            continue;
-        }
+    count = hat_list(filter_id, info);
 
-        // read the vendor info
-        if (read(eeprom_fd, &vinf, VENDOR_SIZE) != VENDOR_SIZE)
+    for (index = 0; index < count; index++)
+    {
+        results[index].address = info[index].address;
+        results[index].id = info[index].id;
+        results[index].result = RESULT_UNDEFINED;
+
+        // open the board from this thread if another can't be created
+        started[index] = (pthread_create(&threads[index], NULL,
+            &_hat_open_thread, &results[index]) == 0);
+        if (!started[index])
         {
-            close(eeprom_fd);
-            continue;
+            _hat_open_thread(&results[index]);
         }
+    }
 
-        // allocate and read the vendor and product strings
-        vinf.vstr = (char*)malloc(vinf.vslen+1);
-        vinf.pstr = (char*)malloc(vinf.pslen+1);
-        if (read(eeprom_fd, vinf.vstr, vinf.vslen) != vinf.vslen)
+    for (index = 0; index < count; index++)
+    {
+        if (started[index])
         {
-            free(vinf.vstr);
-            free(vinf.pstr);
-            close(eeprom_fd);
-            continue;
+            pthread_join(threads[index], NULL);
         }
-        vinf.vstr[vinf.vslen] = '\0';
-        if (read(eeprom_fd, vinf.pstr, vinf.pslen) != vinf.pslen)
+        if (pList != NULL)
         {
-            free(vinf.vstr);
-            free(vinf.pstr);
-            close(eeprom_fd);
-            continue;
+            pList[index] = results[index];
         }
-        vinf.pstr[vinf.pslen] = '\0';
-
-        // compare the vendor string to the desired string
-        if ((strcmp(vinf.vstr, VENDOR_NAME) == 0) &&
-            (filter_id == 0 ? true : (vinf.pid == filter_id)))
-        {
-            // vendor is MCC, save the entry if it matches the PID filter
-            if (pList != NULL)
-            {
-                pList[count].address = address;
-                pList[count].id = vinf.pid;
-                pList[count].version = vinf.pver;
-                strncpy(pList[count].product_name, vinf.pstr, 256);
-            }
-            count++;
-        }
-
-        free(vinf.vstr);
-        free(vinf.pstr);
-        close(eeprom_fd);
     }
 
     return count;
@@ -620,228 +1127,172 @@ int hat_list(uint16_t filter_id, struct HatInfo* pList)
 int _hat_info(uint8_t address, struct HatInfo* entry, char* pData, 
     uint16_t* pSize)
 {
-    bool found_custom;
-    bool found_vendor;
-    bool error;
-    char filename[256];
-    char temp[256];
-    uint8_t atom_num;
-    uint16_t custom_size;
-    int eeprom_fd;
-    struct _Header header;
-    struct _Atom atom;
-    struct _VendorInfo vinf;
-    struct stat filestat;
+    const struct _HatCacheEntry* cached;
 
     if (address >= MAX_NUMBER_HATS)
     {
         return RESULT_BAD_PARAMETER;
     }
 
-    found_vendor = false;
+    pthread_mutex_lock(&_hat_cache_mutex);
+    _hat_cache_refresh();
 
-    if (address == 0)
+    // use the info in /proc/device-tree/hat for address 0 if possible,
+    // otherwise the files in /etc/mcc/hats
+    if ((address == 0) && _hat_cache_proc.is_mcc)
     {
-        // use the info in /proc/device-tree/hat if possible
-        sprintf(filename, "%s/vendor", SYS_HAT_DIR);
-        // open vendor file and compare against VENDOR_NAME
-        eeprom_fd = -1;
-        if (((eeprom_fd = open(filename, O_RDONLY)) != -1) &&
-            (read(eeprom_fd, temp, 256) > 0) &&
-            (strcmp(temp, VENDOR_NAME) == 0))
-        {
-            // name matches
-            found_vendor = true;
-            close(eeprom_fd);
-            eeprom_fd = -1;
-
-            if (entry)
-            {
-                entry->address = 0;
-
-                // read the device info
-                sprintf(filename, "%s/product_id", SYS_HAT_DIR);
-                if (((eeprom_fd = open(filename, O_RDONLY)) != -1) &&
-                    (read(eeprom_fd, temp, 256) > 0))
-                {
-                    // convert string to int
-                    entry->id = (uint16_t)strtoul(temp, NULL, 16);
-                    close(eeprom_fd);
-                    eeprom_fd = -1;
-                }
-
-                sprintf(filename, "%s/product_ver", SYS_HAT_DIR);
-                if (((eeprom_fd = open(filename, O_RDONLY)) != -1) &&
-                    (read(eeprom_fd, temp, 256) > 0))
-                {
-                    entry->version = (uint16_t)strtoul(temp, NULL, 16);
-                    close(eeprom_fd);
-                    eeprom_fd = -1;
-                }
-
-                sprintf(filename, "%s/product", SYS_HAT_DIR);
-                if (((eeprom_fd = open(filename, O_RDONLY)) != -1) &&
-                    (read(eeprom_fd, temp, 256) > 0))
-                {
-                    strcpy(entry->product_name, temp);
-                    close(eeprom_fd);
-                    eeprom_fd = -1;
-                }
-            }
-
-            // get the custom size
-            custom_size = 0;
-            sprintf(filename, "%s/custom_0", SYS_HAT_DIR);
-            if (stat(filename, &filestat) == 0)
-            {
-                custom_size = filestat.st_size;
-
-                // read the file?
-                if (pData)
-                {
-                    if (((eeprom_fd = open(filename, O_RDONLY)) != -1) &&
-                        (read(eeprom_fd, pData, custom_size) > 0))
-                    {
-                        close(eeprom_fd);
-                        eeprom_fd = -1;
-                        pData[custom_size] = '\0';  // null terminate the string
-                    }
-                }
-            }
+        cached = &_hat_cache_proc;
+    }
+    else
+    {
+        cached = &_hat_cache[address];
+    }
 
-            if (pSize)
-            {
-                *pSize = custom_size + 1;   // add room for null
-            }
-        }
-        if (eeprom_fd != -1)
-            close(eeprom_fd);
+    if (!cached->valid)
+    {
+        // no board info found
+        pthread_mutex_unlock(&_hat_cache_mutex);
+        return RESULT_BAD_PARAMETER;
     }
 
-    if (!found_vendor)
+    if (entry != NULL)
     {
-        // try the files in /etc/mcc/hats
-        found_custom = false;
-        sprintf(filename, "%s/eeprom_%d.bin", HAT_SETTINGS_DIR, address);
-        eeprom_fd = -1;
-        if (((eeprom_fd = open(filename, O_RDONLY)) != -1) &&
-            (read(eeprom_fd, &header, HEADER_SIZE) == HEADER_SIZE) &&
-            (header.signature == SIGNATURE) &&
-            (header.ver == FORMAT_VERSION) &&
-            (header.numatoms > 1))
+        if (cached->is_mcc)
         {
-            // header is valid, read atoms
-            atom_num = 0;
-            error = false;
-            while (!(found_custom && found_vendor) &&
-                (atom_num < header.numatoms) &&
-                !error)
-            {
-                if (read(eeprom_fd, &atom, ATOM_SIZE-CRC_SIZE) == 
-                    ATOM_SIZE-CRC_SIZE)
-                {
-                    // process the atom by type
-                    if (atom.type == ATOM_VENDOR_TYPE)
-                    {
-                        // get the vendor info
-                        if (read(eeprom_fd, &vinf, VENDOR_SIZE) == VENDOR_SIZE)
-                        {
-                            vinf.vstr = (char*)malloc(vinf.vslen+1);
-                            vinf.pstr = (char*)malloc(vinf.pslen+1);
-                            if (read(eeprom_fd, vinf.vstr, vinf.vslen) != 
-                                vinf.vslen)
-                            {
-                                free(vinf.vstr);
-                                free(vinf.pstr);
-                                error = true;
-                                continue;
-                            }
-                            vinf.vstr[vinf.vslen] = '\0';
-                            if (read(eeprom_fd, vinf.pstr, vinf.pslen) != 
-                                vinf.pslen)
-                            {
-                                free(vinf.vstr);
-                                free(vinf.pstr);
-                                error = true;
-                                continue;
-                            }
-                            vinf.pstr[vinf.pslen] = '\0';
-                            lseek(eeprom_fd, CRC_SIZE, SEEK_CUR);
-
-                            if (strcmp(vinf.vstr, VENDOR_NAME) == 0)
-                            {
-                                // valid vendor, save the info
-                                if (entry != NULL)
-                                {
-                                    entry->address = address;
-                                    entry->id = vinf.pid;
-                                    entry->version = vinf.pver;
-                                    strncpy(entry->product_name, vinf.pstr, 
-                                        256);
-                                }
-                                found_vendor = true;
-                            }
-                            else
-                            {
-                                // invalid vendor
-                                error = true;
-                            }
-                            free(vinf.vstr);
-                            free(vinf.pstr);
-                        }
-                        else
-                        {
-                            error = true;
-                        }
-                        atom_num++;
-                    }
-                    else if (atom.type == ATOM_CUSTOM_TYPE)
-                    {
-                        // found the custom info
-                        found_custom = true;
-                    }
-                    else
-                    {
-                        // skip
-                        lseek(eeprom_fd, atom.dlen, SEEK_CUR);
-                        atom_num++;
-                    }
-                }
-                else
-                {
-                    error = true;
-                }
-            }
+            *entry = cached->info;
         }
         else
         {
-            // no board info found
-            return RESULT_BAD_PARAMETER;
+            memset(entry, 0, sizeof(*entry));
         }
-
-        custom_size = 0;
-        if (found_custom)
-        {
-            // read the JSON custom data
-            custom_size = atom.dlen - CRC_SIZE;
-            if (pData)
-            {
-                if (read(eeprom_fd, pData, custom_size) != custom_size)
-                {
-                    custom_size = 0;
-                }
-                pData[custom_size] = '\0';  // add null termination
-            }
-        }
-        if (pSize)
+    }
+    if (pData != NULL)
+    {
+        if (cached->custom_size > 0)
         {
-            *pSize = custom_size + 1;   // add room for null
+            memcpy(pData, cached->custom, cached->custom_size);
         }
+        pData[cached->custom_size] = '\0';    // add null termination
+    }
+    if (pSize != NULL)
+    {
+        *pSize = cached->custom_size + 1;   // add room for null
     }
 
+    pthread_mutex_unlock(&_hat_cache_mutex);
     return RESULT_SUCCESS;
 }
 
+/******************************************************************************
+  FNV-1a hash, used to key and check the factory data cache.
+ *****************************************************************************/
+static uint64_t _fnv1a(const void* data, size_t size)
+{
+    const uint8_t* ptr = (const uint8_t*)data;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    while (size--)
+    {
+        hash ^= *ptr++;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/******************************************************************************
+  Load the parsed factory data for a board from the cache in /etc/mcc/hats.
+  Returns false if there is no cache or it does not match the custom data,
+  product, struct size or version, or fails the checksum; the caller then
+  parses the JSON custom data.
+ *****************************************************************************/
+bool _factory_cache_load(uint8_t address, uint16_t id, const char* pData,
+    uint16_t size, void* factory_data, size_t factory_size)
+{
+    struct _FactoryCacheHeader header;
+    char filename[256];
+    uint8_t buffer[sizeof(header) + 512];
+    ssize_t count;
+    int fd;
+
+    if ((address >= MAX_NUMBER_HATS) ||
+        (factory_size > (sizeof(buffer) - sizeof(header))))
+    {
+        return false;
+    }
+
+    sprintf(filename, FACTORY_CACHE_FILE, HAT_SETTINGS_DIR, address);
+    if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) == -1)
+    {
+        return false;
+    }
+    count = read(fd, buffer, sizeof(header) + factory_size);
+    close(fd);
+    if (count != (ssize_t)(sizeof(header) + factory_size))
+    {
+        return false;
+    }
+
+    memcpy(&header, buffer, sizeof(header));
+    if ((header.magic != FACTORY_CACHE_MAGIC) ||
+        (header.version != FACTORY_CACHE_VERSION) ||
+        (header.id != id) ||
+        (header.size != factory_size) ||
+        (header.key != _fnv1a(pData, size)) ||
+        (header.checksum !=
+            (uint32_t)_fnv1a(&buffer[sizeof(header)], factory_size)))
+    {
+        return false;
+    }
+
+    memcpy(factory_data, &buffer[sizeof(header)], factory_size);
+    return true;
+}
+
+/******************************************************************************
+  Save the parsed factory data for a board in the cache.  The file is
+  replaced atomically; failures (e.g. no write permission) are ignored.
+ *****************************************************************************/
+void _factory_cache_store(uint8_t address, uint16_t id, const char* pData,
+    uint16_t size, const void* factory_data, size_t factory_size)
+{
+    struct _FactoryCacheHeader header;
+    char filename[256];
+    char temp_name[280];
+    bool ok;
+    int fd;
+
+    if (address >= MAX_NUMBER_HATS)
+    {
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = FACTORY_CACHE_MAGIC;
+    header.version = FACTORY_CACHE_VERSION;
+    header.id = id;
+    header.size = factory_size;
+    header.checksum = (uint32_t)_fnv1a(factory_data, factory_size);
+    header.key = _fnv1a(pData, size);
+
+    sprintf(filename, FACTORY_CACHE_FILE, HAT_SETTINGS_DIR, address);
+    snprintf(temp_name, sizeof(temp_name), "%s.%d", filename, (int)getpid());
+
+    // set the mode with fchmod() rather than changing the process umask
+    fd = open(temp_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        return;
+    }
+    fchmod(fd, 0644);
+    ok = (write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header)) &&
+        (write(fd, factory_data, factory_size) == (ssize_t)factory_size);
+    close(fd);
+    if (!ok || (rename(temp_name, filename) != 0))
+    {
+        unlink(temp_name);
+    }
+}
+
 /******************************************************************************
   Return an error description string.
  *****************************************************************************/
@@ -903,12 +1354,107 @@ int hat_wait_for_interrupt(int timeout)
     }
 }
 
+/******************************************************************************
+  Return true if any interrupt consumer is enabled.  Called with
+  interrupt_mutex held.
+ *****************************************************************************/
+static bool _interrupt_consumers(void)
+{
+    return ((interrupt_function != NULL) ||
+            (interrupt_event_fd != -1) ||
+            (interrupt_capture_function != NULL));
+}
+
+/******************************************************************************
+  Handle an interrupt by calling the internal capture handler and the user
+  callback and signaling the event descriptor, whichever are enabled.
+ *****************************************************************************/
+static void _interrupt_handler(void* arg)
+{
+    void (*function)(void*);
+    void* data;
+
+    (void)arg;
+
+    // call the capture handler and signal the descriptor while holding the
+    // mutex so they cannot be removed underneath us; the capture handler runs
+    // first so it sees the interrupt sources before a user callback clears
+    // them
+    pthread_mutex_lock(&interrupt_mutex);
+    function = interrupt_function;
+    data = interrupt_data;
+    if (interrupt_capture_function)
+    {
+        interrupt_capture_function(interrupt_capture_data);
+    }
+    if (interrupt_event_fd != -1)
+    {
+        eventfd_write(interrupt_event_fd, 1);
+    }
+    pthread_mutex_unlock(&interrupt_mutex);
+
+    if (function)
+    {
+        function(data);
+    }
+}
+
+/******************************************************************************
+  Start or stop the GPIO interrupt thread after the consumers changed.
+ *****************************************************************************/
+static int _interrupt_update(bool was_enabled, bool enabled)
+{
+    if (was_enabled == enabled)
+    {
+        return RESULT_SUCCESS;
+    }
+
+    if (gpio_interrupt_callback(IRQ_GPIO, enabled ? 0 : 3,
+        enabled ? _interrupt_handler : NULL, NULL) == -1)
+    {
+        return RESULT_UNDEFINED;
+    }
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Set or clear the internal interrupt handler used by the board classes.
+ *****************************************************************************/
+int _interrupt_capture_set(void (*function)(void*), void* data)
+{
+    bool was_enabled;
+    bool enabled;
+    int result;
+
+    pthread_mutex_lock(&interrupt_mutex);
+    was_enabled = _interrupt_consumers();
+    interrupt_capture_function = function;
+    interrupt_capture_data = data;
+    enabled = _interrupt_consumers();
+    pthread_mutex_unlock(&interrupt_mutex);
+
+    result = _interrupt_update(was_enabled, enabled);
+    if ((result != RESULT_SUCCESS) && (function != NULL))
+    {
+        pthread_mutex_lock(&interrupt_mutex);
+        interrupt_capture_function = NULL;
+        interrupt_capture_data = NULL;
+        pthread_mutex_unlock(&interrupt_mutex);
+    }
+    return result;
+}
+
 /******************************************************************************
   Create an interrupt handler that calls the user-provided callback function.
  *****************************************************************************/
 int hat_interrupt_callback_enable(void (*function)(void*), void* data)
 {
-    switch (gpio_interrupt_callback(IRQ_GPIO, 0, function, data))
+    pthread_mutex_lock(&interrupt_mutex);
+    interrupt_function = function;
+    interrupt_data = data;
+    pthread_mutex_unlock(&interrupt_mutex);
+
+    switch (gpio_interrupt_callback(IRQ_GPIO, 0, _interrupt_handler, NULL))
     {
     case -1:    // error
         return RESULT_UNDEFINED;
@@ -923,12 +1469,83 @@ int hat_interrupt_callback_enable(void (*function)(void*), void* data)
  *****************************************************************************/
 int hat_interrupt_callback_disable(void)
 {
-    switch (gpio_interrupt_callback(IRQ_GPIO, 3, NULL, NULL))
+    bool enabled;
+
+    pthread_mutex_lock(&interrupt_mutex);
+    interrupt_function = NULL;
+    interrupt_data = NULL;
+    enabled = _interrupt_consumers();
+    pthread_mutex_unlock(&interrupt_mutex);
+
+    // the interrupt thread is still needed if there are other consumers
+    return _interrupt_update(true, enabled);
+}
+
+/******************************************************************************
+  Return an eventfd that is signaled when an interrupt occurs.
+ *****************************************************************************/
+int hat_interrupt_event_enable(int* fd)
+{
+    int event_fd;
+    bool was_enabled;
+
+    if (fd == NULL)
     {
-    case -1:    // error
+        return RESULT_BAD_PARAMETER;
+    }
+
+    pthread_mutex_lock(&interrupt_mutex);
+    if (interrupt_event_fd != -1)
+    {
+        *fd = interrupt_event_fd;
+        pthread_mutex_unlock(&interrupt_mutex);
+        return RESULT_SUCCESS;
+    }
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd == -1)
+    {
+        pthread_mutex_unlock(&interrupt_mutex);
         return RESULT_UNDEFINED;
-    case 0:
-    default:
+    }
+    was_enabled = _interrupt_consumers();
+    interrupt_event_fd = event_fd;
+    pthread_mutex_unlock(&interrupt_mutex);
+
+    if (_interrupt_update(was_enabled, true) != RESULT_SUCCESS)
+    {
+        pthread_mutex_lock(&interrupt_mutex);
+        interrupt_event_fd = -1;
+        pthread_mutex_unlock(&interrupt_mutex);
+        close(event_fd);
+        return RESULT_UNDEFINED;
+    }
+
+    *fd = event_fd;
+    return RESULT_SUCCESS;
+}
+
+/******************************************************************************
+  Close the interrupt eventfd.
+ *****************************************************************************/
+int hat_interrupt_event_disable(void)
+{
+    int event_fd;
+    bool enabled;
+    int result;
+
+    pthread_mutex_lock(&interrupt_mutex);
+    event_fd = interrupt_event_fd;
+    interrupt_event_fd = -1;
+    enabled = _interrupt_consumers();
+    pthread_mutex_unlock(&interrupt_mutex);
+
+    if (event_fd == -1)
+    {
         return RESULT_SUCCESS;
     }
+
+    result = _interrupt_update(true, enabled);
+    close(event_fd);
+    return result;
 }
@@ -8,6 +8,8 @@
 #ifndef _UTIL_H
 #define _UTIL_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
 #include "daqhats.h"
@@ -36,6 +38,29 @@ enum SpiBus
 // The Raspberry Pi I2C device driver names
 #define I2C_DEVICE_1            "/dev/i2c-1"
 
+// Cache line size (Raspberry Pi Cortex-A53 / A72.)  Scan state written by the
+// scan thread and by the reading thread is kept in separate cache lines, and
+// scan buffers are aligned to it.
+#define CACHE_LINE_SIZE         64
+#define CACHE_ALIGNED           __attribute__((aligned(CACHE_LINE_SIZE)))
+
+// Frames per block when de-interleaving scan data (8 channels of doubles in
+// 4 kB)
+#define SCAN_COPY_BLOCK_FRAMES  64
+
+// Destination layout for scan reads.  Sample i of channel c is stored at
+// planes[c][i] when planes is not NULL, otherwise at
+// buffer[i * sample_stride + c * channel_stride].  buffer_size is the size of
+// buffer, or of each plane, in samples.
+struct ScanLayout
+{
+    double* buffer;
+    double* const* planes;
+    uint32_t buffer_size;
+    uint32_t sample_stride;
+    uint32_t channel_stride;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -53,6 +78,18 @@ void _address_init(void);
 void _set_address(uint8_t address);
 int _hat_info(uint8_t address, struct HatInfo* pEntry, char* pData, 
     uint16_t* pSize);
+bool _factory_cache_load(uint8_t address, uint16_t id, const char* pData,
+    uint16_t size, void* factory_data, size_t factory_size);
+void _factory_cache_store(uint8_t address, uint16_t id, const char* pData,
+    uint16_t size, const void* factory_data, size_t factory_size);
+
+int _interrupt_capture_set(void (*function)(void*), void* data);
+
+void* _aligned_calloc(size_t size);
+uint32_t _scan_layout_frames(const struct ScanLayout* layout,
+    uint8_t channel_count);
+void _scan_copy(const struct ScanLayout* layout, uint32_t first_frame,
+    const double* src, uint32_t frame_count, uint8_t channel_count);
 
 #ifdef __cplusplus
 }
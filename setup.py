@@ -1,13 +1,46 @@
 #!/usr/bin/env python
 
 import sys
-from setuptools import setup
+from setuptools import setup, Extension
+from setuptools.command.build_ext import build_ext
 
 if sys.version_info < (3,4):
     install_requires=['enum34']
 else:
     install_requires=[]
 
+# The native extension speeds up the scan, single-point and DIO paths. It is
+# optional; the package falls back to ctypes if it cannot be built.
+if sys.version_info >= (3,):
+    ext_modules=[
+        Extension(
+            'daqhats._daqhats',
+            sources=['daqhats/_daqhats.c'],
+            libraries=['daqhats'])
+    ]
+else:
+    ext_modules=[]
+
+class OptionalBuildExt(build_ext):
+    """Build the extension if possible, but do not fail the install."""
+    def run(self):
+        try:
+            build_ext.run(self)
+        except Exception: # pylint: disable=broad-except
+            self._warn()
+
+    def build_extension(self, ext):
+        try:
+            build_ext.build_extension(self, ext)
+        except Exception: # pylint: disable=broad-except
+            self._warn()
+
+    @staticmethod
+    def _warn():
+        sys.stderr.write(
+            'WARNING: the daqhats native extension could not be built, '
+            'using ctypes.\n')
+
 setup(
     name='daqhats',
     version='1.4.0.0',
@@ -17,5 +50,7 @@ setup(
     license='MIT',
     url='https://github.com/mccdaq/daqhats',
     packages=['daqhats'],
+    ext_modules=ext_modules,
+    cmdclass={'build_ext': OptionalBuildExt},
     install_requires=install_requires
 )
@@ -0,0 +1,263 @@
+/*
+*   daqhats_stream
+*
+*   Start continuous scans on MCC 118, MCC 128 and MCC 172 boards and publish
+*   them to local subscribers with the library streaming server until
+*   interrupted.
+*
+*   Usage: daqhats_stream [-s socket] [-b samples_per_block] [-c]
+*              address:channel_mask:rate [...]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <daqhats/daqhats.h>
+
+#define DEFAULT_BLOCK_SIZE  100
+
+struct Scan
+{
+    uint8_t address;
+    uint16_t id;
+    uint8_t channel_mask;
+    double rate;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void signal_handler(int signal)
+{
+    (void)signal;
+    running = 0;
+}
+
+static void usage(void)
+{
+    printf("Usage: daqhats_stream [-s socket] [-b samples_per_block] [-c]\n"
+        "           address:channel_mask:rate [...]\n"
+        "  -s  Socket path (default %s)\n"
+        "  -b  Samples per channel in each block (default %d)\n"
+        "  -c  Copy blocks out of the scan buffer before sending\n"
+        "  For the MCC 172 a rate of 0 keeps the current clock "
+        "configuration.\n", HAT_STREAM_DEFAULT_PATH, DEFAULT_BLOCK_SIZE);
+}
+
+/*
+*   Find the board type at an address.
+*/
+static uint16_t find_board(uint8_t address)
+{
+    struct HatInfo* list;
+    uint16_t id;
+    int count;
+    int index;
+
+    id = 0;
+    count = hat_list(HAT_ID_ANY, NULL);
+    if (count <= 0)
+    {
+        return 0;
+    }
+    list = (struct HatInfo*)malloc(count * sizeof(struct HatInfo));
+    if (list == NULL)
+    {
+        return 0;
+    }
+    hat_list(HAT_ID_ANY, list);
+    for (index = 0; index < count; index++)
+    {
+        if (list[index].address == address)
+        {
+            id = list[index].id;
+        }
+    }
+    free(list);
+    return id;
+}
+
+/*
+*   Open a board and start a continuous scan.
+*/
+static int start_scan(const struct Scan* scan)
+{
+    int result;
+
+    switch (scan->id)
+    {
+    case HAT_ID_MCC_118:
+        if ((result = mcc118_open(scan->address)) == RESULT_SUCCESS)
+        {
+            result = mcc118_a_in_scan_start(scan->address, scan->channel_mask,
+                0, scan->rate, OPTS_CONTINUOUS);
+        }
+        break;
+    case HAT_ID_MCC_128:
+        if ((result = mcc128_open(scan->address)) == RESULT_SUCCESS)
+        {
+            result = mcc128_a_in_scan_start(scan->address, scan->channel_mask,
+                0, scan->rate, OPTS_CONTINUOUS);
+        }
+        break;
+    case HAT_ID_MCC_172:
+        if (((result = mcc172_open(scan->address)) == RESULT_SUCCESS) &&
+            (scan->rate > 0.0))
+        {
+            result = mcc172_a_in_clock_config_write(scan->address,
+                SOURCE_LOCAL, scan->rate);
+        }
+        if (result == RESULT_SUCCESS)
+        {
+            result = mcc172_a_in_scan_start(scan->address, scan->channel_mask,
+                0, OPTS_CONTINUOUS);
+        }
+        break;
+    default:
+        result = RESULT_INVALID_DEVICE;
+        break;
+    }
+    return result;
+}
+
+/*
+*   Stop a scan and close the board.
+*/
+static void stop_scan(const struct Scan* scan)
+{
+    switch (scan->id)
+    {
+    case HAT_ID_MCC_118:
+        mcc118_a_in_scan_stop(scan->address);
+        mcc118_a_in_scan_cleanup(scan->address);
+        mcc118_close(scan->address);
+        break;
+    case HAT_ID_MCC_128:
+        mcc128_a_in_scan_stop(scan->address);
+        mcc128_a_in_scan_cleanup(scan->address);
+        mcc128_close(scan->address);
+        break;
+    case HAT_ID_MCC_172:
+        mcc172_a_in_scan_stop(scan->address);
+        mcc172_a_in_scan_cleanup(scan->address);
+        mcc172_close(scan->address);
+        break;
+    default:
+        break;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    struct Scan scans[MAX_NUMBER_HATS];
+    struct HatStreamServer* server;
+    struct sigaction action;
+    const char* path;
+    uint32_t block_size;
+    uint32_t options;
+    uint8_t address_mask;
+    unsigned int address;
+    unsigned int mask;
+    double rate;
+    int scan_count;
+    int started;
+    int result;
+    int opt;
+    int index;
+
+    path = HAT_STREAM_DEFAULT_PATH;
+    block_size = DEFAULT_BLOCK_SIZE;
+    options = HAT_STREAM_OPTS_DEFAULT;
+    while ((opt = getopt(argc, argv, "s:b:ch")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            path = optarg;
+            break;
+        case 'b':
+            block_size = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            options |= HAT_STREAM_OPTS_COPY;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    scan_count = 0;
+    address_mask = 0;
+    for (index = optind; index < argc; index++)
+    {
+        if ((sscanf(argv[index], "%u:%i:%lf", &address, &mask, &rate) != 3) ||
+            (address >= MAX_NUMBER_HATS) ||
+            (mask == 0) ||
+            (mask > 0xFF) ||
+            (address_mask & (1 << address)))
+        {
+            usage();
+            return 1;
+        }
+        scans[scan_count].address = address;
+        scans[scan_count].channel_mask = mask;
+        scans[scan_count].rate = rate;
+        if ((scans[scan_count].id = find_board(address)) == 0)
+        {
+            printf("No board found at address %u\n", address);
+            return 1;
+        }
+        address_mask |= 1 << address;
+        scan_count++;
+    }
+    if ((scan_count == 0) || (block_size == 0))
+    {
+        usage();
+        return 1;
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = signal_handler;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    result = hat_stream_server_start(path, address_mask, block_size, options,
+        &server);
+    if (result != RESULT_SUCCESS)
+    {
+        printf("Can't create %s\n", path);
+        return 1;
+    }
+
+    for (started = 0; started < scan_count; started++)
+    {
+        // publish each scan once it has started
+        if (((result = start_scan(&scans[started])) != RESULT_SUCCESS) ||
+            ((result = hat_stream_server_attach(server,
+                scans[started].address)) != RESULT_SUCCESS))
+        {
+            printf("Can't start the scan on address %d: %d\n",
+                scans[started].address, result);
+            // not attached, so it can be cleaned up now
+            stop_scan(&scans[started]);
+            running = 0;
+            break;
+        }
+    }
+
+    printf("Streaming on %s, press Ctrl-C to stop\n", path);
+    while (running)
+    {
+        pause();
+    }
+
+    // the server reads the scan buffers, so stop it before they are freed
+    hat_stream_server_stop(server);
+    for (index = 0; index < started; index++)
+    {
+        stop_scan(&scans[index]);
+    }
+    return (result == RESULT_SUCCESS) ? 0 : 1;
+}
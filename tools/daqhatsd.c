@@ -0,0 +1,855 @@
+/*
+*   daqhatsd
+*
+*   Optional daemon that owns the DAQ HAT boards and the SPI bus.  It opens
+*   every MCC 118, MCC 128 and MCC 172, accepts requests from the daqhatsd_*
+*   library functions on a Unix socket, and runs each requested scan once,
+*   publishing the data in a shared memory ring that any number of processes
+*   can read.
+*
+*   The control socket and the rings are only accessible to root and the
+*   members of one group (spi by default, -g to change it), the users that
+*   could otherwise use the boards directly.
+*
+*   Usage: daqhatsd [-v] [-g group]
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <daqhats/daqhats.h>
+#include "daqhatsd_protocol.h"
+
+#define MAX_CLIENTS         64
+#define PUMP_WAIT_MS        100
+#define DEFAULT_GROUP       "spi"
+
+// Library functions with the same signature on all scanning boards
+struct ScanFunctions
+{
+    int (*a_in_scan_status)(uint8_t, uint16_t*, uint32_t*);
+    int (*a_in_scan_read)(uint8_t, uint16_t*, int32_t, double, double*,
+        uint32_t, uint32_t*);
+    int (*a_in_scan_buffer_size)(uint8_t, uint32_t*);
+    int (*a_in_scan_channel_count)(uint8_t);
+    int (*a_in_scan_event_enable)(uint8_t, uint32_t, int*);
+    int (*a_in_scan_stop)(uint8_t);
+    int (*a_in_scan_cleanup)(uint8_t);
+    int (*close)(uint8_t);
+};
+
+static const struct ScanFunctions mcc118_functions =
+{
+    mcc118_a_in_scan_status, mcc118_a_in_scan_read,
+    mcc118_a_in_scan_buffer_size, mcc118_a_in_scan_channel_count,
+    mcc118_a_in_scan_event_enable, mcc118_a_in_scan_stop,
+    mcc118_a_in_scan_cleanup, mcc118_close
+};
+
+static const struct ScanFunctions mcc128_functions =
+{
+    mcc128_a_in_scan_status, mcc128_a_in_scan_read,
+    mcc128_a_in_scan_buffer_size, mcc128_a_in_scan_channel_count,
+    mcc128_a_in_scan_event_enable, mcc128_a_in_scan_stop,
+    mcc128_a_in_scan_cleanup, mcc128_close
+};
+
+static const struct ScanFunctions mcc172_functions =
+{
+    mcc172_a_in_scan_status, mcc172_a_in_scan_read,
+    mcc172_a_in_scan_buffer_size, mcc172_a_in_scan_channel_count,
+    mcc172_a_in_scan_event_enable, mcc172_a_in_scan_stop,
+    mcc172_a_in_scan_cleanup, mcc172_close
+};
+
+struct Board
+{
+    uint8_t address;
+    uint16_t id;
+    const struct ScanFunctions* functions;  // NULL if not open
+
+    // the published scan
+    bool active;
+    uint32_t users;
+    struct DaqhatsdRequest params;
+    struct DaqhatsdScanRing* ring;
+    size_t ring_size;
+    pthread_t pump;
+    volatile bool stop_pump;
+
+    // the daemon ends of the joined clients' notification sockets
+    pthread_mutex_t notify_mutex;
+    int notify_fds[MAX_CLIENTS];
+    uint32_t notify_count;
+};
+
+struct Client
+{
+    int fd;
+    uint8_t joined;     // bit mask of the board addresses joined
+    int notify_fd[MAX_NUMBER_HATS];     // valid for the joined addresses
+};
+
+static struct Board boards[MAX_NUMBER_HATS];
+static struct Client clients[MAX_CLIENTS];
+static volatile sig_atomic_t running = 1;
+static bool verbose = false;
+static gid_t access_group;
+
+static void signal_handler(int signal)
+{
+    (void)signal;
+    running = 0;
+}
+
+/*
+*   Wake the clients waiting for data on a board.  A notification that does
+*   not fit in a client's socket buffer is dropped; one pending is enough.
+*/
+static void notify_clients(struct Board* board)
+{
+    uint32_t index;
+    uint8_t event;
+
+    event = 0;
+    pthread_mutex_lock(&board->notify_mutex);
+    for (index = 0; index < board->notify_count; index++)
+    {
+        send(board->notify_fds[index], &event, sizeof(event),
+            MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+    pthread_mutex_unlock(&board->notify_mutex);
+}
+
+/*
+*   Add a client to the notification list of a board.  Returns the client end
+*   of the notification socket, or -1 on error.
+*/
+static int add_notify(struct Client* client, struct Board* board)
+{
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&board->notify_mutex);
+    board->notify_fds[board->notify_count++] = fds[0];
+    pthread_mutex_unlock(&board->notify_mutex);
+    client->notify_fd[board->address] = fds[0];
+    return fds[1];
+}
+
+/*
+*   Remove a client from the notification list of a board.
+*/
+static void remove_notify(struct Client* client, struct Board* board)
+{
+    uint32_t index;
+
+    pthread_mutex_lock(&board->notify_mutex);
+    for (index = 0; index < board->notify_count; index++)
+    {
+        if (board->notify_fds[index] == client->notify_fd[board->address])
+        {
+            board->notify_fds[index] =
+                board->notify_fds[--board->notify_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&board->notify_mutex);
+    close(client->notify_fd[board->address]);
+    client->notify_fd[board->address] = -1;
+}
+
+/*
+*   Move data from the library scan buffer into the shared ring until the
+*   scan ends or the last client leaves.
+*/
+static void* pump_thread(void* arg)
+{
+    struct Board* board = (struct Board*)arg;
+    const struct ScanFunctions* fn = board->functions;
+    struct DaqhatsdScanRing* ring = board->ring;
+    struct pollfd pfd;
+    uint64_t write_count;
+    uint64_t counter;
+    uint32_t index;
+    uint32_t available;
+    uint32_t samples_read;
+    uint16_t status;
+    int event_fd;
+
+    event_fd = -1;
+    fn->a_in_scan_event_enable(board->address, 1, &event_fd);
+
+    write_count = 0;
+    status = 0;
+    while (!board->stop_pump)
+    {
+        if (fn->a_in_scan_status(board->address, &status, &available) !=
+            RESULT_SUCCESS)
+        {
+            status = 0;
+            break;
+        }
+
+        // read straight into the ring, up to the wrap point
+        index = write_count % ring->buffer_size;
+        if (available > (ring->buffer_size - index) / ring->channel_count)
+        {
+            available = (ring->buffer_size - index) / ring->channel_count;
+        }
+        samples_read = 0;
+        if (available > 0)
+        {
+            // reserve the space first so the clients can tell that data they
+            // are copying is being overwritten
+            __atomic_store_n(&ring->reserve_count,
+                write_count + (uint64_t)available * ring->channel_count,
+                __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+
+            if (fn->a_in_scan_read(board->address, &status, available, 0.0,
+                &ring->data[index], ring->buffer_size - index, &samples_read) !=
+                RESULT_SUCCESS)
+            {
+                status = 0;
+                break;
+            }
+        }
+
+        if (samples_read > 0)
+        {
+            write_count += (uint64_t)samples_read * ring->channel_count;
+            __atomic_store_n(&ring->write_count, write_count,
+                __ATOMIC_RELEASE);
+        }
+        if ((samples_read > 0) ||
+            (status != __atomic_load_n(&ring->status, __ATOMIC_RELAXED)))
+        {
+            __atomic_store_n(&ring->status, status, __ATOMIC_RELEASE);
+            notify_clients(board);
+        }
+
+        if (!(status & STATUS_RUNNING) && (samples_read == 0))
+        {
+            // finished, or stopped by an overrun
+            break;
+        }
+
+        if (samples_read == 0)
+        {
+            if (event_fd != -1)
+            {
+                pfd.fd = event_fd;
+                pfd.events = POLLIN;
+                if (poll(&pfd, 1, PUMP_WAIT_MS) > 0)
+                {
+                    if (read(event_fd, &counter, sizeof(counter)) < 0)
+                    {
+                        // nothing to reset
+                    }
+                }
+            }
+            else
+            {
+                usleep(1000);
+            }
+        }
+    }
+
+    __atomic_store_n(&ring->status, status & ~STATUS_RUNNING,
+        __ATOMIC_RELEASE);
+    notify_clients(board);
+    return NULL;
+}
+
+/*
+*   Create the shared ring for a board.
+*/
+static int create_ring(struct Board* board, uint32_t channel_count,
+    uint32_t buffer_size)
+{
+    char name[32];
+    size_t size;
+    void* ptr;
+    int fd;
+
+    snprintf(name, sizeof(name), DAQHATSD_SHM_NAME, board->address);
+    shm_unlink(name);
+    if ((fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0640)) == -1)
+    {
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    if ((fchown(fd, -1, access_group) != 0) ||
+        (fchmod(fd, 0640) != 0))
+    {
+        close(fd);
+        shm_unlink(name);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    size = sizeof(struct DaqhatsdScanRing) + buffer_size * sizeof(double);
+    if (ftruncate(fd, size) != 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    board->ring = (struct DaqhatsdScanRing*)ptr;
+    board->ring_size = size;
+    board->ring->channel_count = channel_count;
+    board->ring->buffer_size = buffer_size;
+    board->ring->write_count = 0;
+    board->ring->reserve_count = 0;
+    board->ring->status = STATUS_RUNNING;
+    board->ring->version = DAQHATSD_VERSION;
+    __atomic_store_n(&board->ring->magic, DAQHATSD_MAGIC, __ATOMIC_RELEASE);
+    return RESULT_SUCCESS;
+}
+
+/*
+*   Remove the shared ring for a board.  Clients that still map it keep their
+*   mapping until they clean up.
+*/
+static void destroy_ring(struct Board* board)
+{
+    char name[32];
+
+    if (board->ring != NULL)
+    {
+        munmap(board->ring, board->ring_size);
+        board->ring = NULL;
+        snprintf(name, sizeof(name), DAQHATSD_SHM_NAME, board->address);
+        shm_unlink(name);
+    }
+}
+
+/*
+*   Start a scan on a board and publish it.
+*/
+static int start_scan(struct Board* board,
+    const struct DaqhatsdRequest* request)
+{
+    const struct ScanFunctions* fn = board->functions;
+    uint32_t buffer_size;
+    int channel_count;
+    int result;
+
+    switch (board->id)
+    {
+    case HAT_ID_MCC_118:
+        result = mcc118_a_in_scan_start(board->address, request->channel_mask,
+            request->samples_per_channel, request->sample_rate_per_channel,
+            request->options);
+        break;
+    case HAT_ID_MCC_128:
+        result = mcc128_a_in_scan_start(board->address, request->channel_mask,
+            request->samples_per_channel, request->sample_rate_per_channel,
+            request->options);
+        break;
+    case HAT_ID_MCC_172:
+        result = RESULT_SUCCESS;
+        if (request->sample_rate_per_channel > 0.0)
+        {
+            result = mcc172_a_in_clock_config_write(board->address,
+                SOURCE_LOCAL, request->sample_rate_per_channel);
+        }
+        if (result == RESULT_SUCCESS)
+        {
+            result = mcc172_a_in_scan_start(board->address,
+                request->channel_mask, request->samples_per_channel,
+                request->options);
+        }
+        break;
+    default:
+        result = RESULT_INVALID_DEVICE;
+        break;
+    }
+    if (result != RESULT_SUCCESS)
+    {
+        return result;
+    }
+
+    channel_count = fn->a_in_scan_channel_count(board->address);
+    if (((result = fn->a_in_scan_buffer_size(board->address, &buffer_size)) !=
+            RESULT_SUCCESS) ||
+        ((result = create_ring(board, channel_count, buffer_size)) !=
+            RESULT_SUCCESS))
+    {
+        fn->a_in_scan_stop(board->address);
+        fn->a_in_scan_cleanup(board->address);
+        return result;
+    }
+
+    board->stop_pump = false;
+    if (pthread_create(&board->pump, NULL, pump_thread, board) != 0)
+    {
+        destroy_ring(board);
+        fn->a_in_scan_stop(board->address);
+        fn->a_in_scan_cleanup(board->address);
+        return RESULT_RESOURCE_UNAVAIL;
+    }
+
+    board->params = *request;
+    board->active = true;
+    board->users = 0;
+    if (verbose)
+    {
+        printf("Started scan on address %d, %d channels\n", board->address,
+            channel_count);
+    }
+    return RESULT_SUCCESS;
+}
+
+/*
+*   Stop a published scan.
+*/
+static void stop_scan(struct Board* board)
+{
+    if (!board->active)
+    {
+        return;
+    }
+
+    board->stop_pump = true;
+    pthread_join(board->pump, NULL);
+    board->functions->a_in_scan_stop(board->address);
+    board->functions->a_in_scan_cleanup(board->address);
+    destroy_ring(board);
+    board->active = false;
+    if (verbose)
+    {
+        printf("Stopped scan on address %d\n", board->address);
+    }
+}
+
+/*
+*   Release a client's use of a scan.
+*/
+static void leave_scan(struct Client* client, uint8_t address)
+{
+    if (client->joined & (1 << address))
+    {
+        client->joined &= ~(1 << address);
+        remove_notify(client, &boards[address]);
+        if (--boards[address].users == 0)
+        {
+            stop_scan(&boards[address]);
+        }
+    }
+}
+
+static bool same_scan(const struct DaqhatsdRequest* a,
+    const struct DaqhatsdRequest* b)
+{
+    return (a->channel_mask == b->channel_mask) &&
+        (a->samples_per_channel == b->samples_per_channel) &&
+        (a->sample_rate_per_channel == b->sample_rate_per_channel) &&
+        (a->options == b->options);
+}
+
+/*
+*   Handle one request from a client.  notify_fd receives a socket to pass to
+*   the client with the reply, or -1.
+*/
+static void handle_request(struct Client* client,
+    const struct DaqhatsdRequest* request, struct DaqhatsdReply* reply,
+    int* notify_fd)
+{
+    struct Board* board;
+
+    memset(reply, 0, sizeof(*reply));
+    *notify_fd = -1;
+    if (request->address >= MAX_NUMBER_HATS)
+    {
+        reply->result = RESULT_BAD_PARAMETER;
+        return;
+    }
+    board = &boards[request->address];
+    if (board->functions == NULL)
+    {
+        reply->result = RESULT_INVALID_DEVICE;
+        return;
+    }
+
+    switch (request->command)
+    {
+    case DAQHATSD_CMD_A_IN_READ:
+        if (board->id == HAT_ID_MCC_118)
+        {
+            reply->result = mcc118_a_in_read(board->address, request->channel,
+                request->options, &reply->value);
+        }
+        else if (board->id == HAT_ID_MCC_128)
+        {
+            reply->result = mcc128_a_in_read(board->address, request->channel,
+                request->options, &reply->value);
+        }
+        else
+        {
+            reply->result = RESULT_INVALID_DEVICE;
+        }
+        break;
+
+    case DAQHATSD_CMD_SCAN_START:
+        if (client->joined & (1 << board->address))
+        {
+            reply->result = RESULT_BUSY;
+        }
+        else if (board->active)
+        {
+            // join the running scan if it is the one requested
+            if (same_scan(&board->params, request) &&
+                (__atomic_load_n(&board->ring->status, __ATOMIC_ACQUIRE) &
+                    STATUS_RUNNING))
+            {
+                reply->start_count = __atomic_load_n(
+                    &board->ring->write_count, __ATOMIC_ACQUIRE);
+                reply->result = RESULT_SUCCESS;
+            }
+            else
+            {
+                reply->result = RESULT_BUSY;
+            }
+        }
+        else
+        {
+            reply->result = start_scan(board, request);
+        }
+
+        if (reply->result == RESULT_SUCCESS)
+        {
+            if ((*notify_fd = add_notify(client, board)) != -1)
+            {
+                client->joined |= (1 << board->address);
+                board->users++;
+            }
+            else
+            {
+                if (board->users == 0)
+                {
+                    stop_scan(board);
+                }
+                reply->result = RESULT_RESOURCE_UNAVAIL;
+            }
+        }
+        break;
+
+    case DAQHATSD_CMD_SCAN_STOP:
+        leave_scan(client, board->address);
+        reply->result = RESULT_SUCCESS;
+        break;
+
+    default:
+        reply->result = RESULT_BAD_PARAMETER;
+        break;
+    }
+}
+
+/*
+*   Open all supported boards.
+*/
+static int open_boards(void)
+{
+    struct HatInfo* list;
+    int count;
+    int index;
+    int opened;
+    uint8_t address;
+
+    count = hat_list(HAT_ID_ANY, NULL);
+    if (count <= 0)
+    {
+        return 0;
+    }
+    list = (struct HatInfo*)malloc(count * sizeof(struct HatInfo));
+    if (list == NULL)
+    {
+        return 0;
+    }
+    hat_list(HAT_ID_ANY, list);
+
+    opened = 0;
+    for (index = 0; index < count; index++)
+    {
+        address = list[index].address;
+        boards[address].address = address;
+        boards[address].id = list[index].id;
+        switch (list[index].id)
+        {
+        case HAT_ID_MCC_118:
+            if (mcc118_open(address) == RESULT_SUCCESS)
+            {
+                boards[address].functions = &mcc118_functions;
+            }
+            break;
+        case HAT_ID_MCC_128:
+            if (mcc128_open(address) == RESULT_SUCCESS)
+            {
+                boards[address].functions = &mcc128_functions;
+            }
+            break;
+        case HAT_ID_MCC_172:
+            if (mcc172_open(address) == RESULT_SUCCESS)
+            {
+                boards[address].functions = &mcc172_functions;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if (boards[address].functions != NULL)
+        {
+            opened++;
+            if (verbose)
+            {
+                printf("Opened %s at address %d\n", list[index].product_name,
+                    address);
+            }
+        }
+    }
+
+    free(list);
+    return opened;
+}
+
+/*
+*   Send a reply to a client, passing a socket with it if notify_fd is not -1.
+*/
+static void send_reply(int fd, struct DaqhatsdReply* reply, int notify_fd)
+{
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr* cmsg;
+
+    iov.iov_base = reply;
+    iov.iov_len = sizeof(*reply);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (notify_fd != -1)
+    {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &notify_fd, sizeof(int));
+    }
+
+    sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (notify_fd != -1)
+    {
+        close(notify_fd);
+    }
+}
+
+static int create_socket(void)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, DAQHATSD_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    unlink(DAQHATSD_SOCKET_PATH);
+    if ((bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+        (chown(DAQHATSD_SOCKET_PATH, -1, access_group) != 0) ||
+        (chmod(DAQHATSD_SOCKET_PATH, 0660) != 0) ||
+        (listen(fd, 8) != 0))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[])
+{
+    struct pollfd fds[MAX_CLIENTS + 1];
+    struct DaqhatsdRequest request;
+    struct DaqhatsdReply reply;
+    struct sigaction action;
+    struct group* entry;
+    const char* group;
+    int client_count;
+    int listen_fd;
+    int index;
+    int fd;
+    ssize_t size;
+    uint8_t address;
+    int notify_fd;
+    int opt;
+
+    group = DEFAULT_GROUP;
+    while ((opt = getopt(argc, argv, "vg:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'v':
+            verbose = true;
+            break;
+        case 'g':
+            group = optarg;
+            break;
+        default:
+            printf("Usage: daqhatsd [-v] [-g group]\n");
+            return 1;
+        }
+    }
+    if (optind < argc)
+    {
+        printf("Usage: daqhatsd [-v] [-g group]\n");
+        return 1;
+    }
+
+    // the group allowed to use the daemon
+    if ((entry = getgrnam(group)) == NULL)
+    {
+        printf("Unknown group %s\n", group);
+        return 1;
+    }
+    access_group = entry->gr_gid;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = signal_handler;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        pthread_mutex_init(&boards[address].notify_mutex, NULL);
+    }
+
+    if (open_boards() == 0)
+    {
+        printf("No supported boards found\n");
+        return 1;
+    }
+
+    if ((listen_fd = create_socket()) == -1)
+    {
+        printf("Can't create %s: %s\n", DAQHATSD_SOCKET_PATH,
+            strerror(errno));
+        return 1;
+    }
+
+    client_count = 0;
+    while (running)
+    {
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (index = 0; index < client_count; index++)
+        {
+            fds[index + 1].fd = clients[index].fd;
+            fds[index + 1].events = POLLIN;
+            fds[index + 1].revents = 0;
+        }
+
+        if (poll(fds, client_count + 1, -1) < 0)
+        {
+            continue;
+        }
+
+        // service existing clients, removing those that disconnected
+        for (index = client_count - 1; index >= 0; index--)
+        {
+            if (fds[index + 1].revents == 0)
+            {
+                continue;
+            }
+            size = recv(clients[index].fd, &request, sizeof(request), 0);
+            if (size == (ssize_t)sizeof(request))
+            {
+                handle_request(&clients[index], &request, &reply, &notify_fd);
+                send_reply(clients[index].fd, &reply, notify_fd);
+                continue;
+            }
+
+            for (address = 0; address < MAX_NUMBER_HATS; address++)
+            {
+                leave_scan(&clients[index], address);
+            }
+            close(clients[index].fd);
+            clients[index] = clients[--client_count];
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd != -1)
+            {
+                if (client_count < MAX_CLIENTS)
+                {
+                    clients[client_count].fd = fd;
+                    clients[client_count].joined = 0;
+                    client_count++;
+                }
+                else
+                {
+                    close(fd);
+                }
+            }
+        }
+    }
+
+    for (index = 0; index < client_count; index++)
+    {
+        for (address = 0; address < MAX_NUMBER_HATS; address++)
+        {
+            leave_scan(&clients[index], address);
+        }
+        close(clients[index].fd);
+    }
+    close(listen_fd);
+    unlink(DAQHATSD_SOCKET_PATH);
+
+    for (address = 0; address < MAX_NUMBER_HATS; address++)
+    {
+        if (boards[address].functions != NULL)
+        {
+            stop_scan(&boards[address]);
+            boards[address].functions->close(address);
+        }
+    }
+    return 0;
+}
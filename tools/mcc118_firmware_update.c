@@ -6,6 +6,7 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "daqhats.h"
 #include "mcc118_update.h"
 
@@ -30,20 +31,78 @@
 
 uint8_t virtual_flash[TOTAL_LENGTH];
 
+// The hex file records sent to the bootloader, each preceded by its length,
+// so all the boards are written from one read of the file
+uint8_t* hex_records;
+size_t hex_records_size;
+
 uint32_t ext_lin_address;
 uint32_t ext_seg_address;
 
 uint16_t hex_user_version;
 uint16_t hex_boot_version;
 
+// The state of the update of one board
+struct Update
+{
+    uint8_t address;
+    pthread_t thread;
+    bool entered;
+    bool started;
+    bool success;
+    const char* step;
+    uint16_t old_version;
+    uint16_t new_version;
+};
+
 void print_usage(void)
 {
     // don't advertise bootloader update option
-    printf("Usage: mcc118_firmware_update <address> <hex file>\n");
-    printf("  address: the board address (0-7)\n");
+    printf("Usage: mcc118_firmware_update <address>[,<address>...] "
+        "<hex file>\n");
+    printf("  address: the board address (0-7), a comma separated list of "
+        "addresses, or\n");
+    printf("           all to update every MCC 118 at the same time\n");
     printf("  hex file: the name of the hex file containing the firmware\n");
 }
 
+// Parse a comma separated list of addresses, or all.  Returns the number of
+// addresses, or 0 if the list is not valid.
+int parse_addresses(char* s, uint8_t* addresses)
+{
+    struct HatInfo list[MAX_NUMBER_HATS];
+    uint8_t mask;
+    unsigned int address;
+    char* token;
+    int count;
+    int index;
+
+    if (strcmp(s, "all") == 0)
+    {
+        count = hat_list(HAT_ID_MCC_118, list);
+        for (index = 0; index < count; index++)
+        {
+            addresses[index] = list[index].address;
+        }
+        return count;
+    }
+
+    count = 0;
+    mask = 0;
+    for (token = strtok(s, ","); token != NULL; token = strtok(NULL, ","))
+    {
+        if ((sscanf(token, "%u", &address) != 1) ||
+            (address >= MAX_NUMBER_HATS) ||
+            (mask & (1 << address)))
+        {
+            return 0;
+        }
+        mask |= 1 << address;
+        addresses[count++] = address;
+    }
+    return count;
+}
+
 uint16_t convert_hex_line(char* s, uint8_t* buffer, uint16_t max)
 {
     int len;
@@ -361,21 +420,100 @@ char kbhit(void)
     return c;
 }
 
-// Update the main firmware
-int update_firmware(int address, char* filename)
+// Erase and write the main firmware from the hex file records, then verify it
+bool write_firmware(int address, const char** step)
 {
+    uint16_t crc_calc;
+    uint16_t crc;
+    size_t offset;
+
+    // erase the flash memory
+    *step = "erase";
+    if (mcc118_bl_erase(address) != RESULT_SUCCESS)
+    {
+        return false;
+    }
+
+    // write the data from the hex file
+    *step = "write";
+    for (offset = 0; offset < hex_records_size;
+        offset += hex_records[offset] + 1)
+    {
+        if (mcc118_bl_write(address, &hex_records[offset + 1],
+            hex_records[offset]) != RESULT_SUCCESS)
+        {
+            return false;
+        }
+    }
+
+    // read the CRC and compare
+    *step = "verify";
+    if (mcc118_bl_read_crc(address, USER_START, USER_LENGTH, &crc) !=
+        RESULT_SUCCESS)
+    {
+        return false;
+    }
+
+    crc_calc = calculate_crc(USER_LENGTH, &virtual_flash[USER_START]);
+    return (crc == crc_calc);
+}
+
+// Update one board that is in the bootloader; runs in its own thread so the
+// boards share the bus and their restart delays overlap
+void* update_board(void* arg)
+{
+    struct Update* update = (struct Update*)arg;
+    uint16_t boot_version;
+
+    update->success = false;
+
+    if (!write_firmware(update->address, &update->step))
+    {
+        mcc118_close(update->address);
+        return NULL;
+    }
+
+    // jump to new firmware
+    update->step = "start firmware";
+    if (mcc118_bl_jump(update->address) != RESULT_SUCCESS)
+    {
+        mcc118_close(update->address);
+        return NULL;
+    }
+    mcc118_close(update->address);
+
+    // wait for device to enter main firmware
+    usleep(800000);
+
+    update->step = "check device";
+    if (mcc118_open(update->address) != RESULT_SUCCESS)
+    {
+        return NULL;
+    }
+    if (mcc118_firmware_version(update->address, &update->new_version,
+        &boot_version) == RESULT_SUCCESS)
+    {
+        update->success = true;
+    }
+    mcc118_close(update->address);
+    return NULL;
+}
+
+// Update the main firmware on one or more boards
+int update_firmware(uint8_t* addresses, int count, char* filename)
+{
+    struct Update updates[MAX_NUMBER_HATS];
     char string[256];
     uint8_t buffer[128];
+    uint8_t* records;
     FILE* file;
-    int fd;
-    int count;
-    uint8_t rec_type;
-    uint16_t crc_calc;
     uint32_t flash_address;
-    uint16_t crc;
-    uint16_t fw_version;
+    uint16_t length;
+    uint8_t rec_type;
     uint16_t boot_version;
-    char c;
+    int index;
+    int failed;
+    char c = 0;
 
     init_virtual_flash();
     
@@ -393,131 +531,150 @@ int update_firmware(int address, char* filename)
         fclose(file);
         return 1;
     }
+
+    // read the hex file into virtual flash and keep the records to send
+    hex_records_size = 0;
+    while (fgets(string, 256, file) != NULL)
+    {
+        if ((length = process_hex_line(string, buffer, 128, &rec_type,
+            &flash_address)) == 0)
+        {
+            continue;
+        }
+
+        // data, don't send records in the bootloader region
+        if ((rec_type == 0) &&
+            ((flash_address < USER_START) ||
+             (flash_address >= (USER_START+USER_LENGTH))))
+        {
+            continue;
+        }
+
+        records = (uint8_t*)realloc(hex_records,
+            hex_records_size + length + 1);
+        if (records == NULL)
+        {
+            printf("Error - out of memory.\n");
+            fclose(file);
+            return 1;
+        }
+        hex_records = records;
+        hex_records[hex_records_size] = (uint8_t)length;
+        memcpy(&hex_records[hex_records_size + 1], buffer, length);
+        hex_records_size += length + 1;
+    }
+    fclose(file);
     
     printf("Checking versions...\n");
     
     printf("Hex file firmware version %X.%02X\n",
         (uint8_t)(hex_user_version >> 8), (uint8_t)hex_user_version);
-        
-    if (mcc118_open(address) != RESULT_SUCCESS)
+
+    for (index = 0; index < count; index++)
     {
-        printf("Error opening the device at address %d.\n", address);
-        fclose(file);
-        return 1;
+        updates[index].address = addresses[index];
+        updates[index].entered = false;
+        updates[index].started = false;
+        updates[index].success = false;
+        updates[index].step = "open";
+        updates[index].new_version = 0;
+
+        if (mcc118_open(addresses[index]) != RESULT_SUCCESS)
+        {
+            printf("Error opening the device at address %d.\n",
+                addresses[index]);
+            break;
+        }
+
+        if (mcc118_firmware_version(addresses[index],
+            &updates[index].old_version, &boot_version) != RESULT_SUCCESS)
+        {
+            printf("Error getting the firmware version at address %d.\n",
+                addresses[index]);
+            mcc118_close(addresses[index]);
+            break;
+        }
+  
+        printf("Device firmware version   %X.%02X (address %d)\n",
+            (uint8_t)(updates[index].old_version >> 8),
+            (uint8_t)updates[index].old_version, addresses[index]);
     }
-    
-    if (mcc118_firmware_version(address, &fw_version, &boot_version) !=
-        RESULT_SUCCESS)
+
+    if (index == count)
     {
-        printf("Error getting the firmware version.\n");
-        return 1;
-    }
-  
-    printf("Device firmware version   %X.%02X\n", 
-        (uint8_t)(fw_version >> 8), (uint8_t)fw_version);
+        printf("Do you want to continue? Press Y to continue, any other key "
+            "to exit. > ");
 
-    printf("Do you want to continue? Press Y to continue, any other key to "
-        "exit. > ");
-    
-    c = kbhit();
-    printf("\n");
+        c = kbhit();
+        printf("\n");
+    }
     
-    if (!((c == 'y') || (c == 'Y')))
+    if ((index < count) || !((c == 'y') || (c == 'Y')))
     {
         printf("Exiting\n");
-        fclose(file);
-        mcc118_close(address);
+        while (index-- > 0)
+        {
+            mcc118_close(addresses[index]);
+        }
         return 1;
     }
-    
-    if (mcc118_enter_bootloader(address) != RESULT_SUCCESS)
+
+    printf("Updating...\n");
+
+    // Put every board in the bootloader before any board is erased.  A board
+    // must get the bootloader command within 500 ms of its reset, and an
+    // erase holds the bus for up to a second.
+    for (index = 0; index < count; index++)
     {
-        printf("Error entering the bootloader.\n");
-        mcc118_close(address);
-        fclose(file);
-        return 1;
+        updates[index].step = "enter bootloader";
+        updates[index].entered = (mcc118_enter_bootloader(
+            updates[index].address) == RESULT_SUCCESS);
+        if (!updates[index].entered)
+        {
+            mcc118_close(updates[index].address);
+        }
     }
-        
-    // erase the flash memory
-    printf("Erasing...");
-    if (mcc118_bl_erase(address) != RESULT_SUCCESS)
+
+    for (index = 0; index < count; index++)
     {
-        printf("Error\n");
-        mcc118_close(address);
-        fclose(file);
-        return 1;
+        if (!updates[index].entered)
+        {
+            continue;
+        }
+        updates[index].started = (pthread_create(&updates[index].thread,
+            NULL, &update_board, &updates[index]) == 0);
+        if (!updates[index].started)
+        {
+            update_board(&updates[index]);
+        }
     }
-    printf("done\n");
-    
-    // write the data from the hex file
-    printf("Writing...");
-    while (fgets(string, 256, file) != NULL)
+
+    failed = 0;
+    for (index = 0; index < count; index++)
     {
-        if ((count = process_hex_line(string, buffer, 128, &rec_type,
-            &flash_address)) == 0)
+        if (updates[index].started)
         {
-            continue;
+            pthread_join(updates[index].thread, NULL);
         }
-        
-        switch (rec_type)
+
+        if (updates[index].success)
         {
-        case 0:
-            // data, don't send records in the bootloader region
-            if ((flash_address < USER_START) ||
-                (flash_address >= (USER_START+USER_LENGTH)))
-            {
-                // skip line
-                continue;
-            }
-            break;
-        default:
-            break;
+            printf("Address %d: firmware version %X.%02X -> %X.%02X\n",
+                updates[index].address,
+                (uint8_t)(updates[index].old_version >> 8),
+                (uint8_t)updates[index].old_version,
+                (uint8_t)(updates[index].new_version >> 8),
+                (uint8_t)updates[index].new_version);
         }
-        
-        // send the record to the device
-        if (mcc118_bl_write(address, buffer, count) != RESULT_SUCCESS)
+        else
         {
-            printf("error\n");
-            fclose(file);
-            mcc118_close(address);
-            return 1;
+            printf("Address %d: error during %s\n", updates[index].address,
+                updates[index].step);
+            failed++;
         }
     }
-    fclose(file);
-    printf("done\n");
-    
-    // read the CRC and compare
-    printf("Verifying...");
-    if (mcc118_bl_read_crc(address, USER_START, USER_LENGTH, &crc) !=
-        RESULT_SUCCESS)
-    {
-        printf("error\n");
-        mcc118_close(address);
-        return 1;
-    }
-    
-    crc_calc = calculate_crc(USER_LENGTH, &virtual_flash[USER_START]);
-    if (crc != crc_calc)
-    {
-        printf("CRC mismatch %04X vs %04X\n", crc_calc, crc);
-        mcc118_close(address);
-        return 1;
-    }
-    printf("done\n");
-    
-    // jump to new firmware
-    printf("Starting firmware...");
-    if (mcc118_bl_jump(address) != RESULT_SUCCESS)
-    {
-        printf("error\n");
-        mcc118_close(address);
-        return 1;
-    }
 
-    printf("done\n");
-    
-    mcc118_close(address);
-    return 0;
+    return (failed == 0) ? 0 : 1;
 }
 
 int update_bootloader(int address, char* filename)
@@ -675,12 +832,12 @@ int update_bootloader(int address, char* filename)
 
 int main(int argc, char* argv[])
 {
-    unsigned int address;
+    uint8_t addresses[MAX_NUMBER_HATS];
     uint8_t address_index;
     uint8_t hexfile_index;
     char filename[1024];
     bool write_bootloader;
-    int result;
+    int count;
     uint16_t fw_version;
     uint16_t boot_version;
     
@@ -710,8 +867,9 @@ int main(int argc, char* argv[])
         hexfile_index = 2;
     }
     
-    if ((sscanf(argv[address_index], "%u", &address) != 1) ||
-        (address >= MAX_NUMBER_HATS))
+    count = parse_addresses(argv[address_index], addresses);
+    if ((count == 0) ||
+        (write_bootloader && (count != 1)))
     {
         print_usage();
         return 1;
@@ -723,16 +881,13 @@ int main(int argc, char* argv[])
         return 1;
     }
     
-    if (write_bootloader)
+    if (!write_bootloader)
     {
-        result = update_bootloader(address, filename);
+        // each board is checked after its update
+        return update_firmware(addresses, count, filename);
     }
-    else
-    {
-        result = update_firmware(address, filename);
-    }
-    
-    if (result == 1)
+
+    if (update_bootloader(addresses[0], filename) == 1)
     {
         return 1;
     }
@@ -741,27 +896,19 @@ int main(int argc, char* argv[])
     // wait for device to enter main firmware
     usleep(800000);
     
-    if (mcc118_open(address) != RESULT_SUCCESS)
+    if (mcc118_open(addresses[0]) != RESULT_SUCCESS)
     {
         printf("error\n");
         return 1;
     }
-    if (mcc118_firmware_version(address, &fw_version, &boot_version) !=
+    if (mcc118_firmware_version(addresses[0], &fw_version, &boot_version) !=
         RESULT_SUCCESS)
     {
         printf("error\n");
         return 1;
     }
     
-    if (write_bootloader)
-    {
-        printf("bootloader version %X.%02X\n", 
-            (uint8_t)(boot_version >> 8), (uint8_t)boot_version);
-    }
-    else
-    {
-        printf("firmware version %X.%02X\n", 
-            (uint8_t)(fw_version >> 8), (uint8_t)fw_version);
-    }
+    printf("bootloader version %X.%02X\n", 
+        (uint8_t)(boot_version >> 8), (uint8_t)boot_version);
     return 0;
 }
@@ -9,6 +9,7 @@
 #include <sys/stat.h>
 #include <linux/spi/spidev.h>
 #include <termios.h>
+#include <pthread.h>
 #include "gpio.h"
 #include "util.h"
 #include "daqhats.h"
@@ -17,15 +18,69 @@
 // allocated at run time to contain the entire file
 uint8_t* frame_file_buffer;
 uint32_t frame_file_size;
-uint32_t frame_file_index;
+
+// The bootloaders signal that they are ready on the shared interrupt line, so
+// only one board at a time may be in the bootloader
+pthread_mutex_t bootloader_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// The state of the update of one board
+struct Update
+{
+    uint8_t address;
+    pthread_t thread;
+    bool started;
+    bool success;
+    const char* step;
+    uint32_t frame_file_index;
+    uint16_t new_version;
+};
 
 void print_usage(void)
 {
-    printf("Usage: mcc128_firmware_update <address> <file>\n");
-    printf("  address: the board address (0-7)\n");
+    printf("Usage: mcc128_firmware_update <address>[,<address>...] <file>\n");
+    printf("  address: the board address (0-7), a comma separated list of "
+        "addresses, or\n");
+    printf("           all to update every MCC 128\n");
     printf("  file: the name of the firmware file\n");
 }
 
+// Parse a comma separated list of addresses, or all.  Returns the number of
+// addresses, or 0 if the list is not valid.
+int parse_addresses(char* s, uint8_t* addresses)
+{
+    struct HatInfo list[MAX_NUMBER_HATS];
+    uint8_t mask;
+    unsigned int address;
+    char* token;
+    int count;
+    int index;
+
+    if (strcmp(s, "all") == 0)
+    {
+        count = hat_list(HAT_ID_MCC_128, list);
+        for (index = 0; index < count; index++)
+        {
+            addresses[index] = list[index].address;
+        }
+        return count;
+    }
+
+    count = 0;
+    mask = 0;
+    for (token = strtok(s, ","); token != NULL; token = strtok(NULL, ","))
+    {
+        if ((sscanf(token, "%u", &address) != 1) ||
+            (address >= MAX_NUMBER_HATS) ||
+            (mask & (1 << address)))
+        {
+            return 0;
+        }
+        mask |= 1 << address;
+        addresses[count++] = address;
+    }
+    return count;
+}
+
 char kbhit(void)
 {
     struct termios info, old_info;
@@ -48,14 +103,15 @@ char kbhit(void)
 }
 
 // Return a pointer to the next frame in the frame buffer and the size of the
-// frame.  frame_file_index must be set to 0 before first use.
-int get_next_frame(uint8_t** frame_ptr, bool* last_frame)
+// frame.  *frame_file_index must be set to 0 before first use.
+int get_next_frame(uint32_t* frame_file_index, uint8_t** frame_ptr,
+    bool* last_frame)
 {
     uint32_t index;
     uint8_t* ptr;
     uint16_t len;
 
-    index = frame_file_index;
+    index = *frame_file_index;
     ptr = &frame_file_buffer[index];
 
     if (index >= frame_file_size)
@@ -80,11 +136,11 @@ int get_next_frame(uint8_t** frame_ptr, bool* last_frame)
         *frame_ptr = ptr;
     }
 
-    frame_file_index += (len + 2);
+    *frame_file_index += (len + 2);
 
     if (last_frame)
     {
-        if (frame_file_index >= frame_file_size)
+        if (*frame_file_index >= frame_file_size)
         {
             *last_frame = true;
         }
@@ -96,14 +152,11 @@ int get_next_frame(uint8_t** frame_ptr, bool* last_frame)
     return len + 2;
 }
 
-int update_firmware(int address, char* filename)
+// Send the firmware frames to one board
+bool write_firmware(struct Update* update)
 {
-    int ret;
     uint8_t tx_data[256];
     uint8_t rx_data[256];
-//    int count;
-    int i;
-    FILE* binfile;
     bool finished;
     bool first_read;
     bool error;
@@ -113,82 +166,16 @@ int update_firmware(int address, char* filename)
     int tr_len;
     int count;
     bool last_frame;
-    struct stat st;
-    char c;
-    uint16_t fw_version;
-
-    if ((stat(filename, &st) == -1) ||
-        (st.st_size == 0) ||
-        ((binfile = fopen(filename, "rb")) == NULL))
-    {
-        printf("Error opening %s.\n", filename);
-        return 1;
-    }
-
-    frame_file_size = st.st_size;
-    frame_file_buffer = (uint8_t*)calloc(1, frame_file_size);
-
-    if (fread(frame_file_buffer, 1, frame_file_size, binfile) != frame_file_size)
-    {
-        printf("Error reading %s.", filename);
-        free(frame_file_buffer);
-        fclose(binfile);
-        return 1;
-    }
-
-    fclose(binfile);
-    frame_file_index = 0;
-
-    ret = mcc128_open(address);
-    if (ret == RESULT_SUCCESS)
-    {
-        if (mcc128_firmware_version(address, &fw_version) == RESULT_SUCCESS)
-        {
-            printf("Checking existing version...\n");
-
-            printf("Device firmware version %X.%02X\n",
-                (uint8_t)(fw_version >> 8), (uint8_t)fw_version);
-        }
-    }
-    else if (ret == RESULT_INVALID_DEVICE)
-    {
-        printf("The device at address %d is not an MCC 128.\n", address);
-        free(frame_file_buffer);
-        return 1;
-    }
-    else
-    {
-        ret = mcc128_open_for_update(address);
-        if (ret == RESULT_SUCCESS)
-        {
-            printf("The device at address %d cannot be confirmed as an MCC 128.\n",
-                address);
-        }
-        else
-        {
-            printf("Unable to update the device: %d\n", ret);
-            free(frame_file_buffer);
-            return 1;
-        }
-    }
-    printf("Do you want to continue? Press Y to continue, any other key to "
-        "exit. > ");
 
-    c = kbhit();
-    printf("\n");
+    update->frame_file_index = 0;
 
-    if (!((c == 'y') || (c == 'Y')))
+    update->step = "enter bootloader";
+    if (mcc128_enter_bootloader(update->address) != RESULT_SUCCESS)
     {
-        printf("Exiting\n");
-        free(frame_file_buffer);
-        mcc128_close(address);
-        return 1;
+        return false;
     }
 
-    printf("Updating...\n");
-
-    mcc128_enter_bootloader(address);
-
+    update->step = "write";
     finished = false;
     error = false;
     first_read = true;
@@ -224,7 +211,7 @@ int update_firmware(int address, char* filename)
             tr_len = 1;
         }
 
-        if (mcc128_bl_transfer(address, tx_data, rx_data, tr_len) != RESULT_SUCCESS)
+        if (mcc128_bl_transfer(update->address, tx_data, rx_data, tr_len) != RESULT_SUCCESS)
         {
             printf("Error: ioctl failed\n");
         }
@@ -249,14 +236,15 @@ int update_firmware(int address, char* filename)
             tx_data[0] = 0xDC;
             tx_data[1] = 0xAA;
             tr_len = 2;
-            if (mcc128_bl_transfer(address, tx_data, NULL, tr_len) != RESULT_SUCCESS)
+            if (mcc128_bl_transfer(update->address, tx_data, NULL, tr_len) != RESULT_SUCCESS)
             {
                 printf("Error: ioctl failed\n");
             }
             break;
         case 0x80:  // WAITING_FRAME_DATA
             //printf("Status: WAITING_FRAME_DATA %02X, ", rx_data[0]);
-            length = get_next_frame(&ptr, &last_frame);
+            length = get_next_frame(&update->frame_file_index, &ptr,
+                &last_frame);
             if (length == -1)
             {
                 printf("invalid frame signature\n");
@@ -264,13 +252,13 @@ int update_firmware(int address, char* filename)
             }
             else if (length == 0)
             {
-                printf("data file complete\n");
+                printf("Address %d: data file complete\n", update->address);
                 finished = true;
             }
             else
             {
                 //printf("sending next frame\n");
-                if (mcc128_bl_transfer(address, ptr, NULL, length) != RESULT_SUCCESS)
+                if (mcc128_bl_transfer(update->address, ptr, NULL, length) != RESULT_SUCCESS)
                 {
                     printf("Error: ioctl failed\n");
                 }
@@ -284,7 +272,7 @@ int update_firmware(int address, char* filename)
             tr.tx_buf = (uintptr_t)tx_data;
             tr.rx_buf = (uintptr_t)NULL;
             tr_len = 2;
-            if (mcc128_bl_transfer(address, tx_data, NULL, tr_len) != RESULT_SUCCESS)
+            if (mcc128_bl_transfer(update->address, tx_data, NULL, tr_len) != RESULT_SUCCESS)
             {
                 printf("Error: ioctl failed\n");
             }
@@ -324,78 +312,204 @@ int update_firmware(int address, char* filename)
         usleep(2);
     }
 
-    free(frame_file_buffer);
-    mcc128_close(address);
+    return !error;
+}
 
-    if (error)
+// Update one board; runs in its own thread so the restart of each board
+// overlaps the updates of the others
+void* update_board(void* arg)
+{
+    struct Update* update = (struct Update*)arg;
+    int retry_count;
+    bool result;
+
+    update->success = false;
+
+    pthread_mutex_lock(&bootloader_mutex);
+    result = write_firmware(update);
+    mcc128_close(update->address);
+    pthread_mutex_unlock(&bootloader_mutex);
+
+    if (!result)
     {
-        return 1;
+        return NULL;
     }
-    else
+
+    // wait for device to boot the new firmware
+    update->step = "check device";
+    retry_count = 0;
+    do
     {
-        printf("Finished\n");
-        return 0;
-    }
+        sleep(1);
+
+        if (mcc128_open(update->address) == RESULT_SUCCESS)
+        {
+            if (mcc128_firmware_version(update->address,
+                &update->new_version) == RESULT_SUCCESS)
+            {
+                update->success = true;
+            }
+            mcc128_close(update->address);
+        }
+        retry_count++;
+    } while ((retry_count < 5) && !update->success);
+
+    return NULL;
 }
 
-int main(int argc, char* argv[])
+// Update the firmware on one or more boards
+int update_firmware(uint8_t* addresses, int count, char* filename)
 {
-    int address;
-    int retry_count;
-    bool success;
-    char* filename;
+    struct Update updates[MAX_NUMBER_HATS];
+    FILE* binfile;
+    struct stat st;
     uint16_t fw_version;
+    int index;
+    int failed;
+    int ret;
+    char c = 0;
 
-    // validate arguments
-    if (argc != 3)
+    if ((stat(filename, &st) == -1) ||
+        (st.st_size == 0) ||
+        ((binfile = fopen(filename, "rb")) == NULL))
     {
-        print_usage();
+        printf("Error opening %s.\n", filename);
         return 1;
     }
 
-    if ((sscanf(argv[1], "%u", &address) != 1) ||
-        (address > 7))
+    frame_file_size = st.st_size;
+    frame_file_buffer = (uint8_t*)calloc(1, frame_file_size);
+
+    if (fread(frame_file_buffer, 1, frame_file_size, binfile) != frame_file_size)
     {
-        print_usage();
+        printf("Error reading %s.", filename);
+        free(frame_file_buffer);
+        fclose(binfile);
         return 1;
     }
 
-    filename = argv[2];
+    fclose(binfile);
+
+    printf("Checking existing version...\n");
+    for (index = 0; index < count; index++)
+    {
+        updates[index].address = addresses[index];
+        updates[index].started = false;
+        updates[index].success = false;
+        updates[index].step = "open";
+        updates[index].new_version = 0;
+
+        ret = mcc128_open(addresses[index]);
+        if (ret == RESULT_SUCCESS)
+        {
+            if (mcc128_firmware_version(addresses[index], &fw_version) ==
+                RESULT_SUCCESS)
+            {
+                printf("Device firmware version %X.%02X (address %d)\n",
+                    (uint8_t)(fw_version >> 8), (uint8_t)fw_version,
+                    addresses[index]);
+            }
+        }
+        else if (ret == RESULT_INVALID_DEVICE)
+        {
+            printf("The device at address %d is not an MCC 128.\n",
+                addresses[index]);
+            break;
+        }
+        else
+        {
+            ret = mcc128_open_for_update(addresses[index]);
+            if (ret == RESULT_SUCCESS)
+            {
+                printf("The device at address %d cannot be confirmed as an "
+                    "MCC 128.\n", addresses[index]);
+            }
+            else
+            {
+                printf("Unable to update the device at address %d: %d\n",
+                    addresses[index], ret);
+                break;
+            }
+        }
+    }
+
+    if (index == count)
+    {
+        printf("Do you want to continue? Press Y to continue, any other key "
+            "to exit. > ");
 
-    // update the firmware
-    if (update_firmware(address, filename) == 1)
+        c = kbhit();
+        printf("\n");
+    }
+
+    if ((index < count) || !((c == 'y') || (c == 'Y')))
     {
+        printf("Exiting\n");
+        free(frame_file_buffer);
+        while (index-- > 0)
+        {
+            mcc128_close(addresses[index]);
+        }
         return 1;
     }
 
-    // check the device
-    printf("Checking device...\n");
+    printf("Updating...\n");
+    for (index = 0; index < count; index++)
+    {
+        updates[index].started = (pthread_create(&updates[index].thread,
+            NULL, &update_board, &updates[index]) == 0);
+        if (!updates[index].started)
+        {
+            update_board(&updates[index]);
+        }
+    }
 
-    // wait for device to boot the new firmware
-    retry_count = 0;
-    success = false;
-    do
+    failed = 0;
+    for (index = 0; index < count; index++)
     {
-        sleep(1);
+        if (updates[index].started)
+        {
+            pthread_join(updates[index].thread, NULL);
+        }
 
-        if (mcc128_open(address) == RESULT_SUCCESS)
+        if (updates[index].success)
         {
-            if (mcc128_firmware_version(address, &fw_version) == RESULT_SUCCESS)
-            {
-                success = true;
-                printf("firmware version %X.%02X\n",
-                    (uint8_t)(fw_version >> 8), (uint8_t)fw_version);
-            }
+            printf("Address %d: firmware version %X.%02X\n",
+                updates[index].address,
+                (uint8_t)(updates[index].new_version >> 8),
+                (uint8_t)updates[index].new_version);
+        }
+        else
+        {
+            printf("Address %d: error during %s\n", updates[index].address,
+                updates[index].step);
+            failed++;
         }
-    } while ((retry_count < 5) && !success);
+    }
 
-    if (!success)
+    free(frame_file_buffer);
+    return (failed == 0) ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    uint8_t addresses[MAX_NUMBER_HATS];
+    int count;
+
+    // validate arguments
+    if (argc != 3)
     {
-        printf("Error\n");
+        print_usage();
         return 1;
     }
-    else
+
+    count = parse_addresses(argv[1], addresses);
+    if (count == 0)
     {
-        return 0;
+        print_usage();
+        return 1;
     }
+
+    // update the firmware; each board is checked after its update
+    return update_firmware(addresses, count, argv[2]);
 }